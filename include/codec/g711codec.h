@@ -61,6 +61,7 @@ class Opal_G711_uLaw_PCM : public Opal_G711_PCM {
   public:
     Opal_G711_uLaw_PCM();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples);
     static int ConvertSample(int sample);
 };
 
@@ -71,6 +72,7 @@ class Opal_PCM_G711_uLaw : public OpalStreamedTranscoder {
   public:
     Opal_PCM_G711_uLaw();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples);
     static int ConvertSample(int sample);
 };
 
@@ -81,6 +83,7 @@ class Opal_G711_ALaw_PCM : public Opal_G711_PCM {
   public:
     Opal_G711_ALaw_PCM();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples);
     static int ConvertSample(int sample);
 };
 
@@ -91,6 +94,7 @@ class Opal_PCM_G711_ALaw : public OpalStreamedTranscoder {
   public:
     Opal_PCM_G711_ALaw();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples);
     static int ConvertSample(int sample);
 };
 
@@ -194,7 +194,19 @@ enum PluginCodec_Flags {
   PluginCodec_BitsPerSampleMask      = 0xf000,
 
   PluginCodec_ChannelsPos            = 16,
-  PluginCodec_ChannelsMask           = 0x003f0000
+  PluginCodec_ChannelsMask           = 0x003f0000,
+
+  /* PluginCodec_MediaTypeAudioStreamed only. If set, the transcode function
+     can convert a whole payload per call, rather than one sample, when the
+     host sets PluginCodec_CoderStreamedBulk in *flag. The 16 bit linear side
+     gives the number of samples, *fromLen/2 for an encoder and *toLen/2 for
+     a decoder. Coded samples are packed least significant bit first at
+     PluginCodec_BitsPerSampleMask bits each, with *toLen set to the number
+     of bytes output. Without the coder flag, e.g. from an older host, the
+     function must still convert one sample per call as an int. */
+  PluginCodec_StreamedBulkMask       = 0x00400000,
+  PluginCodec_StreamedPerSample      = 0x00000000,
+  PluginCodec_StreamedBulk           = 0x00400000
 };
 
 #define PluginCodec_SetChannels(n) (((n-1)<<PluginCodec_ChannelsPos)&PluginCodec_ChannelsMask)
@@ -203,7 +215,8 @@ enum PluginCodec_Flags {
 enum PluginCodec_CoderFlags {
   PluginCodec_CoderSilenceFrame      = 1,    // request audio codec to create silence frame
   PluginCodec_CoderForceIFrame       = 2,    // request video codec to force I frame
-  PluginCodec_CoderPacketLoss        = 4     // indicate to video codec packets were lost
+  PluginCodec_CoderPacketLoss        = 4,    // indicate to video codec packets were lost
+  PluginCodec_CoderStreamedBulk      = 8     // host is converting a whole payload, see PluginCodec_StreamedBulk
 };
 
 enum PluginCodec_ReturnCoderFlags {
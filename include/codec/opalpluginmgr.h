@@ -290,11 +290,13 @@ class OpalPluginStreamedAudioTranscoder : public OpalStreamedTranscoder, public
     PBoolean ExecuteCommand(const OpalMediaCommand & command);
     virtual bool AcceptComfortNoise() const { return comfortNoise; }
     virtual int ConvertOne(int from) const;
+    virtual bool ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples);
   protected:
     virtual bool OnCreated(const OpalMediaFormat & srcFormat,
                            const OpalMediaFormat & destFormat,
                            const BYTE * instance, unsigned instanceLen);
     bool comfortNoise;
+    bool m_bulkConvert;
 };
 
 
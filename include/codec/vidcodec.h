@@ -153,6 +153,10 @@ class OpalVideoTranscoder : public OpalTranscoder
       const OpalMediaFormat & inputMediaFormat,  ///<  Input media format
       const OpalMediaFormat & outputMediaFormat  ///<  Output media format
     );
+
+    /** Destroy transcoder, and any pooled output frames.
+      */
+    ~OpalVideoTranscoder();
   //@}
 
   /**@name Operations */
@@ -257,6 +261,22 @@ class OpalVideoTranscoder : public OpalTranscoder
 
     OpalIntraFrameControl m_encodingIntraFrameControl;
     OpalIntraFrameControl m_decodingIntraFrameControl;
+
+    /**Get an output frame of at least the buffer size, from the pool if
+       possible, otherwise a new one.
+      */
+    RTP_DataFrame * GetPooledFrame(PINDEX bufferSize);
+
+    /**Return a frame, or all the frames in the list, to the pool. Frames
+       that still share their buffer with another RTP_DataFrame, e.g. in a
+       retransmit cache, are deleted rather than recycled.
+      */
+    void RecycleFrame(RTP_DataFrame * frame);
+    void RecycleFrames(RTP_DataFrameList & frames);
+
+    std::vector<RTP_DataFrame *> m_framePool;
+    uint64_t                     m_framePoolHits;
+    uint64_t                     m_framePoolMisses;
 };
 
 
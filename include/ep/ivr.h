@@ -190,6 +190,16 @@ class OpalIVREndPoint : public OpalLocalEndPoint
 
     void SetRecordDirectory(const PDirectory & dir) { m_recordDirectory = dir; }
     const PDirectory & GetRecordDirectory() const   { return m_recordDirectory; }
+
+    /**Set flag for playing prompt files from the process wide cache,
+       OpalIVRPromptCache, pre-encoded to the media format of the call.
+       This only affects connections created after the call.
+      */
+    void SetPromptCaching(bool enable) { m_promptCaching = enable; }
+
+    /**Get flag for playing prompt files from the process wide cache.
+      */
+    bool GetPromptCaching() const { return m_promptCaching; }
   //@}
 
     // Allow users to override cache algorithm
@@ -201,6 +211,7 @@ class OpalIVREndPoint : public OpalLocalEndPoint
     PDECLARE_MUTEX(m_defaultsMutex);
     PVXMLCache     m_ttsCache;
     PDirectory     m_recordDirectory;
+    bool           m_promptCaching;
 
   private:
     P_REMOVE_VIRTUAL(OpalIVRConnection *, CreateConnection(OpalCall &,const PString &,void *,const PString &,OpalConnection::StringOptions *),0);
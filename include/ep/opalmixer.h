@@ -47,6 +47,7 @@
 class RTP_DataFrame;
 class OpalJitterBuffer;
 class OpalMixerConnection;
+class OpalMediaPatchExecutor;
 
 
 //#define OPAL_MIXER_AUDIO_DEBUG 1
@@ -162,6 +163,15 @@ class OpalBaseMixer : public PSmartObject
       */
     unsigned GetPeriodTS() const { return m_periodTS; }
 
+    /**Get the number of mixing periods executed by the push thread.
+      */
+    unsigned GetPeriodCount() const { return m_periodCount; }
+
+    /**Get the number of mixing periods where the push thread took longer
+       than the period to mix, transcode and write the output.
+      */
+    unsigned GetDeadlinesMissed() const { return m_deadlinesMissed; }
+
   protected:
     struct Stream : public PObject {
       virtual ~Stream() { }
@@ -185,6 +195,8 @@ class OpalBaseMixer : public PSmartObject
     RTP_DataFrame * m_pushFrame;        // Cached frame for pushing RTP
     PThread *       m_workerThread;     // reader thread handle
     bool            m_threadRunning;    // used to stop reader thread
+    atomic<unsigned> m_periodCount;     // Number of periods pushed
+    atomic<unsigned> m_deadlinesMissed; // Number of periods that overran
    PDECLARE_MUTEX(m_mutex);             // mutex for list of streams and thread handle
 };
 
@@ -250,6 +262,78 @@ class OpalAudioMixer : public OpalBaseMixer
       const OpalJitterBuffer::Init & init   ///< Initialisation information
     );
 
+    /**Set the maximum number of active speakers to mix.
+       If zero, the default, every stream is mixed. Otherwise, each period
+       only the \p count loudest streams are mixed, using the audio level
+       from the ssrc-audio-level RTP header extension if available, or
+       calculated from the audio if not. A small hysteresis is applied so
+       current speakers are not displaced by a marginally louder stream.
+      */
+    void SetTopSpeakers(
+      unsigned count  ///< Maximum number of speakers mixed
+    );
+
+    /**Get the maximum number of active speakers to mix.
+       Zero indicates every stream is mixed.
+      */
+    unsigned GetTopSpeakers() const { return m_topSpeakers; }
+
+    /**Enable tracking of the active speaker.
+       If enabled, each period the loudest stream is determined, as for
+       SetTopSpeakers(), including the hysteresis. Default is disabled.
+      */
+    void SetActiveSpeakerTracking(
+      bool enable   ///< Enable tracking
+    );
+
+    /**Get the key of the active speaker.
+       This is the last stream to be the loudest, so is not changed during
+       periods where everyone is silent. Empty if nobody has spoken yet or
+       tracking is not enabled.
+      */
+    Key_T GetActiveSpeaker() const;
+
+    /**Get the number of times the active speaker has changed.
+       This may be polled cheaply to determine if GetActiveSpeaker() would
+       return something different.
+      */
+    unsigned GetActiveSpeakerChanges() const { return m_activeSpeakerChanges; }
+
+    /**Low level kernels used for mixing audio.
+       Implementations using SSE2, AVX2 or NEON are selected at run time,
+       according to the processor capabilities, with a portable fallback.
+      */
+    struct MixKernels
+    {
+      const char * m_name;
+
+      /// Add \p count 16 bit samples into the 32 bit accumulator.
+      void (*m_accumulate)(int * mixed, const short * samples, unsigned count);
+
+      /**Output \p count samples of the accumulator, less the \p subtract
+         samples if not NULL, clipped to 16 bits. */
+      void (*m_subtractAndClip)(short * output, const int * mixed, const short * subtract, unsigned count);
+    };
+
+    enum MixKernelTypes {
+      e_ScalarKernels,
+      e_SSE2Kernels,
+      e_AVX2Kernels,
+      e_NEONKernels,
+      NumMixKernelTypes
+    };
+
+    /**Get the kernels for the specified instruction set.
+       Returns NULL if not supported by this build or processor.
+      */
+    static const MixKernels * GetMixKernels(
+      MixKernelTypes type   ///< Instruction set for kernels
+    );
+
+    /**Get the best kernels for this processor.
+      */
+    static const MixKernels & GetMixKernels();
+
   protected:
     struct AudioStream : public Stream
     {
@@ -258,12 +342,15 @@ class OpalAudioMixer : public OpalBaseMixer
 
       virtual void QueuePacket(const RTP_DataFrame & rtp);
       const short * GetAudioDataPtr();
+      int GetAudioLevel();
 
       OpalAudioMixer   & m_mixer;
       OpalJitterBuffer * m_jitter;
       unsigned           m_nextTimestamp;
       PShortArray        m_cacheSamples;
       size_t             m_samplesUsed;
+      int                m_headerLevel;
+      bool               m_speaking;
     };
 
     virtual Stream * CreateStream();
@@ -281,6 +368,14 @@ class OpalAudioMixer : public OpalBaseMixer
     AudioStream    * m_left;
     AudioStream    * m_right;
     std::vector<int> m_mixedAudio;
+
+    unsigned m_topSpeakers;
+    typedef std::vector< std::pair<int, AudioStream *> > SpeakerLevels;
+    SpeakerLevels m_speakerLevels;
+
+    bool             m_trackActiveSpeaker;
+    Key_T            m_activeSpeaker;
+    atomic<unsigned> m_activeSpeakerChanges;
 };
 
 
@@ -357,6 +452,23 @@ class OpalVideoMixer : public OpalBaseMixer
       unsigned height   ///< new height
     );
 
+    /// Area of the output frame in pixels
+    struct Region
+    {
+      Region(unsigned x = 0, unsigned y = 0, unsigned width = 0, unsigned height = 0)
+        : m_x(x), m_y(y), m_width(width), m_height(height) { }
+
+      unsigned m_x, m_y, m_width, m_height;
+    };
+    typedef std::vector<Region> RegionList;
+
+    /**Get the areas of the output frame that changed in the last mix.
+       This is valid in OnMixed() and may be used by an encoder that can skip
+       unchanged macroblocks. An empty list indicates the output frame is
+       identical to the previous one.
+      */
+    const RegionList & GetChangedRegions() const { return m_changedRegions; }
+
   protected:
     struct VideoStream : public Stream
     {
@@ -365,6 +477,9 @@ class OpalVideoMixer : public OpalBaseMixer
       void InsertVideoFrame(unsigned x, unsigned y, unsigned w, unsigned h);
 
       OpalVideoMixer & m_mixer;
+      RTP_DataFrame    m_lastFrame;   // Last input frame with different content
+      PBYTEArray       m_tile;        // m_lastFrame scaled to the tile size
+      Region           m_tileRegion;  // Where m_tile was last put in the frame store
     };
 
     friend struct VideoStream;
@@ -385,6 +500,8 @@ class OpalVideoMixer : public OpalBaseMixer
 
     PBYTEArray m_frameStore;
     size_t     m_lastStreamCount;
+    bool       m_frameStoreFilled; // Background filled, all tiles must be redrawn
+    RegionList m_changedRegions;
 };
 
 #endif // OPAL_VIDEO
@@ -404,12 +521,14 @@ struct OpalMixerNodeInfo
     , m_closeOnEmpty(false)
     , m_listenOnly(false)
     , m_sampleRate(OpalMediaFormat::AudioClockRate)
+    , m_topSpeakers(0)
 #if OPAL_VIDEO
     , m_audioOnly(false)
     , m_style(OpalVideoMixer::eGrid)
     , m_width(PVideoFrameInfo::CIFWidth)
     , m_height(PVideoFrameInfo::CIFHeight)
     , m_rate(15)
+    , m_videoForwarding(false)
 #endif
     , m_mediaPassThru(false)
   { }
@@ -422,12 +541,15 @@ struct OpalMixerNodeInfo
   bool     m_closeOnEmpty;        ///< Mixer node is removed when last participant exits
   bool     m_listenOnly;          ///< Mixer only transmits data to "listeners"
   unsigned m_sampleRate;          ///< Audio sample rate, usually 8000
+  unsigned m_topSpeakers;         ///< Maximum active speakers mixed, zero mixes everyone
 #if OPAL_VIDEO
   bool     m_audioOnly;           ///< No video is to be allowed.
   OpalVideoMixer::Styles m_style; ///< Method for mixing video
   unsigned m_width;               ///< Width of mixed video
   unsigned m_height;              ///< Height of mixed video
   unsigned m_rate;                ///< Frame rate of mixed video
+  bool     m_videoForwarding;     /**< Forward the encoded video of the selected participant,
+                                       or active speaker, rather than mixing it. */
 #endif
   bool     m_mediaPassThru;       /**< Enable media pass through to optimise mixer node
                                        with precisely two attached connections. */
@@ -1035,6 +1157,7 @@ class OpalMixerMediaStream : public OpalMediaStream
   protected:
     virtual void InternalClose();
     virtual bool InternalSetJitterBuffer(const OpalJitterBuffer::Init & init);
+    virtual bool InternalExecuteCommand(const OpalMediaCommand & command);
 
     PSafePtr<OpalMixerNode> m_node;
     bool m_listenOnly;
@@ -1070,6 +1193,18 @@ class OpalAudioStreamMixer : public OpalAudioMixer, public OpalMediaStreamMixer
 
     virtual bool OnPush();
 
+    /**Set the executor used to mix, transcode and write each distinct
+       output format in parallel. If NULL, or only one format is in use,
+       all output is done on the push thread.
+      */
+    void SetExecutor(
+      OpalMediaPatchExecutor * executor
+    ) { m_executor = executor; }
+
+    /**Get the executor used for parallel output.
+      */
+    OpalMediaPatchExecutor * GetExecutor() const { return m_executor; }
+
   protected:
     struct CachedAudio
     {
@@ -1091,6 +1226,26 @@ class OpalAudioStreamMixer : public OpalAudioMixer, public OpalMediaStreamMixer
       const short * audioToSubtract
     );
 
+    struct PushEntry
+    {
+      PushEntry(const PSafePtr<OpalMixerMediaStream> & stream, const Key_T & inputKey)
+        : m_stream(stream), m_inputKey(inputKey) { }
+      PSafePtr<OpalMixerMediaStream> m_stream;
+      Key_T                          m_inputKey; // Empty if nothing to subtract
+    };
+    struct PushGroup
+    {
+      PushGroup() : m_cache(NULL) { }
+      CachedAudio          * m_cache;
+      std::vector<PushEntry> m_entries;
+    };
+    typedef std::map<PString, PushGroup> PushGroupMap;
+
+    void PushGroupEntries(PushGroup & group);
+
+    struct PushBatch;
+    OpalMediaPatchExecutor * m_executor;
+
 #ifdef OPAL_MIXER_AUDIO_DEBUG
     class PAudioMixerDebug * m_audioDebug;
 #endif
@@ -1115,9 +1270,198 @@ class OpalVideoStreamMixer : public OpalVideoMixer, public OpalMediaStreamMixer
     virtual bool SetFrameRate(unsigned rate);
     virtual bool OnMixed(RTP_DataFrame * & output);
 
+    /**Set the executor used to scale, encode and write each distinct
+       output format and frame size in parallel. If NULL, or only one is in
+       use, all output is done on the push thread.
+      */
+    void SetExecutor(
+      OpalMediaPatchExecutor * executor
+    ) { m_executor = executor; }
+
+    /**Get the executor used for parallel output.
+      */
+    OpalMediaPatchExecutor * GetExecutor() const { return m_executor; }
+
+    /// Time taken to scale and encode mixed video for an output format and size
+    struct EncodeStatistics
+    {
+      EncodeStatistics() : m_frames(0), m_overruns(0) { }
+
+      unsigned      m_frames;   ///< Number of frames encoded
+      unsigned      m_overruns; ///< Number of frames that took longer than the mixing period
+      PTimeInterval m_total;    ///< Total time for all frames
+      PTimeInterval m_maximum;  ///< Longest time for a frame
+      PTimeInterval m_last;     ///< Time for the most recent frame
+    };
+    typedef std::map<PString, EncodeStatistics> EncodeStatisticsMap;
+
+    /**Get the encode statistics for each output, keyed by "format WxH".
+      */
+    void GetEncodeStatistics(
+      EncodeStatisticsMap & statistics
+    ) const;
+
   protected:
-    typedef PDictionary<PString, OpalTranscoder> TranscoderMap;
-    TranscoderMap m_transcoders;
+    struct ScaledFrame
+    {
+      ScaledFrame() : m_mixCount(0) { }
+
+      PDECLARE_MUTEX(m_mutex);
+      RTP_DataFrame  m_frame;
+      unsigned       m_mixCount; // Mix the frame was last scaled for
+    };
+    typedef std::map<unsigned, ScaledFrame *> ScaledFrameMap; // Key is width + height*65536
+    ScaledFrameMap m_scaledFrames;
+
+    struct EncodeGroup
+    {
+      EncodeGroup();
+      ~EncodeGroup();
+
+      OpalTranscoder  * m_transcoder;
+      unsigned          m_width;
+      unsigned          m_height;
+      ScaledFrame     * m_scaled;   // NULL if mixed frame is already the right size
+      RTP_DataFrameList m_packets;
+      EncodeStatistics  m_statistics;
+      std::vector< PSafePtr<OpalMixerMediaStream> > m_streams; // Streams to write for current mix
+    };
+    typedef std::pair<PString, unsigned> EncodeKey; // Format name and width + height*65536
+    typedef std::map<EncodeKey, EncodeGroup> EncodeGroupMap;
+    EncodeGroupMap m_encodeGroups;
+
+    void EncodeGroupEntries(EncodeGroup & group, const RTP_DataFrame & output);
+
+    struct EncodeBatch;
+    OpalMediaPatchExecutor * m_executor;
+    PDECLARE_MUTEX(          m_encodeGroupsMutex); // Protects m_encodeGroups and its statistics
+    unsigned                 m_mixCount;
+};
+
+
+/** Video forwarder.
+    This class is used instead of OpalVideoStreamMixer when a node has
+    OpalMixerNodeInfo::m_videoForwarding set. The encoded video from the
+    selected participant is sent, unaltered except for the RTP header, to
+    every other participant using the same media format, with no decoding,
+    mixing or encoding. The selected participant receives the previously
+    selected one.
+
+    Each listener has its own SSRC, sequence numbers and timestamps, which
+    are continuous across changes of the participant being forwarded. A
+    change is made at the next intra frame from the new participant, and
+    one is requested from them at the time of the selection. Requests for
+    an intra frame from a listener are relayed to the participant they are
+    receiving.
+  */
+class OpalVideoForwarder : public PObject
+{
+    PCLASSINFO(OpalVideoForwarder, PObject);
+  public:
+    OpalVideoForwarder();
+    ~OpalVideoForwarder();
+
+    /**Add a stream of video from a participant, which may be forwarded.
+      */
+    void AddSender(
+      const PSafePtr<OpalMixerMediaStream> & stream ///< Sink stream of the mixer
+    );
+
+    /**Remove a stream of video from a participant.
+      */
+    void RemoveSender(
+      const PString & id  ///< Stream identifier
+    );
+
+    /**Add a stream of video to a participant, which receives forwarded video.
+      */
+    void AddListener(
+      const PSafePtr<OpalMixerMediaStream> & stream ///< Source stream of the mixer
+    );
+
+    /**Remove a stream of video to a participant.
+      */
+    void RemoveListener(
+      const PString & id  ///< Stream identifier
+    );
+
+    /**Forward a packet from a participant to the listeners receiving them.
+      */
+    bool WritePacket(
+      const PString & id,           ///< Stream identifier of sender
+      const RTP_DataFrame & packet  ///< Encoded video packet
+    );
+
+    /**Select the participant whose video is forwarded.
+       An explicit selection overrides the active speaker until an explicit
+       selection of an empty token is made.
+      */
+    void SelectSender(
+      const PString & token,  ///< Token for connection of participant
+      bool explicitChoice     ///< Selected by application, not active speaker
+    );
+
+    /**Request an intra frame, on behalf of a listener, from the participant
+       it is receiving.
+      */
+    void OnVideoUpdatePicture(
+      const PString & id  ///< Stream identifier of listener
+    );
+
+  protected:
+    typedef std::vector< PSafePtr<OpalMixerMediaStream> > StreamList;
+
+    struct Sender
+    {
+      Sender(const PSafePtr<OpalMixerMediaStream> & stream);
+
+      PSafePtr<OpalMixerMediaStream>    m_stream;
+      PString                           m_token;
+      OpalVideoFormat                   m_mediaFormat;
+      OpalVideoFormat::FrameDetectorPtr m_detector;
+      bool                              m_frameStart; // Next packet starts a new frame
+    };
+    typedef std::map<PString, Sender *> SenderMap;
+    SenderMap m_senders;
+
+    struct Listener
+    {
+      Listener(const PSafePtr<OpalMixerMediaStream> & stream);
+
+      PSafePtr<OpalMixerMediaStream> m_stream;
+      PString                     m_token;
+      PString                     m_formatName;
+      RTP_DataFrame::PayloadTypes m_payloadType;
+      RTP_SyncSourceId            m_syncSource;
+      PString                     m_senderId;   // Stream being forwarded
+      PString                     m_pendingId;  // Stream to forward from next intra frame
+      bool                        m_sending;
+      RTP_SequenceNumber          m_sequenceOffset;
+      RTP_Timestamp               m_timestampOffset;
+      RTP_SequenceNumber          m_lastSequenceNumber;
+      RTP_Timestamp               m_lastTimestamp;
+      PTimeInterval               m_lastTick;
+    };
+    typedef std::map<PString, Listener> ListenerMap;
+    ListenerMap m_listeners;
+
+    struct Target
+    {
+      PSafePtr<OpalMixerMediaStream> m_stream;
+      RTP_DataFrame::PayloadTypes    m_payloadType;
+      RTP_SyncSourceId               m_syncSource;
+      RTP_SequenceNumber             m_sequenceNumber;
+      RTP_Timestamp                  m_timestamp;
+    };
+
+    void SelectForListener(Listener & listener, StreamList & updateRequests);
+    void SelectForAll(StreamList & updateRequests);
+    static void RequestUpdates(const StreamList & updateRequests);
+
+    PString m_selectedToken;
+    PString m_previousToken;
+    bool    m_explicitChoice;
+    PDECLARE_MUTEX(m_mutex);
 };
 #endif // OPAL_VIDEO
 
@@ -1285,6 +1629,11 @@ class OpalMixerNode : public PSafeObject
      */
     const PTime & GetCreationTime() const { return m_creationTime; }
 
+    /**Get the total number of mixing periods, across the audio and all
+       video mixers, that did not complete within the period.
+     */
+    unsigned GetDeadlinesMissed() const;
+
     /**Set the owner connection.
        If a connection with GetToken(), GetLocalPartyURL() or
        GetRemotePartyURL() equal to \p connectionIdentifier disconnects from
@@ -1294,6 +1643,25 @@ class OpalMixerNode : public PSafeObject
     void SetOwnerConnection(
       const PString & connectionIdentifier
     ) { m_ownerConnection = connectionIdentifier; }
+
+#if OPAL_VIDEO
+    /**Select the participant whose video is forwarded.
+       This is only used if OpalMixerNodeInfo::m_videoForwarding is set.
+       If \p connectionToken is empty, the active speaker is forwarded,
+       which is also the default.
+      */
+    void SelectVideoSender(
+      const PString & connectionToken ///< Token for connection of participant
+    );
+
+    /**Handle a request for an intra frame from a participant.
+       For video forwarding, the request is relayed to the participant
+       whose video is being received.
+      */
+    void OnVideoUpdatePicture(
+      const OpalMixerMediaStream & stream ///< Source stream of the mixer
+    );
+#endif
   //@}
 
   protected:
@@ -1311,6 +1679,14 @@ class OpalMixerNode : public PSafeObject
 #if OPAL_VIDEO
     typedef std::map<OpalVideoFormat::ContentRole, OpalVideoStreamMixer *> VideoMixerMap;
     VideoMixerMap m_videoMixers;
+
+    void CheckActiveSpeaker();
+
+    typedef std::map<OpalVideoFormat::ContentRole, OpalVideoForwarder *> VideoForwarderMap;
+    VideoForwarderMap m_videoForwarders;
+    typedef std::map<PString, OpalVideoForwarder *> ForwarderByIdMap;
+    ForwarderByIdMap  m_forwarderById;
+    atomic<unsigned>  m_activeSpeakerChanges;
 #endif // OPAL_VIDEO
 
     typedef std::map<PString, OpalBaseMixer *> MixerByIdMap;
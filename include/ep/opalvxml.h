@@ -48,6 +48,101 @@ class PTextToSpeech;
 class OpalIVRConnection;
 
 
+/**Process wide cache of IVR prompt files, pre-encoded to the media format
+   of the VXML channel that plays them.
+
+   A prompt played to many calls is read and encoded once, then every
+   session plays the same reference counted memory. If the IVR stream uses
+   the codec natively, see OPAL_OPT_IVR_NATIVE_CODEC, there is no per call
+   transcoding of the prompt at all.
+  */
+class OpalIVRPromptCache : public PObject
+{
+    PCLASSINFO(OpalIVRPromptCache, PObject);
+  public:
+    OpalIVRPromptCache();
+
+    /// Get the process wide cache.
+    static OpalIVRPromptCache & GetInstance();
+
+    /**Get the prompt from the WAV file, encoded in the media format.
+       If not already cached, or the file has been modified since, it is
+       read and encoded.
+
+       Returns false if the prompt cannot be cached, e.g. the file is not
+       mono at the sample rate, or the codec has variable sized frames. The
+       file should then be played as normal.
+      */
+    bool GetPrompt(
+      const PFilePath & filename,   ///< WAV file for prompt
+      const PString & formatName,   ///< Media format of VXML channel
+      unsigned sampleRate,          ///< Sample rate of VXML channel
+      PBYTEArray & data             ///< Encoded prompt, shares the cached memory
+    );
+
+    /**Set the maximum total size of cached prompts in bytes.
+       The least recently used prompts are discarded first. Each entry,
+       including prompts that could not be cached, also counts a small
+       fixed overhead, so failures cannot grow the cache without bound.
+      */
+    void SetMaxSize(PINDEX bytes);
+
+    /// Get the maximum total size of cached prompts in bytes.
+    PINDEX GetMaxSize() const { return m_maxSize; }
+
+    /// Get the total size of cached prompts in bytes, including entry overheads.
+    PINDEX GetSize() const;
+
+    /// Get the number of times a prompt was played from the cache.
+    unsigned GetHits() const { return m_hits; }
+
+    /// Get the number of times a prompt had to be read and encoded.
+    unsigned GetMisses() const { return m_misses; }
+
+    /// Discard all cached prompts.
+    void Flush();
+
+  protected:
+    virtual bool Encode(
+      const PFilePath & filename,
+      const PString & formatName,
+      unsigned sampleRate,
+      PBYTEArray & data
+    );
+    void Trim();
+
+    enum { EntryOverhead = 256 }; // Map entry, key etc
+
+    struct Encoding
+    {
+      Encoding() : m_done(0, INT_MAX), m_references(1) { }
+      PSemaphore m_done;
+      unsigned   m_references; // Encoding thread plus waiters, protected by m_mutex
+    };
+    void ReleaseEncoding(Encoding * encoding);
+
+    struct Prompt
+    {
+      Prompt() : m_lastUsed(0), m_encoding(NULL) { }
+      PINDEX GetCost() const { return m_data.GetSize() + EntryOverhead; }
+
+      PTime      m_modified;
+      PBYTEArray m_data;     // Empty if prompt cannot be cached
+      PUInt64    m_lastUsed;
+      Encoding * m_encoding; // Not NULL while being read and encoded
+    };
+    typedef std::map<PString, Prompt> PromptMap;
+
+    PromptMap        m_prompts;
+    PINDEX           m_size;
+    PINDEX           m_maxSize;
+    PUInt64          m_useCount;
+    atomic<unsigned> m_hits;
+    atomic<unsigned> m_misses;
+    PDECLARE_MUTEX(m_mutex);
+};
+
+
 class OpalVXMLSession : public PVXMLSession 
 {
   PCLASSINFO(OpalVXMLSession, PVXMLSession);
@@ -62,8 +157,21 @@ class OpalVXMLSession : public PVXMLSession
     virtual void OnEndSession();
     virtual bool OnTransfer(const PString & destination, TransferType type);
 
+    /**Play a prompt file.
+       If a prompt cache is set, the file is played from it, pre-encoded to
+       the media format of the VXML channel, where possible.
+      */
+    virtual PBoolean PlayFile(const PString & fn, PINDEX repeat = 1, PINDEX delay = 0, PBoolean autoDelete = false);
+
+    /// Set the prompt cache to use, NULL disables.
+    void SetPromptCache(OpalIVRPromptCache * cache) { m_promptCache = cache; }
+
+    /// Get the prompt cache in use, NULL if disabled.
+    OpalIVRPromptCache * GetPromptCache() const { return m_promptCache; }
+
   protected:
-    OpalIVRConnection & m_connection;
+    OpalIVRConnection  & m_connection;
+    OpalIVRPromptCache * m_promptCache;
 };
 
 #endif
@@ -1769,16 +1769,47 @@ class H323GatekeeperServer : public H323TransactionServer
 
     PSafeDictionary<PString, H323RegisteredEndPoint> m_byIdentifier;
 
-    class StringMap : public PString {
-        PCLASSINFO(StringMap, PString);
+    // Endpoint identifiers, in order of registration, for each address or alias
+    typedef std::map<PString, std::vector<PString> > IdentifierIndex;
+    static void AddToIndex(IdentifierIndex & index, const PString & key, const PString & identifier);
+    static void RemoveFromIndex(IdentifierIndex & index, const PString & key, const PString & identifier);
+    static const PString & FindInIndex(const IdentifierIndex & index, const PString & key);
+
+    // Longest prefix match of voice prefixes, one character per trie level
+    class VoicePrefixTrie
+    {
       public:
-        StringMap(const PString & from, const PString & id)
-          : PString(from), identifier(id) { }
-        PString identifier;
+        VoicePrefixTrie() { }
+        void Add(const PString & prefix, const PString & identifier);
+        void Remove(const PString & prefix, const PString & identifier);
+        const PString & FindLongest(const PString & str) const;
+
+      protected:
+        struct Node {
+          ~Node();
+          std::map<char, Node *> m_children;
+          std::vector<PString>   m_identifiers;
+        };
+        Node m_root;
+
+      private:
+        VoicePrefixTrie(const VoicePrefixTrie &) { }
+        void operator=(const VoicePrefixTrie &) { }
     };
-    PSortedStringList m_byAddress;
-    PSortedStringList m_byAlias;
-    PSortedStringList m_byVoicePrefix;
+
+    // What was put in the above indexes for each endpoint identifier
+    struct IndexedKeys {
+      std::vector<PString> m_addresses;
+      std::vector<PString> m_aliases;
+      std::vector<PString> m_prefixes;
+    };
+    void RemoveFromIndexes(const PString & identifier);
+
+    IdentifierIndex m_byAddress;
+    IdentifierIndex m_byAlias;
+    VoicePrefixTrie m_byVoicePrefix;
+    std::map<PString, IndexedKeys> m_indexedKeys;
+    PDECLARE_READ_WRITE_MUTEX(m_indexMutex); // Only for above indexes, may be taken after m_mutex
 
     PSafeSortedList<H323GatekeeperCall> m_activeCalls;
 
@@ -1384,6 +1384,11 @@ class H323EndPoint : public OpalRTPEndPoint
       OpalConnection::StringOptions * stringOptions = NULL ///<  complex string options
     );
 
+    bool InternalAddToSignalingReactor(const OpalTransportPtr & transport, bool reused);
+    void InternalOnTransportReady(OpalTransport & transport, bool reused);
+    PDECLARE_SignalingReadyNotifier(H323EndPoint, OnInitialTransportReady);
+    PDECLARE_SignalingReadyNotifier(H323EndPoint, OnReusedTransportReady);
+
     // Configuration variables, commonly changed
     typedef map<PString, OpalTransportAddress> AliasToGkMap;
     AliasToGkMap    m_localAliasNames;
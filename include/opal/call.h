@@ -601,6 +601,11 @@ class OpalCall : public PSafeObject
       */
     bool IsRecording() const;
 
+    /**Indicate if the active recording stores media as received, rather
+       than decoded. See OpalRecordManager::IsPassThrough().
+      */
+    bool IsRecordingPassThrough() const;
+
     /** Stop a recording.
         Returns true if the call does exists, an active call is not indicated.
       */
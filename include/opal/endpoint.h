@@ -43,6 +43,100 @@ class OpalCall;
 class OpalMediaStream;
 
 
+/**This class is a hash partitioned collection of PSafeDictionary.
+   Each key is assigned to one of a fixed number of shards, each of which
+   is an independent PSafeDictionary with its own collection mutex, so
+   lookups, additions and removals for different keys rarely contend with
+   each other. References returned are the usual PSafePtr<> from the shard.
+
+   Enumeration is done a shard at a time using GetShardCount() and
+   GetShardAt(), there is no single iterator over all shards.
+  */
+template <class K, class D, unsigned NumShards = 16>
+class OpalSafeShardedDictionary
+{
+  public:
+    typedef PSafeDictionary<K, D> Shard;
+
+    /// Get the shard that contains the key.
+    Shard & GetShard(const K & key) { return m_shards[GetShardIndex(key)]; }
+    const Shard & GetShard(const K & key) const { return m_shards[GetShardIndex(key)]; }
+
+    /// Get the number of shards.
+    unsigned GetShardCount() const { return NumShards; }
+
+    /// Get a shard by index, for enumeration.
+    Shard & GetShardAt(unsigned index) { return m_shards[index]; }
+    const Shard & GetShardAt(unsigned index) const { return m_shards[index]; }
+
+    /// Add an object to the shard for the key.
+    bool SetAt(const K & key, D * obj) { return GetShard(key).SetAt(key, obj); }
+
+    /// Remove the object from the shard for the key.
+    bool RemoveAt(const K & key) { return GetShard(key).RemoveAt(key); }
+
+    /// Find the object in the shard for the key.
+    PSafePtr<D> Find(const K & key, PSafetyMode mode = PSafeReadWrite) const { return GetShard(key).Find(key, mode); }
+
+    /// Get total number of objects in all shards.
+    PINDEX GetSize() const
+    {
+      PINDEX size = 0;
+      for (unsigned i = 0; i < NumShards; ++i)
+        size += m_shards[i].GetSize();
+      return size;
+    }
+
+    /// Remove all objects from all shards.
+    void RemoveAll(bool synchronous = false)
+    {
+      for (unsigned i = 0; i < NumShards; ++i)
+        m_shards[i].RemoveAll(synchronous);
+    }
+
+    /// Delete removed objects in all shards, returns true if all were deleted.
+    bool DeleteObjectsToBeRemoved()
+    {
+      bool allDeleted = true;
+      for (unsigned i = 0; i < NumShards; ++i) {
+        if (!m_shards[i].DeleteObjectsToBeRemoved())
+          allDeleted = false;
+      }
+      return allDeleted;
+    }
+
+    /**Get the shard index for the key.
+       The string form of every key is hashed, case insensitively so
+       caseless keys are consistent. The HashFunction() of PString and PURL
+       only use a short prefix, which for things like SIP branch identifiers
+       and AoRs is nearly always the same, so would skew the shards.
+
+       URLs that compare equal may still differ in their parameters, e.g. a
+       SIPURL only compares parameters present in both, so only the scheme,
+       user, password, host and port are hashed for them.
+      */
+    static unsigned GetShardIndex(const K & key)
+    {
+      PString str = GetKeyString(key);
+      unsigned hash = 2166136261U; // FNV-1a
+      for (const char * ptr = str; *ptr != '\0'; ++ptr)
+        hash = (hash ^ (unsigned)tolower((BYTE)*ptr)) * 16777619U;
+      return hash % NumShards;
+    }
+
+  protected:
+    static const PString & GetKeyString(const PString & key) { return key; }
+    static PString GetKeyString(const PURL & key)
+    {
+      return PSTRSTRM(key.GetScheme() << ':' << key.GetUserName() << ':' << key.GetPassword()
+                      << '@' << key.GetHostName() << ':' << key.GetPort());
+    }
+    static PString GetKeyString(const PObject & key) { return PSTRSTRM(key); }
+
+    Shard m_shards[NumShards];
+};
+
+
 /**This class describes an endpoint base class.
    Each protocol (or psuedo-protocol) would create a descendant off this
    class to manage its particular subsystem. Typically this would involve
@@ -56,6 +56,9 @@
 class OpalEndPoint;
 class OpalMediaPatch;
 class OpalLocalConnection;
+class OpalMediaReactor;
+class OpalSignalingReactor;
+class OpalMediaPatchExecutor;
 class PSSLCertificate;
 class PSSLPrivateKey;
 
@@ -513,6 +516,40 @@ class OpalManager : public PObject
     };
     PARRAY(RouteTable, RouteEntry);
 
+    /**Index for the route table.
+       This avoids executing the regular expression of every entry for each
+       routing decision. Entries are indexed by the literal prefix of their
+       B-Party pattern, or failing that, their A-Party pattern, e.g. "sip:" or
+       "1800". Only entries whose prefix matches the search string, and those
+       with no usable prefix, have their regular expression tried, in table
+       order, so the first match is the same as a linear search of the table.
+      */
+    class RouteIndex
+    {
+      public:
+        void Clear();
+        void Swap(RouteIndex & other);
+        void Add(const RouteEntry & entry, PINDEX index);
+        void Build(const RouteTable & table);
+
+        /**Find the first entry at or after \p start matching \p search.
+           Returns P_MAX_INDEX if there is no match.
+          */
+        PINDEX Find(const RouteTable & table, const PString & search, PINDEX start) const;
+
+      protected:
+        typedef std::map<std::string, std::vector<PINDEX> > PrefixMap;
+        struct Party {
+          PrefixMap        m_prefixes;
+          std::set<size_t> m_lengths;
+        };
+        void Lookup(const Party & party, const std::string & str, PINDEX start, std::vector<PINDEX> & candidates) const;
+
+        Party               m_partyA;
+        Party               m_partyB;
+        std::vector<PINDEX> m_unindexed;
+    };
+
     /**Add a route entry to the route table.
 
        The specification string is of the form:
@@ -632,8 +669,14 @@ class OpalManager : public PObject
     );
 
     /**Parse a route table specification list for the manager.
-       This removes the current routeTable and calls AddRouteEntry for every
-       string in the array.
+       This builds a new route table from every string in the array, as per
+       AddRouteEntry(), then replaces the current route table. Routing may
+       continue using the old table while the new one is being built.
+
+       Each string is passed to AddRouteEntry(), so an override of that
+       function sees every entry, including those read from an "@file". While
+       the table is being built, entries added on this thread go to the new
+       table, and other threads adding entries wait until it is in place.
 
        Returns true if at least one entry was added.
       */
@@ -1699,6 +1742,78 @@ class OpalManager : public PObject
     void SetMaxRtpPacketSize(
       PINDEX size
     ) { m_rtpPacketSizeMax = size; }
+
+    /**Set the number of threads used for reading media transports.
+       If zero, the default, each media transport subchannel has its own
+       read thread. If non-zero, a shared OpalMediaReactor is used, where
+       supported by the platform, to service all media sockets using the
+       indicated number of threads.
+
+       Note the thread count can only be changed while there are no media
+       transports using the reactor, usually before any calls are made.
+      */
+    bool SetMediaReactorThreads(
+      unsigned count  ///< Number of threads, zero disables
+    );
+
+    /**Get the number of threads used for reading media transports.
+       Returns zero if a thread per subchannel is being used.
+      */
+    unsigned GetMediaReactorThreads() const;
+
+    /**Get the shared reactor for reading media transports.
+       Returns NULL if a thread per subchannel is to be used.
+      */
+    OpalMediaReactor * GetMediaReactor() const { return m_mediaReactor; }
+
+    /**Set the number of threads used for executing media patches.
+       If zero, the default, each media patch has its own thread. If
+       non-zero, a shared OpalMediaPatchExecutor is used to drive the
+       asynchronous and passive media patches using the indicated number of
+       worker threads.
+
+       Note the thread count can only be changed while there are no media
+       patches using the executor, usually before any calls are made.
+      */
+    bool SetMediaPatchThreads(
+      unsigned count  ///< Number of threads, zero disables
+    );
+
+    /**Get the number of threads used for executing media patches.
+       Returns zero if a thread per media patch is being used.
+      */
+    unsigned GetMediaPatchThreads() const;
+
+    /**Get the shared executor for media patches.
+       Returns NULL if a thread per media patch is to be used.
+      */
+    OpalMediaPatchExecutor * GetMediaPatchExecutor() const { return m_mediaPatchExecutor; }
+
+    /**Set the number of threads used for reading signalling transports.
+       If zero, the default, each reliable signalling transport, e.g. SIP
+       over TCP or an idle H.225 connection, has its own read thread. If
+       non-zero, a shared OpalSignalingReactor is used, where supported by
+       the platform, to wait on all of those sockets using the indicated
+       number of I/O threads, and complete PDUs are handled by a pool of at
+       most \p maxWorkers threads.
+
+       Note the thread count can only be changed while there are no
+       transports using the reactor, usually before any listeners are started.
+      */
+    bool SetSignalingReactorThreads(
+      unsigned count,         ///< Number of I/O threads, zero disables
+      unsigned maxWorkers = 16 ///< Maximum threads handling received PDUs
+    );
+
+    /**Get the number of I/O threads used for reading signalling transports.
+       Returns zero if a thread per transport is being used.
+      */
+    unsigned GetSignalingReactorThreads() const;
+
+    /**Get the shared reactor for reading signalling transports.
+       Returns NULL if a thread per transport is to be used.
+      */
+    OpalSignalingReactor * GetSignalingReactor() const { return m_signalingReactor; }
   //@}
 
 
@@ -2089,6 +2204,9 @@ class OpalManager : public PObject
 
     PINDEX        m_rtpPayloadSizeMax;
     PINDEX        m_rtpPacketSizeMax;
+    OpalMediaReactor * m_mediaReactor;
+    OpalMediaPatchExecutor * m_mediaPatchExecutor;
+    OpalSignalingReactor * m_signalingReactor;
     OpalJitterBuffer::Params m_jitterParams;
     PStringArray  m_mediaFormatOrder;
     PStringArray  m_mediaFormatMask;
@@ -2133,8 +2251,13 @@ class OpalManager : public PObject
     PInterfaceMonitor::Notifier m_onInterfaceChange;
 #endif
 
+    bool ParseRouteEntry(const PString & spec, RouteTable & table);
+
     RouteTable m_routeTable;
-    PDECLARE_MUTEX(m_routeMutex);
+    RouteIndex m_routeIndex;
+    PDECLARE_READ_WRITE_MUTEX(m_routeMutex);
+    RouteTable * m_routeBuildTable; // Table being built by SetRouteTable()
+    PDECLARE_MUTEX(m_routeBuildMutex);
 
     // Dynamic variables
     PDECLARE_READ_WRITE_MUTEX(m_endpointsMutex);
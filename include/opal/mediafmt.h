@@ -734,6 +734,12 @@ class OpalMediaFormatInternal : public PObject
 
     const PCaselessString & GetName() const { return formatName; }
 
+    /**Assign all of the attributes and options of another media format.
+       The options are deep copied, and the old ones kept for any lock free
+       readers of the well known options.
+      */
+    OpalMediaFormatInternal & operator=(const OpalMediaFormatInternal & other);
+
     virtual PObject * Clone() const;
     virtual void PrintOn(ostream & strm) const;
 
@@ -769,7 +775,84 @@ class OpalMediaFormatInternal : public PObject
 
     void DeconflictPayloadTypes(OpalMediaFormatList & formats);
 
+    /**Options read on the media path, e.g. for every packet or frame. These
+       are located once, when the option list changes, so reading them needs
+       no lock, string comparison or dynamic_cast.
+
+       Changes build a new table of options and publish it with a single
+       atomic pointer store, so a reader sees all of the old or all of the
+       new table, never a partly updated one. Option objects, or whole option
+       lists, that are replaced, e.g. by AddOption() or assignment, are kept
+       until destruction, so a reader may get a stale value but never a
+       deleted option.
+      */
+    enum WellKnownOptions {
+      e_ClockRate,
+      e_FrameTime,
+      e_MaxFrameSize,
+      e_MaxBitRate,
+      e_TargetBitRate,
+      e_TxFramesPerPacket,
+      e_RxFramesPerPacket,
+      e_FrameWidth,
+      e_FrameHeight,
+      NumWellKnownOptions
+    };
+
+    /**Get the well known option for the name. The name must be the reference
+       returned by the option name function, e.g. OpalMediaFormat::ClockRateOption(),
+       any other PString returns NumWellKnownOptions.
+      */
+    static WellKnownOptions GetWellKnownOption(const PString & name);
+
+    int GetWellKnownInteger(WellKnownOptions option, int dflt) const
+    {
+      const WellKnownTable & table = m_wellKnown.Get();
+      if (table.m_unsigned[option] != NULL)
+        return table.m_unsigned[option]->GetValue();
+      if (table.m_integer[option] != NULL)
+        return table.m_integer[option]->GetValue();
+      return dflt;
+    }
+
+    void UpdateWellKnownOptions();
+
   protected:
+    struct WellKnownTable
+    {
+      WellKnownTable();
+      bool Set(const OpalMediaOption * option);
+      bool Contains(const OpalMediaOption * option) const;
+
+      const OpalMediaOptionUnsigned * m_unsigned[NumWellKnownOptions];
+      const OpalMediaOptionInteger  * m_integer[NumWellKnownOptions];
+    };
+
+    /* The current table, plus replaced tables, options and option lists
+       which are kept until destruction, as a lock free reader may still be
+       using them. Only changes to well known options, or to the whole list,
+       replace the table, so few are kept. Copies take a fresh copy of the
+       current table only. */
+    class WellKnownTables
+    {
+      public:
+        WellKnownTables();
+        WellKnownTables(const WellKnownTables & other);
+        WellKnownTables & operator=(const WellKnownTables & other);
+        ~WellKnownTables();
+
+        const WellKnownTable & Get() const { return *m_current; }
+        void Publish(WellKnownTable * table);
+        void Retire(OpalMediaOption * option);
+        void Retire(const PSortedList<OpalMediaOption> & options);
+
+      protected:
+        atomic<WellKnownTable *>        m_current;
+        std::vector<WellKnownTable *>   m_oldTables;
+        std::vector<OpalMediaOption *>  m_oldOptions;
+        std::vector< PSortedList<OpalMediaOption> > m_oldLists; // References keep the objects alive
+    };
+
     bool AdjustByOptionMaps(
       PTRACE_PARAM(const char * operation,)
       bool (*adjuster)(PluginCodec_OptionMap & original, PluginCodec_OptionMap & changed)
@@ -784,6 +867,7 @@ class OpalMediaFormatInternal : public PObject
     time_t                       codecVersionTime;
     bool                         forceIsTransportable;
     bool                         m_allowMultiple;
+    WellKnownTables              m_wellKnown;
 
   friend bool operator==(const char * other, const OpalMediaFormat & fmt);
   friend bool operator!=(const char * other, const OpalMediaFormat & fmt);
@@ -1027,25 +1111,25 @@ class OpalMediaFormat : public PContainer
 
     /**Get the maximum bandwidth used in bits/second.
       */
-    OpalBandwidth GetMaxBandwidth() const { return GetOptionInteger(MaxBitRateOption()); }
+    OpalBandwidth GetMaxBandwidth() const { return GetWellKnownInteger(OpalMediaFormatInternal::e_MaxBitRate, 0); }
     static const PString & MaxBitRateOption();
 
     /**Get the used bandwidth used in bits/second.
       */
-    OpalBandwidth GetUsedBandwidth() const { return GetOptionInteger(TargetBitRateOption(), GetOptionInteger(MaxBitRateOption())); }
+    OpalBandwidth GetUsedBandwidth() const { return GetWellKnownInteger(OpalMediaFormatInternal::e_TargetBitRate, GetMaxBandwidth()); }
     static const PString & TargetBitRateOption();
 
     /**Get the maximum frame size in bytes. If this returns zero then the
        media format has no intrinsic maximum frame size, eg a video format
        would return zero but G.723.1 would return 24.
       */
-    PINDEX GetFrameSize() const { return GetOptionInteger(MaxFrameSizeOption()); }
+    PINDEX GetFrameSize() const { return GetWellKnownInteger(OpalMediaFormatInternal::e_MaxFrameSize, 0); }
     static const PString & MaxFrameSizeOption();
 
     /**Get the frame time in RTP timestamp units. If this returns zero then
        the media format is not real time and has no intrinsic timing eg T.120
       */
-    unsigned GetFrameTime() const { return GetOptionInteger(FrameTimeOption()); }
+    unsigned GetFrameTime() const { return GetWellKnownInteger(OpalMediaFormatInternal::e_FrameTime, 0); }
     static const PString & FrameTimeOption();
 
     /**Get the number of RTP timestamp units per millisecond.
@@ -1059,7 +1143,7 @@ class OpalMediaFormat : public PContainer
 
     /**Get the clock rate in Hz for this format.
       */
-    unsigned GetClockRate() const { return GetOptionInteger(ClockRateOption(), AudioClockRate); }
+    unsigned GetClockRate() const { return GetWellKnownInteger(OpalMediaFormatInternal::e_ClockRate, AudioClockRate); }
     static const PString & ClockRateOption();
 
     /**Get the name of the OpalMediaOption indicating the protocol the format is being used on.
@@ -1157,6 +1241,16 @@ class OpalMediaFormat : public PContainer
       int dflt = 0            ///<  Default value if option not present
     ) const { PWaitAndSignal m(m_mutex); return m_info == NULL ? dflt : m_info->GetOptionInteger(name, dflt); }
 
+    /**Get the value of one of the options commonly used on the media path,
+       e.g. GetClockRate(). This does not use the shared format information
+       lock or search the options by name. The default value is returned if
+       the option is not present.
+      */
+    int GetWellKnownInteger(
+      OpalMediaFormatInternal::WellKnownOptions option, ///< Option to get
+      int dflt                                           ///< Default value if option not present
+    ) const { PWaitAndSignal m(m_mutex); return m_info == NULL ? dflt : m_info->GetWellKnownInteger(option, dflt); }
+
     /**Set the option value of the specified name as an integer.
        Note the option will not be added if it does not exist, the option
        must be explicitly added using AddOption().
@@ -138,6 +138,11 @@ struct OpalNetworkStatistics
   PTime    m_lastReportTime;
   unsigned m_targetBitRate;    // As configured, not actual, which is calculated from m_totalBytes
   float    m_targetFrameRate;  // As configured, not actual, which is calculated from m_totalFrames
+
+  // Media transport receive efficiency, all subchannels (0 is N/A)
+  unsigned m_rxTransportPackets;  // Packets read
+  unsigned m_rxTransportReads;    // System calls made to read them
+  unsigned m_rxTransportAllocs;   // Heap buffers allocated to read them
 };
 
 struct OpalVideoStatistics
@@ -160,6 +165,8 @@ struct OpalVideoStatistics
   unsigned      m_frameHeight;
   unsigned      m_tsto;             // Temporal/Spatial Trade Off, as configured
   int           m_videoQuality;    // -1 is none, 0 is very good > 0 is progressively worse
+  uint64_t      m_framePoolHits;   // Encoder output packets using a recycled buffer
+  uint64_t      m_framePoolMisses; // Encoder output packets needing a new buffer
 #endif
 };
 
@@ -367,6 +374,72 @@ class OpalMediaCryptoSuite : public PObject
 typedef PFactory<OpalMediaCryptoSuite, PCaselessString> OpalMediaCryptoSuiteFactory;
 
 
+class OpalMediaTransport;
+
+/** Class for event driven reading of media transports.
+    Normally, every subchannel of every media transport has a thread blocked
+    in a read. For a busy gateway, that is thousands of threads. This class
+    services any number of media transport sockets with a small, fixed, pool
+    of threads waiting on the operating system event mechanism (epoll), and
+    dispatches received packets to the usual read notifiers.
+
+    Note this is currently only available on Linux, on other platforms
+    IsRunning() returns false and the media transports use a thread per
+    subchannel as usual.
+  */
+class OpalMediaReactor : public PObject
+{
+    PCLASSINFO(OpalMediaReactor, PObject);
+  public:
+    OpalMediaReactor(
+      unsigned threadCount  ///< Number of I/O threads servicing all sockets
+    );
+    ~OpalMediaReactor();
+
+    /// Indicate reactor is supported on this platform, and is running.
+    bool IsRunning() const { return m_running; }
+
+    /// Get the number of I/O threads in the pool.
+    unsigned GetThreadCount() const { return m_threads.size(); }
+
+    /// Get the number of subchannels currently being serviced.
+    PINDEX GetChannelCount() const;
+
+    struct Handle;
+
+  protected:
+    bool Add(OpalMediaTransport & transport, PINDEX subchannel);
+    void Close(OpalMediaTransport & transport, PINDEX subchannel);
+    void ThreadMain(unsigned index);
+    void Dispatch(Handle & handle);
+    void Rearm(Handle & handle);
+    void Wake();
+    void Housekeeping(bool shuttingDown);
+
+    atomic<bool>      m_running;
+    int               m_epollFd;
+    int               m_wakeFd;
+    vector<PThread *> m_threads;
+
+    typedef std::pair<OpalMediaTransport *, PINDEX> HandleKey;
+    typedef std::map<HandleKey, Handle *> HandleMap;
+    HandleMap             m_handles;
+    std::list<Handle *>   m_closed;
+    struct Retired {
+      Handle         * m_handle;
+      vector<unsigned> m_passes;
+    };
+    std::list<Retired>    m_retired;
+    vector<unsigned>      m_threadPasses;
+    PDECLARE_MUTEX(m_mutex);
+
+    PDECLARE_MUTEX(m_housekeepingMutex);
+    PSimpleTimer      m_checkTimer;
+
+  friend class OpalMediaTransport;
+};
+
+
 struct OpalMediaTransportChannelTypes
 {
   enum SubChannels
@@ -427,6 +500,12 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
       */
     virtual bool IsEstablished() const;
 
+    /**Indicate the transport may be serviced by a shared OpalMediaReactor.
+       Transports whose read processing can block, e.g. for a handshake,
+       should return false so they get a thread per subchannel.
+      */
+    virtual bool CanUseMediaReactor() const;
+
     /**Get the local transport address used by this media session.
        The \p subchannel can get an optional secondary channel address
        when false.
@@ -472,6 +551,28 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
       int * mtu = NULL
     ) = 0;
 
+    /**Start batching writes to media transport.
+       Until EndWriteBatch() is called, Write() calls made by this thread to
+       the \p subchannel are collected, and sent using as few system calls
+       as possible. Typically used for all the RTP packets of a video frame.
+
+       Returns false if batching is not supported, or another thread is
+       already batching, in which case Write() operates as normal and
+       EndWriteBatch() must not be called.
+
+       The default behaviour returns false.
+      */
+    virtual bool BeginWriteBatch(
+      SubChannels subchannel = e_Media
+    );
+
+    /**Send all writes collected since BeginWriteBatch() and stop batching.
+       Returns false if any of the writes failed.
+
+       The default behaviour does nothing.
+      */
+    virtual bool EndWriteBatch();
+
     /// Get the error code for the last read operation on transport
     PChannel::Errors GetLastError(SubChannels subchannel) const;
 
@@ -550,6 +651,9 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
     atomic<bool>  m_established;
     atomic<bool>  m_started;
 
+    OpalMediaReactor * m_reactor;
+    atomic<unsigned>   m_reactorChannels;
+
     atomic<CongestionControl *> m_congestionControl;
     PTimer m_ccTimer;
     PDECLARE_NOTIFIER(PTimer, OpalMediaTransport, ProcessCongestionControl);
@@ -565,6 +669,8 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
     friend ostream & operator<<(ostream & strm, RemoteAddressSources source);
 #endif
 
+    struct RxBufferPool;
+
     struct ChannelInfo
     {
       ChannelInfo(
@@ -573,8 +679,22 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
         PChannel * channel
       );
 
+      enum ReadResult {
+        e_ReadData,
+        e_ReadNothing,
+        e_ReadFailed,
+        e_ReadAborted
+      };
+      ReadResult ReadPacket();
+      ReadResult ReadSingle();
       void ThreadMain();
+      void HandleReadTimeout();
+      void CheckMediaTimeout();
+      void SendClosed();
       bool HandleUnavailableError();
+#ifdef P_LINUX
+      ReadResult ReadBatch();
+#endif
 
       typedef PNotifierListTemplate<PBYTEArray> NotifierList;
       NotifierList m_notifiers;
@@ -583,6 +703,9 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
       SubChannels    const m_subchannel;
       PChannel     * const m_channel;
       PThread            * m_thread;
+      bool                 m_polled;   // Serviced by OpalMediaReactor rather than m_thread
+      RxBufferPool       * m_rxPool;
+      PIPSocketAddressAndPort m_batchReceiveAddress; // Source of packet when read via ReadBatch()
       unsigned             m_consecutiveUnavailableErrors;
       PSimpleTimer         m_timeForUnavailableErrors;
       OpalTransportAddress m_localAddress;
@@ -599,6 +722,7 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
 #endif
     };
     friend struct ChannelInfo;
+    friend class OpalMediaReactor;
     typedef vector<ChannelInfo> ChannelArray;
     ChannelArray m_subchannels;
     void AddChannel(PChannel * channel);
@@ -630,16 +754,34 @@ class OpalUDPMediaTransport : public OpalMediaTransport
     virtual bool Open(OpalMediaSession & session, PINDEX count, const PString & localInterface, const OpalTransportAddress & remoteAddress);
     virtual bool SetRemoteAddress(const OpalTransportAddress & remoteAddress, SubChannels subchannel = e_Media);
     virtual bool Write(const void * data, PINDEX length, SubChannels = e_Media, const PIPSocketAddressAndPort * = NULL, int * = NULL);
+    virtual bool BeginWriteBatch(SubChannels subchannel = e_Media);
+    virtual bool EndWriteBatch();
 
     PUDPSocket * GetSubChannelAsSocket(SubChannels subchannel = e_Media) const;
 
   protected:
+    bool InternalWrite(PUDPSocket & socket, SubChannels subchannel, const void * data, PINDEX length, const PIPSocketAddressAndPort & dest, int * mtu);
+    bool FlushWriteBatch();
     virtual bool InternalRxData(SubChannels subchannel, const PBYTEArray & data);
     virtual bool InternalSetRemoteAddress(const PIPSocket::AddressAndPort & ap, SubChannels subchannel, RemoteAddressSources source);
     virtual bool InternalOpenPinHole(PUDPSocket & socket);
 
     bool m_localHasRestrictedNAT;
     vector<PUDPSocket *> m_socketCache;
+
+    struct WriteBatch
+    {
+      WriteBatch();
+
+      PThreadIdentifier       m_thread;
+      SubChannels             m_subchannel;
+      PIPSocketAddressAndPort m_destination;
+      PBYTEArray              m_data;
+      vector<PINDEX>          m_lengths;
+      PINDEX                  m_used;
+    } m_writeBatch;
+    PDECLARE_MUTEX(m_writeBatchMutex);
+    bool m_useSegmentOffload;
 };
 
 
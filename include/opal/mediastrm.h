@@ -239,12 +239,26 @@ class OpalMediaStream : public PSafeObject
 
     /**Write a list of RTP frames of data to the sink media stream.
        The default behaviour simply calls WritePacket() on each of the
-       elements in the list.
+       elements in the list, within a BeginWriteBatch()/EndWriteBatch().
       */
     virtual PBoolean WritePackets(
       RTP_DataFrameList & packets
     );
 
+    /**Indicate a number of WritePacket() calls are to follow.
+       For example, all the packets of a video frame. This allows the media
+       stream to send them using fewer system calls.
+
+       Returns true if EndWriteBatch() must be called after the writes.
+       The default behaviour returns false.
+      */
+    virtual bool BeginWriteBatch();
+
+    /**Complete a batch of writes started with BeginWriteBatch().
+       The default behaviour does nothing.
+      */
+    virtual void EndWriteBatch();
+
     /**Read an RTP frame of data from the source media stream.
        The default behaviour simply calls ReadData() on the data portion of the
        RTP_DataFrame and sets the frames timestamp and marker from the internal
@@ -291,6 +305,13 @@ class OpalMediaStream : public PSafeObject
       RTP_DataFrame & packet
     );
 
+    /**Pushes a list of frames, e.g. all the packets of a video frame, to
+       the patch, so they can be written to the sink streams together.
+      */
+    virtual bool PushPackets(
+      RTP_DataFrameList & packets
+    );
+
     /**Set the data size in bytes that is expected to be used. Some media
        streams can make use of this information to perform optimisations.
 
@@ -42,6 +42,201 @@
 
 class OpalTranscoder;
 
+
+/**Shared executor for media patches.
+   Rather than each OpalMediaPatch having its own thread that sleeps between
+   frames, this drives the patches as tasks from a small, fixed, pool of
+   worker threads. Tasks indicate when they next wish to run and are held
+   in a two level hierarchical timing wheel, of 1ms and 256ms resolution,
+   until due, when they are queued for the next free worker.
+
+   Worker threads are pinned to a processor core each, where supported by
+   the platform, to keep the media path cache warm.
+
+   The delay between when a task was due and when a worker actually ran it
+   is accumulated in a histogram, see GetJitterHistogram().
+  */
+class OpalMediaPatchExecutor : public PObject
+{
+    PCLASSINFO(OpalMediaPatchExecutor, PObject);
+  public:
+    OpalMediaPatchExecutor(
+      unsigned threadCount,   ///< Number of worker threads executing tasks
+      bool pinThreads = true  ///< Pin each worker thread to a processor core
+    );
+    ~OpalMediaPatchExecutor();
+
+    /// Output the executor statistics, including the jitter histogram.
+    virtual void PrintOn(ostream & strm) const;
+
+    class Task;
+    struct TaskList
+    {
+      Task * m_head;
+      Task * m_tail;
+
+      TaskList() : m_head(NULL), m_tail(NULL) { }
+      void Append(Task & task);
+      void Remove(Task & task);
+      Task * PopHead();
+    };
+
+    /**A unit of work to be executed.
+      */
+    class Task
+    {
+      public:
+        Task();
+        virtual ~Task() { }
+
+        /**Execute the task.
+           Return false if the task is finished and should not be executed
+           again. If true is returned, then \p delay is how long before the
+           task is next executed, relative to when it was last due.
+          */
+        virtual bool Execute(
+          PTimeInterval & delay   ///< Delay until next execution, initially zero
+        ) = 0;
+
+        /// Indicate the task has returned false from Execute()
+        bool IsFinished() const { return m_state == e_Finished; }
+
+      private:
+        enum State { e_Idle, e_Waiting, e_Ready, e_Running, e_Finished } m_state;
+        bool              m_removed;
+        bool              m_deleteOnReturn;
+        PInt64            m_dueTick;
+        PThreadIdentifier m_threadId;
+        PSyncPoint        m_completed;
+        Task            * m_prev;
+        Task            * m_next;
+        TaskList        * m_list;
+
+      friend class OpalMediaPatchExecutor;
+      friend struct TaskList;
+    };
+
+    /**Task calling a member function of an object.
+      */
+    template <class T> class TaskObj : public Task
+    {
+      public:
+        typedef bool (T::*Function)(PTimeInterval & delay);
+
+        TaskObj(T & obj, Function fn) : m_object(obj), m_function(fn) { }
+
+        virtual bool Execute(PTimeInterval & delay) { return (m_object.*m_function)(delay); }
+
+      protected:
+        T      & m_object;
+        Function m_function;
+    };
+
+    /**A set of independent jobs run in parallel.
+       Jobs are claimed one at a time by worker tasks and by the thread
+       calling Run(), which keeps claiming until none are left. So jobs the
+       workers have not got to, e.g. because they are all busy, are run by
+       the caller rather than waited for, and the executor being saturated
+       only costs the parallelism.
+      */
+    class Batch
+    {
+      public:
+        Batch();
+        virtual ~Batch() { }
+
+        /**Run jobs 0 to \p count-1, returning when all are complete.
+           If \p executor is NULL, they are all run on the calling thread.
+          */
+        void Run(
+          OpalMediaPatchExecutor * executor,  ///< Executor for parallel jobs
+          unsigned count                      ///< Number of jobs
+        );
+
+      protected:
+        /// Run a single job, may be called on any thread.
+        virtual void RunJob(
+          unsigned index    ///< Index of job, 0 to count-1
+        ) = 0;
+
+        bool RunNext();
+
+        struct WorkerTask;
+        atomic<unsigned> m_next;
+        unsigned         m_count;
+        PSemaphore       m_workerDone;
+    };
+
+    /**Schedule a task for execution after the delay.
+       A task may only be scheduled if it is new or has finished.
+      */
+    void Schedule(
+      Task & task,                          ///< Task to execute
+      const PTimeInterval & delay = 0       ///< Delay before first execution
+    );
+
+    /**Remove a task from the executor and delete it.
+       If the task is being executed by another thread, this will wait for it
+       to complete. If called from within the tasks own Execute() function,
+       the deletion is deferred until it returns.
+
+       The \p task pointer is set to NULL.
+      */
+    void Remove(
+      Task * & task   ///< Task to remove
+    );
+
+    /// Get the number of worker threads.
+    unsigned GetThreadCount() const { return m_workers.size(); }
+
+    /// Get the number of tasks currently scheduled or executing.
+    PINDEX GetTaskCount() const;
+
+    enum { NumJitterBuckets = 8 };
+    /// Upper limit, in milliseconds, of each jitter bucket bar the last.
+    static const unsigned JitterBucketLimits[NumJitterBuckets-1];
+
+    /**Get the histogram of task wake up jitter.
+       Each entry is the count of executions that started within the
+       JitterBucketLimits of when they were due. The last entry is all the
+       executions later than the final limit.
+      */
+    void GetJitterHistogram(
+      std::vector<PUInt64> & counts   ///< Counts for each bucket
+    ) const;
+
+  protected:
+    enum {
+      WheelBits = 8,
+      WheelSize = 1 << WheelBits,
+      WheelMask = WheelSize - 1
+    };
+
+    static PInt64 GetTick();
+    void Insert(Task & task);
+    void Unlink(Task & task);
+    void AdvanceWheel(PInt64 now);
+    void WheelMain();
+    void WorkerMain(unsigned index);
+
+    atomic<bool>      m_running;
+    bool              m_pinThreads;
+    PThread         * m_wheelThread;
+    vector<PThread *> m_workers;
+
+    PDECLARE_MUTEX(m_mutex);
+    PInt64     m_currentTick;
+    PInt64     m_nextWakeTick;
+    TaskList   m_wheel[2][WheelSize];
+    PINDEX     m_waitingCount;
+    TaskList   m_ready;
+    PINDEX     m_taskCount;
+    PSemaphore m_readySignal;
+    PSyncPoint m_wheelSignal;
+    PUInt64    m_jitterHistogram[NumJitterBuckets];
+};
+
+
 /**Media stream "patch cord".
    This class is the thread of control that transfers data from one
    "source" OpalMediStream to one or more other "sink" OpalMediStream
@@ -88,6 +283,12 @@ class OpalMediaPatch : public PSafeObject
   //@{
     /**Start the patch. The default implementation simply starts the
        patch thread, which in turn calls Main()
+
+       If the OpalManager has a shared OpalMediaPatchExecutor, then the
+       patch is instead scheduled as a task on that. Asynchronous patches
+       reading from an RTP stream are then driven entirely by the executor
+       at 10ms intervals, while all others are given their own thread as
+       usual once OnStartMediaPatch() has been called.
       */
     virtual void Start();
 
@@ -198,6 +399,15 @@ class OpalMediaPatch : public PSafeObject
       RTP_DataFrame & frame   ///< Frame to push
     );
 
+    /**Push a list of frames out to all the sink streams.
+       If there is no transcoding or bypass, the whole list is written to
+       each sink with OpalMediaStream::WritePackets(), otherwise this is the
+       same as calling PushFrame() on each of the frames.
+      */
+    virtual PBoolean PushFrames(
+      RTP_DataFrameList & frames   ///< Frames to push
+    );
+
     /**Set bypass patch instance.
 
        This can be useful for back to back calls that happen to be the same
@@ -244,7 +454,13 @@ class OpalMediaPatch : public PSafeObject
 
     /**Called from the associated patch thread */
     virtual void Main();
+    void MainLoop(bool asynchronous);
     void StopThread();
+    PString GetThreadName() const;
+
+    /**Called from the OpalMediaPatchExecutor each time patch is due */
+    bool OnScheduled(PTimeInterval & delay);
+    void OnPatchEnded();
     bool DispatchFrame(RTP_DataFrame & frame);
     bool DispatchFrameLocked(RTP_DataFrame & frame, bool bypassing);
 
@@ -259,8 +475,18 @@ class OpalMediaPatch : public PSafeObject
         bool UpdateMediaFormat(const OpalMediaFormat & mediaFormat);
         bool ExecuteCommand(const OpalMediaCommand & command, bool atLeastOne);
         bool WriteFrame(RTP_DataFrame & sourceFrame, bool bypassing);
+        bool WriteFrames(RTP_DataFrameList & sourceFrames);
 #if OPAL_STATISTICS
         void GetStatistics(OpalMediaStatistics & statistics, bool fromSource) const;
+
+        struct FrameTypes {
+          OpalAudioFormat::FrameType m_audio;
+#if OPAL_VIDEO
+          OpalVideoFormat::FrameType m_video;
+#endif
+        };
+        void GetFrameTypes(const RTP_DataFrame & frame, FrameTypes & types);
+        void UpdateStatistics(const RTP_DataFrame & frame, const FrameTypes & types);
 #endif
 
         OpalMediaPatch  &  m_patch;
@@ -307,6 +533,12 @@ class OpalMediaPatch : public PSafeObject
 
     PThread * m_patchThread;
     PDECLARE_MUTEX(m_patchThreadMutex);
+
+    OpalMediaPatchExecutor       * m_executor;
+    OpalMediaPatchExecutor::Task * m_executorTask;
+    bool                           m_startedByExecutor;
+    bool                           m_asynchronous;
+    RTP_DataFrame                  m_scheduledFrame;
 #if OPAL_STATISTICS
     PThreadIdentifier m_patchThreadId;
 #endif
@@ -324,6 +556,9 @@ class OpalMediaPatch : public PSafeObject
    whenever needed. Useful for implementations where the source is not
    a continuous data stream (e.g. H.224/H.281 FECC, where data is sent
    on user input) or the source stream is driven by an external thread loop.
+
+   If the OpalManager has a shared OpalMediaPatchExecutor, the start up of
+   the patch is executed as a task on that, rather than a decoupled event.
 */
 class OpalPassiveMediaPatch : public OpalMediaPatch
 {
@@ -338,6 +573,8 @@ class OpalPassiveMediaPatch : public OpalMediaPatch
     virtual void Close();
 
   protected:
+    bool OnScheduledStart(PTimeInterval & delay);
+
     bool m_started;
 };
 
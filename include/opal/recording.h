@@ -53,7 +53,8 @@ class OpalRecordManager : public PObject
     /** Factory for creating new recording managers. Selection is made based on the
         file extension of the file supplied to OpalManager::StartRecording().
 
-        Currently only WAV files, and for WIndows only, AVI files, are supported.
+        Currently only WAV files, and for WIndows only, AVI files, are supported,
+        plus PCAP files which store the media as received, see IsPassThrough().
         Howeer this factory allows an application to add their own file formats. */
     typedef PFactory<OpalRecordManager, PFilePathString> Factory;
 
@@ -150,6 +151,15 @@ class OpalRecordManager : public PObject
       */
     virtual bool IsOpen() const = 0;
 
+    /**Indicate the recording stores the media as received, encoded, rather
+       than decoded to PCM-16/YUV420P and mixed. The WriteAudio() and
+       WriteVideo() functions are then given the packets of the source media
+       format of each stream.
+
+       The default behaviour returns false.
+      */
+    virtual bool IsPassThrough() const { return false; }
+
     /**Close the recording file.
        Note this may block until various sub-threads are termianted so
        care may be needed to avoid deadlocks.
@@ -511,6 +511,20 @@ class OpalStreamedTranscoder : public OpalTranscoder
        Returns converted value.
       */
     virtual int ConvertOne(int sample) const = 0;
+
+    /**Convert a block of samples from one format to another.
+       This is called by Convert() for the whole payload before falling back
+       to calling ConvertOne() for every sample. Derived classes may override
+       this to provide a bulk conversion, e.g. table driven, without the
+       virtual call per sample.
+
+       Returns false if bulk conversion is not supported.
+      */
+    virtual bool ConvertSamples(
+      const BYTE * input,   ///<  Input samples
+      BYTE * output,        ///<  Output samples
+      PINDEX samples        ///<  Number of samples
+    );
   //@}
 
   protected:
@@ -525,6 +539,7 @@ class Opal_Linear16Mono_PCM : public OpalStreamedTranscoder {
   public:
     Opal_Linear16Mono_PCM();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples);
 };
 
 
@@ -534,6 +549,7 @@ class Opal_PCM_Linear16Mono : public OpalStreamedTranscoder {
   public:
     Opal_PCM_Linear16Mono();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples);
 };
 
 
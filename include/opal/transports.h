@@ -41,6 +41,7 @@
 #include <ptlib/sockets.h>
 #include <ptclib/psockbun.h>
 #include <ptclib/http.h>
+#include <ptclib/threadpool.h>
 
 
 class OpalManager;
@@ -992,8 +993,16 @@ class OpalTransport : public PSafeObject
     );
 
     /**Determine of the transport is running with a background thread.
+       This includes being serviced by an OpalSignalingReactor.
       */
     virtual PBoolean IsRunning() const;
+
+    /**Indicate the transport may be serviced by a shared OpalSignalingReactor.
+       Transports whose channel does its own framing, so a non-blocking read
+       could lose data, should return false so they get a thread.
+       Default returns false.
+      */
+    virtual bool CanUseSignalingReactor() const;
   //@}
 
     OpalEndPoint & GetEndPoint() const { return m_endpoint; }
@@ -1017,6 +1026,13 @@ class OpalTransport : public PSafeObject
     void Reference()   { ++m_referenceCount; }
     void Dereference() { --m_referenceCount; }
 
+    /**Get buffer for data read from the channel, but not yet consumed.
+       This is for use by the reading thread of stream based protocols that
+       do their own message framing, data after the end of the current
+       message is kept here for the next read.
+      */
+    PBYTEArray & GetReadAheadBuffer() { return m_readAhead; }
+
   protected:
     PDECLARE_NOTIFIER(PTimer, OpalTransport, KeepAlive);
 
@@ -1026,12 +1042,128 @@ class OpalTransport : public PSafeObject
     PCriticalSection m_threadMutex;
     PTimer           m_keepAliveTimer;
     PBYTEArray       m_keepAliveData;
+    PBYTEArray       m_readAhead;
     PSimpleTimer     m_idleTimer;
     atomic<unsigned> m_referenceCount;
+    atomic<unsigned> m_reactorHandles;
+    PThreadIdentifier m_reactorThread; ///< Reactor worker thread in handler, protected by m_threadMutex
 
   private:
     OpalTransport(const OpalTransport & other) : PSafeObject(other), m_endpoint(other.m_endpoint), m_referenceCount(0) { }
     void operator=(const OpalTransport &) { }
+
+  friend class OpalSignalingReactor;
+};
+
+
+/** Class for event driven reading of signalling transports.
+    Normally, every reliable signalling transport, e.g. a SIP TCP/TLS trunk
+    or H.225 connection, has a thread blocked in a read, mostly idle. This
+    class waits on all of their sockets with a small pool of I/O threads
+    using the operating system event mechanism (epoll). Received data is
+    accumulated in the transports read ahead buffer until a framing function
+    indicates a complete PDU is present, then a handler is called from a
+    queue serviced by a pool of worker threads. The handler can then use the
+    usual blocking read functions, which return the buffered PDU immediately.
+
+    Note this is currently only available on Linux, on other platforms
+    IsRunning() returns false and a thread per transport is used as usual.
+  */
+class OpalSignalingReactor : public PObject
+{
+    PCLASSINFO(OpalSignalingReactor, PObject);
+  public:
+    OpalSignalingReactor(
+      unsigned threadCount,   ///< Number of I/O threads servicing all sockets
+      unsigned maxWorkers     ///< Maximum number of threads executing handlers
+    );
+    ~OpalSignalingReactor();
+
+    /// Indicate reactor is supported on this platform, and is running.
+    bool IsRunning() const { return m_running; }
+
+    /// Get the number of I/O threads in the pool.
+    unsigned GetThreadCount() const { return m_threads.size(); }
+
+    /// Get the number of transports currently being serviced.
+    PINDEX GetTransportCount() const;
+
+    /**Function to determine if a complete PDU has been received.
+       Returns the length of the first PDU in \p data, or zero if more data
+       is required to complete it.
+      */
+    typedef PINDEX (*FramingFunction)(const BYTE * data, PINDEX size);
+
+    /**Handler called when a complete PDU is available. The \p rearm
+       parameter is true on entry, set it to false to stop the reactor
+       servicing the transport any further.
+      */
+    typedef PNotifierTemplate<bool &> ReadyNotifier;
+    #define PDECLARE_SignalingReadyNotifier(cls, fn) PDECLARE_NOTIFIER2(OpalTransport, cls, fn, bool &)
+    #define PCREATE_SignalingReadyNotifier(fn) PCREATE_NOTIFIER2(fn, bool &)
+
+    /**Start servicing the transport.
+       Note the channel read timeout is set to zero while the transport is
+       being serviced, and restored when the handler declines to rearm.
+
+       If no complete PDU arrives within \p timeout, the handler is called
+       with whatever partial data there is in the read ahead buffer.
+
+       Returns false if the reactor is not running, or the transport cannot
+       be used with it, in which case the caller should use a thread.
+      */
+    bool Add(
+      const OpalTransportPtr & transport,         ///< Transport to service
+      const ReadyNotifier & notifier,             ///< Handler for complete PDU
+      FramingFunction framer,                     ///< Determine PDU boundaries
+      const PTimeInterval & timeout = PMaxTimeInterval ///< Time to wait for each PDU
+    );
+
+    /**Stop servicing the transport.
+       This is called automatically by OpalTransport::Close().
+      */
+    void Remove(
+      OpalTransport & transport
+    );
+
+    struct Handle;
+
+    // Public for PQueuedThreadPool
+    struct ReadyWork
+    {
+      ReadyWork(OpalSignalingReactor & reactor, Handle * handle) : m_reactor(reactor), m_handle(handle) { }
+      void Work();
+      OpalSignalingReactor & m_reactor;
+      Handle               * m_handle;
+    };
+
+  protected:
+    void ThreadMain(unsigned index);
+    void OnReadable(uint64_t id);
+    bool ReadAvailable(Handle & handle);
+    void OnReady(Handle * handle);
+    bool Arm(Handle & handle);
+    void Detach(Handle & handle);
+    void Queue(Handle & handle);
+    void Housekeeping();
+    void Wake();
+
+    atomic<bool>      m_running;
+    int               m_epollFd;
+    int               m_wakeFd;
+    vector<PThread *> m_threads;
+    PQueuedThreadPool<ReadyWork> m_workers;
+
+    uint64_t m_lastHandleId;
+    typedef std::map<uint64_t, Handle *> HandleMap;
+    HandleMap m_handles;
+    typedef std::map<OpalTransport *, Handle *> TransportMap;
+    TransportMap m_transports;
+    std::list<Handle *> m_closed;
+    PDECLARE_MUTEX(m_mutex);
+
+    PDECLARE_MUTEX(m_checkMutex);
+    PSimpleTimer   m_checkTimer;
 };
 
 
@@ -1148,8 +1280,22 @@ class OpalTransportTCP : public OpalTransportIP
     virtual PBoolean WritePDU(
       const PBYTEArray & pdu     ///<  Packet to write
     );
+
+    /**Indicate the transport may be serviced by a shared OpalSignalingReactor.
+       Returns true.
+      */
+    virtual bool CanUseSignalingReactor() const;
   //@}
 
+    /**Framing function for OpalSignalingReactor for RFC1006 TPKT PDUs.
+       Returns the length, including TPKT header, of the first PDU in the
+       buffer or zero if it is not complete.
+      */
+    static PINDEX GetTPKTFrameLength(
+      const BYTE * data,
+      PINDEX size
+    );
+
     /** Set PDU length format.
         Zero indicates TPKT format (default)
         Negative number is number of little endian bytes.
@@ -1175,6 +1321,7 @@ class OpalTransportTCP : public OpalTransportIP
     virtual const PCaselessString & GetProtoPrefix() const;
 
     bool OnConnectedSocket(PTCPSocket * socket);
+    bool ReadBuffered(BYTE * data, PINDEX length);
 
     int  m_pduLengthFormat;
     int  m_pduLengthOffset;
@@ -1626,6 +1773,7 @@ public:
 
   virtual PBoolean IsCompatibleTransport(const OpalTransportAddress & address) const;
   virtual const PCaselessString & GetProtoPrefix() const;
+  virtual bool CanUseSignalingReactor() const;
 };
 
 
@@ -1672,6 +1820,7 @@ public:
 
   virtual PBoolean IsCompatibleTransport(const OpalTransportAddress & address) const;
   virtual const PCaselessString & GetProtoPrefix() const;
+  virtual bool CanUseSignalingReactor() const;
 };
 
 
@@ -65,6 +65,7 @@ class OpalDTLSMediaTransport : public OpalDTLSMediaTransportParent
 
     virtual bool Open(OpalMediaSession & session, PINDEX count, const PString & localInterface, const OpalTransportAddress & remoteAddress);
     virtual bool IsEstablished() const;
+    virtual bool CanUseMediaReactor() const;
     virtual bool GetKeyInfo(OpalMediaCryptoKeyInfo * keyInfo[2]);
 
     void SetPassiveMode(bool passive) { m_passiveMode = passive; }
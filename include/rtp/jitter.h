@@ -64,6 +64,7 @@ class OpalJitterBuffer : public PObject
       unsigned m_silenceShrinkTime;   ///< Amount to shrink jitter delay by if consistently silent
       unsigned m_jitterDriftPeriod;   ///< Time over which repeated undeflows cause packet to be dropped
       unsigned m_overrunFactor;       ///< Multiplier on JB length (in packets) before throwing away packets
+      unsigned m_ringBufferSize;      ///< Slots in lock free audio ring buffer, zero uses locked map
 
       Params(
         unsigned minJitterDelay = 40,
@@ -79,6 +80,7 @@ class OpalJitterBuffer : public PObject
         , m_silenceShrinkTime(20)
         , m_jitterDriftPeriod(500)
         , m_overrunFactor(2)
+        , m_ringBufferSize(0)
       { }
     };
 
@@ -285,7 +287,7 @@ class OpalAudioJitterBuffer : public OpalJitterBuffer
   //@}
 
   protected:
-    void InternalReset();
+    virtual void InternalReset();
     RTP_Timestamp CalculateRequiredTimestamp(RTP_Timestamp playOutTimestamp) const;
     enum AdjustResult {
       e_Unchanged,
@@ -349,6 +351,158 @@ class OpalAudioJitterBuffer : public OpalJitterBuffer
 };
 
 
+/**This is an Audio jitter buffer using a fixed size ring of pre-allocated
+   frames, indexed by sequence number, instead of a map. The thread writing
+   and the thread reading do not lock against each other. Changes made by the
+   writer that affect play out, talk burst, SSRC change and packet time, are
+   posted to the reader and applied on its next read, as are SetDelay() and
+   Restart(). The ring size is fixed at construction, so a later SetDelay()
+   with a larger maximum delay may result in overruns.
+  */
+class OpalAudioRingJitterBuffer : public OpalAudioJitterBuffer
+{
+  PCLASSINFO(OpalAudioRingJitterBuffer, OpalAudioJitterBuffer);
+
+  public:
+  /**@name Construction */
+  //@{
+    /**Constructor for this jitter buffer. The m_ringBufferSize in the
+       initialisation information is rounded up to a power of two.
+      */
+    OpalAudioRingJitterBuffer(
+      const Init & init  ///< Initialisation information
+    );
+
+    /** Destructor, which deletes the pre-allocated frames
+      */
+    virtual ~OpalAudioRingJitterBuffer();
+  //@}
+
+  /**@name Overrides from PObject */
+  //@{
+    /**Report the statistics for this jitter instance */
+    void PrintOn(
+      ostream & strm
+    ) const;
+  //@}
+
+  /**@name Operations */
+  //@{
+    /**Set the maximum delay the jitter buffer will operate to.
+       This is applied by the reading thread on its next ReadData().
+      */
+    virtual void SetDelay(
+      const Init & init  ///< Initialisation information
+    );
+
+    /**Restart jitter buffer.
+      */
+    virtual void Restart();
+
+    /**Write data frame from the RTP channel.
+      */
+    virtual bool WriteData(
+      const RTP_DataFrame & frame,        ///< Frame to feed into jitter buffer
+      const PTimeInterval & tick = PTimer::Tick() ///< Real time tick for packet arrival
+    );
+
+    /**Read a data frame from the jitter buffer.
+       This function never blocks. If no data is available, an RTP packet
+       with zero payload size is returned.
+      */
+    virtual bool ReadData(
+      RTP_DataFrame & frame,              ///<  Frame to extract from jitter buffer
+      const PTimeInterval & timeout = PMaxTimeInterval  ///< Time out for read
+      PTRACE_PARAM(, const PTimeInterval & tick = PMaxTimeInterval)
+    );
+
+    /**Get current delay for jitter buffer.
+      */
+    virtual RTP_Timestamp GetCurrentJitterDelay() const;
+
+    /**Get average packet time for incoming data.
+      */
+    virtual RTP_Timestamp GetPacketTime() const;
+
+    /**Get the number of frames currently in the ring.
+      */
+    unsigned GetRingDepth() const { return m_insertCount - m_removeCount; }
+
+    /**Get the number of slots in the ring.
+      */
+    unsigned GetRingSize() const { return m_ringSize; }
+  //@}
+
+  protected:
+    virtual void InternalReset();
+    void InternalResetWriter();
+    void InternalFlushWriter();
+    void InternalResetReader(unsigned flushSequence);
+    void InternalApplyChanges();
+
+    struct Slot
+    {
+      Slot() : m_timestamp(0), m_sequence(0), m_full(false) { }
+
+      RTP_DataFrame m_frame;
+      RTP_Timestamp m_timestamp;  ///< Written by writer only
+      unsigned      m_sequence;   ///< Extended sequence number, written by writer only
+      atomic<bool>  m_full;       ///< Writer fills when false, reader empties when true
+    };
+    Slot * GetOldestSlot();
+    void RemoveSlot(Slot & slot);
+
+    /// Change posted by one thread to be handled by another
+    struct Change
+    {
+      Change() : m_posted(0), m_handled(0) { }
+      void Post() { ++m_posted; }
+      bool Handle()
+      {
+        unsigned posted = m_posted;
+        if (posted == m_handled)
+          return false;
+        m_handled = posted;
+        return true;
+      }
+
+      atomic<unsigned> m_posted;
+      unsigned         m_handled;
+    };
+
+    unsigned m_ringSize;
+    unsigned m_ringMask;
+    Slot   * m_slots;
+
+    atomic<unsigned> m_readSequence;   ///< Next extended sequence number for reader
+    atomic<unsigned> m_writeSequence;  ///< One past highest extended sequence number written
+    atomic<unsigned> m_insertCount;
+    atomic<unsigned> m_removeCount;
+
+    // Writer only
+    unsigned      m_lastExtendedSequence;
+    RTP_Timestamp m_writerPacketTime;
+
+    // Writer to reader
+    atomic<unsigned>      m_flushSequence;
+    Change                m_flushChange;
+    Change                m_talkBurstChange;
+    Change                m_sourceChange;
+    atomic<RTP_Timestamp> m_postedPacketTime;
+    Change                m_packetTimeChange;
+
+    // Reader to writer
+    Change m_writerResetChange;
+
+    // Control to reader
+    Change   m_restartChange;
+    Change   m_delayChange;
+    Params   m_pendingParams;
+    unsigned m_pendingTimeUnits;
+    PINDEX   m_pendingPacketSize;
+};
+
+
 /// Null jitter buffer, just a simpple queue
 class OpalNonJitterBuffer : public OpalJitterBuffer
 {
@@ -56,6 +56,19 @@ class OpalPCAPFile : public PFile
     bool WriteFrame(const PEthSocket::Frame & frame);
     bool WriteRTP(const RTP_DataFrame & rtp, WORD port = 5000);
 
+    /**Format the PCAP record for an RTP packet into memory, instead of
+       writing it to the file. This allows a writer to batch many records
+       into one large sequential Write().
+       Returns the offset in the buffer after the record.
+      */
+    PINDEX FormatRTP(
+      PBYTEArray & buffer,          ///< Buffer to put record, grown as needed
+      PINDEX offset,                ///< Offset in buffer for record
+      const RTP_DataFrame & rtp,    ///< RTP packet to record
+      const PTime & timestamp,      ///< Time packet was received
+      WORD port = 5000              ///< UDP source and destination port
+    ) const;
+
     int GetDataLink(PBYTEArray & payload);
     int GetIP(PBYTEArray & payload);
     int GetTCP(PBYTEArray & payload);
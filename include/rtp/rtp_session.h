@@ -184,7 +184,8 @@ class OpalRTPSession : public OpalMediaSession
       e_RxFromNetwork,
       e_RxOutOfOrder,
       e_RxRetransmit,
-      e_RxFromRTX
+      e_RxFromRTX,
+      e_RxFromFEC     ///< Recovered via FEC, or already decoded so it could be used for FEC recovery
     };
 
     /**Write a data frame from the RTP channel.
@@ -196,6 +197,24 @@ class OpalRTPSession : public OpalMediaSession
       const PTime & now = PTime()
     );
 
+    /**Write a list of data frames from the RTP channel.
+       The session is locked, and the frames processed, e.g. encrypted, once
+       for the whole list, then they are sent using a transport write batch,
+       if available. Typically used for all the RTP packets of a video frame.
+
+       Returns e_AbortTransport if any write failed, e_IgnorePacket if every
+       frame was ignored, and e_ProcessPacket otherwise.
+
+       The list is processed by the OnSendData() overload for a list, so a
+       derived session, e.g. SRTP, can handle the whole list in one go.
+      */
+    virtual SendReceiveStatus WriteData(
+      RTP_DataFrameList & frames,                     ///<  Frames to write to the RTP session
+      RewriteMode rewrite = e_RewriteHeader,          ///< Indicate what headers are to be rewritten
+      const PIPSocketAddressAndPort * remote = NULL,  ///< Alternate address to transmit data frames
+      const PTime & now = PTime()
+    );
+
     /**Send a report to remote.
       */
     virtual SendReceiveStatus SendReport(
@@ -251,6 +270,11 @@ class OpalRTPSession : public OpalMediaSession
     );
 
     virtual SendReceiveStatus OnSendData(RewriteMode & rewrite, RTP_DataFrame & frame, const PTime & now);
+    /**Process a list of data frames to be sent, already locked on entry.
+       The \p statuses is filled with the result for each frame. The default
+       behaviour calls OnSendData() for each frame in the list.
+      */
+    virtual void OnSendData(RewriteMode rewrite, RTP_DataFrameList & frames, std::vector<SendReceiveStatus> & statuses, const PTime & now);
     virtual SendReceiveStatus OnSendControl(RTP_ControlFrame & frame, const PTime & now);
     virtual SendReceiveStatus OnPreReceiveData(RTP_DataFrame & frame, const PTime & now);
     virtual SendReceiveStatus OnReceiveData(RTP_DataFrame & frame, ReceiveType rxType, const PTime & now);
@@ -348,6 +372,112 @@ class OpalRTPSession : public OpalMediaSession
       vector<FecLevel> m_level;
     };
 
+    /**Generate RFC 5109 XOR parity for sent packets.
+       Each group of consecutive packets is protected by a number of parity
+       blocks, block N covering every "levels"th packet from offset N. So a
+       burst of up to "levels" lost packets in a group can be recovered.
+
+       Note only the payload, marker, payload type and timestamp are
+       protected, the CSRC list and header extensions are not.
+      */
+    class FecEncoder
+    {
+      public:
+        FecEncoder(
+          unsigned groupSize = 8,   ///< Number of media packets in a group, 1 to 48
+          unsigned levels = 1       ///< Number of parity blocks for each group
+        );
+
+        /// Set the group parameters, this resets any partial group.
+        void SetGroupSize(unsigned groupSize, unsigned levels);
+
+        unsigned GetGroupSize() const { return m_groupSize; }
+        unsigned GetLevels() const { return m_levels; }
+
+        /**Add a sent media packet to the current group.
+           The parity for a group is returned with the packet after the last
+           one in the group, so it is not lost along with that packet.
+           @return true if \p fec is set to parity blocks to send.
+          */
+        bool Encode(
+          const RTP_DataFrame & frame,
+          vector<FecData> & fec
+        );
+
+        /**Get all parity not yet sent, completing any partial group.
+           Used when no media packet is coming to carry it, e.g. on close
+           or when idle, so the final group can still be recovered.
+           @return true if \p fec is set to parity blocks to send.
+          */
+        bool Flush(
+          vector<FecData> & fec
+        );
+
+        /// Indicate there is parity, or a partial group, not yet sent.
+        bool HasPending() const { return m_count > 0 || !m_ready.empty(); }
+
+        /// Get the payload type of the last media packet encoded.
+        RTP_DataFrame::PayloadTypes GetLastPayloadType() const { return m_lastPayloadType; }
+
+        /// Get the timestamp of the last media packet encoded.
+        RTP_Timestamp GetLastTimestamp() const { return m_lastTimestamp; }
+
+      protected:
+        void StartGroup(RTP_SequenceNumber snBase);
+        void CompleteGroup();
+
+        unsigned           m_groupSize;
+        unsigned           m_levels;
+        unsigned           m_count;
+        RTP_SequenceNumber m_snBase;
+        vector<FecData>    m_parity;
+        vector<uint64_t>   m_masks;
+        vector<FecData>    m_ready;
+        RTP_DataFrame::PayloadTypes m_lastPayloadType;
+        RTP_Timestamp               m_lastTimestamp;
+    };
+
+    /**Recover lost packets from received packets and RFC 5109 XOR parity.
+       Parity blocks that cannot yet be used are kept until the packets they
+       protect either arrive, or age out of the history.
+      */
+    class FecDecoder
+    {
+      public:
+        FecDecoder();
+
+        /**Add a received media packet.
+           Any packets that can now be recovered are appended to \p recovered.
+          */
+        void AddPacket(
+          const RTP_DataFrame & frame,
+          RTP_DataFrameList & recovered
+        );
+
+        /**Add a received FEC parity block.
+           Any packets that can now be recovered are appended to \p recovered.
+          */
+        void AddFEC(
+          const FecData & fec,
+          RTP_SyncSourceId ssrc,
+          RTP_DataFrameList & recovered
+        );
+
+      protected:
+        enum { HistorySize = 128, MaxPendingFEC = 32 };
+
+        bool HasPacket(RTP_SequenceNumber sn) const;
+        bool Recover(const FecData & fec, RTP_DataFrameList & recovered);
+        void RecoverPending(RTP_DataFrameList & recovered);
+
+        vector<RTP_DataFrame> m_history;   // Indexed by SN modulo HistorySize
+        vector<int>           m_historySN; // SN of entry in m_history, -1 if empty
+        std::list<FecData>    m_pending;
+        RTP_SyncSourceId      m_ssrc;
+        RTP_SequenceNumber    m_highestSN;
+        bool                  m_receivedAny;
+    };
+
     /// Get the RFC 2198 redundent data payload type
     RTP_DataFrame::PayloadTypes GetRedundencyPayloadType() const { return m_redundencyPayloadType; }
 
@@ -363,8 +493,14 @@ class OpalRTPSession : public OpalMediaSession
     /// Get the RFC 5109 transmit level (number of packets that can be lost)
     unsigned GetUlpFecSendLevel() const { return m_ulpFecSendLevel; }
 
-    /// Set the RFC 2198 redundent data payload type
+    /// Set the RFC 5109 transmit level (number of packets that can be lost)
     void SetUlpFecSendLevel(unsigned level) { m_ulpFecSendLevel = level; }
+
+    /// Get the RFC 5109 transmit group size (number of packets protected)
+    unsigned GetUlpFecGroupSize() const { return m_ulpFecGroupSize; }
+
+    /// Set the RFC 5109 transmit group size (number of packets protected)
+    void SetUlpFecGroupSize(unsigned size) { m_ulpFecGroupSize = size; }
 #endif // OPAL_RTP_FEC
 
     /**Get the label for the RTP session.
@@ -670,6 +806,7 @@ class OpalRTPSession : public OpalMediaSession
     PDECLARE_MediaReadNotifier(OpalRTPSession, OnRxDataPacket);
     PDECLARE_MediaReadNotifier(OpalRTPSession, OnRxControlPacket);
     void SessionFailed(SubChannels subchannel PTRACE_PARAM(, const char * reason));
+    SendReceiveStatus WriteProcessedData(OpalMediaTransport & transport, SendReceiveStatus status, RTP_DataFrame & frame, const PIPSocketAddressAndPort * remote);
 
     OpalRTPEndPoint   & m_endpoint;
     OpalManager       & m_manager;
@@ -699,6 +836,7 @@ class OpalRTPSession : public OpalMediaSession
     RTP_DataFrame::PayloadTypes m_redundencyPayloadType;
     RTP_DataFrame::PayloadTypes m_ulpFecPayloadType;
     unsigned                    m_ulpFecSendLevel;
+    unsigned                    m_ulpFecGroupSize;
 #endif // OPAL_RTP_FEC
 
     class NotifierMap : public std::multimap<unsigned, DataNotifier>
@@ -735,9 +873,14 @@ class OpalRTPSession : public OpalMediaSession
       virtual SendReceiveStatus OnSendRedundantData(RTP_DataFrame & primary, RTP_DataFrameList & redundancies);
       virtual SendReceiveStatus OnReceiveRedundantFrame(RTP_DataFrame & frame);
       virtual SendReceiveStatus OnReceiveRedundantData(RTP_DataFrame & primary, RTP_DataFrame::PayloadTypes payloadType, unsigned timestamp, const BYTE * data, PINDEX size);
-      virtual SendReceiveStatus OnSendFEC(RTP_DataFrame & primary, FecData & fec);
+      virtual SendReceiveStatus OnSendFEC(RTP_DataFrame & primary, vector<FecData> & fec);
+      virtual bool GetFECFlushFrame(RTP_DataFrame & frame, const PTime & now, bool idleOnly);
       virtual SendReceiveStatus OnReceiveFEC(RTP_DataFrame & primary, const FecData & fec);
+      virtual SendReceiveStatus OnReceiveFECProtected(RTP_DataFrame & frame);
+      virtual SendReceiveStatus OnReceiveFECRecovered(RTP_DataFrameList & recovered);
 #endif // OPAL_RTP_FEC
+      SendReceiveStatus DecodeReceivedData(RTP_DataFrame & frame, ReceiveType rxType, const PTime & now);
+      SendReceiveStatus CallReceiveNotifiers(RTP_DataFrame & frame);
 
 
       void CalculateRTT(const PTime & reportTime, const PTimeInterval & reportDelay, const PTime & now);
@@ -791,8 +934,9 @@ class OpalRTPSession : public OpalMediaSession
 
       struct RxPacket : RTP_DataFrame {
         PTime m_lastNackTime; // If lost, this is valid
-        explicit RxPacket(const RTP_DataFrame & pkt) : RTP_DataFrame(pkt), m_lastNackTime(0) { }
-        explicit RxPacket(const PTime & when) : RTP_DataFrame(0), m_lastNackTime(when) { }
+        ReceiveType m_rxType; // How to process when resequenced
+        explicit RxPacket(const RTP_DataFrame & pkt, ReceiveType rxType = e_RxOutOfOrder) : RTP_DataFrame(pkt), m_lastNackTime(0), m_rxType(rxType) { }
+        explicit RxPacket(const PTime & when) : RTP_DataFrame(0), m_lastNackTime(when), m_rxType(e_RxOutOfOrder) { }
       };
       typedef std::map<uint32_t, RxPacket> RxPacketMap;
       RxPacketMap m_pendingRxPackets;
@@ -878,6 +1022,12 @@ class OpalRTPSession : public OpalMediaSession
       OpalJitterBuffer * m_jitterBuffer;
       OpalJitterBuffer * GetJitterBuffer() const;
 
+#if OPAL_RTP_FEC
+      FecEncoder m_fecEncoder;
+      FecDecoder m_fecDecoder;
+      unsigned   m_fecPackets; // Parity blocks sent, or packets recovered
+#endif
+
       PTRACE_THROTTLE(m_throttleSendData,3,20000);
       PTRACE_THROTTLE(m_throttleReceiveData,3,20000);
       PTRACE_THROTTLE(m_throttleRxSR,3,60000,5);
@@ -885,12 +1035,17 @@ class OpalRTPSession : public OpalMediaSession
       PTRACE_THROTTLE(m_throttleTxRED,3,60000);
       PTRACE_THROTTLE(m_throttleRxRED,3,60000);
       PTRACE_THROTTLE(m_throttleRxUnknownFEC,3,10000);
+      PTRACE_THROTTLE(m_throttleTxFEC,3,60000);
+      PTRACE_THROTTLE(m_throttleRxFEC,3,60000);
       PTRACE_THROTTLE(m_throttleInvalidLost,2,60000);
 
       P_REMOVE_VIRTUAL(SendReceiveStatus, OnSendData(RTP_DataFrame &, bool), e_AbortTransport);
       P_REMOVE_VIRTUAL(SendReceiveStatus, OnSendData(RTP_DataFrame &, RewriteMode), e_AbortTransport);
       P_REMOVE_VIRTUAL(SendReceiveStatus, OnOutOfOrderPacket(RTP_DataFrame &), e_AbortTransport);
       P_REMOVE_VIRTUAL(SendReceiveStatus, OnReceiveData(RTP_DataFrame &, ReceiveType), e_AbortTransport);
+#if OPAL_RTP_FEC
+      P_REMOVE_VIRTUAL(SendReceiveStatus, OnSendFEC(RTP_DataFrame &, FecData &), e_AbortTransport);
+#endif
    };
 
     typedef std::map<RTP_SyncSourceId, SyncSource *> SyncSourceMap;
@@ -905,6 +1060,11 @@ class OpalRTPSession : public OpalMediaSession
     virtual bool CheckControlSSRC(RTP_SyncSourceId senderSSRC, RTP_SyncSourceId targetSSRC, SyncSource * & info PTRACE_PARAM(, const char * pduName));
     virtual bool ResequenceOutOfOrderPackets(SyncSource & ssrc) const;
 
+#if OPAL_RTP_FEC
+    /// Send any ULP-FEC parity still waiting for a media packet to carry it
+    virtual void FlushFEC(const PTime & now, bool idleOnly);
+#endif
+
     /// Set up RTCP as per RFC rules
     virtual bool InternalSendReport(RTP_ControlFrame & report, SyncSource & sender, bool includeReceivers, bool forced, const PTime & now);
     virtual void InitialiseControlFrame(RTP_ControlFrame & frame, SyncSource & sender);
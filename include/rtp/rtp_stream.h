@@ -116,6 +116,24 @@ class OpalRTPMediaStream : public OpalMediaStream
       RTP_DataFrame & packet
     );
 
+    /**Write a list of RTP frames of data to the sink media stream.
+       The new behaviour calls OpalRTPSession::WriteData() for the whole
+       list, so the session is locked, and packets encrypted, once.
+      */
+    virtual PBoolean WritePackets(
+      RTP_DataFrameList & packets
+    );
+
+    /**Indicate a number of WritePacket() calls are to follow.
+       The new behaviour batches the writes in the media transport.
+      */
+    virtual bool BeginWriteBatch();
+
+    /**Complete a batch of writes started with BeginWriteBatch().
+       The new behaviour sends everything collected by the media transport.
+      */
+    virtual void EndWriteBatch();
+
     /**Set the data size in bytes that is expected to be used.
       */
     virtual PBoolean SetDataSize(
@@ -195,6 +213,8 @@ protected:
     virtual bool InternalUpdateMediaFormat(const OpalMediaFormat & mediaFormat);
     virtual bool InternalSetPaused(bool pause, bool fromUser, bool fromPatch);
     virtual bool InternalExecuteCommand(const OpalMediaCommand & command);
+    bool PrepareWrite();
+    bool PrepareWritePacket(RTP_DataFrame & packet);
 
     OpalRTPSession    & m_rtpSession;
     bool                m_rewriteHeaders;
@@ -203,6 +223,7 @@ protected:
     OpalMediaStreamPtr  m_passThruStream;
     OpalJitterBuffer  * m_jitterBuffer;
     PTimeInterval       m_readTimeout;
+    OpalMediaTransportPtr m_writeBatchTransport;
 
 #if OPAL_VIDEO
     bool          m_forceIntraFrameFlag;
@@ -67,6 +67,12 @@ namespace OpalFEC
 #endif
 
   const PString & MediaTypeOption();
+
+  /// Option on ULP-FEC formats for number of packets protected by each parity group
+  const PString & GroupSizeOption();
+
+  /// Option on ULP-FEC formats for number of parity blocks per group, i.e. burst of lost packets recoverable
+  const PString & ProtectionLevelOption();
 };
 #endif // OPAL_RTP_FEC
 
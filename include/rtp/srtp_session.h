@@ -140,6 +140,7 @@ class OpalSRTPSession : public OpalRTPSession
     virtual RTP_SyncSourceId AddSyncSource(RTP_SyncSourceId id, Direction dir, const char * cname = NULL);
 
     virtual SendReceiveStatus OnSendData(RewriteMode & rewrite, RTP_DataFrame & frame, const PTime & now);
+    virtual void OnSendData(RewriteMode rewrite, RTP_DataFrameList & frames, std::vector<SendReceiveStatus> & statuses, const PTime & now);
     virtual SendReceiveStatus OnSendControl(RTP_ControlFrame & frame, const PTime & now);
     virtual SendReceiveStatus OnReceiveData(RTP_DataFrame & frame, ReceiveType rxType, const PTime & now);
     virtual SendReceiveStatus OnReceiveControl(RTP_ControlFrame & frame, const PTime & now);
@@ -154,11 +155,29 @@ class OpalSRTPSession : public OpalRTPSession
     virtual void OnRxDataPacket(OpalMediaTransport & transport, PBYTEArray data);
     virtual void OnRxControlPacket(OpalMediaTransport & transport, PBYTEArray data);
 
+    /**Protect a data frame, already locked on entry.
+       If \p frame shares its buffer with other frames, or has no room for
+       the SRTP trailer, it is protected in an internal buffer, which the
+       \p frame is then set to refer to. The original buffer is not altered,
+       and no memory is allocated once the internal buffers are established.
+      */
+    SendReceiveStatus ProtectData(RTP_DataFrame & frame);
+
+    /**Protect a list of data frames, already locked on entry, with the keys
+       already checked. Each frame whose entry in \p statuses is
+       e_ProcessPacket is protected, and its status updated.
+      */
+    void ProtectData(RTP_DataFrameList & frames, std::vector<SendReceiveStatus> & statuses);
+    RTP_DataFrame * GetProtectBuffer();
+
     bool                       m_anyRTCP_SSRC;
     srtp_ctx_t               * m_context;
     std::set<RTP_SyncSourceId> m_addedStream;
     OpalSRTPKeyInfo          * m_keyInfo[2]; // rx & tx
     unsigned                   m_consecutiveErrors[2][2];
+
+    enum { MaxProtectBuffers = 16, ProtectBufferSize = 1500 };
+    vector<RTP_DataFrame>      m_protectBuffers;
     SendReceiveStatus CheckConsecutiveErrors(bool ok, Direction dir, SubChannels subchannel);
 
 #if PTRACING
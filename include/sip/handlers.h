@@ -126,10 +126,18 @@ public:
 
   virtual bool ShutDown();
 
+  /**Try to reconnect a dropped transport for this handler.
+     The reconnect is done from the SIP thread pool, as it can block, with
+     one retry a second later in case the remote is bouncing. Then the
+     handler is set to Restoring, or Unavailable if it could not connect.
+    */
+  void ReconnectTransport(const OpalTransportPtr & transport);
+
 protected:
   virtual PBoolean SendRequest(SIPHandler::State state);
   void RetryLater(unsigned after);
   void OnExpireTimeout();
+  void OnReconnectTimeout();
   PDECLARE_WriteConnectCallback(SIPHandler, WriteTransaction);
 
   const PString m_callID;
@@ -151,6 +159,9 @@ protected:
   std::queue<State>           m_stateQueue;
   bool                        m_receivedResponse;
   SIPPoolTimer<SIPHandler>    m_expireTimer; 
+  SIPPoolTimer<SIPHandler>    m_reconnectTimer;
+  OpalTransportPtr            m_reconnectTransport;
+  unsigned                    m_reconnectAttempts;
   OpalProductInfo             m_productInfo;
   bool                        m_retryForbidden;
 
@@ -1042,6 +1042,8 @@ class SIPEndPoint : public OpalSDPEndPoint
   protected:
     void AddTransport(const OpalTransportPtr & transport, KeepAliveType keepAliveType);
     void TransportThreadMain(OpalTransportPtr transport);
+    bool AddToSignalingReactor(const OpalTransportPtr & transport);
+    PDECLARE_SignalingReadyNotifier(SIPEndPoint, OnTransportReady);
     SIP_PDU::StatusCodes InternalHandleREGISTER(SIP_PDU & request, SIP_PDU * response);
 
     SIPURL        m_proxy;
@@ -1067,7 +1069,8 @@ class SIPEndPoint : public OpalSDPEndPoint
     bool          m_shuttingDown;
 
     // Transport management
-    PSafeDictionary<OpalTransportAddress, OpalTransport> m_transportsTable;
+    typedef OpalSafeShardedDictionary<OpalTransportAddress, OpalTransport> TransportDict;
+    TransportDict m_transportsTable;
     PDECLARE_INSTRUMENTED_MUTEX(m_transportsMutex, SIPTransport, 2000, 1000);
 
     // Sub-protocol handlers
@@ -1077,7 +1080,8 @@ class SIPEndPoint : public OpalSDPEndPoint
     PStringToString   m_receivedConnectionTokens;
     PDECLARE_MUTEX(m_receivedConnectionMutex);
 
-    PSafeDictionary<PString, SIPTransactionBase> m_activeTransactions;
+    typedef OpalSafeShardedDictionary<PString, SIPTransactionBase, 64> TransactionDict;
+    TransactionDict m_activeTransactions;
 
     atomic<unsigned> m_lastSentCSeq;
     int              m_defaultAppearanceCode;
@@ -1094,7 +1098,7 @@ class SIPEndPoint : public OpalSDPEndPoint
     ConferenceMap m_conferenceAOR;
 
     // Registrar
-    typedef PSafeDictionary<SIPURL, RegistrarAoR> RegistrarDict;
+    typedef OpalSafeShardedDictionary<SIPURL, RegistrarAoR, 64> RegistrarDict;
     RegistrarDict m_registeredUAs;
     PStringSet    m_registrarDomains;
 
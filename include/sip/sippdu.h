@@ -675,6 +675,27 @@ class SIP_PDU : public PSafeObject
       bool truncated
     );
 
+    /**Parse a complete PDU held in memory, e.g. a received datagram.
+       This is done in a single pass directly over the buffer, without
+       copying it into intermediate strings and streams.
+      */
+    StatusCodes Parse(
+      const char * data,    ///< Pointer to PDU text
+      PINDEX length,        ///< Length of PDU text
+      bool truncated        ///< Datagram was truncated
+    );
+
+    /**Framing function for OpalSignalingReactor on stream transports.
+       Returns the length of the first complete message, or keep-alive ping,
+       in the buffer, using the blank line at the end of the header and the
+       Content-Length, or zero if more data is needed. A non-zero return
+       guarantees Read() will not block.
+      */
+    static PINDEX GetStreamFrameLength(
+      const BYTE * data,
+      PINDEX size
+    );
+
     /**Write the PDU to the transport.
       */
     virtual bool Send();
@@ -719,6 +740,10 @@ class SIP_PDU : public PSafeObject
   protected:
     void CalculateVia();
     StatusCodes InternalSend(bool canDoTCP);
+    StatusCodes ReadStream();
+    StatusCodes ParseStartLine(const PString & cmd);
+    bool GetValidContentLength(int & contentLength) const;
+    StatusCodes ParseCompleted(const PString & cmd, bool truncated, int contentLength);
 
     Methods     m_method;                 // Request type, ==NumMethods for Response
     StatusCodes m_statusCode;
@@ -59,30 +59,85 @@ static void destroy_codec(const struct PluginCodec_Definition * codec, void * co
 
 /////////////////////////////////////////////////////////////////////////////
 
-#define define_coder(dir, bps) \
-static int dir##coder_##bps(const struct PluginCodec_Definition * codec, \
-                                                           void * context, \
-                                                     const void * from, \
-                                                       unsigned * fromLen, \
-                                                           void * to, \
-                                                       unsigned * toLen, \
-                                                   unsigned int * flag) \
+/* Whole payload per call when the host says so, see PluginCodec_StreamedBulk.
+   Coded samples are packed least significant bit first. Otherwise one sample
+   per call as an int, as older hosts expect. */
+
+#define define_coder(bps, bits) \
+static int encoder_##bps(const struct PluginCodec_Definition * codec, \
+                                                     void * context, \
+                                               const void * from, \
+                                                 unsigned * fromLen, \
+                                                     void * to, \
+                                                 unsigned * toLen, \
+                                             unsigned int * flag) \
 { \
-  *(int *)to = g726_##bps##_##dir##coder(*(int *)from, AUDIO_ENCODING_LINEAR, (struct g726_state_s *)context); \
+  const short * samples = (const short *)from; \
+  unsigned char * coded = (unsigned char *)to; \
+  unsigned count = *fromLen/2; \
+  unsigned needed = (count*bits+7)/8; \
+  unsigned bit = 0; \
+  unsigned i; \
+  if ((*flag & PluginCodec_CoderStreamedBulk) == 0) { \
+    *(int *)to = g726_##bps##_encoder(*(int *)from, AUDIO_ENCODING_LINEAR, (struct g726_state_s *)context); \
+    return 1; \
+  } \
+  if (*toLen < needed) \
+    return 0; \
+  memset(coded, 0, needed); \
+  for (i = 0; i < count; ++i) { \
+    int code = g726_##bps##_encoder(samples[i], AUDIO_ENCODING_LINEAR, (struct g726_state_s *)context); \
+    coded[0] |= (unsigned char)(code << bit); \
+    if (bit + bits > 8) \
+      coded[1] |= (unsigned char)(code >> (8 - bit)); \
+    bit += bits; \
+    if (bit >= 8) { \
+      ++coded; \
+      bit -= 8; \
+    } \
+  } \
+  *toLen = needed; \
+  return 1; \
+} \
+\
+static int decoder_##bps(const struct PluginCodec_Definition * codec, \
+                                                     void * context, \
+                                               const void * from, \
+                                                 unsigned * fromLen, \
+                                                     void * to, \
+                                                 unsigned * toLen, \
+                                             unsigned int * flag) \
+{ \
+  const unsigned char * coded = (const unsigned char *)from; \
+  short * samples = (short *)to; \
+  unsigned count = *toLen/2; \
+  unsigned bit = 0; \
+  unsigned i; \
+  if ((*flag & PluginCodec_CoderStreamedBulk) == 0) { \
+    *(int *)to = g726_##bps##_decoder(*(int *)from, AUDIO_ENCODING_LINEAR, (struct g726_state_s *)context); \
+    return 1; \
+  } \
+  if (*fromLen < (count*bits+7)/8) \
+    return 0; \
+  for (i = 0; i < count; ++i) { \
+    int code = coded[0] >> bit; \
+    if (bit + bits > 8) \
+      code |= coded[1] << (8 - bit); \
+    samples[i] = (short)g726_##bps##_decoder(code & ((1 << bits) - 1), AUDIO_ENCODING_LINEAR, (struct g726_state_s *)context); \
+    bit += bits; \
+    if (bit >= 8) { \
+      ++coded; \
+      bit -= 8; \
+    } \
+  } \
+  *toLen = count*2; \
   return 1; \
 }
 
-define_coder(en, 40)
-define_coder(de, 40)
-
-define_coder(en, 32)
-define_coder(de, 32)
-
-define_coder(en, 24)
-define_coder(de, 24)
-
-define_coder(en, 16)
-define_coder(de, 16)
+define_coder(40, 5)
+define_coder(32, 4)
+define_coder(24, 3)
+define_coder(16, 2)
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -179,6 +234,7 @@ static struct PluginCodec_Definition g726CodecDefn[] =
     &licenseInfo,                         // license information
 
     PluginCodec_MediaTypeAudioStreamed |  // audio codec
+    PluginCodec_StreamedBulk |            // whole payload per call
     (5 << PluginCodec_BitsPerSamplePos) | // bits per sample
     PluginCodec_InputTypeRaw |            // raw input data
     PluginCodec_OutputTypeRaw |           // raw output data
@@ -219,6 +275,7 @@ static struct PluginCodec_Definition g726CodecDefn[] =
     &licenseInfo,                         // license information
 
     PluginCodec_MediaTypeAudioStreamed |  // audio codec
+    PluginCodec_StreamedBulk |            // whole payload per call
     (5 << PluginCodec_BitsPerSamplePos) | // bits per sample
     PluginCodec_InputTypeRaw |            // raw input data
     PluginCodec_OutputTypeRaw |           // raw output data
@@ -261,6 +318,7 @@ static struct PluginCodec_Definition g726CodecDefn[] =
     &licenseInfo,                         // license information
 
     PluginCodec_MediaTypeAudioStreamed |  // audio codec
+    PluginCodec_StreamedBulk |            // whole payload per call
     (4 << PluginCodec_BitsPerSamplePos) | // bits per sample
     PluginCodec_InputTypeRaw |            // raw input data
     PluginCodec_OutputTypeRaw |           // raw output data
@@ -299,6 +357,7 @@ static struct PluginCodec_Definition g726CodecDefn[] =
     &licenseInfo,                         // license information
 
     PluginCodec_MediaTypeAudioStreamed |  // audio codec
+    PluginCodec_StreamedBulk |            // whole payload per call
     (4 << PluginCodec_BitsPerSamplePos) | // bits per sample
     PluginCodec_InputTypeRaw |            // raw input data
     PluginCodec_OutputTypeRaw |           // raw output data
@@ -339,6 +398,7 @@ static struct PluginCodec_Definition g726CodecDefn[] =
     &licenseInfo,                         // license information
 
     PluginCodec_MediaTypeAudioStreamed |  // audio codec
+    PluginCodec_StreamedBulk |            // whole payload per call
     (3 << PluginCodec_BitsPerSamplePos) | // bits per sample
     PluginCodec_InputTypeRaw |            // raw input data
     PluginCodec_OutputTypeRaw |           // raw output data
@@ -377,6 +437,7 @@ static struct PluginCodec_Definition g726CodecDefn[] =
     &licenseInfo,                         // license information
 
     PluginCodec_MediaTypeAudioStreamed |  // audio codec
+    PluginCodec_StreamedBulk |            // whole payload per call
     (3 << PluginCodec_BitsPerSamplePos) | // bits per sample
     PluginCodec_InputTypeRaw |            // raw input data
     PluginCodec_OutputTypeRaw |           // raw output data
@@ -417,6 +478,7 @@ static struct PluginCodec_Definition g726CodecDefn[] =
     &licenseInfo,                         // license information
 
     PluginCodec_MediaTypeAudioStreamed |  // audio codec
+    PluginCodec_StreamedBulk |            // whole payload per call
     (2 << PluginCodec_BitsPerSamplePos) | // bits per sample
     PluginCodec_InputTypeRaw |            // raw input data
     PluginCodec_OutputTypeRaw |           // raw output data
@@ -455,6 +517,7 @@ static struct PluginCodec_Definition g726CodecDefn[] =
     &licenseInfo,                         // license information
 
     PluginCodec_MediaTypeAudioStreamed |  // audio codec
+    PluginCodec_StreamedBulk |            // whole payload per call
     (2 << PluginCodec_BitsPerSamplePos) | // bits per sample
     PluginCodec_InputTypeRaw |            // raw input data
     PluginCodec_OutputTypeRaw |           // raw output data
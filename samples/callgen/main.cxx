@@ -26,6 +26,11 @@
 
 #include <ptclib/pvidfile.h>
 #include <opal/transcoders.h>
+#include <opal/patch.h>
+
+#ifndef _WIN32
+  #include <sys/resource.h>
+#endif
 
 
 #define PTraceModule() "CallGen"
@@ -89,6 +94,7 @@ PString MyManager::GetArgumentSpec() const
          "q-quiet.               Do not display call progress output.\n"
          "c-cdr:                 Specify Call Detail Record file [none]\n"
          "I-in-dir:              Specify directory for incoming media (.pcap) files [disabled]\n"
+         "-cpu-stats:            Output process CPU usage per active call every n seconds [disabled]\n"
        + spec;
 }
 
@@ -102,6 +108,12 @@ void MyManager::Usage(ostream & strm, const PArgList & args)
              "  the call running once established. If zero (the default) then --tmincall\n"
              "  is the length of the call from initiation. The call may or may not be\n"
              "  \"answered\" within that time.\n"
+             "\n"
+             "  To compare media thread models, run the same load, e.g. -m 500, 1000\n"
+             "  and 2000, with and without --media-reactor, and with --cpu-stats 10.\n"
+             "  Similarly with and without --patch-threads, which also adds the media\n"
+             "  patch wake up jitter histogram to the CPU statistics.\n"
+             "  The CPU statistics are written to stderr so --quiet may be used.\n"
              "\n";
 }
 
@@ -141,6 +153,11 @@ bool MyManager::Initialise(PArgList & args, bool, const PString &)
     }
   }
 
+  if (args.HasOption("cpu-stats")) {
+    m_cpuStatsTimer.SetNotifier(PCREATE_NOTIFIER(OnCPUStats), "CPU-Stats");
+    m_cpuStatsTimer.RunContinuous(PTimeInterval(0, args.GetOptionString("cpu-stats").AsUnsigned()));
+  }
+
   if (args.HasOption('l')) {
     cout << "Endpoint is listening for incoming calls, press ^C to exit.\n";
     return true;
@@ -358,10 +375,75 @@ void CallThread::Stop()
 
 MyManager::~MyManager()
 {
+  m_cpuStatsTimer.Stop();
   ShutDownEndpoints();
 }
 
 
+static PTimeInterval GetProcessCPU()
+{
+#ifdef _WIN32
+  FILETIME created, exited, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+    return 0;
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime;
+  k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime;
+  u.HighPart = user.dwHighDateTime;
+  return PTimeInterval((PInt64)((k.QuadPart + u.QuadPart)/10000));
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return PTimeInterval((PInt64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)*1000 +
+                               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)/1000);
+#endif
+}
+
+
+static PString GetThreadCount()
+{
+#ifdef P_LINUX
+  PTextFile status("/proc/self/status", PFile::ReadOnly);
+  PString line;
+  while (status.ReadLine(line)) {
+    if (line.NumCompare("Threads:") == PObject::EqualTo)
+      return line.Mid(8).Trim();
+  }
+#endif
+  return "N/A";
+}
+
+
+void MyManager::OnCPUStats(PTimer &, P_INT_PTR)
+{
+  PTimeInterval cpu = GetProcessCPU();
+  PTimeInterval tick = PTimer::Tick();
+  PTimeInterval usedCPU = cpu - m_lastCPUTime;
+  PTimeInterval elapsed = tick - m_lastCPUTick;
+  bool first = m_lastCPUTick == 0;
+  m_lastCPUTime = cpu;
+  m_lastCPUTick = tick;
+  if (first || elapsed == 0)
+    return;
+
+  PINDEX calls = GetActiveCalls();
+  double percent = usedCPU.GetMilliSeconds()*100.0/elapsed.GetMilliSeconds();
+
+  g_coutMutex.Wait();
+  cerr << "CPU: calls=" << calls
+       << " cpu=" << fixed << setprecision(1) << percent << '%'
+       << " per-call=" << setprecision(3) << (calls > 0 ? percent/calls : 0.0) << '%'
+       << " threads=" << GetThreadCount()
+       << " media-io=" << (GetMediaReactorThreads() > 0 ? PString(GetMediaReactorThreads()) : PString("per-channel"));
+  if (GetMediaPatchExecutor() != NULL)
+    cerr << " patch: " << *GetMediaPatchExecutor();
+  cerr << endl;
+  g_coutMutex.Signal();
+}
+
+
 OpalCall * MyManager:: CreateCall(void * userData)
 {
   return new MyCall(*this, (CallThread *)userData);
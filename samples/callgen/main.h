@@ -171,6 +171,11 @@ class MyManager : public OpalManagerConsole
     unsigned       m_totalCalls;
     unsigned       m_totalEstablished;
     CallThreadList m_threadList;
+
+    PTimer         m_cpuStatsTimer;
+    PTimeInterval  m_lastCPUTime;
+    PTimeInterval  m_lastCPUTick;
+    PDECLARE_NOTIFIER(PTimer, MyManager, OnCPUStats);
 };
 
 
@@ -57,6 +57,112 @@ CodecTest::~CodecTest()
 }
 
 
+static void OutputSampleRate(const char * name, PINDEX samples, const PTimeInterval & elapsed, unsigned clockRate)
+{
+  double rate = samples*1000.0/std::max(elapsed.GetMilliSeconds(), (PInt64)1);
+  cout << "  " << setw(10) << left << name << right << ' '
+       << setw(12) << (PUInt64)rate << " samples/s, "
+       << setprecision(3) << (100.0*clockRate/rate) << "% CPU per call leg  (" << elapsed << "s)" << endl;
+}
+
+
+static void BenchmarkOneWay(OpalTranscoder & transcoder,
+                            const RTP_DataFrame & input,
+                            PINDEX samples,
+                            unsigned iterations)
+{
+  cout << transcoder.GetInputFormat() << " -> " << transcoder.GetOutputFormat() << ":\n";
+
+  RTP_DataFrame output;
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned i = 0; i < iterations; ++i)
+    transcoder.Convert(input, output);
+  unsigned clockRate = transcoder.GetInputFormat().GetClockRate();
+  OutputSampleRate("Convert", samples*iterations, PTimer::Tick() - start, clockRate);
+
+  // The per sample virtual call path used before bulk conversion
+  OpalStreamedTranscoder * streamed = dynamic_cast<OpalStreamedTranscoder *>(&transcoder);
+  if (streamed == NULL)
+    return;
+
+  PINDEX inputBits = input.GetPayloadSize()*8/samples;
+  if (inputBits != 16 && inputBits > 8)
+    return;
+
+  std::vector<short> sink(samples);
+  const BYTE * inputBytes = input.GetPayloadPtr();
+  const short * inputWords = (const short *)inputBytes;
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < iterations; ++i) {
+    if (inputBits == 16) {
+      for (PINDEX s = 0; s < samples; ++s)
+        sink[s] = (short)streamed->ConvertOne(inputWords[s]);
+    }
+    else if (inputBits == 8) {
+      for (PINDEX s = 0; s < samples; ++s)
+        sink[s] = (short)streamed->ConvertOne(inputBytes[s]);
+    }
+    else {
+      // Packed least significant bit first, as OpalStreamedTranscoder does
+      PINDEX bit = 0;
+      for (PINDEX s = 0; s < samples; ++s) {
+        PINDEX byte = bit/8;
+        unsigned value = inputBytes[byte] >> (bit%8);
+        if (bit%8 + inputBits > 8)
+          value |= inputBytes[byte+1] << (8 - bit%8);
+        sink[s] = (short)streamed->ConvertOne(value & ((1 << inputBits) - 1));
+        bit += inputBits;
+      }
+    }
+  }
+  OutputSampleRate("ConvertOne", samples*iterations, PTimer::Tick() - start, clockRate);
+}
+
+
+static void BenchmarkTranscoding(const PString & formatName, unsigned iterations)
+{
+  OpalMediaFormat mediaFormat = formatName;
+  if (!mediaFormat.IsValid() || mediaFormat.GetMediaType() != OpalMediaType::Audio()) {
+    cout << "Cannot benchmark \"" << formatName << "\", not an audio format" << endl;
+    return;
+  }
+
+  if (iterations == 0)
+    iterations = 100000;
+
+  OpalMediaFormatList rawFormats = OpalTranscoder::GetDestinationFormats(mediaFormat);
+  if (rawFormats.IsEmpty()) {
+    cout << "Could not find raw format for " << mediaFormat << endl;
+    return;
+  }
+  OpalMediaFormat rawFormat = rawFormats[0];
+
+  std::auto_ptr<OpalTranscoder> encoder(OpalTranscoder::Create(rawFormat, mediaFormat));
+  std::auto_ptr<OpalTranscoder> decoder(OpalTranscoder::Create(mediaFormat, rawFormat));
+  if (encoder.get() == NULL || decoder.get() == NULL) {
+    cout << "Could not create transcoders for " << mediaFormat << endl;
+    return;
+  }
+
+  // 20ms of noise
+  PINDEX samples = mediaFormat.GetClockRate()/50;
+  RTP_DataFrame pcm(samples*sizeof(short));
+  short * pcmSamples = (short *)pcm.GetPayloadPtr();
+  PRandom rand;
+  for (PINDEX s = 0; s < samples; ++s)
+    pcmSamples[s] = (short)rand.Generate();
+
+  RTP_DataFrame encoded;
+  if (!encoder->Convert(pcm, encoded)) {
+    cout << "Could not encode to " << mediaFormat << endl;
+    return;
+  }
+
+  BenchmarkOneWay(*encoder, pcm, samples, iterations);
+  BenchmarkOneWay(*decoder, encoded, samples, iterations);
+}
+
+
 void CodecTest::Main()
 {
   PArgList & args = GetArguments();
@@ -93,6 +199,8 @@ void CodecTest::Main()
              "i-info. display per-frame info (use multiple times for more info)\n"
              "-pcap: save encoded packets in a PCAP file\n"
              "-list. list all available plugin codecs\n"
+             "-benchmark: benchmark audio transcoding of fmtname, N iterations of 20ms,\n"
+             "            comparing whole payload and per sample conversion\n"
              PTRACE_ARGLIST
              "h-help. print this help message.\n"
              , false);
@@ -145,6 +253,12 @@ void CodecTest::Main()
     return;
   }
 
+  if (args.HasOption("benchmark")) {
+    for (PINDEX i = 0; i < args.GetCount(); ++i)
+      BenchmarkTranscoding(args[i], args.GetOptionString("benchmark").AsUnsigned());
+    return;
+  }
+
   g_infoCount = args.GetOptionCount('i');
 
   unsigned threadCount = args.GetOptionString('S').AsInteger();
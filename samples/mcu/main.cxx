@@ -25,6 +25,7 @@
 
 #include "precompile.h"
 #include "main.h"
+#include <ptclib/random.h>
 
 
 extern const char Manufacturer[] = "Vox Gratia";
@@ -59,6 +60,7 @@ PString MyManager::GetArgumentSpec() const
          "V-no-video.  Disable video for ad-hoc conference.\n"
 #endif
          "-pass-thru.  Enable media pass through optimisation.\n"
+         "-top-speakers: Mix only the n loudest speakers, default is everyone.\n"
          + spec;
 }
 
@@ -93,6 +95,7 @@ bool MyManager::Initialise(PArgList & args, bool verbose)
   info.m_moderatorPIN = args.GetOptionString('m');
   info.m_listenOnly = !info.m_moderatorPIN.IsEmpty();
   info.m_mediaPassThru = args.HasOption("pass-thru");
+  info.m_topSpeakers = args.GetOptionString("top-speakers").AsUnsigned();
 
 #if OPAL_VIDEO
   info.m_audioOnly = args.HasOption('V');
@@ -119,16 +122,17 @@ bool MyManager::Initialise(PArgList & args, bool verbose)
   m_cli->SetCommand("conf add", PCREATE_NOTIFIER_EXT(m_mixer, MyMixerEndPoint, CmdConfAdd),
                     "Add a new conferance:",
 #if OPAL_VIDEO
-                    "[ -V ] [ -s size ] [ -m pin ] <name> [ <name> ... ]\n"
+                    "[ -V ] [ -s size ] [ -m pin ] [ -t n ] <name> [ <name> ... ]\n"
                     "  -V or --no-video       : Disable video\n"
                     "  -s or --size           : Set video size\n"
 #else
-                    "[ -m pin ] <name>\n"
+                    "[ -m pin ] [ -t n ] <name>\n"
 #endif
                     "\n"
                     "  -m or --moderator pin  : PIN to allow to become a moderator and have talk rights\n"
                     "                         : if absent, all participants are moderators.\n"
                     "        --no-pass-thru   : Disable media pass through optimisation.\n"
+                    "  -t or --top-speakers n : Mix only the n loudest speakers.\n"
                    );
   m_cli->SetCommand("conf list", PCREATE_NOTIFIER_EXT(m_mixer, MyMixerEndPoint, CmdConfList),
                     "List conferances");
@@ -156,6 +160,11 @@ bool MyManager::Initialise(PArgList & args, bool verbose)
                     "{ <conf-name> | <guid> } <member-name>\n"
                     "member remove <call-token>");
 
+  m_cli->SetCommand("bench mix", PCREATE_NOTIFIER(CmdBenchMix),
+                    "Benchmark audio mixing kernels:",
+                    "[ -i iterations ]\n"
+                    "  -i or --iterations n   : Number of mixing periods per test (default 1000)\n");
+
   return true;
 }
 
@@ -176,6 +185,63 @@ void MyManager::OnClearedCall(OpalCall & call)
 }
 
 
+void MyManager::CmdBenchMix(PCLI::Arguments & args, P_INT_PTR)
+{
+  args.Parse("i-iterations:");
+  unsigned iterations = args.GetOptionString('i', "1000").AsUnsigned();
+  if (iterations == 0) {
+    args.WriteUsage();
+    return;
+  }
+
+  static const unsigned SampleRates[] = { 8000, 16000, 48000 };
+  static const unsigned Participants[] = { 10, 25, 50, 100, 200 };
+
+  std::vector<const OpalAudioMixer::MixKernels *> kernels;
+  for (int type = 0; type < OpalAudioMixer::NumMixKernelTypes; ++type) {
+    const OpalAudioMixer::MixKernels * k = OpalAudioMixer::GetMixKernels((OpalAudioMixer::MixKernelTypes)type);
+    if (k != NULL)
+      kernels.push_back(k);
+  }
+
+  ostream & out = args.GetContext();
+  out << "Microseconds per 10ms period, mixing all participants then minus-self for each,\n"
+         "Scalar is the same per sample loop as used before the vector kernels.\n"
+      << setw(6) << "Rate" << setw(8) << "Count";
+  for (size_t k = 0; k < kernels.size(); ++k)
+    out << setw(10) << kernels[k]->m_name;
+  out << endl;
+
+  for (PINDEX r = 0; r < PARRAYSIZE(SampleRates); ++r) {
+    unsigned samples = SampleRates[r]/100;
+    for (PINDEX p = 0; p < PARRAYSIZE(Participants); ++p) {
+      unsigned count = Participants[p];
+
+      std::vector<short> input(count*samples);
+      for (size_t i = 0; i < input.size(); ++i)
+        input[i] = (short)(PRandom::Number() >> 4); // Keep loud enough to sometimes clip
+      std::vector<int> mixed(samples);
+      std::vector<short> output(samples);
+
+      out << setw(6) << SampleRates[r] << setw(8) << count;
+      for (size_t k = 0; k < kernels.size(); ++k) {
+        PTimeInterval start = PTimer::Tick();
+        for (unsigned i = 0; i < iterations; ++i) {
+          std::fill(mixed.begin(), mixed.end(), 0);
+          for (unsigned c = 0; c < count; ++c)
+            kernels[k]->m_accumulate(&mixed[0], &input[c*samples], samples);
+          for (unsigned c = 0; c < count; ++c)
+            kernels[k]->m_subtractAndClip(&output[0], &mixed[0], &input[c*samples], samples);
+        }
+        PTimeInterval elapsed = PTimer::Tick() - start;
+        out << setw(10) << fixed << setprecision(1) << (elapsed.GetMilliSeconds()*1000.0/iterations);
+      }
+      out << endl;
+    }
+  }
+}
+
+
 ///////////////////////////////////////////////////////////////
 
 MyMixerEndPoint::MyMixerEndPoint(MyManager & manager)
@@ -207,7 +273,7 @@ OpalMixerNode * MyMixerEndPoint::CreateNode(OpalMixerNodeInfo * info)
 
 void MyMixerEndPoint::CmdConfAdd(PCLI::Arguments & args, P_INT_PTR)
 {
-  args.Parse("s-size:V-no-video.-m-moderator:");
+  args.Parse("s-size:V-no-video.-m-moderator:t-top-speakers:");
   if (args.GetCount() == 0) {
     args.WriteUsage();
     return;
@@ -229,6 +295,7 @@ void MyMixerEndPoint::CmdConfAdd(PCLI::Arguments & args, P_INT_PTR)
 #endif
   info->m_moderatorPIN = args.GetOptionString('m');
   info->m_mediaPassThru = args.HasOption("pass-thru");
+  info->m_topSpeakers = args.GetOptionString('t').AsUnsigned();
 
   PSafePtr<OpalMixerNode> node = AddNode(info);
 
@@ -248,7 +315,7 @@ void MyMixerEndPoint::CmdConfList(PCLI::Arguments & args, P_INT_PTR)
 {
   ostream & out = args.GetContext();
   for (PSafePtr<OpalMixerNode> node = GetFirstNode(PSafeReadOnly); node != NULL; ++node)
-    out << *node << '\n';
+    out << *node << " missed=" << node->GetDeadlinesMissed() << '\n';
   out.flush();
 }
 
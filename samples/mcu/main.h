@@ -137,6 +137,8 @@ class MyManager : public OpalManagerCLI
     virtual void OnEstablishedCall(OpalCall & call);
     virtual void OnClearedCall(OpalCall & call);
 
+    PDECLARE_NOTIFIER(PCLI::Arguments, MyManager, CmdBenchMix);
+
     void Broadcast(const PString & str) { m_cli->Broadcast(str); }
 #endif
 
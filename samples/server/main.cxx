@@ -118,6 +118,7 @@ static const PConstString SignLanguageAnalyserDLLKey("Sign Language Analyser DLL
 #if OPAL_HAS_MIXER
 static const PConstString ConfAudioOnlyKey("Conference Audio Only");
 static const PConstString ConfMediaPassThruKey("Conference Media Pass Through");
+static const PConstString ConfTopSpeakersKey("Conference Top Speakers");
 static const PConstString ConfVideoResolutionKey("Conference Video Resolution");
 
 static const PConstString RecordAllCallsKey("Record All Calls");
@@ -815,6 +816,7 @@ PBoolean MyManager::Configure(PConfig & cfg, PConfigPage * rsrc)
     if (mcuEP->GetAdHocNodeInfo() != NULL)
       adHoc = *mcuEP->GetAdHocNodeInfo();
     adHoc.m_mediaPassThru = rsrc->AddBooleanField(ConfMediaPassThruKey, adHoc.m_mediaPassThru, "Conference media pass though optimisation");
+    adHoc.m_topSpeakers = rsrc->AddIntegerField(ConfTopSpeakersKey, 0, 100, adHoc.m_topSpeakers, "", "Mix only this many of the loudest speakers, zero is everyone");
 
 #if OPAL_VIDEO
     adHoc.m_audioOnly = rsrc->AddBooleanField(ConfAudioOnlyKey, adHoc.m_audioOnly, "Conference is audio only");
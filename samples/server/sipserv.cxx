@@ -159,30 +159,32 @@ PString MySIPEndPoint::OnLoadEndPointStatus(const PString & htmlBlock)
 {
   PString substitution;
 
-  for (PSafePtr<RegistrarAoR> ua(m_registeredUAs); ua != NULL; ++ua) {
-    // make a copy of the repeating html chunk
-    PString insert = htmlBlock;
-
-    PServiceHTML::SpliceMacro(insert, "status EndPointIdentifier", ua->GetAoR());
-
-    SIPURLList contacts = ua->GetContacts();
-    PStringStream addresses;
-    for (SIPURLList::iterator it = contacts.begin(); it != contacts.end(); ++it) {
-      if (it != contacts.begin())
-        addresses << "<br>";
-      addresses << *it;
-    }
-    PServiceHTML::SpliceMacro(insert, "status CallSignalAddresses", addresses);
+  for (unsigned shard = 0; shard < m_registeredUAs.GetShardCount(); ++shard) {
+    for (PSafePtr<RegistrarAoR> ua(m_registeredUAs.GetShardAt(shard)); ua != NULL; ++ua) {
+      // make a copy of the repeating html chunk
+      PString insert = htmlBlock;
+
+      PServiceHTML::SpliceMacro(insert, "status EndPointIdentifier", ua->GetAoR());
+
+      SIPURLList contacts = ua->GetContacts();
+      PStringStream addresses;
+      for (SIPURLList::iterator it = contacts.begin(); it != contacts.end(); ++it) {
+        if (it != contacts.begin())
+          addresses << "<br>";
+        addresses << *it;
+      }
+      PServiceHTML::SpliceMacro(insert, "status CallSignalAddresses", addresses);
 
-    PString str = "<i>Name:</i> " + ua->GetProductInfo().AsString();
-    str.Replace("\t", "<BR><i>Version:</i> ");
-    str.Replace("\t", " <i>Vendor:</i> ");
-    PServiceHTML::SpliceMacro(insert, "status Application", str);
+      PString str = "<i>Name:</i> " + ua->GetProductInfo().AsString();
+      str.Replace("\t", "<BR><i>Version:</i> ");
+      str.Replace("\t", " <i>Vendor:</i> ");
+      PServiceHTML::SpliceMacro(insert, "status Application", str);
 
-    PServiceHTML::SpliceMacro(insert, "status ActiveCalls", "N/A");
+      PServiceHTML::SpliceMacro(insert, "status ActiveCalls", "N/A");
 
-    // Then put it into the page, moving insertion point along after it.
-    substitution += insert;
+      // Then put it into the page, moving insertion point along after it.
+      substitution += insert;
+    }
   }
 
   return substitution;
@@ -0,0 +1,447 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for H.225/H.245 PDU decode benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <h323/h323pdu.h>
+#include <opal/guid.h>
+
+#if !OPAL_H323
+  #error Cannot compile without H.323 support
+#endif
+
+
+/* Decodes a corpus of PER encoded PDUs, as H323SignalPDU::Read() and
+   H323Connection::HandleControlData() do, and reports the decode rate, and
+   the number of heap allocations and bytes each decode does.
+
+   The corpus is a text file, one PDU per line, of the form:
+       <type> <name> <hex>
+   where type is "h225" for a H.225 User-User IE or "h245" for a H.245
+   MultimediaSystemControlMessage. The hex can be taken from the "Raw PDU"
+   of a level 6 trace. Without a corpus, a typical fast start Setup, a large
+   TerminalCapabilitySet and a small request are used, and the -w option
+   saves these as a starting point for a corpus. */
+
+#if !PMEMORY_CHECK
+// Approximate, as does not exclude other threads, but they are idle
+static unsigned g_allocations;
+static size_t   g_allocatedBytes;
+
+void * operator new(size_t size)
+{
+  ++g_allocations;
+  g_allocatedBytes += size;
+  void * ptr = malloc(size);
+  if (ptr == NULL)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void * ptr) throw()
+{
+  free(ptr);
+}
+
+#define COUNTING_ALLOCATIONS 1
+#else
+static const unsigned g_allocations = 0;
+static const size_t   g_allocatedBytes = 0;
+#define COUNTING_ALLOCATIONS 0
+#endif
+
+
+struct CorpusEntry
+{
+  CorpusEntry(const PString & type, const PString & name, const PBYTEArray & data)
+    : m_type(type)
+    , m_name(name)
+    , m_data(data)
+  { }
+
+  PCaselessString m_type;
+  PString         m_name;
+  PBYTEArray      m_data;
+};
+
+typedef std::vector<CorpusEntry> Corpus;
+
+
+static PString ToHex(const PBYTEArray & data)
+{
+  PStringStream strm;
+  strm << hex << setfill('0');
+  for (PINDEX i = 0; i < data.GetSize(); ++i)
+    strm << setw(2) << (unsigned)data[i];
+  return strm;
+}
+
+
+static PBYTEArray FromHex(const PString & str)
+{
+  PBYTEArray data(str.GetLength()/2);
+  for (PINDEX i = 0; i < data.GetSize(); ++i)
+    data[i] = (BYTE)str.Mid(i*2, 2).AsUnsigned(16);
+  return data;
+}
+
+
+static PBYTEArray Encode(const PASN_Object & pdu)
+{
+  PPER_Stream strm;
+  pdu.Encode(strm);
+  strm.CompleteEncoding();
+  return strm;
+}
+
+
+static PBYTEArray BuildSetup(unsigned fastStartCount, unsigned tokenCount)
+{
+  H225_H323_UserInformation uuie;
+  uuie.m_h323_uu_pdu.m_h323_message_body.SetTag(H225_H323_UU_PDU_h323_message_body::e_setup);
+  uuie.m_h323_uu_pdu.m_h245Tunneling = true;
+
+  H225_Setup_UUIE & setup = uuie.m_h323_uu_pdu.m_h323_message_body;
+  setup.m_protocolIdentifier.SetValue("0.0.8.2250.0." + PString(H225_PROTOCOL_VERSION));
+
+  PStringArray aliases;
+  aliases.AppendString("alice");
+  aliases.AppendString("2001");
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_sourceAddress);
+  H323SetAliasAddresses(aliases, setup.m_sourceAddress);
+
+  setup.m_sourceInfo.IncludeOptionalField(H225_EndpointType::e_terminal);
+  setup.m_sourceInfo.m_mc = false;
+  setup.m_sourceInfo.m_undefinedNode = false;
+
+  aliases[0] = "bob";
+  aliases[1] = "2002";
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_destinationAddress);
+  H323SetAliasAddresses(aliases, setup.m_destinationAddress);
+
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_destCallSignalAddress);
+  H323TransportAddress("ip$10.0.0.2:1720").SetPDU(setup.m_destCallSignalAddress);
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_sourceCallSignalAddress);
+  H323TransportAddress("ip$10.0.0.1:1720").SetPDU(setup.m_sourceCallSignalAddress);
+
+  setup.m_conferenceID.SetValue(OpalGloballyUniqueID());
+  setup.m_conferenceGoal.SetTag(H225_Setup_UUIE_conferenceGoal::e_create);
+  setup.m_callType.SetTag(H225_CallType::e_pointToPoint);
+  setup.IncludeOptionalField(H225_Setup_UUIE::e_callIdentifier);
+  setup.m_callIdentifier.m_guid.SetValue(OpalGloballyUniqueID());
+
+  if (tokenCount > 0) {
+    setup.IncludeOptionalField(H225_Setup_UUIE::e_tokens);
+    setup.m_tokens.SetSize(tokenCount);
+    for (unsigned i = 0; i < tokenCount; ++i) {
+      H235_ClearToken & token = setup.m_tokens[i];
+      token.m_tokenOID.SetValue("0.0.8.235.0.3.43");
+      token.IncludeOptionalField(H235_ClearToken::e_timeStamp);
+      token.m_timeStamp = (unsigned)time(NULL);
+      token.IncludeOptionalField(H235_ClearToken::e_random);
+      token.m_random = i+1;
+      token.IncludeOptionalField(H235_ClearToken::e_generalID);
+      token.m_generalID = "gatekeeper";
+    }
+  }
+
+  static const H245_AudioCapability::Choices AudioCodecs[] = {
+    H245_AudioCapability::e_g711Ulaw64k,
+    H245_AudioCapability::e_g711Alaw64k,
+    H245_AudioCapability::e_g729AnnexA
+  };
+
+  if (fastStartCount > 0) {
+    setup.IncludeOptionalField(H225_Setup_UUIE::e_fastStart);
+    setup.m_fastStart.SetSize(fastStartCount);
+    for (unsigned i = 0; i < fastStartCount; ++i) {
+      H245_OpenLogicalChannel open;
+      open.m_forwardLogicalChannelNumber = 101 + i;
+
+      H245_OpenLogicalChannel_forwardLogicalChannelParameters & fwd = open.m_forwardLogicalChannelParameters;
+      fwd.m_dataType.SetTag(H245_DataType::e_audioData);
+      H245_AudioCapability & audio = fwd.m_dataType;
+      audio.SetTag(AudioCodecs[i % PARRAYSIZE(AudioCodecs)]);
+      (PASN_Integer &)audio = 20;
+
+      fwd.m_multiplexParameters.SetTag(H245_OpenLogicalChannel_forwardLogicalChannelParameters_multiplexParameters::e_h2250LogicalChannelParameters);
+      H245_H2250LogicalChannelParameters & param = fwd.m_multiplexParameters;
+      param.m_sessionID = 1;
+      param.IncludeOptionalField(H245_H2250LogicalChannelParameters::e_mediaControlChannel);
+      H323TransportAddress("ip$10.0.0.1:5001").SetPDU(param.m_mediaControlChannel);
+
+      setup.m_fastStart[i].EncodeSubType(open);
+    }
+  }
+
+  return Encode(uuie);
+}
+
+
+static PBYTEArray BuildTerminalCapabilitySet(unsigned audioCount, unsigned videoCount)
+{
+  static const H245_AudioCapability::Choices AudioCodecs[] = {
+    H245_AudioCapability::e_g711Ulaw64k,
+    H245_AudioCapability::e_g711Alaw64k,
+    H245_AudioCapability::e_g722_64k,
+    H245_AudioCapability::e_g728,
+    H245_AudioCapability::e_g729,
+    H245_AudioCapability::e_g729AnnexA
+  };
+
+  H323ControlPDU pdu;
+  H245_TerminalCapabilitySet & tcs = pdu.Build(H245_RequestMessage::e_terminalCapabilitySet);
+  tcs.m_sequenceNumber = 1;
+  tcs.m_protocolIdentifier.SetValue("0.0.8.245.0." + PString(H245_PROTOCOL_VERSION));
+
+  tcs.IncludeOptionalField(H245_TerminalCapabilitySet::e_capabilityTable);
+  tcs.m_capabilityTable.SetSize(audioCount + videoCount);
+
+  for (unsigned i = 0; i < audioCount; ++i) {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[i];
+    entry.m_capabilityTableEntryNumber = i+1;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveAudioCapability);
+    H245_AudioCapability & audio = entry.m_capability;
+    audio.SetTag(AudioCodecs[i % PARRAYSIZE(AudioCodecs)]);
+    (PASN_Integer &)audio = 20 + i;
+  }
+
+  for (unsigned i = 0; i < videoCount; ++i) {
+    H245_CapabilityTableEntry & entry = tcs.m_capabilityTable[audioCount + i];
+    entry.m_capabilityTableEntryNumber = audioCount + i + 1;
+    entry.IncludeOptionalField(H245_CapabilityTableEntry::e_capability);
+    entry.m_capability.SetTag(H245_Capability::e_receiveVideoCapability);
+    H245_VideoCapability & video = entry.m_capability;
+    video.SetTag(H245_VideoCapability::e_genericVideoCapability);
+
+    // Something like H.264 (H.241)
+    H245_GenericCapability & generic = video;
+    H323SetCapabilityIdentifier("0.0.8.241.0.0.1", generic.m_capabilityIdentifier);
+    generic.IncludeOptionalField(H245_GenericCapability::e_maxBitRate);
+    generic.m_maxBitRate = 19200;
+    generic.IncludeOptionalField(H245_GenericCapability::e_collapsing);
+    H323AddGenericParameterInteger(generic.m_collapsing, 41, 64, H245_ParameterValue::e_booleanArray);
+    H323AddGenericParameterInteger(generic.m_collapsing, 42, 29 + i, H245_ParameterValue::e_unsignedMin);
+    H323AddGenericParameterInteger(generic.m_collapsing, 3, 1200, H245_ParameterValue::e_unsignedMin);
+    H323AddGenericParameterInteger(generic.m_collapsing, 4, 8192, H245_ParameterValue::e_unsignedMin);
+  }
+
+  tcs.IncludeOptionalField(H245_TerminalCapabilitySet::e_capabilityDescriptors);
+  tcs.m_capabilityDescriptors.SetSize(1);
+  H245_CapabilityDescriptor & descriptor = tcs.m_capabilityDescriptors[0];
+  descriptor.m_capabilityDescriptorNumber = 0;
+  descriptor.IncludeOptionalField(H245_CapabilityDescriptor::e_simultaneousCapabilities);
+  descriptor.m_simultaneousCapabilities.SetSize(videoCount > 0 ? 2 : 1);
+
+  H245_AlternativeCapabilitySet & audioAlternatives = descriptor.m_simultaneousCapabilities[0];
+  audioAlternatives.SetSize(audioCount);
+  for (unsigned i = 0; i < audioCount; ++i)
+    audioAlternatives[i] = i+1;
+
+  if (videoCount > 0) {
+    H245_AlternativeCapabilitySet & videoAlternatives = descriptor.m_simultaneousCapabilities[1];
+    videoAlternatives.SetSize(videoCount);
+    for (unsigned i = 0; i < videoCount; ++i)
+      videoAlternatives[i] = audioCount + i + 1;
+  }
+
+  return Encode(pdu);
+}
+
+
+static PBYTEArray BuildRoundTripDelayRequest()
+{
+  H323ControlPDU pdu;
+  pdu.BuildRoundTripDelayRequest(1);
+  return Encode(pdu);
+}
+
+
+static bool Decode(const CorpusEntry & entry)
+{
+  PPER_Stream strm(entry.m_data);
+  if (entry.m_type == "h225") {
+    H225_H323_UserInformation pdu;
+    return pdu.Decode(strm);
+  }
+
+  H245_MultimediaSystemControlMessage pdu;
+  return pdu.Decode(strm);
+}
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+
+    bool LoadCorpus(const PFilePath & filename, Corpus & corpus);
+    bool SaveCorpus(const PFilePath & filename, const Corpus & corpus);
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "ASN Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "c-corpus: Corpus file of PDUs to decode, default is built in PDUs\n"
+             "w-write: Write the built in PDUs to a corpus file\n"
+             "n-decodes: Maximum number of decodes of each PDU, default 100000\n"
+             "s-seconds: Maximum time for decodes of each PDU, default 5\n"
+             "f-fast-start: Number of fast start elements in built in Setup, default 6\n"
+             "a-audio: Number of audio capabilities in built in TCS, default 12\n"
+             "v-video: Number of video capabilities in built in TCS, default 4\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned decodes = args.GetOptionAs('n', 100000U);
+  unsigned seconds = args.GetOptionAs('s', 5U);
+
+  Corpus corpus;
+  if (args.HasOption('c')) {
+    if (!LoadCorpus(args.GetOptionString('c'), corpus))
+      return;
+  }
+  else {
+    corpus.push_back(CorpusEntry("h225", "Setup", BuildSetup(args.GetOptionAs('f', 6U), 2)));
+    corpus.push_back(CorpusEntry("h245", "TerminalCapabilitySet", BuildTerminalCapabilitySet(args.GetOptionAs('a', 12U),
+                                                                                             args.GetOptionAs('v', 4U))));
+    corpus.push_back(CorpusEntry("h245", "RoundTripDelayRequest", BuildRoundTripDelayRequest()));
+  }
+
+  if (args.HasOption('w')) {
+    SaveCorpus(args.GetOptionString('w'), corpus);
+    return;
+  }
+
+  if (!COUNTING_ALLOCATIONS)
+    cout << "Allocations not counted in memory check build\n";
+
+  cout << "Type PDU                       Bytes   Decodes/s  us/decode  Allocs  Alloc bytes\n";
+
+  for (Corpus::iterator it = corpus.begin(); it != corpus.end(); ++it) {
+    if (!Decode(*it)) {
+      cerr << "Could not decode " << it->m_type << ' ' << it->m_name << endl;
+      continue;
+    }
+
+    // Count one decode on its own
+    unsigned allocations = g_allocations;
+    size_t allocatedBytes = g_allocatedBytes;
+    Decode(*it);
+    allocations = g_allocations - allocations;
+    allocatedBytes = g_allocatedBytes - allocatedBytes;
+
+    unsigned count = 0;
+    PSimpleTimer timer(0, seconds);
+    while (count < decodes && !timer.HasExpired()) {
+      Decode(*it);
+      ++count;
+    }
+    PTimeInterval elapsed = timer.GetElapsed();
+
+    cout << setw(4) << left << it->m_type << ' '
+         << setw(24) << it->m_name.Left(24) << right << ' '
+         << setw(6) << it->m_data.GetSize() << ' '
+         << fixed << setprecision(0)
+         << setw(11) << count*1000.0/std::max(elapsed.GetMilliSeconds(), (PInt64)1) << ' '
+         << setw(10) << setprecision(2) << elapsed.GetMicroSeconds()/(double)std::max(count, 1U) << ' '
+         << setw(7) << allocations << ' '
+         << setw(12) << allocatedBytes
+         << endl;
+  }
+}
+
+
+bool Test::LoadCorpus(const PFilePath & filename, Corpus & corpus)
+{
+  PTextFile file;
+  if (!file.Open(filename, PFile::ReadOnly)) {
+    cerr << "Could not open corpus file " << filename << endl;
+    return false;
+  }
+
+  PString line;
+  while (file.ReadLine(line)) {
+    line = line.Trim();
+    if (line.IsEmpty() || line[0] == '#')
+      continue;
+
+    PStringArray fields = line.Tokenise(" \t", false);
+    if (fields.GetSize() != 3 || !((fields[0] *= "h225") || (fields[0] *= "h245"))) {
+      cerr << "Invalid corpus line: " << line << endl;
+      continue;
+    }
+
+    corpus.push_back(CorpusEntry(fields[0], fields[1], FromHex(fields[2])));
+  }
+
+  if (corpus.empty()) {
+    cerr << "No PDUs in corpus file " << filename << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+bool Test::SaveCorpus(const PFilePath & filename, const Corpus & corpus)
+{
+  PTextFile file;
+  if (!file.Open(filename, PFile::WriteOnly)) {
+    cerr << "Could not create corpus file " << filename << endl;
+    return false;
+  }
+
+  file << "# <type> <name> <hex>, type is h225 (User-User IE) or h245\n";
+  for (Corpus::const_iterator it = corpus.begin(); it != corpus.end(); ++it)
+    file << it->m_type << ' ' << it->m_name << ' ' << ToHex(it->m_data) << '\n';
+
+  cout << "Written " << corpus.size() << " PDUs to " << filename << endl;
+  return true;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,193 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for gatekeeper registration and admission benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <opal/manager.h>
+#include <h323/h323ep.h>
+#include <h323/gkserver.h>
+
+#if !OPAL_H323
+  #error Cannot compile without H.323 support
+#endif
+
+
+/* Registers endpoints directly with an in-process gatekeeper server, as a
+   RRQ does once it has been validated, then does the endpoint lookups an ARQ
+   or LRQ does: by alias, by voice prefix (longest match of dialled digits)
+   and by call signalling address. Finally unregisters them, as URQ does. */
+
+class BenchEndPoint : public H323RegisteredEndPoint
+{
+    PCLASSINFO(BenchEndPoint, H323RegisteredEndPoint);
+  public:
+    BenchEndPoint(H323GatekeeperServer & server, const PString & id, unsigned index, bool gateway)
+      : H323RegisteredEndPoint(server, id)
+    {
+      m_signalAddresses.AppendAddress(H323TransportAddress(PIPSocket::Address(10, (BYTE)(index>>16), (BYTE)(index>>8), (BYTE)index), 1720));
+      m_aliases.AppendString(PSTRSTRM("user" << index));
+      m_aliases.AppendString(PString(PString::Unsigned, 20000000 + index));
+      if (gateway)
+        m_voicePrefixes.AppendString(PString(PString::Unsigned, 100 + index));
+    }
+};
+
+
+class Worker : public PThread
+{
+    PCLASSINFO(Worker, PThread);
+  public:
+    Worker(H323GatekeeperServer & server, unsigned registrations, unsigned gateways, unsigned lookups)
+      : PThread(10000, NoAutoDeleteThread, NormalPriority, "Worker")
+      , m_server(server)
+      , m_registrations(registrations)
+      , m_gateways(gateways)
+      , m_lookups(lookups)
+      , m_failed(0)
+    { }
+
+    virtual void Main()
+    {
+      PRandom random;
+      for (unsigned i = 0; i < m_lookups; ++i) {
+        unsigned index = random.Generate() % m_registrations;
+        PSafePtr<H323RegisteredEndPoint> ep;
+        switch (i % 3) {
+          case 0 :
+            ep = m_server.FindEndPointByAliasString(PSTRSTRM("user" << index), PSafeReadOnly);
+            break;
+          case 1 :
+            // Dialled number through a gateway, or not found at all
+            ep = m_server.FindEndPointByAliasString(PSTRSTRM((100 + random.Generate() % std::max(m_gateways, 1U)) << "5551234"), PSafeReadOnly);
+            if (m_gateways == 0)
+              continue;
+            break;
+          default :
+            ep = m_server.FindEndPointBySignalAddress(H323TransportAddress(PIPSocket::Address(10, (BYTE)(index>>16), (BYTE)(index>>8), (BYTE)index), 1720), PSafeReadOnly);
+        }
+        if (ep == NULL)
+          ++m_failed;
+      }
+    }
+
+    H323GatekeeperServer & m_server;
+    unsigned m_registrations;
+    unsigned m_gateways;
+    unsigned m_lookups;
+    unsigned m_failed;
+};
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "Gatekeeper Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+{
+}
+
+
+static double Rate(unsigned count, const PTimeInterval & elapsed)
+{
+  return count*1000.0/std::max(elapsed.GetMilliSeconds(), (PInt64)1);
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "r-registrations: Number of registered endpoints, default 50000\n"
+             "g-gateways: Number of those that are gateways with a voice prefix, default 1000\n"
+             "n-lookups: Number of admission lookups per thread, default 300000\n"
+             "t-threads: Number of threads doing lookups, default 4\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned registrations = std::max(args.GetOptionAs('r', 50000U), 1U);
+  unsigned gateways = std::min(args.GetOptionAs('g', 1000U), registrations);
+  unsigned lookups = args.GetOptionAs('n', 300000U);
+  unsigned threads = std::max(args.GetOptionAs('t', 4U), 1U);
+
+  OpalManager manager;
+  H323EndPoint * h323 = new H323EndPoint(manager);
+  H323GatekeeperServer server(*h323);
+
+  cout << "Registering " << registrations << " endpoints, " << gateways << " gateways" << endl;
+
+  PTime startRRQ;
+  PList<H323RegisteredEndPoint> endpoints;
+  endpoints.DisallowDeleteObjects();
+  for (unsigned i = 0; i < registrations; ++i) {
+    H323RegisteredEndPoint * ep = new BenchEndPoint(server, server.CreateEndPointIdentifier(), i, i < gateways);
+    endpoints.Append(ep);
+    server.AddEndPoint(ep);
+  }
+  PTimeInterval elapsedRRQ = PTime() - startRRQ;
+  cout << "RRQ: " << fixed << setprecision(0) << Rate(registrations, elapsedRRQ) << "/s" << endl;
+
+  PList<Worker> workers;
+  for (unsigned i = 0; i < threads; ++i)
+    workers.Append(new Worker(server, registrations, gateways, lookups));
+
+  PTime startARQ;
+  for (PList<Worker>::iterator it = workers.begin(); it != workers.end(); ++it)
+    it->Resume();
+  unsigned failed = 0;
+  for (PList<Worker>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    it->WaitForTermination();
+    failed += it->m_failed;
+  }
+  PTimeInterval elapsedARQ = PTime() - startARQ;
+  cout << "ARQ: " << Rate(lookups*threads, elapsedARQ) << "/s on " << threads << " threads, "
+       << failed << " not found" << endl;
+
+  PTime startURQ;
+  for (PList<H323RegisteredEndPoint>::iterator it = endpoints.begin(); it != endpoints.end(); ++it)
+    server.RemoveEndPoint(&*it);
+  PTimeInterval elapsedURQ = PTime() - startURQ;
+  cout << "URQ: " << Rate(registrations, elapsedURQ) << "/s" << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,277 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for IVR prompt playback benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <ep/ivr.h>
+#include <opal/transcoders.h>
+#include <codec/opalwavfile.h>
+
+#include <math.h>
+
+#if !OPAL_IVR
+  #error Cannot compile without IVR support
+#endif
+
+
+/* Plays the same prompt to many concurrent IVR calls, one packet per stream
+   every packet time, as the media patches would, and times the work done.
+   Transcoding is what happens without the prompt cache: every call reads the
+   WAV file and encodes it with its own transcoder. Cached is the prompt cache
+   with the codec used natively by the IVR: every call copies pre-encoded
+   packets from the one shared buffer. The run is as fast as possible, CPU is
+   the percentage of one core needed to play the streams in real time. */
+
+struct TranscodingStream
+{
+  OpalWAVFile      * m_file;
+  OpalTranscoder   * m_encoder;
+};
+
+
+struct CachedStream
+{
+  PBYTEArray m_data;
+  PINDEX     m_offset;
+};
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+
+  protected:
+    PINDEX PacketSize() const;
+    bool MakePrompt(const PFilePath & filename, unsigned sampleRate, unsigned seconds);
+    PTimeInterval Transcoding(unsigned streams, unsigned packets);
+    PTimeInterval Cached(unsigned streams, unsigned packets);
+
+    PFilePath       m_prompt;
+    OpalMediaFormat m_mediaFormat;
+    unsigned        m_packetTime;
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "IVR Prompt Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+  , m_packetTime(20)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "w-wav: Prompt WAV file, 16 bit mono, default is generated\n"
+             "f-format: Media format of calls, default G.711-uLaw-64k\n"
+             "s-streams: Comma separated list of concurrent stream counts, default 100,1000\n"
+             "d-duration: Seconds of audio played to each stream, default 10\n"
+             "p-packet: Packet time in milliseconds, default 20\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_mediaFormat = args.GetOptionString('f', OpalG711_ULAW_64K);
+  if (!m_mediaFormat.IsValid() || m_mediaFormat.GetMediaType() != OpalMediaType::Audio()) {
+    cerr << "Invalid audio media format" << endl;
+    return;
+  }
+
+  m_packetTime = std::max(args.GetOptionAs('p', m_packetTime), 1U);
+  unsigned duration = std::max(args.GetOptionAs('d', 10U), 1U);
+  unsigned packets = duration*1000/m_packetTime;
+  PStringArray streamCounts = args.GetOptionString('s', "100,1000").Tokenise(",");
+
+  if (args.HasOption('w'))
+    m_prompt = args.GetOptionString('w');
+  else {
+    m_prompt = PDirectory::GetTemporary() + "ivrbench.wav";
+    if (!MakePrompt(m_prompt, m_mediaFormat.GetClockRate(), 5))
+      return;
+  }
+
+  OpalIVRPromptCache & cache = OpalIVRPromptCache::GetInstance();
+  PBYTEArray data;
+  if (!cache.GetPrompt(m_prompt, m_mediaFormat.GetName(), m_mediaFormat.GetClockRate(), data)) {
+    cerr << "Cannot cache " << m_prompt << " as " << m_mediaFormat << endl;
+    return;
+  }
+
+  if (data.GetSize() < PacketSize()) {
+    cerr << "Prompt " << m_prompt << " shorter than a packet" << endl;
+    return;
+  }
+
+  cout << "Playing " << m_prompt << " as " << m_mediaFormat << ", "
+       << duration << " seconds, " << m_packetTime << "ms packets, cached " << cache.GetSize() << " bytes\n"
+          "\n"
+          " Streams  Mode          CPU %   ns/packet\n";
+
+  for (PINDEX i = 0; i < streamCounts.GetSize(); ++i) {
+    unsigned streams = std::max(streamCounts[i].AsUnsigned(), 1U);
+
+    for (int mode = 0; mode < 2; ++mode) {
+      PTimeInterval elapsed = mode == 0 ? Transcoding(streams, packets) : Cached(streams, packets);
+      if (elapsed == 0)
+        return;
+
+      cout << setw(8) << streams << "  "
+           << setw(11) << left << (mode == 0 ? "Transcoding" : "Cached") << right << ' '
+           << fixed << setprecision(1)
+           << setw(7) << elapsed.GetMilliSeconds()*100.0/(duration*1000) << ' '
+           << setprecision(0)
+           << setw(11) << elapsed.GetMicroSeconds()*1000.0/((double)streams*packets)
+           << endl;
+    }
+  }
+
+  cout << "\nCache hits " << cache.GetHits() << ", misses " << cache.GetMisses() << endl;
+
+  if (!args.HasOption('w'))
+    PFile::Remove(m_prompt);
+}
+
+
+bool Test::MakePrompt(const PFilePath & filename, unsigned sampleRate, unsigned seconds)
+{
+  OpalWAVFile file(filename, PFile::WriteOnly);
+  if (!file.IsOpen() || !file.SetSampleRate(sampleRate)) {
+    cerr << "Could not create \"" << filename << '"' << endl;
+    return false;
+  }
+
+  // Something speech like, so codecs do real work
+  static const double Pi = 3.14159265358979;
+  PRandom random(1);
+  std::vector<short> samples(sampleRate*seconds);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    double t = (double)i/sampleRate;
+    double envelope = 0.5 + 0.5*sin(2*Pi*3*t);
+    samples[i] = (short)(envelope*(6000*sin(2*Pi*220*t) + 3000*sin(2*Pi*660*t))
+                         + (int)(random.Generate()%1000) - 500);
+  }
+
+  return file.Write(&samples[0], samples.size()*sizeof(short)) && file.Close();
+}
+
+
+PTimeInterval Test::Transcoding(unsigned streams, unsigned packets)
+{
+  PINDEX pcmSize = m_mediaFormat.GetClockRate()*m_packetTime/1000*2;
+
+  std::vector<TranscodingStream> active(streams);
+  for (unsigned s = 0; s < streams; ++s) {
+    active[s].m_file = new OpalWAVFile(m_prompt, PFile::ReadOnly);
+    active[s].m_encoder = OpalTranscoder::Create(GetOpalPCM16(m_mediaFormat.GetClockRate()), m_mediaFormat);
+    if (!active[s].m_file->IsOpen() || active[s].m_encoder == NULL) {
+      cerr << "Could not start transcoding stream " << s+1 << ", check open file limit" << endl;
+      packets = 0;
+      streams = s+1;
+      break;
+    }
+  }
+
+  RTP_DataFrame input(0, pcmSize);
+  RTP_DataFrame output;
+
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned p = 0; p < packets; ++p) {
+    for (unsigned s = 0; s < streams; ++s) {
+      TranscodingStream & stream = active[s];
+      input.SetPayloadSize(pcmSize);
+      if (!stream.m_file->Read(input.GetPayloadPtr(), pcmSize) || stream.m_file->GetLastReadCount() < pcmSize) {
+        // Prompt repeats
+        stream.m_file->SetPosition(0);
+        stream.m_file->Read(input.GetPayloadPtr(), pcmSize);
+      }
+      output.SetPayloadSize(pcmSize); // Encoded is never larger
+      stream.m_encoder->Convert(input, output);
+    }
+  }
+  PTimeInterval elapsed = PTimer::Tick() - start;
+
+  for (unsigned s = 0; s < streams; ++s) {
+    delete active[s].m_file;
+    delete active[s].m_encoder;
+  }
+
+  return packets > 0 ? elapsed : PTimeInterval(0);
+}
+
+
+PINDEX Test::PacketSize() const
+{
+  // Whole frames, at least one
+  unsigned frames = m_mediaFormat.GetClockRate()*m_packetTime/1000/std::max(m_mediaFormat.GetFrameTime(), 1U);
+  return m_mediaFormat.GetFrameSize()*std::max(frames, 1U);
+}
+
+
+PTimeInterval Test::Cached(unsigned streams, unsigned packets)
+{
+  PINDEX packetSize = PacketSize();
+
+  RTP_DataFrame output(0, packetSize);
+
+  PTimeInterval start = PTimer::Tick();
+
+  // Each call looks up the prompt when it starts playing
+  std::vector<CachedStream> active(streams);
+  for (unsigned s = 0; s < streams; ++s) {
+    OpalIVRPromptCache::GetInstance().GetPrompt(m_prompt, m_mediaFormat.GetName(), m_mediaFormat.GetClockRate(), active[s].m_data);
+    active[s].m_offset = 0;
+  }
+
+  for (unsigned p = 0; p < packets; ++p) {
+    for (unsigned s = 0; s < streams; ++s) {
+      CachedStream & stream = active[s];
+      if (stream.m_offset + packetSize > stream.m_data.GetSize())
+        stream.m_offset = 0; // Prompt repeats
+      output.SetPayloadSize(packetSize);
+      memcpy(output.GetPayloadPtr(), (const BYTE *)stream.m_data + stream.m_offset, packetSize);
+      stream.m_offset += packetSize;
+    }
+  }
+
+  return PTimer::Tick() - start;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,332 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for audio jitter buffer replay benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <rtp/jitter.h>
+#include <rtp/pcapfile.h>
+
+
+/* Replays an RTP audio stream, from a PCAP file or generated with random
+   network delay, loss and talk bursts, through the locked map jitter buffer
+   and the lock free ring jitter buffer. Packets are written at their arrival
+   time and read every frame time, as a media patch would, but in simulated
+   time so the run is repeatable and takes no longer than the processing.
+   Reports the time taken per packet and how each implementation handled
+   late packets and adapted its delay, which should be identical. */
+
+struct Packet
+{
+  PInt64        m_arrival; // Milliseconds
+  RTP_DataFrame m_frame;
+};
+
+typedef std::vector<Packet> Trace;
+
+static bool ArrivedBefore(const Packet & first, const Packet & second)
+{
+  return first.m_arrival < second.m_arrival;
+}
+
+
+struct Result
+{
+  Result()
+    : m_delivered(0)
+    , m_silent(0)
+    , m_tooLate(0)
+    , m_overruns(0)
+    , m_finalDelay(0)
+  { }
+
+  unsigned      m_delivered;
+  unsigned      m_silent;
+  unsigned      m_tooLate;
+  unsigned      m_overruns;
+  unsigned      m_finalDelay;
+  PTimeInterval m_elapsed;
+};
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+
+  protected:
+    bool LoadPCAP(PArgList & args);
+    void Generate(PArgList & args);
+    Result Replay(unsigned ringSize);
+
+    Trace    m_trace;
+    unsigned m_timeUnits;
+    unsigned m_frameTime;
+    unsigned m_minDelay;
+    unsigned m_maxDelay;
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "Jitter Buffer Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+  , m_timeUnits(8)
+  , m_frameTime(20)
+  , m_minDelay(40)
+  , m_maxDelay(250)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "p-pcap: PCAP file to replay, default is generated\n"
+             "-session: Index of RTP session in PCAP file, default first audio\n"
+             "d-duration: Seconds of generated audio, default 600\n"
+             "f-frame: Frame time in milliseconds, default 20\n"
+             "j-jitter: Maximum network jitter of generated packets in milliseconds, default 60\n"
+             "l-loss: Percentage of generated packets lost, default 1\n"
+             "b-burst: Seconds between generated talk bursts, default 10\n"
+             "m-min-delay: Minimum jitter delay in milliseconds, default 40\n"
+             "M-max-delay: Maximum jitter delay in milliseconds, default 250\n"
+             "r-ring: Comma separated list of ring sizes, 0 is locked map, default 0,64,256\n"
+             "n-repeat: Number of times to replay for timing, default 10\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_frameTime = std::max(args.GetOptionAs('f', m_frameTime), 1U);
+  m_minDelay = args.GetOptionAs('m', m_minDelay);
+  m_maxDelay = std::max(args.GetOptionAs('M', m_maxDelay), m_minDelay);
+  unsigned repeat = std::max(args.GetOptionAs('n', 10U), 1U);
+  PStringArray rings = args.GetOptionString('r', "0,64,256").Tokenise(",");
+
+  if (args.HasOption('p')) {
+    if (!LoadPCAP(args))
+      return;
+  }
+  else
+    Generate(args);
+
+  if (m_trace.empty()) {
+    cerr << "No RTP packets to replay" << endl;
+    return;
+  }
+
+  std::stable_sort(m_trace.begin(), m_trace.end(), ArrivedBefore);
+
+  cout << "Replaying " << m_trace.size() << " packets, "
+       << (m_trace.back().m_arrival - m_trace.front().m_arrival)/1000 << " seconds, "
+       << m_timeUnits << "kHz, delay " << m_minDelay << '-' << m_maxDelay << "ms\n"
+          "\n"
+          " Ring   ns/packet  Delivered     Silent   Too late   Overruns  Delay ms\n";
+
+  for (PINDEX i = 0; i < rings.GetSize(); ++i) {
+    unsigned ringSize = rings[i].AsUnsigned();
+
+    Result result;
+    PTimeInterval best;
+    for (unsigned r = 0; r < repeat; ++r) {
+      result = Replay(ringSize);
+      if (r == 0 || result.m_elapsed < best)
+        best = result.m_elapsed;
+    }
+
+    cout << setw(5) << ringSize << ' '
+         << fixed << setprecision(0)
+         << setw(11) << best.GetMicroSeconds()*1000.0/m_trace.size() << ' '
+         << setw(10) << result.m_delivered << ' '
+         << setw(10) << result.m_silent << ' '
+         << setw(10) << result.m_tooLate << ' '
+         << setw(10) << result.m_overruns << ' '
+         << setw(9) << result.m_finalDelay
+         << endl;
+  }
+}
+
+
+bool Test::LoadPCAP(PArgList & args)
+{
+  OpalPCAPFile pcap;
+  if (!pcap.Open(args.GetOptionString('p'), PFile::ReadOnly)) {
+    cerr << "Could not open file \"" << args.GetOptionString('p') << '"' << endl;
+    return false;
+  }
+
+  OpalPCAPFile::DiscoveredRTP discoveredRTP;
+  if (!pcap.DiscoverRTP(discoveredRTP)) {
+    cerr << "No RTP sessions found" << endl;
+    return false;
+  }
+
+  size_t idx = args.GetOptionString("session").AsUnsigned();
+  if (idx == 0) {
+    for (size_t i = 0; i < discoveredRTP.size(); ++i) {
+      if (discoveredRTP[i].m_mediaFormat.GetMediaType() == OpalMediaType::Audio()) {
+        idx = i + 1;
+        break;
+      }
+    }
+  }
+  if (idx == 0 || idx > discoveredRTP.size() || !pcap.SetFilters(discoveredRTP[idx-1])) {
+    cerr << "No audio RTP session found" << endl;
+    return false;
+  }
+
+  cout << "Session " << idx << ' ' << discoveredRTP[idx-1] << endl;
+  const OpalMediaFormat & mediaFormat = discoveredRTP[idx-1].m_mediaFormat;
+  if (mediaFormat.IsValid()) {
+    m_timeUnits = mediaFormat.GetTimeUnits();
+    if (!args.HasOption('f'))
+      m_frameTime = std::max(mediaFormat.GetFrameTime()/m_timeUnits, 1U);
+  }
+
+  if (!pcap.Restart())
+    return false;
+
+  PTime firstPacketTime;
+  while (!pcap.IsEndOfFile()) {
+    Packet packet;
+    if (pcap.GetRTP(packet.m_frame) < 0)
+      continue;
+
+    if (m_trace.empty())
+      firstPacketTime = pcap.GetPacketTime();
+    packet.m_arrival = (pcap.GetPacketTime() - firstPacketTime).GetMilliSeconds();
+    m_trace.push_back(packet);
+  }
+
+  return true;
+}
+
+
+void Test::Generate(PArgList & args)
+{
+  unsigned duration = args.GetOptionAs('d', 600U);
+  unsigned jitter = args.GetOptionAs('j', 60U);
+  unsigned loss = args.GetOptionAs('l', 1U);
+  unsigned burst = args.GetOptionAs('b', 10U)*1000/m_frameTime;
+
+  PRandom random(1); // Same trace every run
+  RTP_SequenceNumber sequenceNumber = (RTP_SequenceNumber)random.Generate();
+  RTP_Timestamp timestamp = random.Generate();
+
+  // Silence, not sent, for up to a second before each talk burst
+  unsigned silent = std::min(1000/m_frameTime, burst/2);
+
+  unsigned frames = duration*1000/m_frameTime;
+  for (unsigned i = 0; i < frames; ++i, timestamp += m_frameTime*m_timeUnits) {
+    bool marker = burst > 0 && i % burst == 0;
+    if (burst > 0 && i % burst >= burst - silent)
+      continue;
+
+    Packet packet;
+    packet.m_frame.SetPayloadType(RTP_DataFrame::PCMU);
+    packet.m_frame.SetPayloadSize(m_frameTime*m_timeUnits);
+    packet.m_frame.SetSyncSource(0x12345678);
+    packet.m_frame.SetSequenceNumber(sequenceNumber++);
+    packet.m_frame.SetTimestamp(timestamp);
+    packet.m_frame.SetMarker(marker);
+
+    if (random.Generate() % 100 < loss)
+      continue;
+
+    // Mostly small jitter, occasionally up to the maximum
+    unsigned delay = 20 + (jitter > 0 ? random.Generate() % (random.Generate() % 10 == 0 ? jitter : (jitter+3)/4 + 1) : 0);
+    packet.m_arrival = i*m_frameTime + delay;
+    m_trace.push_back(packet);
+  }
+}
+
+
+Result Test::Replay(unsigned ringSize)
+{
+  OpalJitterBuffer::Params params(m_minDelay, m_maxDelay);
+  params.m_ringBufferSize = ringSize;
+  OpalJitterBuffer * jitter = OpalJitterBuffer::Create(OpalMediaType::Audio(), OpalJitterBuffer::Init(params, m_timeUnits, 2048));
+
+  Result result;
+
+  /* Each packet must be its own buffer, as it is from the RTP session, as the
+     map jitter buffer delivers the same buffer and changes the timestamp */
+  Trace trace;
+  trace.reserve(m_trace.size());
+  for (Trace::const_iterator it = m_trace.begin(); it != m_trace.end(); ++it) {
+    Packet packet;
+    packet.m_arrival = it->m_arrival;
+    packet.m_frame.Copy(it->m_frame);
+    trace.push_back(packet);
+  }
+
+  // Ticks offset so first is not zero, which the buffer treats as no previous packet
+  static const PInt64 TickOffset = 1000;
+  Trace::const_iterator next = trace.begin();
+  PInt64 readTick = next->m_arrival;
+  RTP_DataFrame frame;
+  RTP_Timestamp playOutTimestamp = 0;
+
+  PTime start;
+  while (next != trace.end()) {
+    while (next != trace.end() && next->m_arrival <= readTick) {
+      jitter->WriteData(next->m_frame, PTimeInterval(next->m_arrival + TickOffset));
+      ++next;
+    }
+
+    frame.SetTimestamp(playOutTimestamp);
+    jitter->ReadData(frame, 0 PTRACE_PARAM(, PTimeInterval(readTick + TickOffset)));
+    if (frame.GetPayloadSize() > 0)
+      ++result.m_delivered;
+    else
+      ++result.m_silent;
+
+    RTP_Timestamp packetTime = jitter->GetPacketTime();
+    playOutTimestamp = frame.GetTimestamp() + (packetTime > 0 ? packetTime : m_frameTime*m_timeUnits);
+    readTick += m_frameTime;
+  }
+  result.m_elapsed = PTime() - start;
+
+  result.m_tooLate = jitter->GetPacketsTooLate();
+  result.m_overruns = jitter->GetBufferOverruns();
+  result.m_finalDelay = jitter->GetCurrentJitterDelay()/m_timeUnits;
+
+  delete jitter;
+  return result;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,182 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for media format option read benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <opal/mediafmt.h>
+
+
+/* Reads the options used on the media path, as media streams, jitter
+   buffers and mixers do, from many threads at once. Each thread has its own
+   copy of the media format, which shares the registered format information,
+   as media streams do. The "name" mode passes option names that are not the
+   option name function references, so uses the original method of locking
+   the shared information and searching the options by name, "typed" uses
+   the well known option accessors. */
+
+enum Modes {
+  e_ByName,
+  e_Typed,
+  NumModes
+};
+
+static const char * const ModeNames[NumModes] = { "name", "typed" };
+
+static const unsigned ReadsPerLoop = 4;
+
+
+class Worker : public PThread
+{
+    PCLASSINFO(Worker, PThread);
+  public:
+    Worker(Modes mode, const OpalMediaFormat & mediaFormat, unsigned loops)
+      : PThread(10000, NoAutoDeleteThread, NormalPriority, "Worker")
+      , m_mode(mode)
+      , m_mediaFormat(mediaFormat)
+      , m_loops(loops)
+      , m_total(0)
+    {
+    }
+
+    virtual void Main()
+    {
+      // Copies, not the references from the option name functions
+      PString clockRateName = (const char *)OpalMediaFormat::ClockRateOption();
+      PString frameTimeName = (const char *)OpalMediaFormat::FrameTimeOption();
+      PString frameSizeName = (const char *)OpalMediaFormat::MaxFrameSizeOption();
+      PString txFramesName  = (const char *)OpalAudioFormat::TxFramesPerPacketOption();
+
+      for (unsigned i = 0; i < m_loops; ++i) {
+        if (m_mode == e_ByName)
+          m_total += m_mediaFormat.GetOptionInteger(clockRateName, OpalMediaFormat::AudioClockRate) +
+                     m_mediaFormat.GetOptionInteger(frameTimeName) +
+                     m_mediaFormat.GetOptionInteger(frameSizeName) +
+                     m_mediaFormat.GetOptionInteger(txFramesName);
+        else
+          m_total += m_mediaFormat.GetClockRate() +
+                     m_mediaFormat.GetFrameTime() +
+                     m_mediaFormat.GetFrameSize() +
+                     m_mediaFormat.GetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption());
+      }
+    }
+
+    Modes           m_mode;
+    OpalMediaFormat m_mediaFormat;
+    unsigned        m_loops;
+    uint64_t        m_total;
+};
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "Media Format Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "n-loops: Number of loops of four option reads per thread, default 1000000\n"
+             "t-threads: Comma separated list of thread counts, default 1,4,16\n"
+             "f-format: Media format to read, default " OPAL_G711_ULAW_64K "\n"
+             "m-mode: Comma separated list of modes, name and/or typed, default both\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned loops = args.GetOptionAs('n', 1000000U);
+  PStringArray threadCounts = args.GetOptionString('t', "1,4,16").Tokenise(",");
+  PStringArray modes = args.GetOptionString('m', "name,typed").Tokenise(",");
+
+  OpalMediaFormat mediaFormat(args.GetOptionString('f', OPAL_G711_ULAW_64K));
+  if (!mediaFormat.IsValid()) {
+    cerr << "Unknown media format \"" << args.GetOptionString('f') << '"' << endl;
+    return;
+  }
+
+  cout << "Reading " << mediaFormat << ": clock rate " << mediaFormat.GetClockRate()
+       << ", frame time " << mediaFormat.GetFrameTime()
+       << ", frame size " << mediaFormat.GetFrameSize() << "\n"
+          "\n"
+          "Mode   Threads      Reads/s   Per thread\n";
+
+  for (PINDEX m = 0; m < modes.GetSize(); ++m) {
+    Modes mode = NumModes;
+    for (PINDEX i = 0; i < NumModes; ++i) {
+      if (modes[m] *= ModeNames[i])
+        mode = (Modes)i;
+    }
+    if (mode == NumModes) {
+      cerr << "Unknown mode \"" << modes[m] << '"' << endl;
+      continue;
+    }
+
+    for (PINDEX t = 0; t < threadCounts.GetSize(); ++t) {
+      unsigned threads = std::max(threadCounts[t].AsUnsigned(), 1U);
+
+      PList<Worker> workers;
+      for (unsigned i = 0; i < threads; ++i)
+        workers.Append(new Worker(mode, mediaFormat, loops));
+
+      PTime start;
+      for (PList<Worker>::iterator it = workers.begin(); it != workers.end(); ++it)
+        it->Resume();
+      for (PList<Worker>::iterator it = workers.begin(); it != workers.end(); ++it)
+        it->WaitForTermination();
+      PTimeInterval elapsed = PTime() - start;
+
+      double rate = (double)loops*ReadsPerLoop*threads*1000.0/std::max(elapsed.GetMilliSeconds(), (PInt64)1);
+      cout << setw(5) << left << ModeNames[mode] << right << ' '
+           << setw(7) << threads << ' '
+           << fixed << setprecision(0)
+           << setw(12) << rate << ' '
+           << setw(12) << (rate/threads)
+           << endl;
+    }
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,166 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for route table lookup benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <opal/manager.h>
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+
+    void Benchmark(unsigned routes);
+
+  protected:
+    OpalManager * m_manager;
+    unsigned      m_lookups;
+    unsigned      m_seconds;
+    bool          m_linear;
+    bool          m_reload;
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "Route Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+  , m_manager(NULL)
+  , m_lookups(100000)
+  , m_seconds(5)
+  , m_linear(false)
+  , m_reload(false)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "r-routes: Comma separated list of route table sizes, default 100,10000,100000\n"
+             "n-lookups: Maximum number of lookups for each table size, default 100000\n"
+             "s-seconds: Maximum time for lookups for each table size, default 5\n"
+             "L-linear. Also time a linear search of every entry, as used previously\n"
+             "R-reload. Also time reloading the whole table\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_lookups = args.GetOptionAs('n', m_lookups);
+  m_seconds = args.GetOptionAs('s', m_seconds);
+  m_linear = args.HasOption('L');
+  m_reload = args.HasOption('R');
+  PStringArray sizes = args.GetOptionString('r', "100,10000,100000").Tokenise(",");
+
+  m_manager = new OpalManager;
+
+  cout << "Routes  Build ms   Lookups/s   Linear/s  Reload ms\n";
+  for (PINDEX i = 0; i < sizes.GetSize(); ++i)
+    Benchmark(sizes[i].AsUnsigned());
+
+  delete m_manager;
+}
+
+
+void Test::Benchmark(unsigned routes)
+{
+  /* Typical carrier style table, a route per dialled prefix, in no
+     particular order, with some defaults at the end */
+  PRandom random;
+  PStringArray specs;
+  PStringArray prefixes;
+  for (unsigned i = 0; i < routes; ++i) {
+    PString prefix(PString::Unsigned, 100000 + random.Generate() % 900000);
+    prefixes.AppendString(prefix);
+    specs.AppendString(PSTRSTRM("sip:.*\t" << prefix << ".*=sip:<du>@gw" << (i%100) << ".example.com"));
+  }
+  specs.AppendString("sip:.*\t\\+.*=sip:<du>@international.example.com");
+  specs.AppendString(".*:.*\t.*=sip:<du>@default.example.com");
+
+  PTime startBuild;
+  m_manager->SetRouteTable(specs);
+  PTimeInterval buildTime = PTime() - startBuild;
+
+  PStringArray searches;
+  for (unsigned i = 0; i < 1000; ++i)
+    searches.AppendString(prefixes[random.Generate() % prefixes.GetSize()] + PString(PString::Unsigned, 1000 + random.Generate() % 9000));
+
+  unsigned count = 0;
+  PSimpleTimer timer(0, m_seconds);
+  while (count < m_lookups && !timer.HasExpired()) {
+    PINDEX entry = 0;
+    if (m_manager->ApplyRouteTable("sip:me@here.com", searches[count % searches.GetSize()], entry).IsEmpty())
+      cerr << "No route for " << searches[count % searches.GetSize()] << endl;
+    ++count;
+  }
+  double rate = count*1000.0/std::max(timer.GetElapsed().GetMilliSeconds(), (PInt64)1);
+
+  double linearRate = 0;
+  if (m_linear) {
+    const OpalManager::RouteTable & table = m_manager->GetRouteTable();
+    unsigned linearCount = 0;
+    PSimpleTimer linearTimer(0, m_seconds);
+    while (linearCount < m_lookups && !linearTimer.HasExpired()) {
+      PString search = "sip:me@here.com\t" + searches[linearCount % searches.GetSize()];
+      for (PINDEX i = 0; i < table.GetSize(); ++i) {
+        if (table[i].IsMatch(search))
+          break;
+      }
+      ++linearCount;
+    }
+    linearRate = linearCount*1000.0/std::max(linearTimer.GetElapsed().GetMilliSeconds(), (PInt64)1);
+  }
+
+  PTimeInterval reloadTime;
+  if (m_reload) {
+    PTime startReload;
+    m_manager->SetRouteTable(specs);
+    reloadTime = PTime() - startReload;
+  }
+
+  cout << setw(6) << routes << ' '
+       << setw(9) << buildTime.GetMilliSeconds() << ' '
+       << fixed << setprecision(0)
+       << setw(11) << rate << ' '
+       << setw(10) << linearRate << ' '
+       << setw(10) << reloadTime.GetMilliSeconds()
+       << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
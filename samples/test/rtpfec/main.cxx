@@ -0,0 +1,240 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for RTP Forward Error Correction loss simulation
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <rtp/rtp_session.h>
+
+#if !OPAL_RTP_FEC
+  #error Cannot compile without RTP FEC support
+#endif
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+
+    struct Results
+    {
+      Results()
+        : m_lost(0)
+        , m_recovered(0)
+        , m_corrupt(0)
+        , m_mediaBytes(0)
+        , m_fecBytes(0)
+        , m_totalDelay(0)
+        , m_maxDelay(0)
+      { }
+
+      unsigned m_lost;
+      unsigned m_recovered;
+      unsigned m_corrupt;
+      uint64_t m_mediaBytes;
+      uint64_t m_fecBytes;
+      unsigned m_totalDelay; // In packet intervals
+      unsigned m_maxDelay;
+    };
+
+    void Simulate(unsigned groupSize, unsigned levels, Results & results);
+
+    struct LostPacket {
+      unsigned   m_index;
+      PBYTEArray m_payload;
+    };
+    typedef std::map<RTP_SequenceNumber, LostPacket> LostMap;
+
+  protected:
+    unsigned m_packets;
+    unsigned m_payloadSize;
+    double   m_lossRate;
+    double   m_burstLength;
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "RTP FEC Test", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+  , m_packets(50000)
+  , m_payloadSize(160)
+  , m_lossRate(0.05)
+  , m_burstLength(1)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "n-packets: Number of packets to simulate, default 50000\n"
+             "l-loss: Packet loss percentage, default 5\n"
+             "b-burst: Mean loss burst length in packets, default 1 (isolated losses)\n"
+             "s-size: Payload size in bytes, default 160\n"
+             "i-interval: Packet interval in milliseconds, default 20\n"
+             "r-rtt: Round trip time for NACK comparison in milliseconds, default 100\n"
+             "g-group: Comma separated list of FEC group sizes, default 4,8,16\n"
+             "L-levels: Comma separated list of FEC protection levels, default 1,2\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_packets = args.GetOptionAs('n', m_packets);
+  m_payloadSize = std::min(args.GetOptionAs('s', m_payloadSize), 1000U); // Must fit in RFC 2198 block
+  m_lossRate = args.GetOptionAs('l', 5.0)/100;
+  m_burstLength = std::max(args.GetOptionAs('b', m_burstLength), 1.0);
+  unsigned interval = args.GetOptionAs('i', 20U);
+  unsigned rtt = args.GetOptionAs('r', 100U);
+  PStringArray groups = args.GetOptionString('g', "4,8,16").Tokenise(",");
+  PStringArray levels = args.GetOptionString('L', "1,2").Tokenise(",");
+
+  cout << "Simulating " << m_packets << " packets of " << m_payloadSize << " bytes every " << interval << "ms, "
+       << (m_lossRate*100) << "% loss, mean burst " << m_burstLength << " packets\n"
+          "\n"
+          "Group Level Overhead  Lost  Residual Recovered  Avg Delay  Max Delay Corrupt\n";
+
+  for (PINDEX g = 0; g < groups.GetSize(); ++g) {
+    for (PINDEX l = 0; l < levels.GetSize(); ++l) {
+      Results results;
+      Simulate(groups[g].AsUnsigned(), levels[l].AsUnsigned(), results);
+
+      unsigned residual = results.m_lost - results.m_recovered;
+      cout << setw(5) << groups[g] << ' '
+           << setw(5) << levels[l] << ' '
+           << fixed << setprecision(1)
+           << setw(7) << (results.m_fecBytes*100.0/results.m_mediaBytes) << "% "
+           << setw(5) << (results.m_lost*100.0/m_packets) << "% "
+           << setw(7) << setprecision(2) << (residual*100.0/m_packets) << "% "
+           << setw(9) << results.m_recovered << ' '
+           << setw(8) << setprecision(1)
+           << (results.m_recovered > 0 ? (double)results.m_totalDelay*interval/results.m_recovered : 0.0) << "ms "
+           << setw(8) << results.m_maxDelay*interval << "ms "
+           << setw(7) << results.m_corrupt
+           << endl;
+    }
+  }
+
+  cout << "\nNACK retransmission would add at least " << (rtt + interval) << "ms per recovered packet." << endl;
+}
+
+
+void Test::Simulate(unsigned groupSize, unsigned levels, Results & results)
+{
+  static const RTP_SyncSourceId SSRC = 0x12345678;
+  static const unsigned MaxRecoveryWait = 256; // Packets
+
+  OpalRTPSession::FecEncoder encoder(groupSize, levels);
+  OpalRTPSession::FecDecoder decoder;
+
+  // Gilbert-Elliott model, in "bad" state all packets lost
+  double goodToBad = m_lossRate/(m_burstLength*(1 - m_lossRate));
+  double badToGood = 1/m_burstLength;
+  bool badState = false;
+
+  LostMap lostPackets;
+
+  PRandom random;
+  for (unsigned index = 0; index < m_packets; ++index) {
+    RTP_DataFrame frame(m_payloadSize);
+    frame.SetPayloadType(RTP_DataFrame::PCMA);
+    frame.SetSequenceNumber((RTP_SequenceNumber)index);
+    frame.SetTimestamp(index*m_payloadSize);
+    frame.SetMarker(index % 50 == 0);
+    frame.SetSyncSource(SSRC);
+    BYTE * payload = frame.GetPayloadPtr();
+    for (unsigned i = 0; i < m_payloadSize; ++i)
+      payload[i] = (BYTE)random.Generate();
+    results.m_mediaBytes += m_payloadSize;
+
+    // FEC parity is carried as RFC 2198 redundant blocks in the same packet
+    vector<OpalRTPSession::FecData> fec;
+    encoder.Encode(frame, fec);
+    for (vector<OpalRTPSession::FecData>::iterator it = fec.begin(); it != fec.end(); ++it) {
+      results.m_fecBytes += 4 + 10; // RED and FEC headers
+      for (vector<OpalRTPSession::FecLevel>::iterator lvl = it->m_level.begin(); lvl != it->m_level.end(); ++lvl)
+        results.m_fecBytes += 2 + lvl->m_mask.GetSize() + lvl->m_data.GetSize();
+    }
+
+    badState = random.Generate()/(double)UINT_MAX < (badState ? 1 - badToGood : goodToBad);
+    if (badState) {
+      ++results.m_lost;
+      LostPacket & lost = lostPackets[frame.GetSequenceNumber()];
+      lost.m_index = index;
+      lost.m_payload = PBYTEArray(frame.GetPayloadPtr(), frame.GetPayloadSize());
+      continue;
+    }
+
+    RTP_DataFrameList recovered;
+    for (vector<OpalRTPSession::FecData>::iterator it = fec.begin(); it != fec.end(); ++it)
+      decoder.AddFEC(*it, SSRC, recovered);
+    decoder.AddPacket(frame, recovered);
+
+    for (RTP_DataFrameList::iterator it = recovered.begin(); it != recovered.end(); ++it) {
+      LostMap::iterator lost = lostPackets.find(it->GetSequenceNumber());
+      if (lost == lostPackets.end()) {
+        ++results.m_corrupt;
+        continue;
+      }
+
+      if (it->GetPayloadSize() != lost->second.m_payload.GetSize() ||
+          memcmp(it->GetPayloadPtr(), lost->second.m_payload, it->GetPayloadSize()) != 0 ||
+          it->GetTimestamp() != lost->second.m_index*m_payloadSize ||
+          it->GetMarker() != (lost->second.m_index % 50 == 0) ||
+          it->GetPayloadType() != RTP_DataFrame::PCMA)
+        ++results.m_corrupt;
+      else {
+        ++results.m_recovered;
+        unsigned delay = index - lost->second.m_index;
+        results.m_totalDelay += delay;
+        if (results.m_maxDelay < delay)
+          results.m_maxDelay = delay;
+      }
+
+      lostPackets.erase(lost);
+    }
+
+    // Give up on those never going to be recovered, before sequence numbers wrap
+    for (LostMap::iterator it = lostPackets.begin(); it != lostPackets.end(); ) {
+      if (index - it->second.m_index > MaxRecoveryWait)
+        lostPackets.erase(it++);
+      else
+        ++it;
+    }
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,192 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for signalling reactor benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/sockets.h>
+#include <opal/manager.h>
+#include <sip/sipep.h>
+
+#if !OPAL_SIP
+  #error Cannot compile without SIP support
+#endif
+
+
+/* Opens many idle TCP connections to a SIP listener, as a large number of
+   trunks or registered clients would, and measures the memory and threads
+   used per connection, with thread per transport and with the signalling
+   reactor. Each connection is then sent a CRLF keep-alive ping, which the
+   endpoint answers with a pong, to confirm it is being serviced and measure
+   the round trip time. */
+
+struct ProcessStatus
+{
+  ProcessStatus()
+    : m_rssKB(0)
+    , m_vmKB(0)
+    , m_threads(0)
+  {
+    // Linux specific, zero elsewhere
+    PTextFile status("/proc/self/status", PFile::ReadOnly);
+    PString line;
+    while (status.ReadLine(line)) {
+      if (line.NumCompare("VmRSS:") == PObject::EqualTo)
+        m_rssKB = line.Mid(6).AsUnsigned();
+      else if (line.NumCompare("VmSize:") == PObject::EqualTo)
+        m_vmKB = line.Mid(7).AsUnsigned();
+      else if (line.NumCompare("Threads:") == PObject::EqualTo)
+        m_threads = line.Mid(8).AsUnsigned();
+    }
+  }
+
+  unsigned m_rssKB;
+  unsigned m_vmKB;
+  unsigned m_threads;
+};
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+
+    void Benchmark(unsigned reactorThreads, WORD port);
+
+  protected:
+    unsigned m_connections;
+    unsigned m_settle;
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "Signalling Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+  , m_connections(1000)
+  , m_settle(2)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "c-connections: Maximum number of idle connections to open, default 1000\n"
+             "r-reactor: Comma separated list of reactor thread counts, 0 is thread per transport, default 0,2\n"
+             "p-port: First TCP port for SIP listener, incremented for each run, default 15060\n"
+             "s-settle: Seconds to wait for connections to be accepted, default 2\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_connections = args.GetOptionAs('c', m_connections);
+  m_settle = args.GetOptionAs('s', m_settle);
+  WORD port = args.GetOptionAs('p', (WORD)15060);
+  PStringArray reactors = args.GetOptionString('r', "0,2").Tokenise(",");
+
+  cout << "Reactor Connections Threads  RSS KB/conn  VM KB/conn  Answered  Avg RTT us  Max RTT us\n";
+  for (PINDEX i = 0; i < reactors.GetSize(); ++i)
+    Benchmark(reactors[i].AsUnsigned(), (WORD)(port + i));
+}
+
+
+void Test::Benchmark(unsigned reactorThreads, WORD port)
+{
+  OpalManager * manager = new OpalManager;
+  if (reactorThreads > 0 && !manager->SetSignalingReactorThreads(reactorThreads)) {
+    cerr << "Signalling reactor not supported on this platform" << endl;
+    delete manager;
+    return;
+  }
+
+  SIPEndPoint * sip = new SIPEndPoint(*manager);
+  if (!sip->StartListener(PSTRSTRM("tcp$127.0.0.1:" << port))) {
+    cerr << "Could not listen on port " << port << endl;
+    delete manager;
+    return;
+  }
+
+  ProcessStatus before;
+
+  // Open until the limit, or we run out of something (e.g. file handles)
+  PList<PTCPSocket> sockets;
+  while ((unsigned)sockets.GetSize() < m_connections) {
+    PTCPSocket * socket = new PTCPSocket(port);
+    if (!socket->Connect("127.0.0.1")) {
+      PTRACE(2, "Connection " << sockets.GetSize() << " failed: " << socket->GetErrorText());
+      delete socket;
+      break;
+    }
+    socket->SetReadTimeout(5000);
+    sockets.Append(socket);
+  }
+
+  PThread::Sleep(m_settle*1000);
+  ProcessStatus idle;
+
+  unsigned answered = 0;
+  PTimeInterval totalRTT, maxRTT;
+  for (PList<PTCPSocket>::iterator it = sockets.begin(); it != sockets.end(); ++it) {
+    PTimeInterval start = PTimer::Tick();
+    char pong[2];
+    if (it->Write("\r\n\r\n", 4) && it->ReadBlock(pong, sizeof(pong)) && pong[0] == '\r' && pong[1] == '\n') {
+      PTimeInterval rtt = PTimer::Tick() - start;
+      totalRTT += rtt;
+      if (maxRTT < rtt)
+        maxRTT = rtt;
+      ++answered;
+    }
+  }
+
+  unsigned count = std::max((unsigned)sockets.GetSize(), 1U);
+  cout << setw(7) << reactorThreads << ' '
+       << setw(11) << sockets.GetSize() << ' '
+       << setw(7) << idle.m_threads << ' '
+       << fixed << setprecision(1)
+       << setw(11) << ((double)idle.m_rssKB - before.m_rssKB)/count << ' '
+       << setw(11) << ((double)idle.m_vmKB - before.m_vmKB)/count << ' '
+       << setw(9) << answered << ' '
+       << setprecision(0)
+       << setw(11) << (answered > 0 ? totalRTT.GetMicroSeconds()/(double)answered : 0.0) << ' '
+       << setw(11) << (double)maxRTT.GetMicroSeconds()
+       << endl;
+
+  sockets.RemoveAll();
+  delete manager;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -74,6 +74,118 @@ class RegTest : public PProcess
 PCREATE_PROCESS(RegTest);
 
 
+/* Benchmark of the SIPEndPoint transaction and registrar table access
+   patterns, comparing a single PSafeDictionary to the sharded dictionary.
+   OPTIONS does a transaction add, find and remove, REGISTER a find of an
+   existing AoR, adding it if it is not there. */
+
+struct BenchEntry : public PSafeObject
+{
+};
+
+
+template <class Dict>
+class BenchThread : public PThread
+{
+  public:
+    BenchThread(Dict & dict, unsigned operations, bool doRegister)
+      : PThread(10000, NoAutoDeleteThread)
+      , m_dict(dict)
+      , m_operations(operations)
+      , m_register(doRegister)
+    {
+    }
+
+    virtual void Main()
+    {
+      m_start.Wait();
+
+      if (m_register) {
+        for (unsigned i = 0; i < m_operations; ++i) {
+          const SIPURL & aor = m_aors[i % m_aors.size()];
+          if (m_dict.Find(aor, PSafeReadWrite) == NULL)
+            m_dict.SetAt(aor, new BenchEntry);
+        }
+      }
+      else {
+        for (unsigned i = 0; i < m_operations; ++i) {
+          const PString & id = m_ids[i % m_ids.size()];
+          m_dict.SetAt(id, new BenchEntry);
+          m_dict.Find(id, PSafeReference);
+          m_dict.RemoveAt(id);
+        }
+      }
+    }
+
+    Dict &     m_dict;
+    unsigned   m_operations;
+    bool       m_register;
+    PSyncPoint m_start;
+    std::vector<SIPURL>  m_aors;
+    std::vector<PString> m_ids;
+};
+
+
+template <class Dict>
+static double BenchmarkTable(Dict & dict, unsigned threadCount, unsigned operations, bool doRegister)
+{
+  static const unsigned KeysPerThread = 1000;
+
+  std::vector<BenchThread<Dict> *> threads;
+  for (unsigned t = 0; t < threadCount; ++t) {
+    BenchThread<Dict> * thread = new BenchThread<Dict>(dict, operations, doRegister);
+    for (unsigned k = 0; k < KeysPerThread; ++k) {
+      if (doRegister)
+        thread->m_aors.push_back(SIPURL(psprintf("sip:user%u-%u@example.com", t, k)));
+      else
+        thread->m_ids.push_back(psprintf("z9hG4bK%u-%u", t, k));
+    }
+    threads.push_back(thread);
+  }
+
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned t = 0; t < threadCount; ++t)
+    threads[t]->m_start.Signal();
+  for (unsigned t = 0; t < threadCount; ++t) {
+    threads[t]->WaitForTermination();
+    delete threads[t];
+  }
+  PTimeInterval elapsed = PTimer::Tick() - start;
+
+  dict.RemoveAll();
+  dict.DeleteObjectsToBeRemoved();
+
+  return 1000.0*threadCount*operations/std::max(elapsed.GetMilliSeconds(), (PInt64)1);
+}
+
+
+static void BenchmarkTables(unsigned maxThreads, unsigned operations)
+{
+  if (maxThreads == 0)
+    maxThreads = 1;
+
+  cout << "Threads     OPTIONS/s   (sharded)    REGISTER/s   (sharded)" << endl;
+  unsigned threads = 1;
+  for (;;) {
+    PSafeDictionary<PString, BenchEntry> singleTransactions;
+    OpalSafeShardedDictionary<PString, BenchEntry, 64> shardedTransactions;
+    PSafeDictionary<SIPURL, BenchEntry> singleRegistrar;
+    OpalSafeShardedDictionary<SIPURL, BenchEntry, 64> shardedRegistrar;
+
+    cout << setw(7) << threads
+         << setw(14) << (PUInt64)BenchmarkTable(singleTransactions, threads, operations, false)
+         << setw(12) << (PUInt64)BenchmarkTable(shardedTransactions, threads, operations, false)
+         << setw(14) << (PUInt64)BenchmarkTable(singleRegistrar, threads, operations, true)
+         << setw(12) << (PUInt64)BenchmarkTable(shardedRegistrar, threads, operations, true)
+         << endl;
+
+    if (threads >= maxThreads)
+      break;
+    threads = std::min(threads*2, maxThreads);
+  }
+}
+
+
 RegTest::RegTest()
   : PProcess("OPAL RegTest", "RegTest", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
 {
@@ -92,6 +204,8 @@ void RegTest::Main()
                   "P-proxy: Proxy to use for registration.\n"
                   "d-delay: Delay time (seconds) before unregistering (2 seconds)\n"
                   "v-verbose. Indicate verbose output.\n"
+                  "-bench-tables: Benchmark transaction/registrar tables, 1 to N threads.\n"
+                  "-bench-operations: Operations per thread for benchmark (100000).\n"
                   PTRACE_ARGLIST
                   "h-help."
                   , false) || args.HasOption('h')) {
@@ -105,6 +219,12 @@ void RegTest::Main()
 
   PTRACE_INITIALISE(args);
 
+  if (args.HasOption("bench-tables")) {
+    BenchmarkTables(args.GetOptionString("bench-tables").AsUnsigned(),
+                    args.GetOptionAs("bench-operations", 100000U));
+    return;
+  }
+
   {
     OpalManager manager;
     MySIPEndPoint * endpoint = new MySIPEndPoint(manager);
@@ -0,0 +1,348 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for SRTP protection benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <opal/manager.h>
+#include <opal/call.h>
+#include <rtp/rtpep.h>
+#include <rtp/srtp_session.h>
+
+#if !OPAL_SRTP
+  #error Cannot compile without SRTP support
+#endif
+
+#if HAS_SRTP_SRTP_H
+  #include <srtp2/srtp.h>
+#else
+  #include <srtp.h>
+#endif
+
+
+/* Measures OpalSRTPSession::OnSendData() when one media frame, e.g. from the
+   mixer, is sent to many legs, each with its own SRTP session. The "copy"
+   mode is the original behaviour of making the shared frame unique for every
+   leg, "buffered" lets the session protect the shared frame into its reused
+   buffers, "batch" also processes a group of packets under one session lock,
+   as WriteData() does for a RTP_DataFrameList. The transport write is not
+   included, only the session processing. */
+
+enum Modes {
+  e_Copy,
+  e_Buffered,
+  e_Batch,
+  NumModes
+};
+
+static const char * const ModeNames[NumModes] = { "copy", "buffered", "batch" };
+
+
+class BenchEndPoint : public OpalRTPEndPoint
+{
+    PCLASSINFO(BenchEndPoint, OpalRTPEndPoint);
+  public:
+    BenchEndPoint(OpalManager & manager)
+      : OpalRTPEndPoint(manager, "bench", NoAttributes)
+    { }
+
+    virtual PSafePtr<OpalConnection> MakeConnection(OpalCall &, const PString &, void *, unsigned, OpalConnection::StringOptions *)
+    {
+      return NULL;
+    }
+
+    virtual OpalMediaFormatList GetMediaFormats() const
+    {
+      return OpalMediaFormatList();
+    }
+};
+
+
+class BenchConnection : public OpalRTPConnection
+{
+    PCLASSINFO(BenchConnection, OpalRTPConnection);
+  public:
+    BenchConnection(OpalCall & call, BenchEndPoint & endpoint)
+      : OpalRTPConnection(call, endpoint, "bench")
+    { }
+
+    virtual bool IsNetworkConnection() const { return true; }
+};
+
+
+class Leg : public OpalSRTPSession
+{
+    PCLASSINFO(Leg, OpalSRTPSession);
+  public:
+    Leg(OpalConnection & connection, unsigned sessionId)
+      : OpalSRTPSession(Init(connection, sessionId, OpalMediaType::Video(), false))
+    { }
+
+    bool SetKey()
+    {
+      OpalMediaCryptoSuite * cryptoSuite = OpalMediaCryptoSuiteFactory::CreateInstance("AES_CM_128_HMAC_SHA1_80");
+      if (cryptoSuite == NULL)
+        return false;
+
+      OpalMediaCryptoKeyInfo * keyInfo = cryptoSuite->CreateKeyInfo();
+      keyInfo->Randomise();
+
+      OpalMediaCryptoKeyList keys;
+      keys.Append(keyInfo);
+      return ApplyCryptoKey(keys, false);
+    }
+
+    bool Protect(RTP_DataFrame & frame)
+    {
+      if (!LockReadWrite(P_DEBUG_LOCATION))
+        return false;
+      RewriteMode rewrite = e_RewriteSSRC;
+      SendReceiveStatus status = OnSendData(rewrite, frame, PTime());
+      UnlockReadWrite(P_DEBUG_LOCATION);
+      return status == e_ProcessPacket;
+    }
+
+    unsigned Protect(RTP_DataFrameList & frames)
+    {
+      if (!LockReadWrite(P_DEBUG_LOCATION))
+        return 0;
+      std::vector<SendReceiveStatus> statuses;
+      OnSendData(e_RewriteSSRC, frames, statuses, PTime());
+      UnlockReadWrite(P_DEBUG_LOCATION);
+      return (unsigned)std::count(statuses.begin(), statuses.end(), e_ProcessPacket);
+    }
+};
+
+
+class Worker : public PThread
+{
+    PCLASSINFO(Worker, PThread);
+  public:
+    Worker(OpalConnection & connection, Modes mode, unsigned legs, unsigned packets, unsigned payloadSize, unsigned batch)
+      : PThread(10000, NoAutoDeleteThread, NormalPriority, "Worker")
+      , m_mode(mode)
+      , m_packets(packets)
+      , m_payloadSize(payloadSize)
+      , m_batch(std::max(batch, 1U))
+      , m_protected(0)
+      , m_failed(0)
+      , m_ok(true)
+    {
+      for (unsigned i = 0; i < legs; ++i) {
+        m_legs.push_back(new Leg(connection, i+1));
+        if (!m_legs.back()->SetKey())
+          m_ok = false;
+      }
+    }
+
+    ~Worker()
+    {
+      for (std::vector<Leg *>::iterator it = m_legs.begin(); it != m_legs.end(); ++it)
+        delete *it;
+    }
+
+    virtual void Main()
+    {
+      PRandom random;
+      RTP_DataFrame shared(m_payloadSize);
+      shared.SetPayloadType(RTP_DataFrame::DynamicBase);
+      shared.SetSyncSource(0x12345678);
+      BYTE * payload = shared.GetPayloadPtr();
+      for (unsigned i = 0; i < m_payloadSize; ++i)
+        payload[i] = (BYTE)random.Generate();
+
+      std::vector<RTP_DataFrame> frames(m_batch);
+
+      for (unsigned sn = 0; sn < m_packets; sn += m_batch) {
+        unsigned count = std::min(m_batch, m_packets - sn);
+        for (unsigned i = 0; i < count; ++i) {
+          frames[i] = shared;
+          frames[i].MakeUnique();
+          frames[i].SetSequenceNumber((RTP_SequenceNumber)(sn + i));
+          frames[i].SetTimestamp((sn + i)*3000);
+        }
+
+        for (std::vector<Leg *>::iterator leg = m_legs.begin(); leg != m_legs.end(); ++leg) {
+          switch (m_mode) {
+            case e_Copy :
+              for (unsigned i = 0; i < count; ++i) {
+                RTP_DataFrame frame = frames[i];
+                frame.MakeUnique();
+                frame.SetMinSize(frame.GetPacketSize() + SRTP_MAX_TRAILER_LEN);
+                Count((*leg)->Protect(frame));
+              }
+              break;
+
+            case e_Buffered :
+              for (unsigned i = 0; i < count; ++i) {
+                RTP_DataFrame frame = frames[i]; // Mixer output is shared with every leg
+                Count((*leg)->Protect(frame));
+              }
+              break;
+
+            default :
+            {
+              RTP_DataFrameList list;
+              for (unsigned i = 0; i < count; ++i)
+                list.Append(new RTP_DataFrame(frames[i])); // Mixer output is shared with every leg
+              unsigned ok = (*leg)->Protect(list);
+              m_protected += ok;
+              m_failed += count - ok;
+            }
+          }
+        }
+      }
+    }
+
+    void Count(bool ok)
+    {
+      if (ok)
+        ++m_protected;
+      else
+        ++m_failed;
+    }
+
+    Modes         m_mode;
+    std::vector<Leg *> m_legs;
+    unsigned      m_packets;
+    unsigned      m_payloadSize;
+    unsigned      m_batch;
+    unsigned      m_protected;
+    unsigned      m_failed;
+    bool          m_ok;
+};
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "SRTP Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "p-packets: Number of packets sent to each leg, default 20000\n"
+             "l-legs: Number of legs per thread the packets are fanned out to, default 8\n"
+             "s-size: Payload size in bytes, default 1200\n"
+             "b-batch: Number of packets protected per lock, default 8\n"
+             "t-threads: Number of threads, ideally no more than CPU cores, default 1\n"
+             "m-mode: Comma separated list of modes, copy, buffered and/or batch, default all\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned packets = args.GetOptionAs('p', 20000U);
+  unsigned legs = std::max(args.GetOptionAs('l', 8U), 1U);
+  unsigned payloadSize = std::min(args.GetOptionAs('s', 1200U), 1400U);
+  unsigned batch = std::max(args.GetOptionAs('b', 8U), 1U);
+  unsigned threads = std::max(args.GetOptionAs('t', 1U), 1U);
+  PStringArray modes = args.GetOptionString('m', "copy,buffered,batch").Tokenise(",");
+
+  OpalManager manager;
+  BenchEndPoint * endpoint = new BenchEndPoint(manager);
+  OpalCall * call = manager.InternalCreateCall();
+  if (call == NULL) {
+    cerr << "Could not create call" << endl;
+    return;
+  }
+  BenchConnection * connection = new BenchConnection(*call, *endpoint);
+
+  cout << "Protecting " << packets << " packets of " << payloadSize << " bytes to "
+       << legs << " legs, on " << threads << " threads\n"
+          "\n"
+          "Mode      Packets/s  Per core    Mbit/s  Failed\n";
+
+  for (PINDEX m = 0; m < modes.GetSize(); ++m) {
+    Modes mode = NumModes;
+    for (PINDEX i = 0; i < NumModes; ++i) {
+      if (modes[m] *= ModeNames[i])
+        mode = (Modes)i;
+    }
+    if (mode == NumModes) {
+      cerr << "Unknown mode \"" << modes[m] << '"' << endl;
+      continue;
+    }
+
+    PList<Worker> workers;
+    for (unsigned i = 0; i < threads; ++i) {
+      Worker * worker = new Worker(*connection, mode, legs, packets, payloadSize, batch);
+      if (!worker->m_ok) {
+        cerr << "Could not create SRTP sessions" << endl;
+        delete worker;
+        return;
+      }
+      workers.Append(worker);
+    }
+
+    PTime start;
+    for (PList<Worker>::iterator it = workers.begin(); it != workers.end(); ++it)
+      it->Resume();
+
+    uint64_t total = 0;
+    unsigned failed = 0;
+    for (PList<Worker>::iterator it = workers.begin(); it != workers.end(); ++it) {
+      it->WaitForTermination();
+      total += it->m_protected;
+      failed += it->m_failed;
+    }
+    PTimeInterval elapsed = PTime() - start;
+
+    double rate = total*1000.0/std::max(elapsed.GetMilliSeconds(), (PInt64)1);
+    cout << setw(8) << left << ModeNames[mode] << right
+         << fixed << setprecision(0)
+         << setw(11) << rate << ' '
+         << setw(9) << (rate/threads) << ' '
+         << setw(9) << (rate*(payloadSize+RTP_DataFrame::MinHeaderSize)*8/1000000) << ' '
+         << setw(7) << failed
+         << endl;
+  }
+
+  delete connection;
+  call->Clear();
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,165 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for video mixer compositing benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <ep/opalmixer.h>
+
+#if !OPAL_VIDEO
+  #error Cannot compile without video support
+#endif
+
+
+/* Feeds decoded participant video into a grid video mixer, as a conference
+   node does, and times the mix of each output frame. Every participant sends
+   a frame every period, as a decoder does, but only the given percentage of
+   them have content that changed, the rest are identical to their previous
+   frame, as for a static scene. At 100% motion every tile is rescaled every
+   period, which is what the mixer did before tracking changes. */
+
+static void MakeFrame(RTP_DataFrame & frame, unsigned width, unsigned height, unsigned seed)
+{
+  size_t frameBytes = PVideoFrameInfo::CalculateFrameBytes(width, height);
+  frame.SetPayloadSize(frameBytes + sizeof(PluginCodec_Video_FrameHeader));
+
+  PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)frame.GetPayloadPtr();
+  header->x = header->y = 0;
+  header->width = width;
+  header->height = height;
+
+  BYTE * data = OpalVideoFrameDataPtr(header);
+  for (size_t i = 0; i < frameBytes; ++i)
+    data[i] = (BYTE)(i/width + seed*13 + i%7);
+}
+
+
+class Test : public PProcess
+{
+    PCLASSINFO(Test, PProcess)
+  public:
+    Test();
+
+    virtual void Main();
+};
+
+
+PCREATE_PROCESS(Test);
+
+
+Test::Test()
+  : PProcess("Open Phone Abstraction Library", "Video Mixer Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_PATCH, false, false, OPAL_OEM)
+{
+}
+
+
+void Test::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "p-participants: Comma separated list of participant counts, default 4,9,16,25\n"
+             "m-motion: Comma separated list of percentage of participants with changed video, default 0,20,100\n"
+             "i-input: Input video size, default CIF\n"
+             "o-output: Output video size, default 720p\n"
+             "n-frames: Number of output frames to mix, default 300\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned inWidth, inHeight, outWidth, outHeight;
+  if (!PVideoFrameInfo::ParseSize(args.GetOptionString('i', "CIF"), inWidth, inHeight) ||
+      !PVideoFrameInfo::ParseSize(args.GetOptionString('o', "720p"), outWidth, outHeight)) {
+    cerr << "Invalid video size" << endl;
+    return;
+  }
+
+  unsigned frames = std::max(args.GetOptionAs('n', 300U), 1U);
+  PStringArray participantCounts = args.GetOptionString('p', "4,9,16,25").Tokenise(",");
+  PStringArray motions = args.GetOptionString('m', "0,20,100").Tokenise(",");
+
+  cout << "Mixing " << inWidth << 'x' << inHeight << " into " << outWidth << 'x' << outHeight << " grid\n"
+          "\n"
+          "Participants Motion %  us/frame  Changed tiles/frame\n";
+
+  PRandom random(1);
+  for (PINDEX p = 0; p < participantCounts.GetSize(); ++p) {
+    unsigned participants = std::max(participantCounts[p].AsUnsigned(), 1U);
+
+    /* Two different frames for each participant to alternate between, each
+       its own buffer, as the fill constructor would share one */
+    std::vector<RTP_DataFrame> content;
+    for (unsigned i = 0; i < participants*2; ++i) {
+      RTP_DataFrame frame;
+      MakeFrame(frame, inWidth, inHeight, i);
+      content.push_back(frame);
+    }
+
+    for (PINDEX m = 0; m < motions.GetSize(); ++m) {
+      unsigned motion = motions[m].AsUnsigned();
+
+      OpalVideoMixer mixer(OpalVideoMixer::eGrid, outWidth, outHeight, 15, false);
+      std::vector<unsigned> current(participants);
+      for (unsigned i = 0; i < participants; ++i)
+        mixer.AddStream(PString(PString::Unsigned, i));
+
+      RTP_DataFrame mixed(0, outWidth*outHeight*2);
+      PTimeInterval elapsed;
+      unsigned changedTiles = 0;
+
+      for (unsigned f = 0; f < frames; ++f) {
+        for (unsigned i = 0; i < participants; ++i) {
+          if (f == 0 || random.Generate() % 100 < motion)
+            current[i] = 1 - current[i];
+          mixer.WriteStream(PString(PString::Unsigned, i), content[i*2 + current[i]]);
+        }
+
+        PTimeInterval start = PTimer::Tick();
+        mixer.ReadMixed(mixed);
+        elapsed += PTimer::Tick() - start;
+
+        // First frame is always the whole frame
+        if (f > 0)
+          changedTiles += mixer.GetChangedRegions().size();
+      }
+
+      cout << setw(12) << participants << ' '
+           << setw(8) << motion << ' '
+           << fixed << setprecision(0)
+           << setw(9) << elapsed.GetMicroSeconds()/(double)frames << ' '
+           << setprecision(1)
+           << setw(20) << changedTiles/(double)std::max(frames-1, 1U)
+           << endl;
+    }
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -44,6 +44,61 @@ extern "C" {
 };
 
 
+/* Lookup tables for bulk conversion, the 64k entry encode tables are indexed
+   by the 16 bit linear sample as unsigned, the decode tables by the 8 bit
+   companded value. Built once at load time from the reference functions so
+   results are identical to ConvertOne(). */
+static struct G711LookupTables
+{
+  short m_ulawToLinear[256];
+  short m_alawToLinear[256];
+  BYTE  m_linearToUlaw[65536];
+  BYTE  m_linearToAlaw[65536];
+
+  G711LookupTables()
+  {
+    for (int i = 0; i < 256; ++i) {
+      m_ulawToLinear[i] = (short)ulaw2linear(i);
+      m_alawToLinear[i] = (short)alaw2linear(i);
+    }
+    for (int i = 0; i < 65536; ++i) {
+      m_linearToUlaw[i] = (BYTE)linear2ulaw((short)i);
+      m_linearToAlaw[i] = (BYTE)linear2alaw((short)i);
+    }
+  }
+} const G711Tables;
+
+
+static void G711Decode(const short * table, const BYTE * input, BYTE * output, PINDEX samples)
+{
+  short * outputWords = (short *)output;
+  PINDEX i = 0;
+  for (; i + 4 <= samples; i += 4) {
+    outputWords[i  ] = table[input[i  ]];
+    outputWords[i+1] = table[input[i+1]];
+    outputWords[i+2] = table[input[i+2]];
+    outputWords[i+3] = table[input[i+3]];
+  }
+  for (; i < samples; ++i)
+    outputWords[i] = table[input[i]];
+}
+
+
+static void G711Encode(const BYTE * table, const BYTE * input, BYTE * output, PINDEX samples)
+{
+  const unsigned short * inputWords = (const unsigned short *)input;
+  PINDEX i = 0;
+  for (; i + 4 <= samples; i += 4) {
+    output[i  ] = table[inputWords[i  ]];
+    output[i+1] = table[inputWords[i+1]];
+    output[i+2] = table[inputWords[i+2]];
+    output[i+3] = table[inputWords[i+3]];
+  }
+  for (; i < samples; ++i)
+    output[i] = table[inputWords[i]];
+}
+
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -100,6 +155,13 @@ int Opal_G711_uLaw_PCM::ConvertOne(int sample) const
 }
 
 
+bool Opal_G711_uLaw_PCM::ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples)
+{
+  G711Decode(G711Tables.m_ulawToLinear, input, output, samples);
+  return true;
+}
+
+
 int Opal_G711_uLaw_PCM::ConvertSample(int sample)
 {
   return ulaw2linear(sample);
@@ -121,6 +183,13 @@ int Opal_PCM_G711_uLaw::ConvertOne(int sample) const
 }
 
 
+bool Opal_PCM_G711_uLaw::ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples)
+{
+  G711Encode(G711Tables.m_linearToUlaw, input, output, samples);
+  return true;
+}
+
+
 int Opal_PCM_G711_uLaw::ConvertSample(int sample)
 {
   return linear2ulaw(sample);
@@ -142,6 +211,13 @@ int Opal_G711_ALaw_PCM::ConvertOne(int sample) const
 }
 
 
+bool Opal_G711_ALaw_PCM::ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples)
+{
+  G711Decode(G711Tables.m_alawToLinear, input, output, samples);
+  return true;
+}
+
+
 int Opal_G711_ALaw_PCM::ConvertSample(int sample)
 {
   return alaw2linear(sample);
@@ -162,6 +238,13 @@ int Opal_PCM_G711_ALaw::ConvertOne(int sample) const
 }
 
 
+bool Opal_PCM_G711_ALaw::ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples)
+{
+  G711Encode(G711Tables.m_linearToAlaw, input, output, samples);
+  return true;
+}
+
+
 int Opal_PCM_G711_ALaw::ConvertSample(int sample)
 {
   return linear2alaw(sample);
@@ -862,6 +862,7 @@ OpalPluginStreamedAudioTranscoder::OpalPluginStreamedAudioTranscoder(const OpalT
   comfortNoise       = (codecDef->flags & PluginCodec_ComfortNoiseMask) == PluginCodec_ComfortNoise;
   acceptEmptyPayload = (codecDef->flags & PluginCodec_EmptyPayloadMask) == PluginCodec_EmptyPayload;
   acceptOtherPayloads = (codecDef->flags & PluginCodec_OtherPayloadMask) == PluginCodec_OtherPayload;
+  m_bulkConvert = (codecDef->flags & PluginCodec_StreamedBulkMask) == PluginCodec_StreamedBulk;
 }
 
 
@@ -895,6 +896,7 @@ int OpalPluginStreamedAudioTranscoder::ConvertOne(int from) const
 
   // Note updateMutex should already be locked at this point.
 
+  // Without PluginCodec_CoderStreamedBulk even bulk plugins do one sample
   unsigned int fromLen = sizeof(from);
   int to;
   unsigned toLen = sizeof(to);
@@ -903,6 +905,26 @@ int OpalPluginStreamedAudioTranscoder::ConvertOne(int from) const
 }
 
 
+bool OpalPluginStreamedAudioTranscoder::ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples)
+{
+  if (!m_bulkConvert || context == NULL)
+    return false;
+
+  // Note updateMutex should already be locked at this point.
+
+  unsigned fromLen = (samples*inputBitsPerSample+7)/8;
+  unsigned toLen = (samples*outputBitsPerSample+7)/8;
+  unsigned flags = PluginCodec_CoderStreamedBulk;
+  if (!Transcode(input, &fromLen, output, &toLen, &flags)) {
+    PTRACE(2, "Bulk streamed transcode failed for " << samples << " samples");
+    memset(output, 0, (samples*outputBitsPerSample+7)/8);
+  }
+
+  // Output is already filled in, so never fall back to per sample
+  return true;
+}
+
+
 #if OPAL_VIDEO
 
 /////////////////////////////////////////////////////////////////////////////
@@ -983,7 +1005,8 @@ PBoolean OpalPluginVideoTranscoder::ConvertFrames(const RTP_DataFrame & src, RTP
 
 bool OpalPluginVideoTranscoder::EncodeFrames(const RTP_DataFrame & src, RTP_DataFrameList & dstList)
 {
-  dstList.RemoveAll();
+  // Previous packets have been sent by now, so buffers can be reused
+  RecycleFrames(dstList);
 
   if (src.GetPayloadSize() == 0)
     return true;
@@ -1002,7 +1025,7 @@ bool OpalPluginVideoTranscoder::EncodeFrames(const RTP_DataFrame & src, RTP_Data
   PTRACE_IF(4, foreIFrame, "I-Frame forced from video codec at frame " << m_totalFrames+1);
   do {
     // Some plug ins a very rude and use more memory than we say they can, so add an extra 1k
-    RTP_DataFrame * dst = new RTP_DataFrame((PINDEX)0, outputDataSize+1024);
+    RTP_DataFrame * dst = GetPooledFrame(outputDataSize+1024);
     dst->CopyHeader(src);
     dst->SetPayloadType(GetPayloadType(false));
 
@@ -1012,7 +1035,7 @@ bool OpalPluginVideoTranscoder::EncodeFrames(const RTP_DataFrame & src, RTP_Data
     flags = foreIFrame || m_totalFrames == 0 ? PluginCodec_CoderForceIFrame : 0;
 
     if (!Transcode((const BYTE *)src, &fromLen, dst->GetPointer(), &toLen, &flags)) {
-      delete dst;
+      RecycleFrame(dst);
       return false;
     }
 
@@ -1020,7 +1043,7 @@ bool OpalPluginVideoTranscoder::EncodeFrames(const RTP_DataFrame & src, RTP_Data
       m_lastFrameWasIFrame = true;
 
     if (toLen < RTP_DataFrame::MinHeaderSize || (PINDEX)toLen < dst->GetHeaderSize())
-      delete dst;
+      RecycleFrame(dst);
     else {
       dst->SetPayloadSize(toLen - dst->GetHeaderSize());
       dst->SetMarker((flags & PluginCodec_ReturnCoderLastFrame) != 0);
@@ -128,11 +128,67 @@ OpalVideoTranscoder::OpalVideoTranscoder(const OpalMediaFormat & inputMediaForma
   , m_frameDropRate(0)
   , m_frameDropBits(0)
   , m_lastTimestamp(UINT_MAX)
+  , m_framePoolHits(0)
+  , m_framePoolMisses(0)
 {
   acceptEmptyPayload = true;
 }
 
 
+OpalVideoTranscoder::~OpalVideoTranscoder()
+{
+  for (std::vector<RTP_DataFrame *>::iterator it = m_framePool.begin(); it != m_framePool.end(); ++it)
+    delete *it;
+}
+
+
+static const size_t MaxFramePoolSize = 256; // Enough packets for a large I-Frame
+
+RTP_DataFrame * OpalVideoTranscoder::GetPooledFrame(PINDEX bufferSize)
+{
+  if (m_framePool.empty()) {
+    ++m_framePoolMisses;
+    return new RTP_DataFrame((PINDEX)0, bufferSize);
+  }
+
+  ++m_framePoolHits;
+  RTP_DataFrame * frame = m_framePool.back();
+  m_framePool.pop_back();
+
+  // Same state as a new frame, the encoder only sets what it needs
+  frame->SetPayloadSize(0);
+  frame->SetPaddingSize(0);
+  frame->SetExtension(false);
+  frame->SetMarker(false);
+  frame->SetMinSize(bufferSize);
+  return frame;
+}
+
+
+void OpalVideoTranscoder::RecycleFrame(RTP_DataFrame * frame)
+{
+  if (frame->IsUnique() && m_framePool.size() < MaxFramePoolSize)
+    m_framePool.push_back(frame);
+  else
+    delete frame;
+}
+
+
+void OpalVideoTranscoder::RecycleFrames(RTP_DataFrameList & frames)
+{
+  if (frames.IsEmpty())
+    return;
+
+  for (RTP_DataFrameList::iterator it = frames.begin(); it != frames.end(); ++it)
+    RecycleFrame(&*it);
+
+  // Pointers are now owned by pool, so stop list deleting them
+  frames.DisallowDeleteObjects();
+  frames.RemoveAll();
+  frames.AllowDeleteObjects();
+}
+
+
 static void SetFrameBytes(const OpalMediaFormat & fmt, const PString & widthOption, const PString & heightOption, PINDEX & size)
 {
   int width  = fmt.GetOptionInteger(widthOption, PVideoFrameInfo::CIFWidth);
@@ -207,6 +263,8 @@ void OpalVideoTranscoder::GetStatistics(OpalMediaStatistics & statistics) const
 {
   OpalTranscoder::GetStatistics(statistics);
   statistics.m_droppedFrames = m_framesDropped;
+  statistics.m_framePoolHits = m_framePoolHits;
+  statistics.m_framePoolMisses = m_framePoolMisses;
 }
 #endif
 
@@ -49,6 +49,7 @@
 
 OpalIVREndPoint::OpalIVREndPoint(OpalManager & mgr, const char * prefix)
   : OpalLocalEndPoint(mgr, prefix, false)
+  , m_promptCaching(false)
 {
   SetDefaultVXML("<?xml version=\"1.0\"?>\n"
                 "<vxml version=\"1.0\">\n"
@@ -182,6 +183,8 @@ OpalIVRConnection::OpalIVRConnection(OpalCall & call,
 
   m_vxmlSession.SetCache(ep.GetTextToSpeechCache());
   m_vxmlSession.SetRecordDirectory(ep.GetRecordDirectory());
+  if (ep.GetPromptCaching())
+    m_vxmlSession.SetPromptCache(&OpalIVRPromptCache::GetInstance());
 
   PTRACE(4, "Constructed");
 }
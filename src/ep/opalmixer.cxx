@@ -36,11 +36,35 @@
 #include <opal/patch.h>
 #include <rtp/rtp.h>
 #include <rtp/jitter.h>
+#include <codec/silencedetect.h>
 #include <ptlib/vconvert.h>
 #include <ptclib/pwavfile.h>
+#include <ptclib/random.h>
 #include <sip/handlers.h>
 #include <sip/sipcon.h>
 
+#include <algorithm>
+#include <functional>
+
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define OPAL_MIXER_SSE2 1
+  #include <emmintrin.h>
+  #if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+    #define OPAL_MIXER_AVX2 1
+    #define OPAL_MIXER_AVX2_TARGET __attribute__((target("avx2")))
+    #include <immintrin.h>
+  #elif defined(_MSC_VER) && _MSC_VER >= 1700
+    #define OPAL_MIXER_AVX2 1
+    #define OPAL_MIXER_AVX2_TARGET
+    #include <immintrin.h>
+    #include <intrin.h>
+  #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #define OPAL_MIXER_NEON 1
+  #include <arm_neon.h>
+#endif
+
 
 #define DETAIL_LOG_LEVEL 6
 
@@ -89,6 +113,8 @@ OpalBaseMixer::OpalBaseMixer(bool pushThread, unsigned periodMS, unsigned period
   , m_pushFrame(NULL)
   , m_workerThread(NULL)
   , m_threadRunning(false)
+  , m_periodCount(0)
+  , m_deadlinesMissed(0)
 {
 }
 
@@ -229,8 +255,22 @@ void OpalBaseMixer::PushThreadMain()
 {
   PTRACE(4, "PushThread start " << m_periodMS << " ms");
   PAdaptiveDelay delay(500);
-  while (m_threadRunning && OnPush())
+  PTRACE_THROTTLE(throttleDeadline, 3, 10000);
+  while (m_threadRunning) {
+    PTimeInterval start = PTimer::Tick();
+    if (!OnPush())
+      break;
+
+    ++m_periodCount;
+    PTimeInterval elapsed = PTimer::Tick() - start;
+    if (elapsed > m_periodMS) {
+      ++m_deadlinesMissed;
+      PTRACE(throttleDeadline, "Period deadline missed: took " << elapsed
+             << " for " << m_periodMS << "ms period, missed=" << m_deadlinesMissed << '/' << m_periodCount);
+    }
+
     delay.Delay(m_periodMS);
+  }
 
   PTRACE(4, "PushThread end");
 }
@@ -255,6 +295,222 @@ bool OpalBaseMixer::OnMixed(RTP_DataFrame * & /*mixed*/)
 
 /////////////////////////////////////////////////////////////////////////////
 
+static const int MaxMixedSample = 32765;
+static const int SpeakerHysteresisDB = 6;
+
+
+static void ScalarAccumulate(int * mixed, const short * samples, unsigned count)
+{
+  for (unsigned i = 0; i < count; ++i)
+    mixed[i] += samples[i];
+}
+
+
+static void ScalarSubtractAndClip(short * output, const int * mixed, const short * subtract, unsigned count)
+{
+  for (unsigned i = 0; i < count; ++i) {
+    int value = mixed[i];
+    if (subtract != NULL)
+      value -= subtract[i];
+    if (value < -MaxMixedSample)
+      value = -MaxMixedSample;
+    else if (value > MaxMixedSample)
+      value = MaxMixedSample;
+    output[i] = (short)value;
+  }
+}
+
+
+#if OPAL_MIXER_SSE2
+
+static void SSE2Accumulate(int * mixed, const short * samples, unsigned count)
+{
+  unsigned i = 0;
+  for (; i+8 <= count; i += 8) {
+    __m128i in = _mm_loadu_si128((const __m128i *)(samples+i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+    _mm_storeu_si128((__m128i *)(mixed+i),   _mm_add_epi32(_mm_loadu_si128((const __m128i *)(mixed+i)),   lo));
+    _mm_storeu_si128((__m128i *)(mixed+i+4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(mixed+i+4)), hi));
+  }
+  ScalarAccumulate(mixed+i, samples+i, count-i);
+}
+
+
+static void SSE2SubtractAndClip(short * output, const int * mixed, const short * subtract, unsigned count)
+{
+  const __m128i minSample = _mm_set1_epi16(-MaxMixedSample);
+  const __m128i maxSample = _mm_set1_epi16(MaxMixedSample);
+
+  unsigned i = 0;
+  for (; i+8 <= count; i += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(mixed+i));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(mixed+i+4));
+    if (subtract != NULL) {
+      __m128i in = _mm_loadu_si128((const __m128i *)(subtract+i));
+      lo = _mm_sub_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+      hi = _mm_sub_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+    }
+    // Saturating pack to 16 bits, then clip to the slightly smaller range
+    __m128i out = _mm_packs_epi32(lo, hi);
+    out = _mm_min_epi16(_mm_max_epi16(out, minSample), maxSample);
+    _mm_storeu_si128((__m128i *)(output+i), out);
+  }
+  ScalarSubtractAndClip(output+i, mixed+i, subtract != NULL ? subtract+i : NULL, count-i);
+}
+
+#endif // OPAL_MIXER_SSE2
+
+
+#if OPAL_MIXER_AVX2
+
+OPAL_MIXER_AVX2_TARGET
+static void AVX2Accumulate(int * mixed, const short * samples, unsigned count)
+{
+  unsigned i = 0;
+  for (; i+16 <= count; i += 16) {
+    __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samples+i)));
+    __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samples+i+8)));
+    _mm256_storeu_si256((__m256i *)(mixed+i),   _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(mixed+i)),   lo));
+    _mm256_storeu_si256((__m256i *)(mixed+i+8), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(mixed+i+8)), hi));
+  }
+  ScalarAccumulate(mixed+i, samples+i, count-i);
+}
+
+
+OPAL_MIXER_AVX2_TARGET
+static void AVX2SubtractAndClip(short * output, const int * mixed, const short * subtract, unsigned count)
+{
+  const __m256i minSample = _mm256_set1_epi16(-MaxMixedSample);
+  const __m256i maxSample = _mm256_set1_epi16(MaxMixedSample);
+
+  unsigned i = 0;
+  for (; i+16 <= count; i += 16) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)(mixed+i));
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(mixed+i+8));
+    if (subtract != NULL) {
+      lo = _mm256_sub_epi32(lo, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(subtract+i))));
+      hi = _mm256_sub_epi32(hi, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(subtract+i+8))));
+    }
+    // Pack works within 128 bit lanes, so need to put the quad words back in order
+    __m256i out = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+    out = _mm256_min_epi16(_mm256_max_epi16(out, minSample), maxSample);
+    _mm256_storeu_si256((__m256i *)(output+i), out);
+  }
+  ScalarSubtractAndClip(output+i, mixed+i, subtract != NULL ? subtract+i : NULL, count-i);
+}
+
+
+static bool IsAVX2Supported()
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) // OSXSAVE and OS saves YMM
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // OPAL_MIXER_AVX2
+
+
+#if OPAL_MIXER_NEON
+
+static void NEONAccumulate(int * mixed, const short * samples, unsigned count)
+{
+  unsigned i = 0;
+  for (; i+8 <= count; i += 8) {
+    int16x8_t in = vld1q_s16(samples+i);
+    vst1q_s32(mixed+i,   vaddq_s32(vld1q_s32(mixed+i),   vmovl_s16(vget_low_s16(in))));
+    vst1q_s32(mixed+i+4, vaddq_s32(vld1q_s32(mixed+i+4), vmovl_s16(vget_high_s16(in))));
+  }
+  ScalarAccumulate(mixed+i, samples+i, count-i);
+}
+
+
+static void NEONSubtractAndClip(short * output, const int * mixed, const short * subtract, unsigned count)
+{
+  const int16x8_t minSample = vdupq_n_s16(-MaxMixedSample);
+  const int16x8_t maxSample = vdupq_n_s16(MaxMixedSample);
+
+  unsigned i = 0;
+  for (; i+8 <= count; i += 8) {
+    int32x4_t lo = vld1q_s32(mixed+i);
+    int32x4_t hi = vld1q_s32(mixed+i+4);
+    if (subtract != NULL) {
+      int16x8_t in = vld1q_s16(subtract+i);
+      lo = vsubq_s32(lo, vmovl_s16(vget_low_s16(in)));
+      hi = vsubq_s32(hi, vmovl_s16(vget_high_s16(in)));
+    }
+    int16x8_t out = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+    vst1q_s16(output+i, vminq_s16(vmaxq_s16(out, minSample), maxSample));
+  }
+  ScalarSubtractAndClip(output+i, mixed+i, subtract != NULL ? subtract+i : NULL, count-i);
+}
+
+#endif // OPAL_MIXER_NEON
+
+
+const OpalAudioMixer::MixKernels * OpalAudioMixer::GetMixKernels(MixKernelTypes type)
+{
+  static const MixKernels ScalarKernels = { "Scalar", ScalarAccumulate, ScalarSubtractAndClip };
+#if OPAL_MIXER_SSE2
+  static const MixKernels SSE2Kernels = { "SSE2", SSE2Accumulate, SSE2SubtractAndClip };
+#endif
+#if OPAL_MIXER_AVX2
+  static const MixKernels AVX2Kernels = { "AVX2", AVX2Accumulate, AVX2SubtractAndClip };
+  static const bool AVX2Supported = IsAVX2Supported();
+#endif
+#if OPAL_MIXER_NEON
+  static const MixKernels NEONKernels = { "NEON", NEONAccumulate, NEONSubtractAndClip };
+#endif
+
+  switch (type) {
+    case e_ScalarKernels :
+      return &ScalarKernels;
+#if OPAL_MIXER_SSE2
+    case e_SSE2Kernels :
+      return &SSE2Kernels;
+#endif
+#if OPAL_MIXER_AVX2
+    case e_AVX2Kernels :
+      return AVX2Supported ? &AVX2Kernels : NULL;
+#endif
+#if OPAL_MIXER_NEON
+    case e_NEONKernels :
+      return &NEONKernels;
+#endif
+    default :
+      return NULL;
+  }
+}
+
+
+static const OpalAudioMixer::MixKernels & SelectMixKernels()
+{
+  for (int type = OpalAudioMixer::NumMixKernelTypes-1; type > OpalAudioMixer::e_ScalarKernels; --type) {
+    const OpalAudioMixer::MixKernels * kernels = OpalAudioMixer::GetMixKernels((OpalAudioMixer::MixKernelTypes)type);
+    if (kernels != NULL) {
+      PTRACE(4, "Using " << kernels->m_name << " audio mixing kernels");
+      return *kernels;
+    }
+  }
+  return *OpalAudioMixer::GetMixKernels(OpalAudioMixer::e_ScalarKernels);
+}
+
+
+const OpalAudioMixer::MixKernels & OpalAudioMixer::GetMixKernels()
+{
+  static const MixKernels & best = SelectMixKernels();
+  return best;
+}
+
+
 OpalAudioMixer::OpalAudioMixer(bool stereo,
                            unsigned sampleRate,
                                bool pushThread,
@@ -264,6 +520,9 @@ OpalAudioMixer::OpalAudioMixer(bool stereo,
   , m_sampleRate(sampleRate)
   , m_left(NULL)
   , m_right(NULL)
+  , m_topSpeakers(0)
+  , m_trackActiveSpeaker(false)
+  , m_activeSpeakerChanges(0)
 {
   m_mixedAudio.resize(m_periodTS);
 }
@@ -365,21 +624,89 @@ bool OpalAudioMixer::SetJitterBufferSize(const Key_T & key, const OpalJitterBuff
 }
 
 
+void OpalAudioMixer::SetTopSpeakers(unsigned count)
+{
+  PWaitAndSignal mutex(m_mutex);
+  m_topSpeakers = count;
+  PTRACE(4, "Top speakers set to " << count);
+}
+
+
+void OpalAudioMixer::SetActiveSpeakerTracking(bool enable)
+{
+  PWaitAndSignal mutex(m_mutex);
+  m_trackActiveSpeaker = enable;
+  PTRACE(4, "Active speaker tracking " << (enable ? "enabled" : "disabled"));
+}
+
+
+OpalBaseMixer::Key_T OpalAudioMixer::GetActiveSpeaker() const
+{
+  PWaitAndSignal mutex(m_mutex);
+  return m_activeSpeaker;
+}
+
+
 void OpalAudioMixer::PreMixStreams()
 {
   // Expected to already be mutexed
 
-  size_t streamCount = m_inputStreams.size();
-  const short ** buffers = (const short **)alloca(streamCount*sizeof(short *));
+  std::fill(m_mixedAudio.begin(), m_mixedAudio.end(), 0);
+  if (m_mixedAudio.empty())
+    return;
 
-  size_t i = 0;
-  for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter, ++i)
-    buffers[i] = ((AudioStream *)iter->second)->GetAudioDataPtr();
+  const MixKernels & kernels = GetMixKernels();
 
-  for (unsigned samp = 0; samp < m_periodTS; ++samp) {
-    m_mixedAudio[samp] = 0;
-    for (size_t strm = 0; strm < streamCount; ++strm)
-      m_mixedAudio[samp] += *(buffers[strm])++;
+  bool mixAll = m_topSpeakers == 0 || m_topSpeakers >= m_inputStreams.size();
+  if (mixAll && !m_trackActiveSpeaker) {
+    for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter) {
+      AudioStream & stream = *(AudioStream *)iter->second;
+      kernels.m_accumulate(&m_mixedAudio[0], stream.GetAudioDataPtr(), m_periodTS);
+      stream.m_speaking = true;
+    }
+    return;
+  }
+
+  // Must collect every stream, so input queues drain, then mix the loudest
+  m_speakerLevels.clear();
+  const Key_T * loudest = NULL;
+  int loudestLevel = OpalSilenceDetector::MinAudioLevel;
+  for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter) {
+    AudioStream & stream = *(AudioStream *)iter->second;
+    stream.GetAudioDataPtr();
+    int level = stream.GetAudioLevel();
+    if (level > OpalSilenceDetector::MinAudioLevel)
+      m_speakerLevels.push_back(std::make_pair(stream.m_speaking ? level+SpeakerHysteresisDB : level, &stream));
+    stream.m_speaking = false;
+
+    if (iter->first == m_activeSpeaker)
+      level += SpeakerHysteresisDB;
+    if (level > loudestLevel) {
+      loudestLevel = level;
+      loudest = &iter->first;
+    }
+  }
+
+  if (m_trackActiveSpeaker && loudest != NULL && *loudest != m_activeSpeaker) {
+    PTRACE(4, "Active speaker changed from \"" << m_activeSpeaker << "\" to \"" << *loudest << '"');
+    m_activeSpeaker = *loudest;
+    ++m_activeSpeakerChanges;
+  }
+
+  if (mixAll) {
+    for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter) {
+      AudioStream & stream = *(AudioStream *)iter->second;
+      kernels.m_accumulate(&m_mixedAudio[0], stream.m_cacheSamples, m_periodTS);
+      stream.m_speaking = true;
+    }
+    return;
+  }
+
+  SpeakerLevels::iterator last = m_speakerLevels.begin() + std::min((size_t)m_topSpeakers, m_speakerLevels.size());
+  std::partial_sort(m_speakerLevels.begin(), last, m_speakerLevels.end(), std::greater<SpeakerLevels::value_type>());
+  for (SpeakerLevels::iterator it = m_speakerLevels.begin(); it != last; ++it) {
+    kernels.m_accumulate(&m_mixedAudio[0], it->second->m_cacheSamples, m_periodTS);
+    it->second->m_speaking = true;
   }
 }
 
@@ -435,17 +762,8 @@ void OpalAudioMixer::MixAdditive(RTP_DataFrame & frame, const short * audioToSub
   if (size == 0)
     frame.SetTimestamp(m_outputTimestamp);
 
-  short * dst = (short *)(frame.GetPayloadPtr()+size);
-  for (unsigned i = 0; i < m_periodTS; ++i) {
-    int value = m_mixedAudio[i];
-    if (audioToSubtract != NULL)
-      value -= *audioToSubtract++;
-    if (value < -32765)
-      value = -32765;
-    else if (value > 32765)
-      value = 32765;
-    *dst++ = (short)value;
-  }
+  if (m_periodTS > 0)
+    GetMixKernels().m_subtractAndClip((short *)(frame.GetPayloadPtr()+size), &m_mixedAudio[0], audioToSubtract, m_periodTS);
 }
 
 
@@ -461,6 +779,8 @@ OpalAudioMixer::AudioStream::AudioStream(OpalAudioMixer & mixer)
   , m_nextTimestamp(0)
   , m_cacheSamples(mixer.GetPeriodTS())
   , m_samplesUsed(0)
+  , m_headerLevel(INT_MAX)
+  , m_speaking(true)
 {
 }
 
@@ -504,6 +824,10 @@ const short * OpalAudioMixer::AudioStream::GetAudioDataPtr()
 
     memcpy(cachePtr, ((const short *)m_queue.front().GetPayloadPtr())+m_samplesUsed, samplesToCopy*sizeof(short));
 
+    int level = m_queue.front().GetMetaData().m_audioLevel;
+    if (level != INT_MAX && (m_headerLevel == INT_MAX || level > m_headerLevel))
+      m_headerLevel = level;
+
     cachePtr += samplesToCopy;
     samplesLeft -= samplesToCopy;
     m_nextTimestamp += samplesToCopy;
@@ -524,6 +848,18 @@ const short * OpalAudioMixer::AudioStream::GetAudioDataPtr()
 }
 
 
+int OpalAudioMixer::AudioStream::GetAudioLevel()
+{
+  // Use level from RTP header extension, if we have it, else work it out
+  int level = m_headerLevel;
+  m_headerLevel = INT_MAX;
+  if (level != INT_MAX)
+    return level;
+
+  return OpalSilenceDetector::CalculateDB().Accumulate(m_cacheSamples, m_mixer.GetPeriodTS()*sizeof(short)).Finalise();
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 #if OPAL_VIDEO
@@ -535,6 +871,7 @@ OpalVideoMixer::OpalVideoMixer(Styles style, unsigned width, unsigned height, un
   , m_bgFillGreen(0)
   , m_bgFillBlue(0)
   , m_lastStreamCount(0)
+  , m_frameStoreFilled(true)
 {
   SetFrameSize(width, height);
 }
@@ -564,6 +901,7 @@ bool OpalVideoMixer::SetFrameSize(unsigned width, unsigned height)
   PColourConverter::FillYUV420P(0, 0, m_width, m_height, m_width, m_height,
                                 m_frameStore.GetPointer(PVideoFrameInfo::CalculateFrameBytes(m_width, m_height)),
                                 m_bgFillRed, m_bgFillGreen, m_bgFillBlue);
+  m_frameStoreFilled = true;
 
   m_mutex.Signal();
   return true;
@@ -603,12 +941,17 @@ bool OpalVideoMixer::MixVideo()
   w &= 0xfffffffc;
   h &= 0xfffffffc;
 
+  m_changedRegions.clear();
+  if (m_frameStoreFilled)
+    m_changedRegions.push_back(Region(0, 0, m_width, m_height));
+
   for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter) {
     InsertVideoFrame(iter, x, y, w, h);
     if (!NextMix(x, y, w, h, left))
       break;
   }
 
+  m_frameStoreFilled = false;
   return true;
 }
 
@@ -652,6 +995,7 @@ bool OpalVideoMixer::StartMix(unsigned & x, unsigned & y, unsigned & w, unsigned
                                       m_frameStore.GetPointer(),
                                       m_bgFillRed, m_bgFillGreen, m_bgFillBlue);
         m_lastStreamCount = m_inputStreams.size();
+        m_frameStoreFilled = true;
       }
       switch (m_lastStreamCount) {
         case 0:
@@ -732,28 +1076,68 @@ void OpalVideoMixer::VideoStream::QueuePacket(const RTP_DataFrame & rtp)
 }
 
 
+static bool SameVideo(const RTP_DataFrame & frame1, const RTP_DataFrame & frame2)
+{
+  if (frame1.GetPayloadSize() != frame2.GetPayloadSize())
+    return false;
+
+  const PluginCodec_Video_FrameHeader * header1 = (const PluginCodec_Video_FrameHeader *)frame1.GetPayloadPtr();
+  const PluginCodec_Video_FrameHeader * header2 = (const PluginCodec_Video_FrameHeader *)frame2.GetPayloadPtr();
+  return header1->width == header2->width &&
+         header1->height == header2->height &&
+         memcmp(OpalVideoFrameDataPtr(header1), OpalVideoFrameDataPtr(header2),
+                PVideoFrameInfo::CalculateFrameBytes(header1->width, header1->height)) == 0;
+}
+
+
 void OpalVideoMixer::VideoStream::InsertVideoFrame(unsigned x, unsigned y, unsigned w, unsigned h)
 {
-  if (m_queue.empty())
-    return;
+  /* A new frame, which is often identical to the last one from decoders of
+     static scenes, only needs scaling if the content changed. */
+  bool changed = false;
+  if (!m_queue.empty()) {
+    if (!SameVideo(m_queue.front(), m_lastFrame)) {
+      m_lastFrame.Copy(m_queue.front()); // Source buffer may be reused for the next frame
+      changed = true;
+    }
+
+    /* To avoid continual build up of frames in queue if input frame rate
+       greater than mixer frame, we flush the queue, but keep one to allow for
+       slight mismatches in timing when frame rates are identical. */
+    do {
+      m_queue.pop();
+    } while (m_queue.size() > 1);
+  }
+
+  if (m_lastFrame.GetPayloadSize() < (PINDEX)sizeof(PluginCodec_Video_FrameHeader))
+    return; // Nothing received yet
+
+  bool resized = m_tileRegion.m_width != w || m_tileRegion.m_height != h;
+  if (!changed && !resized && !m_mixer.m_frameStoreFilled && m_tileRegion.m_x == x && m_tileRegion.m_y == y)
+    return; // Tile in frame store is still correct
+
+  BYTE * tile = m_tile.GetPointer(PVideoFrameInfo::CalculateFrameBytes(w, h));
+  if (changed || resized) {
+    const PluginCodec_Video_FrameHeader * header = (const PluginCodec_Video_FrameHeader *)m_lastFrame.GetPayloadPtr();
 
-  PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)m_queue.front().GetPayloadPtr();
+    PTRACE(DETAIL_LOG_LEVEL, "Scaling video: " << header->width << 'x' << header->height
+           << " -> " << x << ',' << y << '/' << w << 'x' << h);
 
-  PTRACE(DETAIL_LOG_LEVEL, "Copying video: " << header->width << 'x' << header->height
-         << " -> " << x << ',' << y << '/' << w << 'x' << h);
+    PColourConverter::CopyYUV420P(0, 0, header->width, header->height,
+                                  header->width, header->height, OpalVideoFrameDataPtr(header),
+                                  0, 0, w, h,
+                                  w, h, tile,
+                                  PVideoFrameInfo::eScale);
+  }
 
-  PColourConverter::CopyYUV420P(0, 0, header->width, header->height,
-                                header->width, header->height, OpalVideoFrameDataPtr(header),
+  PColourConverter::CopyYUV420P(0, 0, w, h, w, h, tile,
                                 x, y, w, h,
                                 m_mixer.m_width, m_mixer.m_height, m_mixer.m_frameStore.GetPointer(),
                                 PVideoFrameInfo::eScale);
 
-  /* To avoid continual build up of frames in queue if input frame rate
-     greater than mixer frame, we flush the queue, but keep one to allow for
-     slight mismatches in timing when frame rates are identical. */
-  do {
-    m_queue.pop();
-  } while (m_queue.size() > 1);
+  m_tileRegion = Region(x, y, w, h);
+  if (!m_mixer.m_frameStoreFilled) // Already have whole frame if filled
+    m_mixer.m_changedRegions.push_back(m_tileRegion);
 }
 
 
@@ -1140,8 +1524,11 @@ OpalMixerMediaStream::OpalMixerMediaStream(OpalConnection & conn,
      connections. */
   if (IsSink()) {
 #if OPAL_VIDEO
-    if (m_mediaFormat.GetMediaType() == OpalMediaType::Video())
-      m_mediaFormat = OpalYUV420P;
+    if (m_mediaFormat.GetMediaType() == OpalMediaType::Video()) {
+      // Unless forwarding, where we want the encoded video as is
+      if (!m_node->GetNodeInfo().m_videoForwarding)
+        m_mediaFormat = OpalYUV420P;
+    }
     else
 #endif
       m_mediaFormat = OpalPCM16;
@@ -1219,6 +1606,22 @@ bool OpalMixerMediaStream::InternalSetJitterBuffer(const OpalJitterBuffer::Init
 }
 
 
+bool OpalMixerMediaStream::InternalExecuteCommand(const OpalMediaCommand & command)
+{
+#if OPAL_VIDEO
+  // With forwarding there is no encoder in our patch to do this
+  if (IsSource() &&
+      m_node->GetNodeInfo().m_videoForwarding &&
+      dynamic_cast<const OpalVideoUpdatePicture *>(&command) != NULL) {
+    m_node->OnVideoUpdatePicture(*this);
+    return true;
+  }
+#endif
+
+  return OpalMediaStream::InternalExecuteCommand(command);
+}
+
+
 #if OPAL_VIDEO
 bool OpalMixerMediaStream::CheckMixedVideoSize(unsigned width, unsigned height)
 {
@@ -1240,9 +1643,20 @@ OpalMixerNode::OpalMixerNode(OpalMixerNodeManager & manager,
   , m_info(info != NULL ? info : new OpalMixerNodeInfo)
   , m_shuttingDown(false)
   , m_audioMixer(manager.CreateAudioMixer(*m_info))
+#if OPAL_VIDEO
+  , m_activeSpeakerChanges(0)
+#endif
 {
   PTRACE_CONTEXT_ID_NEW();
 
+  if (m_audioMixer != NULL) {
+    m_audioMixer->SetExecutor(manager.GetManager().GetMediaPatchExecutor());
+#if OPAL_VIDEO
+    if (m_info->m_videoForwarding)
+      m_audioMixer->SetActiveSpeakerTracking(true);
+#endif
+  }
+
   m_connections.DisallowDeleteObjects();
 
   AddName(m_info->m_name);
@@ -1283,6 +1697,10 @@ void OpalMixerNode::ShutDown()
     for (VideoMixerMap::iterator it = m_videoMixers.begin(); it != m_videoMixers.end(); ++it)
       delete it->second;
     m_videoMixers.clear();
+    m_forwarderById.clear();
+    for (VideoForwarderMap::iterator it = m_videoForwarders.begin(); it != m_videoForwarders.end(); ++it)
+      delete it->second;
+    m_videoForwarders.clear();
 #endif
     m_manager.RemoveNodeNames(GetNames());
     m_names.RemoveAll();
@@ -1294,6 +1712,21 @@ void OpalMixerNode::ShutDown()
 }
 
 
+unsigned OpalMixerNode::GetDeadlinesMissed() const
+{
+  PSafeLockReadOnly lock(*this);
+  if (!lock.IsLocked())
+    return 0;
+
+  unsigned missed = m_audioMixer != NULL ? m_audioMixer->GetDeadlinesMissed() : 0;
+#if OPAL_VIDEO
+  for (VideoMixerMap::const_iterator it = m_videoMixers.begin(); it != m_videoMixers.end(); ++it)
+    missed += it->second->GetDeadlinesMissed();
+#endif
+  return missed;
+}
+
+
 void OpalMixerNode::PrintOn(ostream & strm) const
 {
   char prevfill = strm.fill();
@@ -1388,12 +1821,28 @@ bool OpalMixerNode::AttachStream(OpalMixerMediaStream * stream)
 #if OPAL_VIDEO
   if (stream->GetMediaFormat().GetMediaType() == OpalMediaType::Video()) {
     OpalVideoFormat::ContentRole role = stream->GetMediaFormat().GetOptionEnum(OpalVideoFormat::ContentRoleOption(), OpalVideoFormat::eNoRole);
+
+    if (m_info->m_videoForwarding) {
+      OpalVideoForwarder * & forwarder = m_videoForwarders[role];
+      if (forwarder == NULL)
+        forwarder = new OpalVideoForwarder();
+
+      m_forwarderById[id] = forwarder;
+
+      if (stream->IsSink())
+        forwarder->AddSender(stream);
+      else
+        forwarder->AddListener(stream);
+      return true;
+    }
+
     OpalVideoStreamMixer * videoMixer;
     VideoMixerMap::iterator it = m_videoMixers.find(role);
     if (it != m_videoMixers.end())
       videoMixer = it->second;
     else {
       videoMixer = m_manager.CreateVideoMixer(*m_info);
+      videoMixer->SetExecutor(m_manager.GetManager().GetMediaPatchExecutor());
       m_videoMixers[role] = videoMixer;
     }
 
@@ -1427,6 +1876,16 @@ void OpalMixerNode::DetachStream(OpalMixerMediaStream * stream)
 
 #if OPAL_VIDEO
   if (stream->GetMediaFormat().GetMediaType() == OpalMediaType::Video()) {
+    ForwarderByIdMap::iterator fwd = m_forwarderById.find(id);
+    if (fwd != m_forwarderById.end()) {
+      if (stream->IsSource())
+        fwd->second->RemoveListener(id);
+      else
+        fwd->second->RemoveSender(id);
+      m_forwarderById.erase(fwd);
+      return;
+    }
+
     VideoMixerMap::iterator it = m_videoMixers.find(stream->GetMediaFormat().GetOptionEnum(OpalVideoFormat::ContentRoleOption(), OpalVideoFormat::eNoRole));
     if (it == m_videoMixers.end())
       return;
@@ -1489,10 +1948,70 @@ bool OpalMixerNode::WritePacket(const OpalMixerMediaStream & stream, const RTP_D
 {
   PString id = stream.GetID();
   MixerByIdMap::iterator it = m_mixerById.find(id);
-  return it == m_mixerById.end() || it->second->WriteStream(id, input);
+  if (it != m_mixerById.end())
+    return it->second->WriteStream(id, input);
+
+#if OPAL_VIDEO
+  ForwarderByIdMap::iterator fwd = m_forwarderById.find(id);
+  if (fwd != m_forwarderById.end()) {
+    CheckActiveSpeaker();
+    return fwd->second->WritePacket(id, input);
+  }
+#endif
+
+  return true;
 }
 
 
+#if OPAL_VIDEO
+void OpalMixerNode::CheckActiveSpeaker()
+{
+  if (m_audioMixer == NULL)
+    return;
+
+  unsigned changes = m_audioMixer->GetActiveSpeakerChanges();
+  if (m_activeSpeakerChanges.exchange(changes) == changes)
+    return;
+
+  // Rarely happens, so a search for the connection with the audio stream is OK
+  PString audioId = m_audioMixer->GetActiveSpeaker();
+  for (PSafePtr<OpalConnection> connection(m_connections, PSafeReference); connection != NULL; ++connection) {
+    if (connection->GetMediaStream(audioId, false) != NULL) {
+      for (VideoForwarderMap::iterator it = m_videoForwarders.begin(); it != m_videoForwarders.end(); ++it)
+        it->second->SelectSender(connection->GetToken(), false);
+      break;
+    }
+  }
+}
+
+
+void OpalMixerNode::SelectVideoSender(const PString & connectionToken)
+{
+  PSafeLockReadOnly lock(*this);
+  if (!lock.IsLocked())
+    return;
+
+  for (VideoForwarderMap::iterator it = m_videoForwarders.begin(); it != m_videoForwarders.end(); ++it)
+    it->second->SelectSender(connectionToken, true);
+
+  // Back to the active speaker
+  if (connectionToken.IsEmpty() && m_audioMixer != NULL) {
+    m_activeSpeakerChanges = m_audioMixer->GetActiveSpeakerChanges() - 1;
+    CheckActiveSpeaker();
+  }
+}
+
+
+void OpalMixerNode::OnVideoUpdatePicture(const OpalMixerMediaStream & stream)
+{
+  PString id = stream.GetID();
+  ForwarderByIdMap::iterator it = m_forwarderById.find(id);
+  if (it != m_forwarderById.end())
+    it->second->OnVideoUpdatePicture(id);
+}
+#endif
+
+
 void OpalMixerNode::BroadcastUserInput(const OpalConnection * connection, const PString & value)
 {
   for (PSafePtr<OpalConnection> conn(m_connections, PSafeReference); conn != NULL; ++conn) {
@@ -1707,10 +2226,12 @@ void OpalMediaStreamMixer::CloseOne(const PSafePtr<OpalMixerMediaStream> & strea
 
 OpalAudioStreamMixer::OpalAudioStreamMixer(const OpalMixerNodeInfo & info)
   : OpalAudioMixer(false, info.m_sampleRate)
+  , m_executor(NULL)
 #if OPAL_MIXER_AUDIO_DEBUG
   , m_audioDebug(new PAudioMixerDebug(info.m_name))
 #endif
 {
+  m_topSpeakers = info.m_topSpeakers;
 }
 
 
@@ -1812,30 +2333,95 @@ void OpalAudioStreamMixer::PushOne(PSafePtr<OpalMixerMediaStream> & stream,
 }
 
 
+struct OpalAudioStreamMixer::PushBatch : public OpalMediaPatchExecutor::Batch
+{
+  PushBatch(OpalAudioStreamMixer & mixer, PushGroupMap & groups)
+    : m_mixer(mixer)
+  {
+    for (PushGroupMap::iterator it = groups.begin(); it != groups.end(); ++it)
+      m_groups.push_back(&it->second);
+  }
+
+  virtual void RunJob(unsigned index)
+  {
+    m_mixer.PushGroupEntries(*m_groups[index]);
+  }
+
+  OpalAudioStreamMixer   & m_mixer;
+  std::vector<PushGroup *> m_groups;
+};
+
+
+void OpalAudioStreamMixer::PushGroupEntries(PushGroup & group)
+{
+  for (std::vector<PushEntry>::iterator it = group.m_entries.begin(); it != group.m_entries.end(); ++it) {
+    PSafePtr<OpalMixerMediaStream> stream = it->m_stream;
+    it->m_stream.SetNULL(); // Make sure last reference is released on this thread
+    if (!stream.SetSafetyMode(PSafeReadOnly))
+      continue;
+
+    m_mutex.Wait(); // Signal() call for this mutex is inside PushOne()
+
+    // Participant may have left since grouping, in which case nothing to subtract
+    const short * audioToSubtract = NULL;
+    if (!it->m_inputKey.IsEmpty()) {
+      StreamMap_T::iterator inputStream = m_inputStreams.find(it->m_inputKey);
+      if (inputStream != m_inputStreams.end())
+        audioToSubtract = ((AudioStream *)inputStream->second)->m_cacheSamples;
+    }
+
+    PushOne(stream, *group.m_cache, audioToSubtract);
+  }
+}
+
+
 bool OpalAudioStreamMixer::OnPush()
 {
   MIXER_DEBUG_OUT(PTimer::Tick().GetMilliSeconds() << ',' << m_outputTimestamp << ',');
 
+  /* Group the output streams by the cache they use, each group is a
+     separate mix, transcode and write that is independent of the others. */
+  PushGroupMap groups;
+
   m_mutex.Wait();
   PreMixStreams();
-  m_mutex.Signal();
 
   for (StreamDict::iterator it = m_outputStreams.begin(); it != m_outputStreams.end(); ++it) {
     PSafePtr<OpalMixerMediaStream> stream = it->second;
-    m_mutex.Wait(); // Signal() call for this mutex is inside PushOne()
+    stream.SetSafetyMode(PSafeReference);
 
-    // Check for full participant, so can subtract their signal
+    PString cacheKey;
+    Key_T inputKey;
+
+    // Check for full participant currently in the mix, so can subtract their signal
     StreamMap_T::iterator inputStream = m_inputStreams.find(it->first);
-    if (inputStream != m_inputStreams.end())
-      PushOne(stream, m_cache[stream->GetID()], ((AudioStream *)inputStream->second)->m_cacheSamples);
+    if (inputStream != m_inputStreams.end() && ((AudioStream *)inputStream->second)->m_speaking) {
+      cacheKey = stream->GetID();
+      inputKey = it->first;
+    }
     else {
-      // Listen only participant, can use cached encoded audio
-      PString encodedFrameKey = stream->GetMediaFormat();
-      encodedFrameKey.sprintf(":%u", stream->GetDataSize());
-      PushOne(stream, m_cache[encodedFrameKey], NULL);
+      // Listen only participant, or not speaking, can use cached encoded audio
+      cacheKey = stream->GetMediaFormat();
+      cacheKey.sprintf(":%u", stream->GetDataSize());
     }
+
+    PushGroup & group = groups[cacheKey];
+    if (group.m_cache == NULL)
+      group.m_cache = &m_cache[cacheKey];
+    group.m_entries.push_back(PushEntry(stream, inputKey));
   }
 
+  m_mutex.Signal();
+
+#if OPAL_MIXER_AUDIO_DEBUG
+  OpalMediaPatchExecutor * executor = NULL; // Debug output is not thread safe
+#else
+  OpalMediaPatchExecutor * executor = m_executor;
+#endif
+  // All groups must be complete before the period can end
+  PushBatch batch(*this, groups);
+  batch.Run(executor, batch.m_groups.size());
+
   for (std::map<PString, CachedAudio>::iterator iterCache = m_cache.begin(); iterCache != m_cache.end(); ++iterCache) {
     switch (iterCache->second.m_state) {
       case CachedAudio::Collected :
@@ -1879,6 +2465,8 @@ OpalAudioStreamMixer::CachedAudio::~CachedAudio()
 #if OPAL_VIDEO
 OpalVideoStreamMixer::OpalVideoStreamMixer(const OpalMixerNodeInfo & info)
   : OpalVideoMixer(info.m_style, info.m_width, info.m_height, info.m_rate)
+  , m_executor(NULL)
+  , m_mixCount(0)
 {
 }
 
@@ -1886,6 +2474,23 @@ OpalVideoStreamMixer::OpalVideoStreamMixer(const OpalMixerNodeInfo & info)
 OpalVideoStreamMixer::~OpalVideoStreamMixer()
 {
   StopPushThread();
+
+#if PTRACING
+  if (PTrace::CanTrace(3)) {
+    EncodeStatisticsMap statistics;
+    GetEncodeStatistics(statistics);
+    for (EncodeStatisticsMap::iterator it = statistics.begin(); it != statistics.end(); ++it) {
+      if (it->second.m_frames > 0)
+        PTRACE(3, "Encoded " << it->first << ": frames=" << it->second.m_frames
+               << " avg=" << it->second.m_total.GetMicroSeconds()/it->second.m_frames << "us"
+               << " max=" << it->second.m_maximum
+               << " overruns=" << it->second.m_overruns);
+    }
+  }
+#endif
+
+  for (ScaledFrameMap::iterator it = m_scaledFrames.begin(); it != m_scaledFrames.end(); ++it)
+    delete it->second;
 }
 
 
@@ -1894,21 +2499,139 @@ bool OpalVideoStreamMixer::SetFrameRate(unsigned rate)
   if (!OpalVideoMixer::SetFrameRate(rate))
     return false;
 
-  for (TranscoderMap::iterator it = m_transcoders.begin(); it != m_transcoders.end(); ++it) {
-    OpalMediaFormat mediaFormat;
-    mediaFormat.SetOptionInteger(OpalMediaFormat::FrameTimeOption(), m_periodTS);
-    it->second.UpdateMediaFormats(OpalMediaFormat(), mediaFormat);
+  PWaitAndSignal lock(m_encodeGroupsMutex);
+  for (EncodeGroupMap::iterator it = m_encodeGroups.begin(); it != m_encodeGroups.end(); ++it) {
+    if (it->second.m_transcoder != NULL) {
+      OpalMediaFormat mediaFormat;
+      mediaFormat.SetOptionInteger(OpalMediaFormat::FrameTimeOption(), m_periodTS);
+      it->second.m_transcoder->UpdateMediaFormats(OpalMediaFormat(), mediaFormat);
+    }
   }
   return true;
 }
 
 
+void OpalVideoStreamMixer::GetEncodeStatistics(EncodeStatisticsMap & statistics) const
+{
+  statistics.clear();
+
+  PWaitAndSignal lock(m_encodeGroupsMutex);
+  for (EncodeGroupMap::const_iterator it = m_encodeGroups.begin(); it != m_encodeGroups.end(); ++it) {
+    if (it->second.m_transcoder != NULL)
+      statistics[PSTRSTRM(it->first.first << ' ' << it->second.m_width << 'x' << it->second.m_height)] = it->second.m_statistics;
+  }
+}
+
+
+OpalVideoStreamMixer::EncodeGroup::EncodeGroup()
+  : m_transcoder(NULL)
+  , m_width(0)
+  , m_height(0)
+  , m_scaled(NULL)
+{
+}
+
+
+OpalVideoStreamMixer::EncodeGroup::~EncodeGroup()
+{
+  delete m_transcoder;
+}
+
+
+struct OpalVideoStreamMixer::EncodeBatch : public OpalMediaPatchExecutor::Batch
+{
+  EncodeBatch(OpalVideoStreamMixer & mixer, const std::vector<EncodeGroup *> & groups, const RTP_DataFrame & output)
+    : m_mixer(mixer)
+    , m_groups(groups)
+    , m_output(output)
+  {
+  }
+
+  virtual void RunJob(unsigned index)
+  {
+    m_mixer.EncodeGroupEntries(*m_groups[index], m_output);
+  }
+
+  OpalVideoStreamMixer             & m_mixer;
+  const std::vector<EncodeGroup *> & m_groups;
+  const RTP_DataFrame              & m_output;
+};
+
+
+void OpalVideoStreamMixer::EncodeGroupEntries(EncodeGroup & group, const RTP_DataFrame & output)
+{
+  PTimeInterval start = PTimer::Tick();
+
+  const RTP_DataFrame * rawRTP = &output;
+  if (group.m_scaled == NULL) {
+    PTRACE(5, "Using mixer video frame: " << group.m_width << 'x' << group.m_height);
+  }
+  else {
+    // Scaled once per mix, by whichever encode of this size gets here first
+    PWaitAndSignal lock(group.m_scaled->m_mutex);
+    rawRTP = &group.m_scaled->m_frame;
+    if (group.m_scaled->m_mixCount != m_mixCount) {
+      const OpalVideoTranscoder::FrameHeader * header = (const OpalVideoTranscoder::FrameHeader *)output.GetPayloadPtr();
+      PTRACE(5, "Scaling video frame: " << header->width << 'x' << header->height << " to " << group.m_width << 'x' << group.m_height);
+      RTP_DataFrame & scaled = group.m_scaled->m_frame;
+      scaled.CopyHeader(output);
+      scaled.SetPayloadSize(PVideoFrameInfo::CalculateFrameBytes(group.m_width, group.m_height)+sizeof(OpalVideoTranscoder::FrameHeader));
+      OpalVideoTranscoder::FrameHeader * resized = (OpalVideoTranscoder::FrameHeader *)scaled.GetPayloadPtr();
+      resized->x = resized->y = 0;
+      resized->width = group.m_width;
+      resized->height = group.m_height;
+      PColourConverter::CopyYUV420P(0, 0, header->width, header->height,
+                                    header->width, header->height, OpalVideoFrameDataPtr(header),
+                                    0, 0, group.m_width, group.m_height,
+                                    group.m_width, group.m_height, OpalVideoFrameDataPtr(resized),
+                                    PVideoFrameInfo::eScale);
+      group.m_scaled->m_mixCount = m_mixCount;
+    }
+    else {
+      PTRACE(5, "Using cached video frame: " << group.m_width << 'x' << group.m_height);
+    }
+  }
+
+  bool converted = group.m_transcoder->ConvertFrames(*rawRTP, group.m_packets);
+
+  PTimeInterval elapsed = PTimer::Tick() - start;
+  m_encodeGroupsMutex.Wait();
+  EncodeStatistics & stats = group.m_statistics;
+  ++stats.m_frames;
+  stats.m_total += elapsed;
+  stats.m_last = elapsed;
+  if (stats.m_maximum < elapsed)
+    stats.m_maximum = elapsed;
+  if (elapsed > m_periodMS)
+    ++stats.m_overruns;
+  m_encodeGroupsMutex.Signal();
+
+  // Push as soon as this encode is done, without waiting for the others
+  for (size_t i = 0; i < group.m_streams.size(); ++i) {
+    PSafePtr<OpalMixerMediaStream> stream = group.m_streams[i];
+    group.m_streams[i].SetNULL(); // Make sure last reference is released on this thread
+    if (converted) {
+      // Still PSafeReference, as OpalMediaStream::PushPackets might block
+      stream->PushPackets(group.m_packets);
+    }
+    else {
+      PTRACE(2, "Could not convert video to " << group.m_transcoder->GetOutputFormat() << " for stream id " << stream->GetID());
+      CloseOne(stream);
+    }
+  }
+  group.m_streams.clear();
+}
+
+
 bool OpalVideoStreamMixer::OnMixed(RTP_DataFrame * & output)
 {
-  typedef std::map<PString, RTP_DataFrameList> CachedPackets;
-  CachedPackets cachedPackets;
-  typedef std::map<unsigned, RTP_DataFrame> CachedFrameStore;
-  CachedFrameStore cachedFrameStore;
+  ++m_mixCount;
+
+  const OpalVideoTranscoder::FrameHeader * header = (const OpalVideoTranscoder::FrameHeader *)output->GetPayloadPtr();
+
+  /* Group the output streams by format and size, each group is a separate
+     scale, encode and write that is independent of the others. */
+  std::vector<EncodeGroup *> groups;
 
   for (StreamDict::iterator it = m_outputStreams.begin(); it != m_outputStreams.end(); ++it) {
     PSafePtr<OpalMixerMediaStream> stream = it->second;
@@ -1920,97 +2643,349 @@ bool OpalVideoStreamMixer::OnMixed(RTP_DataFrame * & output)
       stream.SetSafetyMode(PSafeReference); // OpalMediaStream::PushPacket might block
       stream->PushPacket(*output);
       stream.SetSafetyMode(PSafeReadOnly); // restore lock
+      continue;
+    }
+
+    unsigned width, height;
+    if (stream->CheckMixedVideoSize(header->width, header->height)) {
+      // Try and set outgoing video to same size as mixed frame store
+      mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthOption(), header->width);
+      mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightOption(), header->height);
+      if (!stream->UpdateMediaFormat(mediaFormat, true)) {
+        PTRACE(2, "Could not adjust media format to " << header->width << 'x' << header->height);
+        continue;
+      }
+      mediaFormat = stream->GetMediaFormat();
+      width = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption());
+      height = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption());
+      PTRACE(4, "Output of " << mediaFormat << " started at " << width << 'x' << height
+             << " (" << header->width << 'x' << header->height << ")"
+                " to stream id " << stream->GetID());
     }
     else {
-      unsigned width, height;
-      const OpalVideoTranscoder::FrameHeader * header = (const OpalVideoTranscoder::FrameHeader *)output->GetPayloadPtr();
-      if (stream->CheckMixedVideoSize(header->width, header->height)) {
-        // Try and set outgoing video to same size as mixed frame store
-        mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthOption(), header->width);
-        mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightOption(), header->height);
-        if (!stream->UpdateMediaFormat(mediaFormat, true)) {
-          PTRACE(2, "Could not adjust media format to " << header->width << 'x' << header->height);
-          continue;
-        }
-        mediaFormat = stream->GetMediaFormat();
-        width = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption());
-        height = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption());
-        PTRACE(4, "Output of " << mediaFormat << " started at " << width << 'x' << height
-               << " (" << header->width << 'x' << header->height << ")"
-                  " to stream id " << stream->GetID());
+      width = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption());
+      height = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption());
+    }
+
+    unsigned frameSizeKey = width + height*65536;
+
+    m_encodeGroupsMutex.Wait();
+    EncodeGroup & group = m_encodeGroups[EncodeKey(mediaFormat.GetName(), frameSizeKey)];
+    m_encodeGroupsMutex.Signal();
+
+    if (group.m_transcoder == NULL) {
+      mediaFormat.SetOptionInteger(OpalMediaFormat::FrameTimeOption(), m_periodTS);
+      group.m_transcoder = OpalTranscoder::Create(OpalYUV420P, mediaFormat);
+      if (group.m_transcoder == NULL) {
+        PTRACE(2, "Could not create transcoder to " << mediaFormat << " for stream id " << stream->GetID());
+        CloseOne(stream);
+        continue;
       }
+      PTRACE(3, "Created transcoder to " << mediaFormat << ' '
+             << width << 'x' << height << " for stream id " << stream->GetID());
+      group.m_width = width;
+      group.m_height = height;
+    }
+
+    if (group.m_streams.empty()) {
+      if (header->width == width && header->height == height)
+        group.m_scaled = NULL;
       else {
-        width = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption());
-        height = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption());
+        ScaledFrame * & scaled = m_scaledFrames[frameSizeKey];
+        if (scaled == NULL)
+          scaled = new ScaledFrame;
+        group.m_scaled = scaled;
       }
+      groups.push_back(&group);
+    }
+
+    stream.SetSafetyMode(PSafeReference); // OpalMediaStream::PushPacket might block
+    group.m_streams.push_back(stream);
+  }
+
+  // The mixed frame must remain valid until all groups are done
+  EncodeBatch batch(*this, groups, *output);
+  batch.Run(m_executor, groups.size());
+
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+OpalVideoForwarder::OpalVideoForwarder()
+  : m_explicitChoice(false)
+{
+}
+
+
+OpalVideoForwarder::~OpalVideoForwarder()
+{
+  for (SenderMap::iterator it = m_senders.begin(); it != m_senders.end(); ++it)
+    delete it->second;
+}
 
-      PStringStream keyPackets;
-      keyPackets << mediaFormat << ' ' << width << 'x' << height;
-
-      CachedPackets::iterator itPackets = cachedPackets.find(keyPackets);
-      if (itPackets == cachedPackets.end()) {
-        OpalTranscoder * transcoder = m_transcoders.GetAt(keyPackets);
-        if (transcoder == NULL) {
-          mediaFormat.SetOptionInteger(OpalMediaFormat::FrameTimeOption(), m_periodTS);
-          transcoder = OpalTranscoder::Create(OpalYUV420P, mediaFormat);
-          if (transcoder == NULL) {
-            PTRACE(2, "Could not create transcoder to " << mediaFormat << " for stream id " << stream->GetID());
-            CloseOne(stream);
-            continue;
-          }
-          PTRACE(3, "Created transcoder to " << mediaFormat << ' '
-                 << width << 'x' << height << " for stream id " << stream->GetID());
-          m_transcoders.SetAt(keyPackets, transcoder);
-        }
 
-        RTP_DataFrame * rawRTP;
-        if (header->width == width && header->height == height) {
-          PTRACE(5, "Using mixer video frame: " << width << 'x' << height);
-          rawRTP = output;
+OpalVideoForwarder::Sender::Sender(const PSafePtr<OpalMixerMediaStream> & stream)
+  : m_stream(stream)
+  , m_token(stream->GetConnection().GetToken())
+  , m_frameStart(true)
+{
+  m_stream.SetSafetyMode(PSafeReference);
+  m_mediaFormat = stream->GetMediaFormat();
+}
+
+
+OpalVideoForwarder::Listener::Listener(const PSafePtr<OpalMixerMediaStream> & stream)
+  : m_stream(stream)
+  , m_token(stream->GetConnection().GetToken())
+  , m_formatName(stream->GetMediaFormat().GetName())
+  , m_payloadType(stream->GetMediaFormat().GetPayloadType())
+  , m_syncSource(PRandom::Number())
+  , m_sending(false)
+  , m_sequenceOffset(0)
+  , m_timestampOffset(0)
+  , m_lastSequenceNumber(0)
+  , m_lastTimestamp(0)
+{
+  m_stream.SetSafetyMode(PSafeReference);
+}
+
+
+void OpalVideoForwarder::AddSender(const PSafePtr<OpalMixerMediaStream> & stream)
+{
+  StreamList updateRequests;
+  {
+    PWaitAndSignal mutex(m_mutex);
+
+    Sender * & sender = m_senders[stream->GetID()];
+    delete sender;
+    sender = new Sender(stream);
+    PTRACE(4, "Added video sender " << stream->GetID() << " for " << sender->m_mediaFormat << " from " << sender->m_token);
+
+    SelectForAll(updateRequests);
+  }
+  RequestUpdates(updateRequests);
+}
+
+
+void OpalVideoForwarder::RemoveSender(const PString & id)
+{
+  StreamList updateRequests;
+  {
+    PWaitAndSignal mutex(m_mutex);
+
+    SenderMap::iterator it = m_senders.find(id);
+    if (it == m_senders.end())
+      return;
+
+    PTRACE(4, "Removed video sender " << id);
+    delete it->second;
+    m_senders.erase(it);
+
+    for (ListenerMap::iterator listener = m_listeners.begin(); listener != m_listeners.end(); ++listener) {
+      if (listener->second.m_senderId == id)
+        listener->second.m_senderId.MakeEmpty();
+      if (listener->second.m_pendingId == id)
+        listener->second.m_pendingId.MakeEmpty();
+    }
+
+    SelectForAll(updateRequests);
+  }
+  RequestUpdates(updateRequests);
+}
+
+
+void OpalVideoForwarder::AddListener(const PSafePtr<OpalMixerMediaStream> & stream)
+{
+  StreamList updateRequests;
+  {
+    PWaitAndSignal mutex(m_mutex);
+
+    PString id = stream->GetID();
+    m_listeners.erase(id);
+    Listener & listener = m_listeners.insert(ListenerMap::value_type(id, Listener(stream))).first->second;
+    PTRACE(4, "Added video listener " << id << " for " << listener.m_formatName << " to " << listener.m_token);
+
+    SelectForListener(listener, updateRequests);
+  }
+  RequestUpdates(updateRequests);
+}
+
+
+void OpalVideoForwarder::RemoveListener(const PString & id)
+{
+  PWaitAndSignal mutex(m_mutex);
+  if (m_listeners.erase(id) > 0)
+    PTRACE(4, "Removed video listener " << id);
+}
+
+
+void OpalVideoForwarder::SelectSender(const PString & token, bool explicitChoice)
+{
+  StreamList updateRequests;
+  {
+    PWaitAndSignal mutex(m_mutex);
+
+    if (explicitChoice)
+      m_explicitChoice = !token.IsEmpty();
+    else if (m_explicitChoice)
+      return; // Active speaker does not override application
+
+    if (token.IsEmpty() || token == m_selectedToken)
+      return;
+
+    PTRACE(3, "Selected " << (explicitChoice ? "explicit" : "active speaker") << " video sender " << token);
+    m_previousToken = m_selectedToken;
+    m_selectedToken = token;
+
+    SelectForAll(updateRequests);
+  }
+  RequestUpdates(updateRequests);
+}
+
+
+void OpalVideoForwarder::SelectForAll(StreamList & updateRequests)
+{
+  for (ListenerMap::iterator it = m_listeners.begin(); it != m_listeners.end(); ++it)
+    SelectForListener(it->second, updateRequests);
+}
+
+
+void OpalVideoForwarder::SelectForListener(Listener & listener, StreamList & updateRequests)
+{
+  // Already mutexed
+
+  // The selected participant sees the previous selection, not themselves
+  const PString & wanted = listener.m_token != m_selectedToken ? m_selectedToken : m_previousToken;
+
+  SenderMap::iterator selected = m_senders.end();
+  for (SenderMap::iterator it = m_senders.begin(); it != m_senders.end(); ++it) {
+    if (it->second->m_token == listener.m_token || it->second->m_mediaFormat.GetName() != listener.m_formatName)
+      continue;
+    if (it->second->m_token == wanted) {
+      selected = it;
+      break;
+    }
+    // If nothing received yet, anyone is better than nobody
+    if (selected == m_senders.end() && listener.m_senderId.IsEmpty() && listener.m_pendingId.IsEmpty())
+      selected = it;
+  }
+
+  if (selected == m_senders.end() || selected->first == listener.m_senderId || selected->first == listener.m_pendingId)
+    return;
+
+  PTRACE(4, "Video listener " << listener.m_stream->GetID() << " switching to sender " << selected->first);
+  listener.m_pendingId = selected->first;
+  updateRequests.push_back(selected->second->m_stream);
+}
+
+
+bool OpalVideoForwarder::WritePacket(const PString & id, const RTP_DataFrame & packet)
+{
+  std::vector<Target> targets;
+
+  {
+    PWaitAndSignal mutex(m_mutex);
+
+    SenderMap::iterator itSender = m_senders.find(id);
+    if (itSender == m_senders.end())
+      return true;
+
+    Sender & sender = *itSender->second;
+    bool frameStart = sender.m_frameStart;
+    sender.m_frameStart = packet.GetMarker();
+
+    PTimeInterval now = PTimer::Tick();
+    bool frameTypeKnown = false;
+    OpalVideoFormat::FrameType frameType = OpalVideoFormat::e_UnknownFrameType;
+
+    for (ListenerMap::iterator it = m_listeners.begin(); it != m_listeners.end(); ++it) {
+      Listener & listener = it->second;
+
+      if (listener.m_pendingId == id) {
+        if (!frameTypeKnown) {
+          frameType = sender.m_mediaFormat.GetFrameType(packet.GetPayloadPtr(), packet.GetPayloadSize(), sender.m_detector);
+          frameTypeKnown = true;
         }
-        else {
-          unsigned frameStoreKey = width + height*65536;
-          CachedFrameStore::iterator itFrameStore = cachedFrameStore.find(frameStoreKey);
-          if (itFrameStore != cachedFrameStore.end()) {
-            PTRACE(5, "Using cached video frame: " << header->width << 'x' << header->height << " to " << width << 'x' << height);
-            rawRTP = &itFrameStore->second;
-          }
-          else {
-            PTRACE(5, "Scaling video frame: " << header->width << 'x' << header->height << " to " << width << 'x' << height);
-            rawRTP = &cachedFrameStore[frameStoreKey];
-            rawRTP->CopyHeader(*output);
-            rawRTP->SetPayloadSize(PVideoFrameInfo::CalculateFrameBytes(width, height)+sizeof(OpalVideoTranscoder::FrameHeader));
-            OpalVideoTranscoder::FrameHeader * resized = (OpalVideoTranscoder::FrameHeader *)rawRTP->GetPayloadPtr();
-            resized->width = width;
-            resized->height = height;
-            PColourConverter::CopyYUV420P(0, 0, header->width, header->height,
-                                          header->width, header->height, OpalVideoFrameDataPtr(header),
-                                          0, 0, width, height,
-                                          width, height, OpalVideoFrameDataPtr(resized),
-                                          PVideoFrameInfo::eScale);
+
+        // If codec cannot tell us, switch at a frame boundary and hope the intra frame is not far behind
+        if (frameType == OpalVideoFormat::e_IntraFrame || (frameType == OpalVideoFormat::e_UnknownFrameType && frameStart)) {
+          PTRACE(3, "Video listener " << it->first << " switched to sender " << id << " on "
+                 << (frameType == OpalVideoFormat::e_IntraFrame ? "intra frame" : "frame boundary"));
+          listener.m_senderId = id;
+          listener.m_pendingId.MakeEmpty();
+
+          // Continue on from where the last sender left off
+          if (listener.m_sending) {
+            unsigned elapsed = (unsigned)std::max((now - listener.m_lastTick).GetMilliSeconds(), (PInt64)1);
+            listener.m_sequenceOffset = (RTP_SequenceNumber)(listener.m_lastSequenceNumber + 1 - packet.GetSequenceNumber());
+            listener.m_timestampOffset = listener.m_lastTimestamp + elapsed*sender.m_mediaFormat.GetTimeUnits() - packet.GetTimestamp();
           }
         }
+      }
 
-        RTP_DataFrameList packets;
-        if (!transcoder->ConvertFrames(*rawRTP, packets)) {
-          PTRACE(2, "Could not convert video to " << mediaFormat << " for stream id " << stream->GetID());
-          CloseOne(stream);
-          continue;
-        }
+      if (listener.m_senderId != id)
+        continue;
+
+      Target target;
+      target.m_stream = listener.m_stream;
+      target.m_payloadType = listener.m_payloadType;
+      target.m_syncSource = listener.m_syncSource;
+      target.m_sequenceNumber = (RTP_SequenceNumber)(packet.GetSequenceNumber() + listener.m_sequenceOffset);
+      target.m_timestamp = packet.GetTimestamp() + listener.m_timestampOffset;
+      targets.push_back(target);
+
+      listener.m_sending = true;
+      listener.m_lastSequenceNumber = target.m_sequenceNumber;
+      listener.m_lastTimestamp = target.m_timestamp;
+      listener.m_lastTick = now;
+    }
+  }
 
-        itPackets = cachedPackets.insert(CachedPackets::value_type(keyPackets, packets)).first;
-      }
+  // Outside of mutex as OpalMediaStream::PushPacket might block
+  for (std::vector<Target>::iterator it = targets.begin(); it != targets.end(); ++it) {
+    // Each listener gets its own copy, as sending may alter it, e.g. SRTP
+    RTP_DataFrame frame;
+    frame.Copy(packet);
+    frame.SetPayloadType(it->m_payloadType);
+    frame.SetSyncSource(it->m_syncSource);
+    frame.SetSequenceNumber(it->m_sequenceNumber);
+    frame.SetTimestamp(it->m_timestamp);
+    it->m_stream->PushPacket(frame);
+  }
 
-      stream.SetSafetyMode(PSafeReference); // OpalMediaStream::PushPacket might block
+  return true;
+}
 
-      for (RTP_DataFrameList::iterator frame = itPackets->second.begin(); frame != itPackets->second.end(); ++frame)
-        stream->PushPacket(*frame);
 
-      stream.SetSafetyMode(PSafeReadOnly); // restore lock
-    }
+void OpalVideoForwarder::OnVideoUpdatePicture(const PString & id)
+{
+  StreamList updateRequests;
+  {
+    PWaitAndSignal mutex(m_mutex);
+
+    ListenerMap::iterator listener = m_listeners.find(id);
+    if (listener == m_listeners.end())
+      return;
+
+    SenderMap::iterator sender = m_senders.find(listener->second.m_pendingId.IsEmpty() ? listener->second.m_senderId
+                                                                                        : listener->second.m_pendingId);
+    if (sender == m_senders.end())
+      return;
+
+    PTRACE(4, "Relaying video update picture from listener " << id << " to sender " << sender->first);
+    updateRequests.push_back(sender->second->m_stream);
   }
+  RequestUpdates(updateRequests);
+}
 
-  return true;
+
+void OpalVideoForwarder::RequestUpdates(const StreamList & updateRequests)
+{
+  // Goes back through the senders media patch to their connection
+  for (StreamList::const_iterator it = updateRequests.begin(); it != updateRequests.end(); ++it)
+    (*it)->ExecuteCommand(OpalVideoUpdatePicture());
 }
 #endif
 
@@ -36,6 +36,7 @@
 #include <ep/ivr.h>
 
 #include <opal/call.h>
+#include <opal/transcoders.h>
 #include <codec/opalwavfile.h>
 
 
@@ -43,9 +44,257 @@
 
 #if OPAL_IVR
 
+OpalIVRPromptCache::OpalIVRPromptCache()
+  : m_size(0)
+  , m_maxSize(32*1024*1024)
+  , m_useCount(0)
+  , m_hits(0)
+  , m_misses(0)
+{
+}
+
+
+OpalIVRPromptCache & OpalIVRPromptCache::GetInstance()
+{
+  static OpalIVRPromptCache instance;
+  return instance;
+}
+
+
+bool OpalIVRPromptCache::GetPrompt(const PFilePath & filename,
+                                   const PString & formatName,
+                                   unsigned sampleRate,
+                                   PBYTEArray & data)
+{
+  PFileInfo info;
+  if (!PFile::GetInfo(filename, info))
+    return false;
+
+  PString key = PSTRSTRM(filename << '\n' << formatName << '\n' << sampleRate);
+
+  PWaitAndSignal lock(m_mutex);
+
+  for (;;) {
+    PromptMap::iterator it = m_prompts.find(key);
+    if (it == m_prompts.end())
+      break;
+
+    if (it->second.m_encoding != NULL) {
+      // Wait for the call encoding it, rather than all encoding it at once
+      Encoding * encoding = it->second.m_encoding;
+      ++encoding->m_references;
+      m_mutex.Signal();
+      encoding->m_done.Wait();
+      m_mutex.Wait();
+      ReleaseEncoding(encoding);
+      continue; // Look again, as may have since been modified or discarded
+    }
+
+    if (it->second.m_modified == info.modified) {
+      it->second.m_lastUsed = ++m_useCount;
+      data = it->second.m_data;
+      if (data.IsEmpty())
+        return false;
+      ++m_hits;
+      return true;
+    }
+
+    PTRACE(4, "IVR\tPrompt file " << filename << " modified, re-encoding");
+    m_size -= it->second.GetCost();
+    m_prompts.erase(it);
+    break;
+  }
+
+  ++m_misses;
+
+  Encoding * encoding = new Encoding;
+  Prompt & newPrompt = m_prompts[key];
+  newPrompt.m_modified = info.modified;
+  newPrompt.m_lastUsed = ++m_useCount;
+  newPrompt.m_encoding = encoding;
+
+  // Encoded unlocked, so other prompts are not held up
+  m_mutex.Signal();
+  PBYTEArray encoded;
+  if (!Encode(filename, formatName, sampleRate, encoded))
+    encoded.SetSize(0);
+  m_mutex.Wait();
+
+  data = encoded;
+
+  PromptMap::iterator it = m_prompts.find(key);
+  if (it != m_prompts.end() && it->second.m_encoding == encoding) {
+    it->second.m_encoding = NULL;
+    it->second.m_data = data;
+    m_size += it->second.GetCost();
+    PTRACE_IF(4, !data.IsEmpty(), "IVR\tCached prompt " << filename << " as " << formatName << '@' << sampleRate
+              << ", " << data.GetSize() << " bytes, total " << m_size);
+  }
+
+  for (unsigned i = 1; i < encoding->m_references; ++i)
+    encoding->m_done.Signal();
+  ReleaseEncoding(encoding);
+
+  Trim();
+
+  return !data.IsEmpty();
+}
+
+
+void OpalIVRPromptCache::ReleaseEncoding(Encoding * encoding)
+{
+  // Last one out, m_mutex must be locked
+  if (--encoding->m_references == 0)
+    delete encoding;
+}
+
+
+bool OpalIVRPromptCache::Encode(const PFilePath & filename,
+                                const PString & formatName,
+                                unsigned sampleRate,
+                                PBYTEArray & data)
+{
+  OpalWAVFile file(filename, PFile::ReadOnly);
+  if (!file.IsOpen()) {
+    PTRACE(2, "IVR\tCould not open prompt file " << filename);
+    return false;
+  }
+
+  if (file.GetChannels() != 1 || file.GetSampleRate() != sampleRate || file.GetSampleSize() != 16) {
+    PTRACE(3, "IVR\tCannot cache prompt file " << filename << ", not 16 bit mono at " << sampleRate << "Hz");
+    return false;
+  }
+
+  static const PINDEX ReadChunk = 8192;
+  PBYTEArray pcm;
+  PINDEX length = 0;
+  for (;;) {
+    if (length + ReadChunk > pcm.GetSize())
+      pcm.SetSize(std::max(pcm.GetSize()*2, length + ReadChunk));
+    if (!file.Read(pcm.GetPointer() + length, ReadChunk) || file.GetLastReadCount() == 0)
+      break;
+    length += file.GetLastReadCount();
+  }
+  pcm.SetSize(length);
+
+  if (length == 0) {
+    PTRACE(2, "IVR\tEmpty prompt file " << filename);
+    return false;
+  }
+
+  if (formatName == VXML_PCM16) {
+    data = pcm;
+    return true;
+  }
+
+  OpalMediaFormat mediaFormat(formatName);
+  if (!mediaFormat.IsValid() || mediaFormat.GetClockRate() != sampleRate || mediaFormat.GetFrameSize() == 0) {
+    PTRACE(3, "IVR\tCannot cache prompt file " << filename << ", unsupported format " << formatName << '@' << sampleRate);
+    return false;
+  }
+
+  std::auto_ptr<OpalTranscoder> encoder(OpalTranscoder::Create(GetOpalPCM16(sampleRate), mediaFormat));
+  if (encoder.get() == NULL) {
+    PTRACE(2, "IVR\tCould not create transcoder to " << mediaFormat << " for prompt file " << filename);
+    return false;
+  }
+
+  PINDEX inputSize = encoder->GetOptimalDataFrameSize(true);
+  PINDEX outputSize = encoder->GetOptimalDataFrameSize(false);
+  PINDEX frameSize = mediaFormat.GetFrameSize();
+
+  data.SetSize((length + inputSize - 1)/inputSize*outputSize);
+  PINDEX encodedLength = 0;
+
+  RTP_DataFrame input(0, inputSize);
+  RTP_DataFrame output(0, outputSize);
+  for (PINDEX offset = 0; offset < length; offset += inputSize) {
+    // Final partial frame is padded with silence
+    PINDEX count = std::min(inputSize, length - offset);
+    input.SetPayloadSize(inputSize);
+    memcpy(input.GetPayloadPtr(), pcm.GetPointer() + offset, count);
+    memset(input.GetPayloadPtr() + count, 0, inputSize - count);
+
+    output.SetPayloadSize(outputSize);
+    if (!encoder->Convert(input, output)) {
+      PTRACE(2, "IVR\tCould not encode prompt file " << filename << " to " << mediaFormat);
+      return false;
+    }
+
+    /* The VXML channel reads the data as fixed size frames, so a codec with
+       variable sized frames cannot be played from a contiguous buffer. */
+    PINDEX size = output.GetPayloadSize();
+    if (size % frameSize != 0) {
+      PTRACE(3, "IVR\tCannot cache prompt file " << filename << ", " << mediaFormat << " has variable frame size");
+      return false;
+    }
+
+    if (encodedLength + size > data.GetSize())
+      data.SetSize(encodedLength + size);
+    memcpy(data.GetPointer() + encodedLength, output.GetPayloadPtr(), size);
+    encodedLength += size;
+  }
+
+  data.SetSize(encodedLength);
+  return encodedLength > 0;
+}
+
+
+void OpalIVRPromptCache::Trim()
+{
+  while (m_size > m_maxSize) {
+    PromptMap::iterator oldest = m_prompts.end();
+    for (PromptMap::iterator it = m_prompts.begin(); it != m_prompts.end(); ++it) {
+      if (it->second.m_encoding == NULL && (oldest == m_prompts.end() || it->second.m_lastUsed < oldest->second.m_lastUsed))
+        oldest = it;
+    }
+    if (oldest == m_prompts.end())
+      break;
+
+    // Sessions still playing it keep their reference to the data
+    PTRACE(4, "IVR\tDiscarding cached prompt " << oldest->first.Left(oldest->first.Find('\n')));
+    m_size -= oldest->second.GetCost();
+    m_prompts.erase(oldest);
+  }
+}
+
+
+void OpalIVRPromptCache::SetMaxSize(PINDEX bytes)
+{
+  PWaitAndSignal lock(m_mutex);
+  m_maxSize = bytes;
+  Trim();
+}
+
+
+PINDEX OpalIVRPromptCache::GetSize() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_size;
+}
+
+
+void OpalIVRPromptCache::Flush()
+{
+  PWaitAndSignal lock(m_mutex);
+
+  // Prompts being encoded are still waited for, and have no cost yet
+  for (PromptMap::iterator it = m_prompts.begin(); it != m_prompts.end();) {
+    if (it->second.m_encoding == NULL)
+      m_prompts.erase(it++);
+    else
+      ++it;
+  }
+  m_size = 0;
+}
+
+
+///////////////////////////////////////////////////////////////
+
 OpalVXMLSession::OpalVXMLSession(OpalIVRConnection & conn, PTextToSpeech * tts, PBoolean autoDelete)
   : PVXMLSession(tts, autoDelete),
-    m_connection(conn)
+    m_connection(conn),
+    m_promptCache(NULL)
 {
   PTRACE_CONTEXT_ID_FROM(conn);
 
@@ -88,6 +337,30 @@ bool OpalVXMLSession::OnTransfer(const PString & destination, TransferType type)
 }
 
 
+PBoolean OpalVXMLSession::PlayFile(const PString & fn, PINDEX repeat, PINDEX delay, PBoolean autoDelete)
+{
+  // Temporary files, e.g. from text to speech, are not worth caching
+  if (m_promptCache != NULL && !autoDelete) {
+    PString formatName;
+    unsigned sampleRate = 0;
+    PVXMLChannel * channel = GetAndLockVXMLChannel();
+    if (channel != NULL) {
+      formatName = channel->GetAudioFormat();
+      sampleRate = channel->GetSampleRate();
+      UnLockVXMLChannel();
+    }
+
+    PBYTEArray data;
+    if (sampleRate > 0 && m_promptCache->GetPrompt(fn, formatName, sampleRate, data)) {
+      PTRACE(4, "IVR\tPlaying cached prompt " << fn << " as " << formatName << ", " << repeat << " times, " << delay << "ms");
+      return PlayData(data, repeat, delay);
+    }
+  }
+
+  return PVXMLSession::PlayFile(fn, repeat, delay, autoDelete);
+}
+
+
 #endif // OPAL_IVR
 
 
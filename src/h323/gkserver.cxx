@@ -2976,6 +2976,122 @@ H323GatekeeperRequest::Response H323GatekeeperServer::OnInfoResponse(H323Gatekee
 }
 
 
+void H323GatekeeperServer::AddToIndex(IdentifierIndex & index, const PString & key, const PString & identifier)
+{
+  std::vector<PString> & identifiers = index[key];
+  if (std::find(identifiers.begin(), identifiers.end(), identifier) == identifiers.end())
+    identifiers.push_back(identifier);
+}
+
+
+void H323GatekeeperServer::RemoveFromIndex(IdentifierIndex & index, const PString & key, const PString & identifier)
+{
+  IdentifierIndex::iterator it = index.find(key);
+  if (it == index.end())
+    return;
+
+  std::vector<PString>::iterator id = std::find(it->second.begin(), it->second.end(), identifier);
+  if (id != it->second.end())
+    it->second.erase(id);
+  if (it->second.empty())
+    index.erase(it);
+}
+
+
+const PString & H323GatekeeperServer::FindInIndex(const IdentifierIndex & index, const PString & key)
+{
+  IdentifierIndex::const_iterator it = index.find(key);
+  return it != index.end() ? it->second.front() : PString::Empty();
+}
+
+
+H323GatekeeperServer::VoicePrefixTrie::Node::~Node()
+{
+  for (std::map<char, Node *>::iterator it = m_children.begin(); it != m_children.end(); ++it)
+    delete it->second;
+}
+
+
+void H323GatekeeperServer::VoicePrefixTrie::Add(const PString & prefix, const PString & identifier)
+{
+  Node * node = &m_root;
+  for (const char * ptr = prefix; *ptr != '\0'; ++ptr) {
+    Node * & child = node->m_children[*ptr];
+    if (child == NULL)
+      child = new Node;
+    node = child;
+  }
+
+  if (node != &m_root && std::find(node->m_identifiers.begin(), node->m_identifiers.end(), identifier) == node->m_identifiers.end())
+    node->m_identifiers.push_back(identifier);
+}
+
+
+void H323GatekeeperServer::VoicePrefixTrie::Remove(const PString & prefix, const PString & identifier)
+{
+  std::vector<Node *> path;
+  Node * node = &m_root;
+  for (const char * ptr = prefix; *ptr != '\0'; ++ptr) {
+    std::map<char, Node *>::iterator it = node->m_children.find(*ptr);
+    if (it == node->m_children.end())
+      return;
+    path.push_back(node);
+    node = it->second;
+  }
+
+  std::vector<PString>::iterator id = std::find(node->m_identifiers.begin(), node->m_identifiers.end(), identifier);
+  if (id == node->m_identifiers.end())
+    return;
+  node->m_identifiers.erase(id);
+
+  // Prune the branch back as far as it is no longer needed
+  PINDEX pos = prefix.GetLength();
+  while (node->m_identifiers.empty() && node->m_children.empty() && !path.empty()) {
+    Node * parent = path.back();
+    path.pop_back();
+    parent->m_children.erase(prefix[--pos]);
+    delete node;
+    node = parent;
+  }
+}
+
+
+const PString & H323GatekeeperServer::VoicePrefixTrie::FindLongest(const PString & str) const
+{
+  const PString * longest = &PString::Empty();
+  const Node * node = &m_root;
+  for (const char * ptr = str; *ptr != '\0'; ++ptr) {
+    std::map<char, Node *>::const_iterator it = node->m_children.find(*ptr);
+    if (it == node->m_children.end())
+      break;
+    node = it->second;
+    if (!node->m_identifiers.empty())
+      longest = &node->m_identifiers.front();
+  }
+  return *longest;
+}
+
+
+void H323GatekeeperServer::RemoveFromIndexes(const PString & identifier)
+{
+  // Index mutex already write locked
+
+  std::map<PString, IndexedKeys>::iterator it = m_indexedKeys.find(identifier);
+  if (it == m_indexedKeys.end())
+    return;
+
+  std::vector<PString>::iterator key;
+  for (key = it->second.m_addresses.begin(); key != it->second.m_addresses.end(); ++key)
+    RemoveFromIndex(m_byAddress, *key, identifier);
+  for (key = it->second.m_aliases.begin(); key != it->second.m_aliases.end(); ++key)
+    RemoveFromIndex(m_byAlias, *key, identifier);
+  for (key = it->second.m_prefixes.begin(); key != it->second.m_prefixes.end(); ++key)
+    m_byVoicePrefix.Remove(*key, identifier);
+
+  m_indexedKeys.erase(it);
+}
+
+
 void H323GatekeeperServer::AddEndPoint(H323RegisteredEndPoint * ep)
 {
   PTRACE(3, "RAS\tAdding registered endpoint: " << *ep);
@@ -2992,16 +3108,29 @@ void H323GatekeeperServer::AddEndPoint(H323RegisteredEndPoint * ep)
     m_totalRegistrations++;
   }
 
-  for (i = 0; i < ep->GetSignalAddressCount(); i++)
-    m_byAddress.Append(new StringMap(ep->GetSignalAddress(i), ep->GetIdentifier()));
+  m_indexMutex.StartWrite();
+
+  // A repeated full registration may have changed addresses etc
+  const PString & identifier = ep->GetIdentifier();
+  RemoveFromIndexes(identifier);
+  IndexedKeys & keys = m_indexedKeys[identifier];
+
+  for (i = 0; i < ep->GetSignalAddressCount(); i++) {
+    keys.m_addresses.push_back(ep->GetSignalAddress(i));
+    AddToIndex(m_byAddress, keys.m_addresses.back(), identifier);
+  }
 
   for (i = 0; i < ep->GetAliasCount(); i++) {
-    PString alias = ep->GetAlias(i);
-    m_byAlias.Append(new StringMap(ep->GetAlias(i), ep->GetIdentifier()));
+    keys.m_aliases.push_back(ep->GetAlias(i));
+    AddToIndex(m_byAlias, keys.m_aliases.back(), identifier);
   }
 
-  for (i = 0; i < ep->GetPrefixCount(); i++)
-    m_byVoicePrefix.Append(new StringMap(ep->GetPrefix(i), ep->GetIdentifier()));
+  for (i = 0; i < ep->GetPrefixCount(); i++) {
+    keys.m_prefixes.push_back(ep->GetPrefix(i));
+    m_byVoicePrefix.Add(keys.m_prefixes.back(), identifier);
+  }
+
+  m_indexMutex.EndWrite();
 
   m_mutex.Signal();
 }
@@ -3021,28 +3150,10 @@ PBoolean H323GatekeeperServer::RemoveEndPoint(H323RegisteredEndPoint * ep)
 
   PWaitAndSignal wait(m_mutex);
 
-  PINDEX i;
-
-  // remove prefixes belonging to this endpoint
-  for (i = 0; i < m_byVoicePrefix.GetSize(); i++) {
-    StringMap & prefixMap = (StringMap &)*m_byVoicePrefix.GetAt(i);
-    if (prefixMap.identifier == ep->GetIdentifier())
-      m_byVoicePrefix.RemoveAt(i);
-  }
-
-  // remove aliases belonging to this endpoint
-  for (i = 0; i < m_byAlias.GetSize(); i++) {
-    StringMap & aliasMap = (StringMap &)*m_byAlias.GetAt(i);
-    if (aliasMap.identifier == ep->GetIdentifier())
-      m_byAlias.RemoveAt(i);
-  }
-
-  // remove call signalling addresses
-  for (i = 0; i < m_byAddress.GetSize(); i++) {
-    StringMap & aliasMap = (StringMap &)*m_byAddress.GetAt(i);
-    if (aliasMap.identifier == ep->GetIdentifier())
-      m_byAddress.RemoveAt(i);
-  }
+  // remove prefixes, aliases and call signalling addresses belonging to this endpoint
+  m_indexMutex.StartWrite();
+  RemoveFromIndexes(ep->GetIdentifier());
+  m_indexMutex.EndWrite();
 
 #if OPAL_H501
   // remove the descriptor
@@ -3063,20 +3174,14 @@ void H323GatekeeperServer::RemoveAlias(H323RegisteredEndPoint & ep,
 
   m_mutex.Wait();
 
-  PINDEX pos = m_byAlias.GetValuesIndex(alias);
-  if (pos != P_MAX_INDEX) {
-    // Allow for possible multiple aliases
-    while (pos < m_byAlias.GetSize()) {
-      StringMap & aliasMap = (StringMap &)m_byAlias[pos];
-      if (aliasMap != alias)
-        break;
-
-      if (aliasMap.identifier == ep.GetIdentifier())
-        m_byAlias.RemoveAt(pos);
-      else
-        pos++;
-    }
+  m_indexMutex.StartWrite();
+  RemoveFromIndex(m_byAlias, alias, ep.GetIdentifier());
+  std::map<PString, IndexedKeys>::iterator keys = m_indexedKeys.find(ep.GetIdentifier());
+  if (keys != m_indexedKeys.end()) {
+    std::vector<PString> & aliases = keys->second.m_aliases;
+    aliases.erase(std::remove(aliases.begin(), aliases.end(), alias), aliases.end());
   }
+  m_indexMutex.EndWrite();
 
   if (ep.ContainsAlias(alias))
     ep.RemoveAlias(alias);
@@ -3110,28 +3215,31 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByIdentifier(
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointBySignalAddresses(
                             const H225_ArrayOf_TransportAddress & addresses, PSafetyMode mode)
 {
-  PWaitAndSignal wait(m_mutex);
+  PString identifier;
 
-  for (PINDEX i = 0; i < addresses.GetSize(); i++) {
-    PINDEX pos = m_byAddress.GetValuesIndex(H323TransportAddress(addresses[i]));
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)m_byAddress[pos]).identifier, mode);
-  }
+  m_indexMutex.StartRead();
+  for (PINDEX i = 0; i < addresses.GetSize() && identifier.IsEmpty(); i++)
+    identifier = FindInIndex(m_byAddress, H323TransportAddress(addresses[i]));
+  m_indexMutex.EndRead();
 
-  return (H323RegisteredEndPoint *)NULL;
+  if (identifier.IsEmpty())
+    return (H323RegisteredEndPoint *)NULL;
+
+  return FindEndPointByIdentifier(identifier, mode);
 }
 
 
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointBySignalAddress(
                                      const H323TransportAddress & address, PSafetyMode mode)
 {
-  PWaitAndSignal wait(m_mutex);
+  m_indexMutex.StartRead();
+  PString identifier = FindInIndex(m_byAddress, address);
+  m_indexMutex.EndRead();
 
-  PINDEX pos = m_byAddress.GetValuesIndex(address);
-  if (pos != P_MAX_INDEX)
-    return FindEndPointByIdentifier(((StringMap &)m_byAddress[pos]).identifier, mode);
+  if (identifier.IsEmpty())
+    return (H323RegisteredEndPoint *)NULL;
 
-  return (H323RegisteredEndPoint *)NULL;
+  return FindEndPointByIdentifier(identifier, mode);
 }
 
 
@@ -3145,13 +3253,12 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasAddres
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasString(
                                                   const PString & alias, PSafetyMode mode)
 {
-  {
-    PWaitAndSignal wait(m_mutex);
-    PINDEX pos = m_byAlias.GetValuesIndex(alias);
+  m_indexMutex.StartRead();
+  PString identifier = FindInIndex(m_byAlias, alias);
+  m_indexMutex.EndRead();
 
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)m_byAlias[pos]).identifier, mode);
-  }
+  if (!identifier.IsEmpty())
+    return FindEndPointByIdentifier(identifier, mode);
 
   return FindEndPointByPrefixString(alias, mode);
 }
@@ -3160,17 +3267,19 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasString
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPartialAlias(
                                                   const PString & alias, PSafetyMode mode)
 {
-  PWaitAndSignal wait(m_mutex);
-  PINDEX pos = m_byAlias.GetNextStringsIndex(alias);
-
-  if (pos != P_MAX_INDEX) {
-    StringMap & possible = (StringMap &)m_byAlias[pos];
-    if (possible.NumCompare(alias) == EqualTo) {
-      PTRACE(4, "RAS\tPartial endpoint search for "
-                "\"" << alias << "\" found \"" << possible << '"');
-      return FindEndPointByIdentifier(possible.identifier, mode);
-    }
+  PString identifier;
+
+  m_indexMutex.StartRead();
+  IdentifierIndex::const_iterator possible = m_byAlias.lower_bound(alias);
+  if (possible != m_byAlias.end() && possible->first.NumCompare(alias) == EqualTo) {
+    PTRACE(4, "RAS\tPartial endpoint search for "
+              "\"" << alias << "\" found \"" << possible->first << '"');
+    identifier = possible->second.front();
   }
+  m_indexMutex.EndRead();
+
+  if (!identifier.IsEmpty())
+    return FindEndPointByIdentifier(identifier, mode);
 
   PTRACE(4, "RAS\tPartial endpoint search for \"" << alias << "\" failed");
   return (H323RegisteredEndPoint *)NULL;
@@ -3180,18 +3289,14 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPartialAlia
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPrefixString(
                                                   const PString & prefix, PSafetyMode mode)
 {
-  PWaitAndSignal wait(m_mutex);
+  m_indexMutex.StartRead();
+  PString identifier = m_byVoicePrefix.FindLongest(prefix);
+  m_indexMutex.EndRead();
 
-  if (m_byVoicePrefix.IsEmpty())
+  if (identifier.IsEmpty())
     return (H323RegisteredEndPoint *)NULL;
 
-  for (PINDEX len = prefix.GetLength(); len > 0; len--) {
-    PINDEX pos = m_byVoicePrefix.GetValuesIndex(prefix.Left(len));
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)m_byVoicePrefix[pos]).identifier, mode);
-  }
-
-  return (H323RegisteredEndPoint *)NULL;
+  return FindEndPointByIdentifier(identifier, mode);
 }
 
 
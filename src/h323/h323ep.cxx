@@ -843,8 +843,9 @@ void H323EndPoint::OnReleased(OpalConnection & connection)
     m_reusableTransportMutex.Wait();
     m_reusableTransports.insert(signallingChannel);
     m_reusableTransportMutex.Signal();
-    signallingChannel->AttachThread(new PThreadObj2Arg<H323EndPoint, OpalTransportPtr, bool>(*this,
-                signallingChannel, true, &H323EndPoint::InternalNewIncomingConnection, false, "H225 Maintain"));
+    if (!InternalAddToSignalingReactor(signallingChannel, true))
+      signallingChannel->AttachThread(new PThreadObj2Arg<H323EndPoint, OpalTransportPtr, bool>(*this,
+                  signallingChannel, true, &H323EndPoint::InternalNewIncomingConnection, false, "H225 Maintain"));
   }
 
   OpalRTPEndPoint::OnReleased(connection);
@@ -853,11 +854,62 @@ void H323EndPoint::OnReleased(OpalConnection & connection)
 
 void H323EndPoint::NewIncomingConnection(OpalListener &, const OpalTransportPtr & transport)
 {
-  if (transport != NULL)
+  if (transport != NULL && !InternalAddToSignalingReactor(transport, false))
     InternalNewIncomingConnection(transport);
 }
 
 
+bool H323EndPoint::InternalAddToSignalingReactor(const OpalTransportPtr & transport, bool reused)
+{
+  OpalSignalingReactor * reactor = m_manager.GetSignalingReactor();
+  if (reactor == NULL)
+    return false;
+
+  if (!reactor->Add(transport,
+                    reused ? PCREATE_SignalingReadyNotifier(OnReusedTransportReady)
+                           : PCREATE_SignalingReadyNotifier(OnInitialTransportReady),
+                    OpalTransportTCP::GetTPKTFrameLength,
+                    GetFirstSignalPduTimeout()))
+    return false;
+
+  PTRACE(4, "H225\tAwaiting first PDU via reactor on " << (reused ? "reused" : "initial") << " connection " << *transport);
+  return true;
+}
+
+
+void H323EndPoint::OnInitialTransportReady(OpalTransport & transport, bool & rearm)
+{
+  rearm = false;
+  InternalOnTransportReady(transport, false);
+}
+
+
+void H323EndPoint::OnReusedTransportReady(OpalTransport & transport, bool & rearm)
+{
+  rearm = false;
+  InternalOnTransportReady(transport, true);
+}
+
+
+void H323EndPoint::InternalOnTransportReady(OpalTransport & transport, bool reused)
+{
+  /* Once a call starts, HandleSignallingChannel() needs the read timeouts for
+     call supervision, so hand over to a thread, as if the reactor was not used. */
+  m_manager.GetSignalingReactor()->Remove(transport);
+
+  const PBYTEArray & readAhead = transport.GetReadAheadBuffer();
+  if (OpalTransportTCP::GetTPKTFrameLength(readAhead, readAhead.GetSize()) == 0) {
+    PTRACE(3, "H225\tNo initial PDU on " << (reused ? "reused" : "initial") << " connection, closing " << transport);
+    transport.Close();
+    return;
+  }
+
+  OpalTransportPtr transportPtr(&transport, PSafeReference);
+  transport.AttachThread(new PThreadObj2Arg<H323EndPoint, OpalTransportPtr, bool>(*this,
+              transportPtr, reused, &H323EndPoint::InternalNewIncomingConnection, false, "H225 Answer"));
+}
+
+
 void H323EndPoint::InternalNewIncomingConnection(OpalTransportPtr transport, bool reused)
 {
   if (transport == NULL)
@@ -906,6 +906,13 @@ bool OpalCall::IsRecording() const
 }
 
 
+bool OpalCall::IsRecordingPassThrough() const
+{
+  PSafeLockReadOnly lock(*this);
+  return lock.IsLocked() && m_recordManager != NULL && m_recordManager->IsPassThrough();
+}
+
+
 bool OpalCall::StopRecording()
 {
   PSafeLockReadWrite lock(*this);
@@ -1046,10 +1046,22 @@ void OpalConnection::OnStartRecording(OpalMediaPatch * patch)
     return;
   }
 
-  patch->AddFilter(m_recordAudioNotifier, OpalPCM16);
+  if (m_ownerCall.IsRecordingPassThrough()) {
+    // Record media as received, before any decoding
+    const OpalMediaFormat & format = patch->GetSource().GetMediaFormat();
 #if OPAL_VIDEO
-  patch->AddFilter(m_recordVideoNotifier, OPAL_YUV420P);
+    if (format.GetMediaType() == OpalMediaType::Video())
+      patch->AddFilter(m_recordVideoNotifier, format);
+    else
+#endif
+      patch->AddFilter(m_recordAudioNotifier, format);
+  }
+  else {
+    patch->AddFilter(m_recordAudioNotifier, OpalPCM16);
+#if OPAL_VIDEO
+    patch->AddFilter(m_recordVideoNotifier, OPAL_YUV420P);
 #endif
+  }
 
   PTRACE(4, "Added record filter on connection " << *this << ", patch " << *patch);
 }
@@ -1062,10 +1074,18 @@ void OpalConnection::OnStopRecording(OpalMediaPatch * patch)
 
   m_ownerCall.OnStopRecording(MakeRecordingKey(*patch));
 
-  patch->RemoveFilter(m_recordAudioNotifier, OpalPCM16);
+  const OpalMediaFormat & format = patch->GetSource().GetMediaFormat();
 #if OPAL_VIDEO
-  patch->RemoveFilter(m_recordVideoNotifier, OPAL_YUV420P);
+  if (format.GetMediaType() == OpalMediaType::Video()) {
+    patch->RemoveFilter(m_recordVideoNotifier, OPAL_YUV420P);
+    patch->RemoveFilter(m_recordVideoNotifier, format);
+  }
+  else
 #endif
+  {
+    patch->RemoveFilter(m_recordAudioNotifier, OpalPCM16);
+    patch->RemoveFilter(m_recordAudioNotifier, format);
+  }
 
   PTRACE(4, "Removed record filter on " << *patch);
 }
@@ -1162,6 +1182,7 @@ void OpalConnection::OnRecordAudio(RTP_DataFrame & frame, P_INT_PTR param)
 
   const OpalMediaPatch * patch = (const OpalMediaPatch *)param;
   std::auto_ptr<RTP_DataFrame> copyFrame(new RTP_DataFrame(frame.GetPointer(), frame.GetPacketSize()));
+  copyFrame->SetMetaData(frame.GetMetaData()); // Keep arrival time
   GetEndPoint().GetManager().QueueDecoupledEvent(new PSafeWorkArg2<OpalConnection, PString, std::auto_ptr<RTP_DataFrame> >(
                    this, MakeRecordingKey(*patch), copyFrame, &OpalConnection::InternalOnRecordAudio), psprintf("%p", this));
 }
@@ -1179,6 +1200,7 @@ void OpalConnection::OnRecordVideo(RTP_DataFrame & frame, P_INT_PTR param)
 {
   const OpalMediaPatch * patch = (const OpalMediaPatch *)param;
   std::auto_ptr<RTP_DataFrame> copyFrame(new RTP_DataFrame(frame.GetPointer(), frame.GetPacketSize()));
+  copyFrame->SetMetaData(frame.GetMetaData()); // Keep arrival time
   GetEndPoint().GetManager().QueueDecoupledEvent(new PSafeWorkArg2<OpalConnection, PString, std::auto_ptr<RTP_DataFrame> >(
                    this, MakeRecordingKey(*patch), copyFrame, &OpalConnection::InternalOnRecordVideo), psprintf("%p", this));
 }
@@ -1818,7 +1818,8 @@ void OpalConsoleIVREndPoint::GetArgumentSpec(ostream & strm) const
 {
   strm << "[Interactive Voice Response options:]"
           "-no-ivr.     Disable IVR subsystem\n"
-          "-ivr-script: The default VXML script to run\n";
+          "-ivr-script: The default VXML script to run\n"
+          "-ivr-prompt-cache: Play prompt files pre-encoded from a shared cache of the size in megabytes\n";
 }
 
 
@@ -1840,6 +1841,16 @@ bool OpalConsoleIVREndPoint::Initialise(PArgList & args, bool verbose, const PSt
     SetDefaultVXML(vxml);
   }
 
+  if (args.HasOption("ivr-prompt-cache")) {
+    unsigned megabytes = args.GetOptionString("ivr-prompt-cache").AsUnsigned();
+    if (megabytes > 0) {
+      if (verbose)
+        output << "IVR prompt cache: " << megabytes << "MB\n";
+      OpalIVRPromptCache::GetInstance().SetMaxSize(megabytes*1024*1024);
+      SetPromptCaching(true);
+    }
+  }
+
   return true;
 }
 
@@ -1868,6 +1879,7 @@ void OpalConsoleMixerEndPoint::GetArgumentSpec(ostream & strm) const
           "-no-mcu.       Disable MCU subsystem\n"
 #if OPAL_VIDEO
           "-audio-only.   Audio only conference\n"
+          "-video-forward. Forward active speaker video rather than mixing\n"
 #endif
           ;
 }
@@ -1887,6 +1899,7 @@ bool OpalConsoleMixerEndPoint::Initialise(PArgList & args, bool verbose, const P
   OpalMixerNodeInfo adHoc;
 #if OPAL_VIDEO
   adHoc.m_audioOnly = args.HasOption("audio-only");
+  adHoc.m_videoForwarding = args.HasOption("video-forward");
 #endif
   SetAdHocNodeInfo(adHoc);
 
@@ -1934,6 +1947,7 @@ PString OpalManagerConsole::GetArgumentSpec() const
 
          "[Audio options:]"
          "-jitter:           Set audio jitter buffer size (min[,max] default 50,250)\n"
+         "-jitter-ring:      Number of slots in lock free audio jitter buffer, 0 is locked map (default 0)\n"
          "-silence-detect:   Set audio silence detect mode (\"none\", \"fixed\" or default \"adaptive\")\n"
          "-no-inband-detect. Disable detection of in-band tones.\n";
 
@@ -1981,6 +1995,9 @@ PString OpalManagerConsole::GetArgumentSpec() const
          "-rtp-size:         Set RTP maximum payload size in bytes.\n"
          "-aud-qos:          Set Audio RTP Quality of Service to n\n"
          "-vid-qos:          Set Video RTP Quality of Service to n\n"
+         "-media-reactor:    Number of shared media read threads, 0 is thread per channel (default 0)\n"
+         "-patch-threads:    Number of shared media patch threads, 0 is thread per patch (default 0)\n"
+         "-signal-reactor:   Number of shared signalling read threads, 0 is thread per transport (default 0)\n"
 
          "[Debug & General:]"
 #if OPAL_STATISTICS
@@ -2149,6 +2166,12 @@ bool OpalManagerConsole::Initialise(PArgList & args, bool verbose, const PString
     SetAudioJitterDelay(minJitter, maxJitter);
   }
 
+  if (args.HasOption("jitter-ring")) {
+    OpalJitterBuffer::Params params = GetJitterParameters();
+    params.m_ringBufferSize = args.GetOptionString("jitter-ring").AsUnsigned();
+    SetJitterParameters(params);
+  }
+
   if (args.HasOption("silence-detect")) {
     OpalSilenceDetector::Params params = GetSilenceDetectParams();
     PCaselessString arg = args.GetOptionString("silence-detect");
@@ -2222,6 +2245,27 @@ bool OpalManagerConsole::Initialise(PArgList & args, bool verbose, const PString
     SetMaxRtpPayloadSize(size);
   }
 
+  if (args.HasOption("media-reactor")) {
+    if (!SetMediaReactorThreads(args.GetOptionString("media-reactor").AsUnsigned())) {
+      output << "Could not start media reactor, not supported on this platform.\n";
+      return false;
+    }
+  }
+
+  if (args.HasOption("patch-threads")) {
+    if (!SetMediaPatchThreads(args.GetOptionString("patch-threads").AsUnsigned())) {
+      output << "Could not change media patch threads while in use.\n";
+      return false;
+    }
+  }
+
+  if (args.HasOption("signal-reactor")) {
+    if (!SetSignalingReactorThreads(args.GetOptionString("signal-reactor").AsUnsigned())) {
+      output << "Could not start signalling reactor, not supported on this platform.\n";
+      return false;
+    }
+  }
+
   if (verbose)
     output << "TCP ports: " << GetTCPPortRange() << "\n"
               "UDP ports: " << GetUDPPortRange() << "\n"
@@ -2230,7 +2274,10 @@ bool OpalManagerConsole::Initialise(PArgList & args, bool verbose, const PString
 #if OPAL_VIDEO
               "Video QoS: " << GetMediaQoS(OpalMediaType::Video()) << "\n"
 #endif
-              "RTP payload size: " << GetMaxRtpPayloadSize() << '\n';
+              "RTP payload size: " << GetMaxRtpPayloadSize() << "\n"
+              "Media read threads: " << (GetMediaReactorThreads() > 0 ? PString(GetMediaReactorThreads()) : PString("per channel")) << "\n"
+              "Media patch threads: " << (GetMediaPatchThreads() > 0 ? PString(GetMediaPatchThreads()) : PString("per patch")) << "\n"
+              "Signalling read threads: " << (GetSignalingReactorThreads() > 0 ? PString(GetSignalingReactorThreads()) : PString("per transport")) << '\n';
 
 #if OPAL_PTLIB_NAT
   PString natMethod, natServer;
@@ -299,6 +299,9 @@ OpalManager::OpalManager()
   , m_defaultDisplayName(m_defaultUserName)
   , m_rtpPayloadSizeMax(1400) // RFC879 recommends 576 bytes, but that is ancient history, 99.999% of the time 1400+ bytes is used.
   , m_rtpPacketSizeMax(10*1024)
+  , m_mediaReactor(NULL)
+  , m_mediaPatchExecutor(NULL)
+  , m_signalingReactor(NULL)
   , m_mediaFormatOrder(PARRAYSIZE(DefaultMediaFormatOrder), DefaultMediaFormatOrder)
   , m_mediaFormatMask(PARRAYSIZE(DefaultMediaFormatMask), DefaultMediaFormatMask)
   , m_disableDetectInBandDTMF(false)
@@ -325,6 +328,7 @@ OpalManager::OpalManager()
   , m_natMethods(new PNatMethods(true))
   , m_onInterfaceChange(PCREATE_InterfaceNotifier(OnInterfaceChange))
 #endif
+  , m_routeBuildTable(NULL)
   , lastCallTokenID(0)
   , P_DISABLE_MSVC_WARNINGS(4355, m_activeCalls(*this))
   , m_clearingAllCallsCount(0)
@@ -410,6 +414,11 @@ OpalManager::~OpalManager()
   delete m_natMethods;
 #endif
 
+  // All media patches and transports should be gone by now
+  delete m_mediaPatchExecutor;
+  delete m_mediaReactor;
+  delete m_signalingReactor;
+
   OpalMediaFormat::RemoveRegisteredMediaFormats("*");
 
   PTRACE(4, "Deleted manager.");
@@ -1654,7 +1663,118 @@ bool OpalManager::RouteEntry::IsMatch(const PString & search) const
 }
 
 
-PBoolean OpalManager::AddRouteEntry(const PString & spec)
+/* Get the part of the pattern that must literally be at the start of any
+   string it matches, in lower case as route patterns ignore case. */
+static std::string GetRoutePatternPrefix(const PString & pattern)
+{
+  // Alternatives could start with anything
+  if (pattern.Find('|') != P_MAX_INDEX)
+    return std::string();
+
+  PINDEX length = pattern.FindOneOf(".[]()*+?{}^$\\");
+  if (length == P_MAX_INDEX)
+    length = pattern.GetLength();
+  else if (length > 0 && strchr("*?{", pattern[length]) != NULL)
+    --length; // Previous character may not be present at all
+
+  return (const char *)pattern.Left(length).ToLower();
+}
+
+
+void OpalManager::RouteIndex::Clear()
+{
+  m_partyA.m_prefixes.clear();
+  m_partyA.m_lengths.clear();
+  m_partyB.m_prefixes.clear();
+  m_partyB.m_lengths.clear();
+  m_unindexed.clear();
+}
+
+
+void OpalManager::RouteIndex::Swap(RouteIndex & other)
+{
+  m_partyA.m_prefixes.swap(other.m_partyA.m_prefixes);
+  m_partyA.m_lengths.swap(other.m_partyA.m_lengths);
+  m_partyB.m_prefixes.swap(other.m_partyB.m_prefixes);
+  m_partyB.m_lengths.swap(other.m_partyB.m_lengths);
+  m_unindexed.swap(other.m_unindexed);
+}
+
+
+void OpalManager::RouteIndex::Add(const RouteEntry & entry, PINDEX index)
+{
+  // The B-Party is usually the more discriminating, e.g. dialled digits
+  Party * party = &m_partyB;
+  std::string prefix = GetRoutePatternPrefix(entry.GetPartyB());
+  if (prefix.empty()) {
+    party = &m_partyA;
+    prefix = GetRoutePatternPrefix(entry.GetPartyA());
+    if (prefix.empty()) {
+      m_unindexed.push_back(index);
+      return;
+    }
+  }
+
+  party->m_prefixes[prefix].push_back(index);
+  party->m_lengths.insert(prefix.length());
+}
+
+
+void OpalManager::RouteIndex::Build(const RouteTable & table)
+{
+  Clear();
+  for (PINDEX i = 0; i < table.GetSize(); ++i)
+    Add(table[i], i);
+  PTRACE(4, "Route index built: entries=" << table.GetSize() << ", "
+            "A-Party prefixes=" << m_partyA.m_prefixes.size() << ", "
+            "B-Party prefixes=" << m_partyB.m_prefixes.size() << ", "
+            "unindexed=" << m_unindexed.size());
+}
+
+
+void OpalManager::RouteIndex::Lookup(const Party & party, const std::string & str, PINDEX start, std::vector<PINDEX> & candidates) const
+{
+  std::string prefix;
+  for (std::set<size_t>::const_iterator length = party.m_lengths.begin(); length != party.m_lengths.end(); ++length) {
+    if (*length > str.length())
+      break;
+
+    prefix.assign(str, 0, *length);
+    PrefixMap::const_iterator it = party.m_prefixes.find(prefix);
+    if (it != party.m_prefixes.end())
+      candidates.insert(candidates.end(), std::lower_bound(it->second.begin(), it->second.end(), start), it->second.end());
+  }
+}
+
+
+PINDEX OpalManager::RouteIndex::Find(const RouteTable & table, const PString & search, PINDEX start) const
+{
+  /* The pattern is "^(A)\t(B)$", so if the search has exactly one tab then A
+     and B must match either side of it, and we can use the prefixes. */
+  PINDEX tab = search.Find('\t');
+  if (tab == P_MAX_INDEX || search.Find('\t', tab+1) != P_MAX_INDEX) {
+    for (PINDEX i = start; i < table.GetSize(); ++i) {
+      if (table[i].IsMatch(search))
+        return i;
+    }
+    return P_MAX_INDEX;
+  }
+
+  std::vector<PINDEX> candidates(std::lower_bound(m_unindexed.begin(), m_unindexed.end(), start), m_unindexed.end());
+  Lookup(m_partyA, (const char *)search.Left(tab).ToLower(), start, candidates);
+  Lookup(m_partyB, (const char *)search.Mid(tab+1).ToLower(), start, candidates);
+  std::sort(candidates.begin(), candidates.end());
+
+  for (std::vector<PINDEX>::iterator it = candidates.begin(); it != candidates.end(); ++it) {
+    if (table[*it].IsMatch(search))
+      return *it;
+  }
+
+  return P_MAX_INDEX;
+}
+
+
+bool OpalManager::ParseRouteEntry(const PString & spec, RouteTable & table)
 {
   if (spec[0] == '#') // Comment
     return false;
@@ -1666,7 +1786,8 @@ PBoolean OpalManager::AddRouteEntry(const PString & spec)
       return false;
     }
     PTRACE(4, "Adding routes from file \"" << file.GetFilePath() << '"');
-    PBoolean ok = false;
+    // Each line goes through the virtual, so overrides see every entry
+    bool ok = false;
     PString line;
     while (file.good()) {
       file >> line;
@@ -1684,37 +1805,72 @@ PBoolean OpalManager::AddRouteEntry(const PString & spec)
   }
 
   PTRACE(4, "Added route \"" << *entry << '"');
-  m_routeMutex.Wait();
-  m_routeTable.Append(entry);
-  m_routeMutex.Signal();
+  table.Append(entry);
   return true;
 }
 
 
-PBoolean OpalManager::SetRouteTable(const PStringArray & specs)
+PBoolean OpalManager::AddRouteEntry(const PString & spec)
 {
-  PBoolean ok = false;
+  PWaitAndSignal build(m_routeBuildMutex);
+
+  // Compile outside of the route lock, so routing of other calls is not held up
+  RouteTable entries;
+  entries.DisallowDeleteObjects();
+  if (!ParseRouteEntry(spec, entries))
+    return false;
 
-  m_routeMutex.Wait();
-  m_routeTable.RemoveAll();
+  if (m_routeBuildTable != NULL) {
+    // Called from SetRouteTable(), add to the new table, which it indexes
+    for (PINDEX i = 0; i < entries.GetSize(); ++i)
+      m_routeBuildTable->Append(&entries[i]);
+    return true;
+  }
 
+  PWriteWaitAndSignal mutex(m_routeMutex);
+  for (PINDEX i = 0; i < entries.GetSize(); ++i) {
+    m_routeIndex.Add(entries[i], m_routeTable.GetSize());
+    m_routeTable.Append(&entries[i]);
+  }
+  return true;
+}
+
+
+PBoolean OpalManager::SetRouteTable(const PStringArray & specs)
+{
+  PWaitAndSignal build(m_routeBuildMutex);
+
+  // Build new table outside of the route lock, so routing continues with old table
+  RouteTable table;
+  m_routeBuildTable = &table;
+  bool ok = false;
   for (PINDEX i = 0; i < specs.GetSize(); i++) {
     if (AddRouteEntry(specs[i].Trim()))
       ok = true;
   }
+  m_routeBuildTable = NULL;
 
-  m_routeMutex.Signal();
+  RouteIndex index;
+  index.Build(table);
 
+  PWriteWaitAndSignal mutex(m_routeMutex);
+  m_routeTable = table;
+  m_routeIndex.Swap(index);
   return ok;
 }
 
 
 void OpalManager::SetRouteTable(const RouteTable & table)
 {
-  m_routeMutex.Wait();
-  m_routeTable = table;
-  m_routeTable.MakeUnique();
-  m_routeMutex.Signal();
+  RouteTable newTable = table;
+  newTable.MakeUnique();
+
+  RouteIndex index;
+  index.Build(newTable);
+
+  PWriteWaitAndSignal mutex(m_routeMutex);
+  m_routeTable = newTable;
+  m_routeIndex.Swap(index);
 }
 
 
@@ -1723,7 +1879,7 @@ PString OpalManager::ApplyRouteTable(const PString & a_party, const PString & b_
   PString destination;
 
   {
-    PWaitAndSignal mutex(m_routeMutex);
+    PReadWaitAndSignal mutex(m_routeMutex);
 
     if (m_routeTable.IsEmpty())
       return routeIndex++ == 0 ? b_party : PString::Empty();
@@ -1753,18 +1909,22 @@ PString OpalManager::ApplyRouteTable(const PString & a_party, const PString & b_
           */
 
     while (routeIndex < m_routeTable.GetSize()) {
-      RouteEntry & entry = m_routeTable[routeIndex++];
-      if (entry.IsMatch(search)) {
-        search = entry.GetDestination();
+      PINDEX match = m_routeIndex.Find(m_routeTable, search, routeIndex);
+      if (match == P_MAX_INDEX) {
+        routeIndex = m_routeTable.GetSize();
+        break;
+      }
 
-        if (search.NumCompare("label:") != EqualTo) {
-          destination = search;
-          break;
-        }
+      routeIndex = match+1;
+      search = m_routeTable[match].GetDestination();
 
-        // restart search in table using label.
-        routeIndex = 0;
+      if (search.NumCompare("label:") != EqualTo) {
+        destination = search;
+        break;
       }
+
+      // restart search in table using label.
+      routeIndex = 0;
     }
   }
 
@@ -2134,6 +2294,98 @@ void OpalManager::SetMediaQoS(const OpalMediaType & type, const PIPSocket::QoS &
 }
 
 
+bool OpalManager::SetMediaReactorThreads(unsigned count)
+{
+  if (count == GetMediaReactorThreads())
+    return true;
+
+  if (m_mediaReactor != NULL) {
+    if (m_mediaReactor->GetChannelCount() > 0) {
+      PTRACE(2, "Cannot change media reactor threads while in use");
+      return false;
+    }
+    delete m_mediaReactor;
+    m_mediaReactor = NULL;
+  }
+
+  if (count == 0)
+    return true;
+
+  m_mediaReactor = new OpalMediaReactor(count);
+  if (m_mediaReactor->IsRunning())
+    return true;
+
+  delete m_mediaReactor;
+  m_mediaReactor = NULL;
+  return false;
+}
+
+
+unsigned OpalManager::GetMediaReactorThreads() const
+{
+  return m_mediaReactor != NULL ? m_mediaReactor->GetThreadCount() : 0;
+}
+
+
+bool OpalManager::SetMediaPatchThreads(unsigned count)
+{
+  if (count == GetMediaPatchThreads())
+    return true;
+
+  if (m_mediaPatchExecutor != NULL) {
+    if (m_mediaPatchExecutor->GetTaskCount() > 0) {
+      PTRACE(2, "Cannot change media patch threads while in use");
+      return false;
+    }
+    delete m_mediaPatchExecutor;
+    m_mediaPatchExecutor = NULL;
+  }
+
+  if (count > 0)
+    m_mediaPatchExecutor = new OpalMediaPatchExecutor(count);
+  return true;
+}
+
+
+unsigned OpalManager::GetMediaPatchThreads() const
+{
+  return m_mediaPatchExecutor != NULL ? m_mediaPatchExecutor->GetThreadCount() : 0;
+}
+
+
+bool OpalManager::SetSignalingReactorThreads(unsigned count, unsigned maxWorkers)
+{
+  if (count == GetSignalingReactorThreads())
+    return true;
+
+  if (m_signalingReactor != NULL) {
+    if (m_signalingReactor->GetTransportCount() > 0) {
+      PTRACE(2, "Cannot change signalling reactor threads while in use");
+      return false;
+    }
+    delete m_signalingReactor;
+    m_signalingReactor = NULL;
+  }
+
+  if (count == 0)
+    return true;
+
+  m_signalingReactor = new OpalSignalingReactor(count, maxWorkers);
+  if (m_signalingReactor->IsRunning())
+    return true;
+
+  delete m_signalingReactor;
+  m_signalingReactor = NULL;
+  return false;
+}
+
+
+unsigned OpalManager::GetSignalingReactorThreads() const
+{
+  return m_signalingReactor != NULL ? m_signalingReactor->GetThreadCount() : 0;
+}
+
+
 BYTE OpalManager::GetMediaTypeOfService(const OpalMediaType & type) const
 {
   return (BYTE)(m_mediaQoS[type].m_dscp << 2);
@@ -958,7 +958,9 @@ PBoolean OpalMediaFormat::MakeUnique()
     return true;
 
   m_info = (OpalMediaFormatInternal *)m_info->Clone();
+  m_info->m_wellKnown.Retire(m_info->options); // Clone's table refers to the shared options
   m_info->options.MakeUnique();
+  m_info->UpdateWellKnownOptions();
   return false;
 }
 
@@ -1257,7 +1259,6 @@ bool OpalMediaFormat::SetRegisteredMediaFormat(const OpalMediaFormat & mediaForm
          is really happening is the above only compares the name, and below
          copies all of the attributes (OpalMediaFormatOtions) across. */
       *format->m_info = *mediaFormat.m_info;
-      format->m_info->options.MakeUnique();
       return true;
     }
   }
@@ -1305,7 +1306,6 @@ OpalMediaFormatInternal::OpalMediaFormatInternal(const char * fullName,
   , forceIsTransportable(false)
   , m_allowMultiple(am)
 {
-
   AddOption(new OpalMediaOptionString(OpalMediaFormat::DescriptionOption(), true, fullName));
 
   if (nj)
@@ -1406,6 +1406,32 @@ void OpalMediaFormatInternal::DeconflictPayloadTypes(OpalMediaFormatList & forma
 }
 
 
+OpalMediaFormatInternal & OpalMediaFormatInternal::operator=(const OpalMediaFormatInternal & other)
+{
+  if (this == &other)
+    return *this;
+
+  PWaitAndSignal m1(m_mutex);
+  PWaitAndSignal m2(other.m_mutex);
+
+  formatName = other.formatName;
+  rtpPayloadType = other.rtpPayloadType;
+  rtpEncodingName = other.rtpEncodingName;
+  mediaType = other.mediaType;
+  codecVersionTime = other.codecVersionTime;
+  forceIsTransportable = other.forceIsTransportable;
+  m_allowMultiple = other.m_allowMultiple;
+
+  // Lock free readers may still be using the old options until the new ones are published
+  m_wellKnown.Retire(options);
+  options = other.options;
+  options.MakeUnique();
+  UpdateWellKnownOptions();
+
+  return *this;
+}
+
+
 PObject * OpalMediaFormatInternal::Clone() const
 {
   PWaitAndSignal m1(m_mutex);
@@ -1582,6 +1608,10 @@ bool OpalMediaFormatInternal::SetOptionBoolean(const PString & name, bool value)
 
 int OpalMediaFormatInternal::GetOptionInteger(const PString & name, int dflt) const
 {
+  WellKnownOptions wellKnown = GetWellKnownOption(name);
+  if (wellKnown < NumWellKnownOptions)
+    return GetWellKnownInteger(wellKnown, dflt);
+
   PWaitAndSignal m(m_mutex);
   OpalMediaOptionUnsigned * optUnsigned = dynamic_cast<OpalMediaOptionUnsigned *>(FindOption(name));
   if (optUnsigned != NULL)
@@ -1685,14 +1715,160 @@ bool OpalMediaFormatInternal::AddOption(OpalMediaOption * option, PBoolean overw
       return false;
     }
 
-    options.RemoveAt(index);
+    // Lock free readers may be using the old option until the new one is published
+    OpalMediaOption & oldOption = options[index];
+    if (m_wellKnown.Get().Contains(&oldOption)) {
+      options.DisallowDeleteObjects();
+      options.RemoveAt(index);
+      options.AllowDeleteObjects();
+      m_wellKnown.Retire(&oldOption);
+    }
+    else
+      options.RemoveAt(index);
   }
 
   options.Append(option);
+
+  WellKnownTable * table = new WellKnownTable(m_wellKnown.Get());
+  if (table->Set(option))
+    m_wellKnown.Publish(table);
+  else
+    delete table;
   return true;
 }
 
 
+static const PString & GetWellKnownOptionName(PINDEX option)
+{
+  switch (option) {
+    case OpalMediaFormatInternal::e_ClockRate :
+      return OpalMediaFormat::ClockRateOption();
+    case OpalMediaFormatInternal::e_FrameTime :
+      return OpalMediaFormat::FrameTimeOption();
+    case OpalMediaFormatInternal::e_MaxFrameSize :
+      return OpalMediaFormat::MaxFrameSizeOption();
+    case OpalMediaFormatInternal::e_MaxBitRate :
+      return OpalMediaFormat::MaxBitRateOption();
+    case OpalMediaFormatInternal::e_TargetBitRate :
+      return OpalMediaFormat::TargetBitRateOption();
+    case OpalMediaFormatInternal::e_TxFramesPerPacket :
+      return OpalAudioFormat::TxFramesPerPacketOption();
+    case OpalMediaFormatInternal::e_RxFramesPerPacket :
+      return OpalAudioFormat::RxFramesPerPacketOption();
+#if OPAL_VIDEO
+    case OpalMediaFormatInternal::e_FrameWidth :
+      return OpalVideoFormat::FrameWidthOption();
+    case OpalMediaFormatInternal::e_FrameHeight :
+      return OpalVideoFormat::FrameHeightOption();
+#endif // OPAL_VIDEO
+    default :
+      return PString::Empty();
+  }
+}
+
+
+OpalMediaFormatInternal::WellKnownOptions OpalMediaFormatInternal::GetWellKnownOption(const PString & name)
+{
+  // Compare references not strings, callers use the option name functions
+  for (PINDEX i = 0; i < NumWellKnownOptions; ++i) {
+    if (&name == &GetWellKnownOptionName(i))
+      return (WellKnownOptions)i;
+  }
+  return NumWellKnownOptions;
+}
+
+
+OpalMediaFormatInternal::WellKnownTable::WellKnownTable()
+{
+  memset(m_unsigned, 0, sizeof(m_unsigned));
+  memset(m_integer, 0, sizeof(m_integer));
+}
+
+
+bool OpalMediaFormatInternal::WellKnownTable::Set(const OpalMediaOption * option)
+{
+  for (PINDEX i = 0; i < NumWellKnownOptions; ++i) {
+    if (option->GetName() == GetWellKnownOptionName(i)) {
+      m_unsigned[i] = dynamic_cast<const OpalMediaOptionUnsigned *>(option);
+      m_integer[i] = dynamic_cast<const OpalMediaOptionInteger *>(option);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool OpalMediaFormatInternal::WellKnownTable::Contains(const OpalMediaOption * option) const
+{
+  for (PINDEX i = 0; i < NumWellKnownOptions; ++i) {
+    if (m_unsigned[i] == option || m_integer[i] == option)
+      return true;
+  }
+  return false;
+}
+
+
+OpalMediaFormatInternal::WellKnownTables::WellKnownTables()
+  : m_current(new WellKnownTable)
+{
+}
+
+
+OpalMediaFormatInternal::WellKnownTables::WellKnownTables(const WellKnownTables & other)
+  : m_current(new WellKnownTable(other.Get()))
+{
+}
+
+
+OpalMediaFormatInternal::WellKnownTables & OpalMediaFormatInternal::WellKnownTables::operator=(const WellKnownTables & other)
+{
+  if (this != &other)
+    Publish(new WellKnownTable(other.Get()));
+  return *this;
+}
+
+
+OpalMediaFormatInternal::WellKnownTables::~WellKnownTables()
+{
+  delete m_current;
+  for (size_t i = 0; i < m_oldTables.size(); ++i)
+    delete m_oldTables[i];
+  for (size_t i = 0; i < m_oldOptions.size(); ++i)
+    delete m_oldOptions[i];
+}
+
+
+void OpalMediaFormatInternal::WellKnownTables::Publish(WellKnownTable * table)
+{
+  // Writers are serialised by the OpalMediaFormatInternal mutex
+  m_oldTables.push_back(m_current);
+  m_current = table;
+}
+
+
+void OpalMediaFormatInternal::WellKnownTables::Retire(OpalMediaOption * option)
+{
+  m_oldOptions.push_back(option);
+}
+
+
+void OpalMediaFormatInternal::WellKnownTables::Retire(const PSortedList<OpalMediaOption> & options)
+{
+  m_oldLists.push_back(options);
+}
+
+
+void OpalMediaFormatInternal::UpdateWellKnownOptions()
+{
+  PWaitAndSignal m(m_mutex);
+
+  WellKnownTable * table = new WellKnownTable;
+  for (PINDEX i = 0; i < options.GetSize(); i++)
+    table->Set(&options[i]);
+  m_wellKnown.Publish(table);
+}
+
+
 class OpalMediaOptionSearchArg : public OpalMediaOption
 {
 public:
@@ -44,6 +44,12 @@
 #include <ptclib/cypher.h>
 #include <ptclib/pstunsrvr.h>
 
+#ifdef P_LINUX
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <netinet/udp.h>
+#endif
+
 
 #define PTraceModule() "Media"
 #define new PNEW
@@ -139,6 +145,9 @@ OpalNetworkStatistics::OpalNetworkStatistics()
   , m_lastReportTime(0)
   , m_targetBitRate(0)
   , m_targetFrameRate(0)
+  , m_rxTransportPackets(0)
+  , m_rxTransportReads(0)
+  , m_rxTransportAllocs(0)
 {
 }
 
@@ -168,6 +177,8 @@ OpalVideoStatistics::OpalVideoStatistics()
   , m_frameHeight(0)
   , m_tsto(0)
   , m_videoQuality(-1)
+  , m_framePoolHits(0)
+  , m_framePoolMisses(0)
 {
 }
 
@@ -434,6 +445,10 @@ void OpalMediaStatistics::PrintOn(ostream & strm) const
   if (m_roundTripTime >= 0)
     strm << setw(indent) <<       "Round Trip Time" << " = " << m_roundTripTime << '\n';
 
+  if (m_rxTransportPackets > 0)
+    strm << setw(indent) <<      "Reads per packet" << " = " << (double)m_rxTransportReads/m_rxTransportPackets << '\n'
+         << setw(indent) <<     "Allocs per packet" << " = " << (double)m_rxTransportAllocs/m_rxTransportPackets << '\n';
+
   if (m_mediaType == OpalMediaType::Audio()) {
     strm << setw(indent) <<           "JB too late" << " = " << m_packetsTooLate << '\n'
          << setw(indent) <<           "JB overruns" << " = " << m_packetOverruns << '\n';
@@ -452,6 +467,10 @@ void OpalMediaStatistics::PrintOn(ostream & strm) const
          << setw(indent) <<        "Dropped frames" << " = " << m_droppedFrames << '\n';
     if (m_videoQuality >= 0)
       strm << setw(indent) <<  "Video quality (QP)" << " = " << m_videoQuality << '\n';
+    if (m_framePoolHits + m_framePoolMisses > 0)
+      strm << setw(indent) <<  "Encoder buffer pool" << " = " << m_framePoolHits << " hits, "
+           << m_framePoolMisses << " misses, "
+           << (unsigned)(100.0*m_framePoolHits/(m_framePoolHits + m_framePoolMisses)) << "% hit rate\n";
   }
 #endif
 #if OPAL_FAX
@@ -596,6 +615,8 @@ OpalMediaTransport::OpalMediaTransport(const PString & name)
   , m_opened(false)
   , m_established(false)
   , m_started(false)
+  , m_reactor(NULL)
+  , m_reactorChannels(0)
   , m_congestionControl(NULL)
 {
   m_ccTimer.SetNotifier(PCREATE_NOTIFIER(ProcessCongestionControl), "RTP-CC");
@@ -608,6 +629,7 @@ OpalMediaTransport::~OpalMediaTransport()
   for (vector<ChannelInfo>::iterator it = m_subchannels.begin(); it != m_subchannels.end(); ++it) {
     delete it->m_channel;
     delete it->m_thread;
+    delete it->m_rxPool;
   }
 
   delete m_congestionControl.exchange(NULL);
@@ -677,6 +699,24 @@ bool OpalMediaTransport::IsEstablished() const
 }
 
 
+bool OpalMediaTransport::CanUseMediaReactor() const
+{
+  return true;
+}
+
+
+bool OpalMediaTransport::BeginWriteBatch(SubChannels)
+{
+  return false;
+}
+
+
+bool OpalMediaTransport::EndWriteBatch()
+{
+  return true;
+}
+
+
 OpalTransportAddress OpalMediaTransport::GetLocalAddress(SubChannels subchannel) const
 {
   OpalTransportAddress addr;
@@ -789,12 +829,95 @@ void OpalMediaTransport::SetRemoteBehindNAT()
 }
 
 
+/* Pool of receive buffers, re-used once the read notifiers have released
+   them, so a read does not need a heap allocation per packet. Each buffer
+   has storage for the maximum packet, and a separate array that is attached
+   to that storage with the actual packet size, which is what is passed on
+   to the notifiers. If a notifier keeps a reference, e.g. in a jitter
+   buffer, that buffer is skipped until it is released. */
+struct OpalMediaTransport::RxBufferPool
+{
+  enum {
+    MaxBuffers = 32,
+    MaxBatch = 16
+  };
+
+  struct Buffer
+  {
+    Buffer(PINDEX size) : m_storage(size), m_inBatch(false) { }
+
+    PBYTEArray m_storage;
+    PBYTEArray m_packet;
+    bool       m_inBatch;
+  };
+
+  RxBufferPool(PINDEX packetSize)
+    : m_packetSize(packetSize)
+    , m_next(0)
+    , m_batchSize(1)
+    , m_packets(0)
+    , m_reads(0)
+    , m_allocations(0)
+  {
+  }
+
+  ~RxBufferPool()
+  {
+    for (vector<Buffer *>::iterator it = m_buffers.begin(); it != m_buffers.end(); ++it) {
+      if ((*it)->m_packet.IsUnique())
+        delete *it;
+      else {
+        // Someone still has a reference to the storage, so we must let it go
+        PTRACE(2, "Receive buffer still in use at close, cannot be released.");
+      }
+    }
+  }
+
+  Buffer * GetFree(bool canAllocate = true)
+  {
+    for (size_t i = 0; i < m_buffers.size(); ++i) {
+      Buffer * buffer = m_buffers[m_next];
+      if (++m_next >= m_buffers.size())
+        m_next = 0;
+      if (buffer->m_packet.IsUnique() && !buffer->m_inBatch)
+        return buffer;
+    }
+
+    if (!canAllocate || m_buffers.size() >= MaxBuffers)
+      return NULL;
+
+    ++m_allocations;
+    m_buffers.push_back(new Buffer(m_packetSize));
+    return m_buffers.back();
+  }
+
+  PINDEX           m_packetSize;
+  vector<Buffer *> m_buffers;
+  size_t           m_next;
+  unsigned         m_batchSize;
+
+  unsigned m_packets;
+  unsigned m_reads;
+  unsigned m_allocations;
+};
+
+
 #if OPAL_STATISTICS
 void OpalMediaTransport::GetStatistics(OpalMediaStatistics & statistics) const
 {
   statistics.m_transportName = m_name;
   statistics.m_localAddress  = GetLocalAddress(e_Media);
   statistics.m_remoteAddress = GetRemoteAddress(e_Media);
+
+  statistics.m_rxTransportPackets = statistics.m_rxTransportReads = statistics.m_rxTransportAllocs = 0;
+  for (ChannelArray::const_iterator it = m_subchannels.begin(); it != m_subchannels.end(); ++it) {
+    const RxBufferPool * pool = it->m_rxPool;
+    if (pool != NULL) {
+      statistics.m_rxTransportPackets += pool->m_packets;
+      statistics.m_rxTransportReads   += pool->m_reads;
+      statistics.m_rxTransportAllocs  += pool->m_allocations;
+    }
+  }
 }
 #endif
 
@@ -804,6 +927,8 @@ OpalMediaTransport::ChannelInfo::ChannelInfo(OpalMediaTransport & owner, SubChan
   , m_subchannel(subchannel)
   , m_channel(chan)
   , m_thread(NULL)
+  , m_polled(false)
+  , m_rxPool(NULL)
   , m_consecutiveUnavailableErrors(0)
   , m_remoteAddressSource(e_RemoteAddressUnknown)
   , m_lastError(PChannel::NoError)
@@ -818,74 +943,213 @@ void OpalMediaTransport::ChannelInfo::ThreadMain()
   PTRACE(4, &m_owner, m_owner << m_subchannel << " media transport read thread starting");
 
   while (m_channel->IsOpen()) {
-    PBYTEArray data(m_owner.m_packetSize);
+    if (ReadPacket() == e_ReadAborted)
+      break;
+  }
 
-    PTRACE(m_throttleReadPacket, &m_owner, m_owner << m_subchannel << " reading packet:"
-           " sz=" << data.GetSize() << ","
-           " timeout=" << m_channel->GetReadTimeout() << ","
-           " if=" << m_localAddress);
+  SendClosed();
 
-    if (m_channel->Read(data.GetPointer(), data.GetSize())) {
-      data.SetSize(m_channel->GetLastReadCount());
-      PTRACE_IF(4, m_remoteGoneError != PChannel::Timeout, &m_owner, m_owner << m_subchannel << " first receive data: sz=" << data.GetSize());
-      if (m_owner.InternalRxData(m_subchannel, data))
-        m_remoteGoneError = PChannel::Timeout;
+  PTRACE(4, &m_owner, m_owner << m_subchannel << " media transport read thread ended");
+}
+
+
+OpalMediaTransport::ChannelInfo::ReadResult OpalMediaTransport::ChannelInfo::ReadPacket()
+{
+#ifdef P_LINUX
+  // Batching needs non-blocking socket, and no wrapper channels that need to see every packet
+  if (m_polled && m_channel == m_channel->GetBaseReadChannel() && PIsDescendant(m_channel, PUDPSocket))
+    return ReadBatch();
+#endif
+
+  return ReadSingle();
+}
+
+
+OpalMediaTransport::ChannelInfo::ReadResult OpalMediaTransport::ChannelInfo::ReadSingle()
+{
+  PBYTEArray data;
+  BYTE * buffer;
+  RxBufferPool::Buffer * pooled = m_rxPool->GetFree();
+  if (pooled != NULL)
+    buffer = pooled->m_storage.GetPointer();
+  else {
+    buffer = data.GetPointer(m_owner.m_packetSize);
+    ++m_rxPool->m_allocations;
+  }
+
+  PTRACE(m_throttleReadPacket, &m_owner, m_owner << m_subchannel << " reading packet:"
+         " sz=" << m_owner.m_packetSize << ","
+         " timeout=" << m_channel->GetReadTimeout() << ","
+         " if=" << m_localAddress);
+
+  ++m_rxPool->m_reads;
+  if (m_channel->Read(buffer, m_owner.m_packetSize)) {
+    ++m_rxPool->m_packets;
+    if (pooled != NULL) {
+      pooled->m_packet.Attach(buffer, m_channel->GetLastReadCount());
+      data = pooled->m_packet;
     }
-    else {
-      P_INSTRUMENTED_LOCK_READ_ONLY2(lock, m_owner);
-      if (!lock.IsLocked())
-        break;
+    else
+      data.SetSize(m_channel->GetLastReadCount());
+    PTRACE_IF(4, m_remoteGoneError != PChannel::Timeout, &m_owner, m_owner << m_subchannel << " first receive data: sz=" << data.GetSize());
+    if (m_owner.InternalRxData(m_subchannel, data))
+      m_remoteGoneError = PChannel::Timeout;
+    return e_ReadData;
+  }
 
-      switch (m_channel->GetErrorCode(PChannel::LastReadError)) {
-        case PChannel::BufferTooSmall:
-          PTRACE(2, &m_owner, m_owner << m_subchannel << " read packet too large for buffer of " << data.GetSize() << " bytes.");
-          break;
+  P_INSTRUMENTED_LOCK_READ_ONLY2(lock, m_owner);
+  if (!lock.IsLocked())
+    return e_ReadAborted;
 
-        case PChannel::Interrupted:
-          PTRACE(4, &m_owner, m_owner << m_subchannel << " read packet interrupted.");
-          // Shouldn't happen, but it does.
-          break;
+  switch (m_channel->GetErrorCode(PChannel::LastReadError)) {
+    case PChannel::BufferTooSmall:
+      PTRACE(2, &m_owner, m_owner << m_subchannel << " read packet too large for buffer of " << m_owner.m_packetSize << " bytes.");
+      break;
 
-        case PChannel::NoError:
-          PTRACE(3, &m_owner, m_owner << m_subchannel << " received UDP packet with no payload.");
-          break;
+    case PChannel::Interrupted:
+      PTRACE(4, &m_owner, m_owner << m_subchannel << " read packet interrupted.");
+      // Shouldn't happen, but it does.
+      break;
 
-        case PChannel::Unavailable:
-          if (m_owner.m_mediaTimer.IsRunning()) {
-            HandleUnavailableError();
-            break;
-          }
-          // Do timeout case
-
-        case PChannel::Timeout:
-          if (m_owner.m_mediaTimer.IsRunning())
-            PTRACE(2, &m_owner, m_owner << m_subchannel << " timed out (" << m_channel->GetReadTimeout() << "s), other subchannels running");
-          else {
-            PTRACE(1, &m_owner, m_owner << m_subchannel << " timed out (" << m_owner.m_mediaTimeout << "s), closing");
-            m_owner.InternalClose();
-            m_lastError = m_remoteGoneError;
-          }
-          break;
+    case PChannel::NoError:
+      PTRACE(3, &m_owner, m_owner << m_subchannel << " received UDP packet with no payload.");
+      break;
 
-        default:
-          m_lastError = m_channel->GetErrorCode(PChannel::LastReadError);
-          PTRACE(1, &m_owner, m_owner << m_subchannel
-                 << " read error (" << m_channel->GetErrorNumber(PChannel::LastReadError) << "): "
-                 << m_channel->GetErrorText(PChannel::LastReadError));
-          m_owner.InternalClose();
-          break;
+    case PChannel::Unavailable:
+      if (m_owner.m_mediaTimer.IsRunning()) {
+        HandleUnavailableError();
+        break;
       }
+      HandleReadTimeout();
+      break;
+
+    case PChannel::Timeout:
+      // When polled the socket is non-blocking, so just means nothing more to read
+      if (m_polled)
+        return e_ReadNothing;
+      HandleReadTimeout();
+      break;
+
+    default:
+      m_lastError = m_channel->GetErrorCode(PChannel::LastReadError);
+      PTRACE(1, &m_owner, m_owner << m_subchannel
+             << " read error (" << m_channel->GetErrorNumber(PChannel::LastReadError) << "): "
+             << m_channel->GetErrorText(PChannel::LastReadError));
+      m_owner.InternalClose();
+      break;
+  }
+
+  return e_ReadFailed;
+}
+
+
+#ifdef P_LINUX
+OpalMediaTransport::ChannelInfo::ReadResult OpalMediaTransport::ChannelInfo::ReadBatch()
+{
+  // Get as many datagrams as we can in one system call, straight into pooled buffers.
+  RxBufferPool::Buffer * buffers[RxBufferPool::MaxBatch];
+  struct iovec iov[RxBufferPool::MaxBatch];
+  struct sockaddr_storage addresses[RxBufferPool::MaxBatch];
+  struct mmsghdr messages[RxBufferPool::MaxBatch];
+
+  unsigned count = 0;
+  while (count < m_rxPool->m_batchSize) {
+    // Only grow the pool beyond what we have when under load
+    if ((buffers[count] = m_rxPool->GetFree(count == 0 || m_rxPool->m_batchSize > 1)) == NULL)
+      break;
+    buffers[count]->m_inBatch = true;
+
+    iov[count].iov_base = buffers[count]->m_storage.GetPointer();
+    iov[count].iov_len = m_owner.m_packetSize;
+    memset(&messages[count], 0, sizeof(messages[count]));
+    messages[count].msg_hdr.msg_iov = &iov[count];
+    messages[count].msg_hdr.msg_iovlen = 1;
+    messages[count].msg_hdr.msg_name = &addresses[count];
+    messages[count].msg_hdr.msg_namelen = sizeof(addresses[count]);
+    ++count;
+  }
+
+  for (unsigned i = 0; i < count; ++i)
+    buffers[i]->m_inBatch = false;
+
+  if (count == 0)
+    return ReadSingle(); // Everything held by notifiers, fall back to allocating
+
+  ++m_rxPool->m_reads;
+  int received = recvmmsg(m_channel->GetHandle(), messages, count, MSG_DONTWAIT, NULL);
+  if (received <= 0) {
+    if (received == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+      return e_ReadNothing;
+    if (errno == EINTR)
+      return e_ReadFailed;
+
+    // Let the usual read path get and handle the error
+    return ReadSingle();
+  }
+
+  // Adapt how many buffers we use, full batch means there is probably more waiting
+  if ((unsigned)received == count && count == m_rxPool->m_batchSize)
+    m_rxPool->m_batchSize = std::min(m_rxPool->m_batchSize*2, (unsigned)RxBufferPool::MaxBatch);
+  else if (m_rxPool->m_batchSize > 1 && (unsigned)received < m_rxPool->m_batchSize/2)
+    m_rxPool->m_batchSize /= 2;
+
+  for (int i = 0; i < received; ++i) {
+    ++m_rxPool->m_packets;
+
+    if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+      PTRACE(2, &m_owner, m_owner << m_subchannel << " read packet too large for buffer of " << m_owner.m_packetSize << " bytes.");
+      continue;
     }
+
+    PIPSocket::Address ip(addresses[i].ss_family, messages[i].msg_hdr.msg_namelen, (struct sockaddr *)&addresses[i]);
+    WORD port = ntohs(addresses[i].ss_family == AF_INET6 ? ((struct sockaddr_in6 *)&addresses[i])->sin6_port
+                                                         : ((struct sockaddr_in *)&addresses[i])->sin_port);
+    m_batchReceiveAddress.SetAddress(ip, port);
+
+    buffers[i]->m_packet.Attach(buffers[i]->m_storage.GetPointer(), messages[i].msg_len);
+    PTRACE_IF(4, m_remoteGoneError != PChannel::Timeout, &m_owner, m_owner << m_subchannel << " first receive data: sz=" << messages[i].msg_len);
+    if (m_owner.InternalRxData(m_subchannel, buffers[i]->m_packet))
+      m_remoteGoneError = PChannel::Timeout;
   }
 
+  m_batchReceiveAddress = PIPSocketAddressAndPort();
+  return e_ReadData;
+}
+#endif // P_LINUX
+
+
+void OpalMediaTransport::ChannelInfo::HandleReadTimeout()
+{
+  if (m_owner.m_mediaTimer.IsRunning())
+    PTRACE(2, &m_owner, m_owner << m_subchannel << " timed out (" << m_channel->GetReadTimeout() << "s), other subchannels running");
+  else {
+    PTRACE(1, &m_owner, m_owner << m_subchannel << " timed out (" << m_owner.m_mediaTimeout << "s), closing");
+    m_owner.InternalClose();
+    m_lastError = m_remoteGoneError;
+  }
+}
+
+
+void OpalMediaTransport::ChannelInfo::CheckMediaTimeout()
+{
+  // Polled equivalent of the read timeout, as socket never blocks
+  if (m_owner.m_mediaTimer.IsRunning())
+    return;
+
+  P_INSTRUMENTED_LOCK_READ_ONLY2(lock, m_owner);
+  if (lock.IsLocked() && m_owner.m_opened)
+    HandleReadTimeout();
+}
+
+
+void OpalMediaTransport::ChannelInfo::SendClosed()
+{
   // Send and empty packet to consumer to indicate transport has closed.
   if (m_owner.LockReadOnly(P_DEBUG_LOCATION)) {
     ChannelInfo::NotifierList notifiers = m_notifiers;
     m_owner.UnlockReadOnly(P_DEBUG_LOCATION);
     notifiers(m_owner, PBYTEArray());
   }
-
-  PTRACE(4, &m_owner, m_owner << m_subchannel << " media transport read thread ended");
 }
 
 
@@ -922,6 +1186,10 @@ void OpalMediaTransport::InternalClose()
   m_opened = m_established = false;
 
   for (vector<ChannelInfo>::iterator it = m_subchannels.begin(); it != m_subchannels.end(); ++it) {
+    // Must remove from reactor before the handle is closed and possibly re-used
+    if (it->m_polled && m_reactor != NULL)
+      m_reactor->Close(*this, it->m_subchannel);
+
     if (it->m_channel != NULL) {
       if (it->m_channel->CloseBaseReadChannel())
         PTRACE(4, *this << it->m_subchannel << " closing.");
@@ -964,9 +1232,17 @@ void OpalMediaTransport::Start()
   if (!lock.IsLocked())
     return;
 
-  PTRACE(4, *this << "starting read theads, " << m_subchannels.size() << " sub-channels");
+  bool useReactor = m_reactor != NULL && m_reactor->IsRunning() && CanUseMediaReactor();
+
+  PTRACE(4, *this << "starting read " << (useReactor ? "reactor" : "theads") << ", " << m_subchannels.size() << " sub-channels");
   for (ChannelArray::iterator it = m_subchannels.begin(); it != m_subchannels.end(); ++it) {
-    if (it->m_channel != NULL && it->m_thread == NULL) {
+    if (it->m_channel != NULL && it->m_thread == NULL && !it->m_polled) {
+      if (it->m_rxPool == NULL)
+        it->m_rxPool = new RxBufferPool(m_packetSize);
+
+      if (useReactor && m_reactor->Add(*this, it->m_subchannel))
+        continue;
+
       PStringStream threadName;
       threadName << m_name;
       if (m_subchannels.size() > 1)
@@ -993,6 +1269,10 @@ bool OpalMediaTransport::GarbageCollection()
       return false;
   }
 
+  // Reactor still has to send final empty packet to notifiers
+  if (m_reactorChannels > 0)
+    return false;
+
   PTRACE(4, *this << "stopped " << m_subchannels.size() << " subchannel(s).");
   return true;
 }
@@ -1020,6 +1300,381 @@ PChannel * OpalMediaTransport::AddWrapperChannels(SubChannels /*subchannel*/, PC
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+struct OpalMediaReactor::Handle
+{
+  Handle(OpalMediaTransport & transport, PINDEX subchannel, int fd)
+    : m_transport(transport)
+    , m_subchannel(subchannel)
+    , m_fd(fd)
+    , m_closing(false)
+    , m_dispatching(false)
+  { }
+
+  OpalMediaTransport & m_transport;
+  PINDEX               m_subchannel;
+  int                  m_fd;
+  PDECLARE_MUTEX(      m_mutex);
+  bool                 m_closing;
+  bool                 m_dispatching;
+};
+
+
+static const PTimeInterval CheckChannelsInterval(0, 1);
+
+#ifdef P_LINUX
+static const int      MaxEventsPerWait = 32;
+static const int      EventWaitTimeoutMS = 100;
+static const unsigned MaxPacketsPerDispatch = 16;
+#endif
+
+
+OpalMediaReactor::OpalMediaReactor(unsigned threadCount)
+  : m_running(false)
+  , m_epollFd(-1)
+  , m_wakeFd(-1)
+  , m_checkTimer(CheckChannelsInterval)
+{
+#ifdef P_LINUX
+  if (threadCount == 0)
+    return;
+
+  if ((m_epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    PTRACE(1, "Could not create epoll for media reactor: errno=" << errno);
+    return;
+  }
+
+  if ((m_wakeFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) < 0) {
+    PTRACE(1, "Could not create event for media reactor: errno=" << errno);
+    return;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev) < 0) {
+    PTRACE(1, "Could not add wake event to media reactor: errno=" << errno);
+    return;
+  }
+
+  m_running = true;
+  m_threadPasses.resize(threadCount);
+  for (unsigned i = 0; i < threadCount; ++i)
+    m_threads.push_back(new PThreadObj1Arg<OpalMediaReactor, unsigned>(*this, i, &OpalMediaReactor::ThreadMain,
+                                                                      false, PSTRSTRM("Media-IO:" << i), PThread::HighPriority));
+  PTRACE(3, "Started media reactor with " << threadCount << " threads");
+#else
+  PTRACE_IF(2, threadCount > 0, "Media reactor not supported on this platform, using thread per channel");
+#endif
+}
+
+
+OpalMediaReactor::~OpalMediaReactor()
+{
+  m_running = false;
+  Wake();
+
+  for (vector<PThread *>::iterator it = m_threads.begin(); it != m_threads.end(); ++it) {
+    PTRACE_IF(2, !(*it)->WaitForTermination(10000), "Media reactor thread did not terminate");
+    delete *it;
+  }
+
+  // Anything left gets the final empty packet before we go
+  {
+    vector<HandleKey> remaining;
+    {
+      PWaitAndSignal lock(m_mutex);
+      for (HandleMap::iterator it = m_handles.begin(); it != m_handles.end(); ++it)
+        remaining.push_back(it->first);
+    }
+    for (vector<HandleKey>::iterator it = remaining.begin(); it != remaining.end(); ++it)
+      Close(*it->first, it->second);
+  }
+  Housekeeping(true);
+
+#ifdef P_LINUX
+  if (m_wakeFd >= 0)
+    ::close(m_wakeFd);
+  if (m_epollFd >= 0)
+    ::close(m_epollFd);
+#endif
+}
+
+
+PINDEX OpalMediaReactor::GetChannelCount() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_handles.size();
+}
+
+
+bool OpalMediaReactor::Add(OpalMediaTransport & transport, PINDEX subchannel)
+{
+#ifdef P_LINUX
+  if (!m_running)
+    return false;
+
+  OpalMediaTransport::ChannelInfo & info = transport.m_subchannels[subchannel];
+  PChannel * base = info.m_channel->GetBaseReadChannel();
+  if (base == NULL || !base->IsOpen())
+    return false;
+
+  Handle * handle = new Handle(transport, subchannel, base->GetHandle());
+
+  // Channel must never block from now on, Timeout means "nothing to read"
+  info.m_polled = true;
+  info.m_channel->SetReadTimeout(0);
+
+  PWaitAndSignal lock(m_mutex);
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN|EPOLLONESHOT;
+  ev.data.ptr = handle;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, handle->m_fd, &ev) < 0) {
+    PTRACE(2, &transport, transport << (OpalMediaTransport::SubChannels)subchannel
+           << " could not add to media reactor: errno=" << errno);
+    info.m_polled = false;
+    info.m_channel->SetReadTimeout(transport.m_mediaTimeout+200);
+    delete handle;
+    return false;
+  }
+
+  m_handles[HandleKey(&transport, subchannel)] = handle;
+  ++transport.m_reactorChannels;
+  PTRACE(4, &transport, transport << (OpalMediaTransport::SubChannels)subchannel << " added to media reactor, fd=" << handle->m_fd);
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+void OpalMediaReactor::Close(OpalMediaTransport & transport, PINDEX subchannel)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  HandleMap::iterator it = m_handles.find(HandleKey(&transport, subchannel));
+  if (it == m_handles.end())
+    return;
+
+  Handle & handle = *it->second;
+  {
+    PWaitAndSignal lock2(handle.m_mutex);
+    if (handle.m_closing)
+      return;
+    handle.m_closing = true;
+#ifdef P_LINUX
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, handle.m_fd, NULL);
+#endif
+  }
+
+  m_closed.push_back(&handle);
+  Wake();
+}
+
+
+void OpalMediaReactor::Wake()
+{
+#ifdef P_LINUX
+  if (m_wakeFd >= 0) {
+    eventfd_t one = 1;
+    if (eventfd_write(m_wakeFd, one) < 0 && errno != EAGAIN)
+      PTRACE(1, "Could not wake media reactor: errno=" << errno);
+  }
+#endif
+}
+
+
+void OpalMediaReactor::ThreadMain(unsigned index)
+{
+#ifdef P_LINUX
+  PTRACE(4, "Media reactor thread " << index << " started");
+
+  struct epoll_event events[MaxEventsPerWait];
+  while (m_running) {
+    bool housekeeping;
+    {
+      /* Bump our pass count, once it has moved past the value recorded when
+         a handle was retired, this thread cannot possibly hold a pointer
+         to it from a previous epoll_wait() and it is safe to delete. */
+      PWaitAndSignal lock(m_mutex);
+      ++m_threadPasses[index];
+      housekeeping = !m_closed.empty() || !m_retired.empty() || m_checkTimer.HasExpired();
+    }
+
+    if (housekeeping && m_housekeepingMutex.Wait(0)) {
+      Housekeeping(false);
+      m_housekeepingMutex.Signal();
+    }
+
+    int count = epoll_wait(m_epollFd, events, MaxEventsPerWait, EventWaitTimeoutMS);
+    if (count < 0) {
+      PTRACE_IF(1, errno != EINTR, "Media reactor wait failed: errno=" << errno);
+      continue;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.ptr != NULL)
+        Dispatch(*static_cast<Handle *>(events[i].data.ptr));
+      else {
+        eventfd_t value;
+        eventfd_read(m_wakeFd, &value);
+      }
+    }
+  }
+
+  PTRACE(4, "Media reactor thread " << index << " ended");
+#endif
+}
+
+
+void OpalMediaReactor::Dispatch(Handle & handle)
+{
+  {
+    PWaitAndSignal lock(handle.m_mutex);
+    if (handle.m_closing)
+      return;  // Transport may already be gone, do not touch
+    handle.m_dispatching = true;
+  }
+
+  OpalMediaTransport::ChannelInfo & info = handle.m_transport.m_subchannels[handle.m_subchannel];
+  PTRACE_CONTEXT_ID_PUSH_THREAD(handle.m_transport);
+
+  /* Drain a few packets, but not without limit, so one busy socket cannot
+     starve the others sharing this thread. Level triggered, so if there are
+     more, we will get called again. */
+  bool closed = false;
+  for (unsigned count = 0; count < MaxPacketsPerDispatch; ++count) {
+    if (!info.m_channel->IsOpen()) {
+      closed = true;
+      break;
+    }
+
+    OpalMediaTransport::ChannelInfo::ReadResult result = info.ReadPacket();
+    if (result == OpalMediaTransport::ChannelInfo::e_ReadNothing)
+      break;
+    if (result == OpalMediaTransport::ChannelInfo::e_ReadAborted) {
+      closed = true;
+      break;
+    }
+  }
+
+  if (closed)
+    Close(handle.m_transport, handle.m_subchannel);
+
+  Rearm(handle);
+}
+
+
+void OpalMediaReactor::Rearm(Handle & handle)
+{
+  PWaitAndSignal lock(handle.m_mutex);
+
+  handle.m_dispatching = false;
+  if (handle.m_closing)
+    return;
+
+#ifdef P_LINUX
+  struct epoll_event ev;
+  ev.events = EPOLLIN|EPOLLONESHOT;
+  ev.data.ptr = &handle;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_MOD, handle.m_fd, &ev) < 0)
+    PTRACE(2, &handle.m_transport, handle.m_transport << (OpalMediaTransport::SubChannels)handle.m_subchannel
+           << " could not re-arm in media reactor: errno=" << errno);
+#endif
+}
+
+
+void OpalMediaReactor::Housekeeping(bool shuttingDown)
+{
+  std::list<Handle *> closed;
+  vector<HandleKey> toCheck;
+  {
+    PWaitAndSignal lock(m_mutex);
+
+    closed.swap(m_closed);
+
+    std::list<Retired>::iterator it = m_retired.begin();
+    while (it != m_retired.end()) {
+      bool quiescent = true;
+      if (!shuttingDown) {
+        for (size_t i = 0; i < m_threadPasses.size(); ++i) {
+          if (it->m_passes[i] == m_threadPasses[i]) {
+            quiescent = false;
+            break;
+          }
+        }
+      }
+      if (quiescent) {
+        delete it->m_handle;
+        m_retired.erase(it++);
+      }
+      else
+        ++it;
+    }
+
+    if (!shuttingDown && m_checkTimer.HasExpired()) {
+      m_checkTimer = CheckChannelsInterval;
+      for (HandleMap::iterator it = m_handles.begin(); it != m_handles.end(); ++it) {
+        if (!it->second->m_closing)
+          toCheck.push_back(it->first);
+      }
+    }
+  }
+
+  for (std::list<Handle *>::iterator it = closed.begin(); it != closed.end(); ++it) {
+    Handle & handle = **it;
+
+    if (!shuttingDown) {
+      handle.m_mutex.Wait();
+      bool dispatching = handle.m_dispatching;
+      handle.m_mutex.Signal();
+      if (dispatching) {
+        // Still in use by some other thread, try again later
+        PWaitAndSignal lock(m_mutex);
+        m_closed.push_back(&handle);
+        continue;
+      }
+    }
+
+    OpalMediaTransport & transport = handle.m_transport;
+    PTRACE(4, &transport, transport << (OpalMediaTransport::SubChannels)handle.m_subchannel << " removed from media reactor");
+    transport.m_subchannels[handle.m_subchannel].SendClosed();
+
+    {
+      PWaitAndSignal lock(m_mutex);
+      m_handles.erase(HandleKey(&transport, handle.m_subchannel));
+      Retired retired;
+      retired.m_handle = &handle;
+      retired.m_passes = m_threadPasses;
+      m_retired.push_back(retired);
+    }
+
+    // Must be last, after this the transport may be garbage collected
+    --transport.m_reactorChannels;
+  }
+
+  if (shuttingDown) {
+    PWaitAndSignal lock(m_mutex);
+    for (std::list<Retired>::iterator it = m_retired.begin(); it != m_retired.end(); ++it)
+      delete it->m_handle;
+    m_retired.clear();
+    return;
+  }
+
+  /* Only housekeeping removes handles, so the transports of all those we
+     collected above cannot be garbage collected from under us. */
+  for (vector<HandleKey>::iterator it = toCheck.begin(); it != toCheck.end(); ++it) {
+    OpalMediaTransport::ChannelInfo & info = it->first->m_subchannels[it->second];
+    if (info.m_channel->IsOpen())
+      info.CheckMediaTimeout();
+    else
+      Close(*it->first, it->second);
+  }
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 OpalTCPMediaTransport::OpalTCPMediaTransport(const PString & name)
@@ -1075,9 +1730,22 @@ bool OpalTCPMediaTransport::Write(const void * data, PINDEX length, SubChannels
 
 //////////////////////////////////////////////////////////////////////////////
 
+// Limits of UDP segmentation offload, also reasonable for sendmmsg()
+static const PINDEX MaxWriteBatchBytes = 65000;
+static const size_t MaxWriteBatchPackets = 64;
+
+OpalUDPMediaTransport::WriteBatch::WriteBatch()
+  : m_thread(PNullThreadIdentifier)
+  , m_subchannel(e_Media)
+  , m_used(0)
+{
+}
+
+
 OpalUDPMediaTransport::OpalUDPMediaTransport(const PString & name)
   : OpalMediaTransport(name)
   , m_localHasRestrictedNAT(false)
+  , m_useSegmentOffload(true)
 {
 }
 
@@ -1099,8 +1767,9 @@ bool OpalUDPMediaTransport::InternalRxData(SubChannels subchannel, const PBYTEAr
   if (m_remoteBehindNAT) {
     // If remote address never set from higher levels, then try and figure
     // it out from the first packet received.
-    PIPAddressAndPort ap;
-    GetSubChannelAsSocket(subchannel)->GetLastReceiveAddress(ap);
+    PIPAddressAndPort ap = m_subchannels[subchannel].m_batchReceiveAddress;
+    if (!ap.IsValid())
+      GetSubChannelAsSocket(subchannel)->GetLastReceiveAddress(ap);
     InternalSetRemoteAddress(ap, subchannel, e_RemoteAddressFromFirstPacket);
     if (subchannel == e_Control) {
       ap.SetPort(ap.GetPort() - 1);
@@ -1301,6 +1970,7 @@ bool OpalUDPMediaTransport::Open(OpalMediaSession & session,
     SetRemoteBehindNAT();
   m_mediaTimeout = session.GetStringOptions().GetVar(OPAL_OPT_MEDIA_RX_TIMEOUT, manager.GetNoMediaTimeout());
   m_maxNoTransmitTime = session.GetStringOptions().GetVar(OPAL_OPT_MEDIA_TX_TIMEOUT, manager.GetTxMediaTimeout());
+  m_reactor = manager.GetMediaReactor();
 
   PIPAddress bindingIP(localInterface);
   if (!bindingIP.IsValid()) {
@@ -1432,12 +2102,41 @@ bool OpalUDPMediaTransport::Write(const void * data, PINDEX length, SubChannels
     return false;
   }
 
+  // Collect for FlushWriteBatch(), unless we need immediate feedback on MTU
+  if (m_writeBatch.m_thread == PThread::GetCurrentThreadId() &&
+      m_writeBatch.m_subchannel == subchannel &&
+      (m_mtuDiscoverMode < 0 || mtu == NULL) &&
+      length <= MaxWriteBatchBytes) {
+    if (!m_writeBatch.m_lengths.empty() &&
+            (!(m_writeBatch.m_destination == sendAddr) ||
+             m_writeBatch.m_used + length > MaxWriteBatchBytes ||
+             m_writeBatch.m_lengths.size() >= MaxWriteBatchPackets))
+      FlushWriteBatch();
+
+    memcpy(m_writeBatch.m_data.GetPointer(MaxWriteBatchBytes) + m_writeBatch.m_used, data, length);
+    m_writeBatch.m_used += length;
+    m_writeBatch.m_lengths.push_back(length);
+    m_writeBatch.m_destination = sendAddr;
+    return true;
+  }
+
+  return InternalWrite(*socket, subchannel, data, length, sendAddr, mtu);
+}
+
+
+bool OpalUDPMediaTransport::InternalWrite(PUDPSocket & socket,
+                                          SubChannels subchannel,
+                                          const void * data,
+                                          PINDEX length,
+                                          const PIPSocketAddressAndPort & sendAddr,
+                                          int * mtu)
+{
   PTRACE(m_subchannels[subchannel].m_throttleWritePacket,
          *this << "writing UDP media data: subchannel=" << subchannel << ", size=" << length << ", dest=" << sendAddr);
-  if (socket->WriteTo(data, length, sendAddr))
+  if (socket.WriteTo(data, length, sendAddr))
     return true;
 
-  switch (socket->GetErrorCode(PChannel::LastWriteError)) {
+  switch (socket.GetErrorCode(PChannel::LastWriteError)) {
     case PChannel::Unavailable:
       if (m_subchannels[subchannel].HandleUnavailableError())
         return true;
@@ -1445,7 +2144,7 @@ bool OpalUDPMediaTransport::Write(const void * data, PINDEX length, SubChannels
 
     case PChannel::BufferTooSmall:
       if (m_mtuDiscoverMode >= 0 && mtu != NULL) {
-        *mtu = socket->GetCurrentMTU();
+        *mtu = socket.GetCurrentMTU();
         return false;
       }
       break;
@@ -1457,12 +2156,178 @@ bool OpalUDPMediaTransport::Write(const void * data, PINDEX length, SubChannels
   PTRACE(1, *this << "error writing to " << sendAddr
                   << " (" << length << " bytes)"
                      " on " << subchannel << " subchannel"
-                     " (" << socket->GetErrorNumber(PChannel::LastWriteError) << "):"
-                     " " << socket->GetErrorText(PChannel::LastWriteError));
+                     " (" << socket.GetErrorNumber(PChannel::LastWriteError) << "):"
+                     " " << socket.GetErrorText(PChannel::LastWriteError));
   return false;
 }
 
 
+bool OpalUDPMediaTransport::BeginWriteBatch(SubChannels subchannel)
+{
+  PThreadIdentifier us = PThread::GetCurrentThreadId();
+  if (m_writeBatch.m_thread == us)
+    return false; // Nested batches not supported, outer one collects everything
+
+  // Mutex is held until EndWriteBatch(), other threads just write directly
+  if (!m_writeBatchMutex.Wait(0))
+    return false;
+
+  m_writeBatch.m_subchannel = subchannel;
+  m_writeBatch.m_thread = us;
+  return true;
+}
+
+
+bool OpalUDPMediaTransport::EndWriteBatch()
+{
+  if (!PAssert(m_writeBatch.m_thread == PThread::GetCurrentThreadId(), PLogicError))
+    return false;
+
+  bool ok;
+  if (LockReadOnly(P_DEBUG_LOCATION)) {
+    ok = FlushWriteBatch();
+    UnlockReadOnly(P_DEBUG_LOCATION);
+  }
+  else {
+    m_writeBatch.m_lengths.clear();
+    m_writeBatch.m_used = 0;
+    ok = false;
+  }
+
+  m_writeBatch.m_thread = PNullThreadIdentifier;
+  m_writeBatchMutex.Signal();
+  return ok;
+}
+
+
+#ifdef P_LINUX
+static socklen_t SetSocketAddress(const PIPSocketAddressAndPort & ap, struct sockaddr_storage & sa)
+{
+  memset(&sa, 0, sizeof(sa));
+
+#if OPAL_PTLIB_IPV6
+  if (ap.GetAddress().GetVersion() == 6) {
+    struct sockaddr_in6 & sin6 = reinterpret_cast<struct sockaddr_in6 &>(sa);
+    sin6.sin6_family = AF_INET6;
+    sin6.sin6_addr = ap.GetAddress();
+    sin6.sin6_port = htons(ap.GetPort());
+    return sizeof(sin6);
+  }
+#endif
+
+  struct sockaddr_in & sin = reinterpret_cast<struct sockaddr_in &>(sa);
+  sin.sin_family = AF_INET;
+  sin.sin_addr = ap.GetAddress();
+  sin.sin_port = htons(ap.GetPort());
+  return sizeof(sin);
+}
+#endif // P_LINUX
+
+
+bool OpalUDPMediaTransport::FlushWriteBatch()
+{
+  size_t count = m_writeBatch.m_lengths.size();
+  if (count == 0)
+    return true;
+
+  PUDPSocket * socket = GetSubChannelAsSocket(m_writeBatch.m_subchannel);
+  if (socket == NULL) {
+    m_writeBatch.m_lengths.clear();
+    m_writeBatch.m_used = 0;
+    return false;
+  }
+
+  const BYTE * data = m_writeBatch.m_data;
+  size_t sent = 0;
+
+#ifdef P_LINUX
+  if (count > 1) {
+    struct sockaddr_storage sa;
+    socklen_t saLen = SetSocketAddress(m_writeBatch.m_destination, sa);
+
+#ifdef UDP_SEGMENT
+    /* If all packets, except possibly the last, are the same size, as is
+       usually the case for a video frame, kernel can do the lot in one go. */
+    bool sameSize = m_useSegmentOffload;
+    for (size_t i = 1; sameSize && i < count; ++i)
+      sameSize = m_writeBatch.m_lengths[i] == m_writeBatch.m_lengths[0] ||
+                 (i == count-1 && m_writeBatch.m_lengths[i] < m_writeBatch.m_lengths[0]);
+    if (sameSize) {
+      struct iovec iov;
+      iov.iov_base = const_cast<BYTE *>(data);
+      iov.iov_len = m_writeBatch.m_used;
+
+      char control[CMSG_SPACE(sizeof(uint16_t))];
+      memset(control, 0, sizeof(control));
+
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name = &sa;
+      msg.msg_namelen = saLen;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_UDP;
+      cmsg->cmsg_type = UDP_SEGMENT;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      *(uint16_t *)CMSG_DATA(cmsg) = (uint16_t)m_writeBatch.m_lengths[0];
+
+      if (sendmsg(socket->GetHandle(), &msg, 0) >= 0)
+        sent = count;
+      else if (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP) {
+        PTRACE(3, *this << "UDP segmentation offload not available (errno=" << errno << "), using sendmmsg");
+        m_useSegmentOffload = false;
+      }
+    }
+#endif // UDP_SEGMENT
+
+    if (sent == 0) {
+      struct iovec iov[MaxWriteBatchPackets];
+      struct mmsghdr messages[MaxWriteBatchPackets];
+      memset(messages, 0, sizeof(messages[0])*count);
+
+      const BYTE * ptr = data;
+      for (size_t i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<BYTE *>(ptr);
+        iov[i].iov_len = m_writeBatch.m_lengths[i];
+        ptr += m_writeBatch.m_lengths[i];
+        messages[i].msg_hdr.msg_name = &sa;
+        messages[i].msg_hdr.msg_namelen = saLen;
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+      }
+
+      while (sent < count) {
+        int result = sendmmsg(socket->GetHandle(), &messages[sent], count - sent, 0);
+        if (result <= 0) {
+          if (result < 0 && errno == EINTR)
+            continue;
+          break;
+        }
+        sent += result;
+      }
+    }
+  }
+#endif // P_LINUX
+
+  // Anything not sent in bulk, including due to error, is sent individually so errors handled as usual
+  bool ok = true;
+  const BYTE * ptr = data;
+  for (size_t i = 0; i < count; ++i) {
+    if (i >= sent && !InternalWrite(*socket, m_writeBatch.m_subchannel, ptr, m_writeBatch.m_lengths[i], m_writeBatch.m_destination, NULL))
+      ok = false;
+    ptr += m_writeBatch.m_lengths[i];
+  }
+
+  m_writeBatch.m_lengths.clear();
+  m_writeBatch.m_used = 0;
+  return ok;
+}
+
+
 PUDPSocket * OpalUDPMediaTransport::GetSubChannelAsSocket(SubChannels subchannel) const
 {
   return (size_t)subchannel < m_socketCache.size() ? m_socketCache[subchannel] : NULL;
@@ -277,12 +277,31 @@ PBoolean OpalMediaStream::Close()
 
 PBoolean OpalMediaStream::WritePackets(RTP_DataFrameList & packets)
 {
+  bool batched = packets.GetSize() > 1 && BeginWriteBatch();
+
+  bool ok = true;
   for (RTP_DataFrameList::iterator packet = packets.begin(); packet != packets.end(); ++packet) {
-    if (!WritePacket(*packet))
-      return false;
+    if (!WritePacket(*packet)) {
+      ok = false;
+      break;
+    }
   }
 
-  return true;
+  if (batched)
+    EndWriteBatch();
+
+  return ok;
+}
+
+
+bool OpalMediaStream::BeginWriteBatch()
+{
+  return false;
+}
+
+
+void OpalMediaStream::EndWriteBatch()
+{
 }
 
 
@@ -408,6 +427,13 @@ PBoolean OpalMediaStream::PushPacket(RTP_DataFrame & packet)
 }
 
 
+bool OpalMediaStream::PushPackets(RTP_DataFrameList & packets)
+{
+  OpalMediaPatchPtr mediaPatch = m_mediaPatch;
+  return mediaPatch != NULL && mediaPatch->PushFrames(packets);
+}
+
+
 PBoolean OpalMediaStream::SetDataSize(PINDEX dataSize, PINDEX /*frameTime*/)
 {
   if (dataSize <= 0) {
@@ -40,16 +40,476 @@
 #include <opal/endpoint.h>
 #include <opal/transcoders.h>
 #include <rtp/rtpconn.h>
+#include <rtp/rtp_stream.h>
 
 #if OPAL_VIDEO
 #include <codec/vidcodec.h>
 #endif
 
+#ifdef P_LINUX
+#include <sched.h>
+#endif
+
 #define PTraceModule() "Patch"
 
 #define new PNEW
 
 
+static const PInt64 MaxExecutorCatchUp = 200; // milliseconds
+static const PInt64 MaxWheelDelay = 255*256;  // milliseconds
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+const unsigned OpalMediaPatchExecutor::JitterBucketLimits[OpalMediaPatchExecutor::NumJitterBuckets-1] = {
+  1, 2, 5, 10, 20, 50, 100
+};
+
+
+OpalMediaPatchExecutor::Task::Task()
+  : m_state(e_Idle)
+  , m_removed(false)
+  , m_deleteOnReturn(false)
+  , m_dueTick(0)
+  , m_threadId(PNullThreadIdentifier)
+  , m_prev(NULL)
+  , m_next(NULL)
+  , m_list(NULL)
+{
+}
+
+
+void OpalMediaPatchExecutor::TaskList::Append(Task & task)
+{
+  task.m_list = this;
+  task.m_next = NULL;
+  task.m_prev = m_tail;
+  if (m_tail != NULL)
+    m_tail->m_next = &task;
+  else
+    m_head = &task;
+  m_tail = &task;
+}
+
+
+void OpalMediaPatchExecutor::TaskList::Remove(Task & task)
+{
+  if (task.m_prev != NULL)
+    task.m_prev->m_next = task.m_next;
+  else
+    m_head = task.m_next;
+
+  if (task.m_next != NULL)
+    task.m_next->m_prev = task.m_prev;
+  else
+    m_tail = task.m_prev;
+
+  task.m_prev = task.m_next = NULL;
+  task.m_list = NULL;
+}
+
+
+OpalMediaPatchExecutor::Task * OpalMediaPatchExecutor::TaskList::PopHead()
+{
+  Task * task = m_head;
+  if (task != NULL)
+    Remove(*task);
+  return task;
+}
+
+
+OpalMediaPatchExecutor::OpalMediaPatchExecutor(unsigned threadCount, bool pinThreads)
+  : m_running(true)
+  , m_pinThreads(pinThreads)
+  , m_wheelThread(NULL)
+  , m_currentTick(GetTick())
+  , m_nextWakeTick(m_currentTick)
+  , m_waitingCount(0)
+  , m_taskCount(0)
+  , m_readySignal(0, INT_MAX)
+{
+  memset(m_jitterHistogram, 0, sizeof(m_jitterHistogram));
+
+  if (threadCount == 0)
+    threadCount = 1;
+
+  for (unsigned i = 0; i < threadCount; ++i)
+    m_workers.push_back(new PThreadObj1Arg<OpalMediaPatchExecutor, unsigned>(*this, i, &OpalMediaPatchExecutor::WorkerMain,
+                                                                             false, PSTRSTRM("Patch:" << i), PThread::HighPriority));
+  m_wheelThread = new PThreadObj<OpalMediaPatchExecutor>(*this, &OpalMediaPatchExecutor::WheelMain,
+                                                         false, "Patch Wheel", PThread::HighestPriority);
+  PTRACE(3, "Started media patch executor with " << threadCount << " threads");
+}
+
+
+OpalMediaPatchExecutor::~OpalMediaPatchExecutor()
+{
+  m_running = false;
+
+  m_wheelSignal.Signal();
+  PTRACE_IF(2, !m_wheelThread->WaitForTermination(10000), "Media patch wheel thread did not terminate");
+  delete m_wheelThread;
+
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    m_readySignal.Signal();
+  for (vector<PThread *>::iterator it = m_workers.begin(); it != m_workers.end(); ++it) {
+    PTRACE_IF(2, !(*it)->WaitForTermination(10000), "Media patch worker thread did not terminate");
+    delete *it;
+  }
+
+  PTRACE_IF(2, m_taskCount > 0, "Media patch executor destroyed with " << m_taskCount << " tasks outstanding");
+}
+
+
+void OpalMediaPatchExecutor::PrintOn(ostream & strm) const
+{
+  std::vector<PUInt64> counts;
+  GetJitterHistogram(counts);
+
+  strm << "threads=" << m_workers.size() << " tasks=" << GetTaskCount() << " jitter:";
+  for (PINDEX i = 0; i < NumJitterBuckets; ++i) {
+    if (i < NumJitterBuckets-1)
+      strm << " <" << JitterBucketLimits[i];
+    else
+      strm << " >=" << JitterBucketLimits[i-1];
+    strm << "ms=" << counts[i];
+  }
+}
+
+
+PInt64 OpalMediaPatchExecutor::GetTick()
+{
+  return PTimer::Tick().GetMilliSeconds();
+}
+
+
+void OpalMediaPatchExecutor::Schedule(Task & task, const PTimeInterval & delay)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  if (!PAssert(task.m_state == Task::e_Idle || task.m_state == Task::e_Finished, PInvalidParameter))
+    return;
+
+  ++m_taskCount;
+  task.m_removed = false;
+  task.m_deleteOnReturn = false;
+  task.m_dueTick = GetTick() + delay.GetMilliSeconds();
+  Insert(task);
+}
+
+
+void OpalMediaPatchExecutor::Remove(Task * & task)
+{
+  if (task == NULL)
+    return;
+
+  Task * removing = task;
+  task = NULL;
+
+  {
+    PWaitAndSignal lock(m_mutex);
+
+    switch (removing->m_state) {
+      case Task::e_Waiting :
+      case Task::e_Ready :
+        Unlink(*removing);
+        --m_taskCount;
+        break;
+
+      case Task::e_Running :
+        removing->m_removed = true;
+        if (removing->m_threadId == PThread::GetCurrentThreadId()) {
+          // Called from within Execute(), worker deletes it on return
+          removing->m_deleteOnReturn = true;
+          return;
+        }
+        break;
+
+      default :
+        break;
+    }
+  }
+
+  if (removing->m_removed) {
+    while (!removing->m_completed.Wait(10000)) {
+      PTRACE(2, "Waiting for media patch task " << removing << " to complete");
+    }
+  }
+
+  delete removing;
+}
+
+
+OpalMediaPatchExecutor::Batch::Batch()
+  : m_next(0)
+  , m_count(0)
+  , m_workerDone(0, INT_MAX)
+{
+}
+
+
+struct OpalMediaPatchExecutor::Batch::WorkerTask : public OpalMediaPatchExecutor::Task
+{
+  WorkerTask(Batch & batch)
+    : m_batch(batch)
+  {
+  }
+
+  virtual bool Execute(PTimeInterval &)
+  {
+    while (m_batch.RunNext())
+      m_batch.m_workerDone.Signal();
+    return false;
+  }
+
+  Batch & m_batch;
+};
+
+
+bool OpalMediaPatchExecutor::Batch::RunNext()
+{
+  unsigned index = m_next++;
+  if (index >= m_count)
+    return false;
+
+  RunJob(index);
+  return true;
+}
+
+
+void OpalMediaPatchExecutor::Batch::Run(OpalMediaPatchExecutor * executor, unsigned count)
+{
+  m_count = count;
+  m_next = 0;
+
+  if (executor == NULL || count < 2) {
+    while (RunNext())
+      ;
+    return;
+  }
+
+  // One worker task per job we are not doing ourselves, up to the pool size
+  std::vector<Task *> tasks(std::min(count-1, executor->GetThreadCount()));
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    tasks[i] = new WorkerTask(*this);
+    executor->Schedule(*tasks[i]);
+  }
+
+  unsigned ran = 0;
+  while (RunNext())
+    ++ran;
+
+  // Every job is now claimed, only wait for those running on workers
+  for (unsigned i = ran; i < count; ++i)
+    m_workerDone.Wait();
+
+  for (size_t i = 0; i < tasks.size(); ++i)
+    executor->Remove(tasks[i]);
+}
+
+
+PINDEX OpalMediaPatchExecutor::GetTaskCount() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_taskCount;
+}
+
+
+void OpalMediaPatchExecutor::GetJitterHistogram(std::vector<PUInt64> & counts) const
+{
+  PWaitAndSignal lock(m_mutex);
+  counts.assign(m_jitterHistogram, m_jitterHistogram+NumJitterBuckets);
+}
+
+
+void OpalMediaPatchExecutor::Insert(Task & task)
+{
+  // Called with m_mutex already locked
+  PInt64 delta = task.m_dueTick - m_currentTick;
+  if (delta <= 0) {
+    task.m_state = Task::e_Ready;
+    m_ready.Append(task);
+    m_readySignal.Signal();
+    return;
+  }
+
+  task.m_state = Task::e_Waiting;
+  ++m_waitingCount;
+
+  if (delta < WheelSize)
+    m_wheel[0][task.m_dueTick & WheelMask].Append(task);
+  else {
+    /* Long delays are placed in the furthest slot, and are simply
+       re-inserted when that slot is cascaded. */
+    PInt64 slotTick = delta < MaxWheelDelay ? task.m_dueTick : (m_currentTick + MaxWheelDelay);
+    m_wheel[1][(slotTick >> WheelBits) & WheelMask].Append(task);
+  }
+
+  if (task.m_dueTick < m_nextWakeTick)
+    m_wheelSignal.Signal();
+}
+
+
+void OpalMediaPatchExecutor::Unlink(Task & task)
+{
+  // Called with m_mutex already locked
+  if (task.m_list == NULL)
+    return;
+
+  if (task.m_state == Task::e_Waiting)
+    --m_waitingCount;
+  else if (task.m_state == Task::e_Ready)
+    m_readySignal.Wait(0); // Keep semaphore in step with ready list
+  task.m_list->Remove(task);
+  task.m_state = Task::e_Idle;
+}
+
+
+void OpalMediaPatchExecutor::AdvanceWheel(PInt64 now)
+{
+  // Called with m_mutex already locked
+  if (m_waitingCount == 0) {
+    m_currentTick = now;
+    return;
+  }
+
+  while (m_currentTick < now) {
+    ++m_currentTick;
+
+    if ((m_currentTick & WheelMask) == 0) {
+      TaskList & cascade = m_wheel[1][(m_currentTick >> WheelBits) & WheelMask];
+      Task * task;
+      while ((task = cascade.PopHead()) != NULL) {
+        --m_waitingCount;
+        Insert(*task);
+      }
+    }
+
+    TaskList & slot = m_wheel[0][m_currentTick & WheelMask];
+    Task * task;
+    while ((task = slot.PopHead()) != NULL) {
+      --m_waitingCount;
+      Insert(*task);
+    }
+  }
+}
+
+
+void OpalMediaPatchExecutor::WheelMain()
+{
+  PTRACE(4, "Media patch wheel thread started");
+
+  while (m_running) {
+    PInt64 wait;
+    {
+      PWaitAndSignal lock(m_mutex);
+
+      AdvanceWheel(GetTick());
+
+      if (m_waitingCount == 0)
+        wait = 1000;
+      else {
+        // Wait for next occupied slot, or next cascade, whichever is sooner
+        wait = WheelSize - (m_currentTick & WheelMask);
+        for (PInt64 i = 1; i < wait; ++i) {
+          if (m_wheel[0][(m_currentTick + i) & WheelMask].m_head != NULL) {
+            wait = i;
+            break;
+          }
+        }
+      }
+
+      m_nextWakeTick = m_currentTick + wait;
+    }
+
+    m_wheelSignal.Wait(PTimeInterval(wait));
+  }
+
+  PTRACE(4, "Media patch wheel thread ended");
+}
+
+
+void OpalMediaPatchExecutor::WorkerMain(unsigned index)
+{
+  PTRACE(4, "Media patch worker thread " << index << " started");
+
+#ifdef P_LINUX
+  if (m_pinThreads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 1) {
+      cpu_set_t cpuSet;
+      CPU_ZERO(&cpuSet);
+      CPU_SET(index % cpus, &cpuSet);
+      if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+        PTRACE(2, "Could not pin media patch worker thread " << index << " to cpu " << (index % cpus));
+      }
+    }
+  }
+#endif
+
+  for (;;) {
+    m_readySignal.Wait();
+    if (!m_running)
+      break;
+
+    Task * task;
+    PInt64 dueTick;
+    {
+      PWaitAndSignal lock(m_mutex);
+      if ((task = m_ready.PopHead()) == NULL)
+        continue;
+      task->m_state = Task::e_Running;
+      task->m_threadId = PThread::GetCurrentThreadId();
+      dueTick = task->m_dueTick;
+    }
+
+    PInt64 startTick = GetTick();
+    PTimeInterval delay(0);
+    bool again = task->Execute(delay);
+
+    bool deleteTask = false;
+    {
+      PWaitAndSignal lock(m_mutex);
+
+      PInt64 jitter = startTick - dueTick;
+      PINDEX bucket = 0;
+      while (bucket < NumJitterBuckets-1 && jitter >= JitterBucketLimits[bucket])
+        ++bucket;
+      ++m_jitterHistogram[bucket];
+
+      task->m_threadId = PNullThreadIdentifier;
+
+      if (task->m_removed) {
+        task->m_state = Task::e_Finished;
+        --m_taskCount;
+        if (task->m_deleteOnReturn)
+          deleteTask = true;
+        else
+          task->m_completed.Signal();
+      }
+      else if (again) {
+        task->m_dueTick = dueTick + delay.GetMilliSeconds();
+        PInt64 now = GetTick();
+        if (task->m_dueTick < now - MaxExecutorCatchUp) {
+          PTRACE(4, "Media patch task " << task << " fell behind by " << (now - task->m_dueTick) << "ms");
+          task->m_dueTick = now + delay.GetMilliSeconds();
+        }
+        Insert(*task);
+      }
+      else {
+        task->m_state = Task::e_Finished;
+        --m_taskCount;
+      }
+    }
+
+    if (deleteTask)
+      delete task;
+  }
+
+  PTRACE(4, "Media patch worker thread " << index << " ended");
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalMediaPatch::OpalMediaPatch(OpalMediaStream & src)
@@ -61,6 +521,11 @@ OpalMediaPatch::OpalMediaPatch(OpalMediaStream & src)
 #if OPAL_STATISTICS
   , m_patchThreadId(PNullThreadIdentifier)
 #endif
+  , m_executor(NULL)
+  , m_executorTask(NULL)
+  , m_startedByExecutor(false)
+  , m_asynchronous(false)
+  , m_scheduledFrame(0)
   , m_transcoderChanged(false)
 {
   PTRACE_CONTEXT_ID_FROM(src);
@@ -155,16 +620,28 @@ void OpalMediaPatch::Start()
     return;
   }
 
+  if (m_executorTask != NULL && !m_executorTask->IsFinished()) {
+    PTRACE(5, "Already scheduled on executor");
+    return;
+  }
+
   delete m_patchThread;
   m_patchThread = NULL;
 
+  if (m_executorTask != NULL)
+    m_executor->Remove(m_executorTask);
+
   if (CanStart()) {
-    PString threadName = m_source.GetPatchThreadName();
-    if (threadName.IsEmpty() && !m_sinks.empty())
-      threadName = m_sinks.front().m_stream->GetPatchThreadName();
-    if (threadName.IsEmpty())
-      threadName = "Media Patch";
-    m_patchThread = new PThreadObj<OpalMediaPatch>(*this, &OpalMediaPatch::Main, false, threadName, PThread::HighPriority);
+    m_startedByExecutor = false;
+    m_executor = m_source.GetConnection().GetEndPoint().GetManager().GetMediaPatchExecutor();
+    if (m_executor != NULL) {
+      m_executorTask = new OpalMediaPatchExecutor::TaskObj<OpalMediaPatch>(*this, &OpalMediaPatch::OnScheduled);
+      m_executor->Schedule(*m_executorTask);
+      PTRACE(4, "Scheduled on executor: " << *this);
+      return;
+    }
+
+    m_patchThread = new PThreadObj<OpalMediaPatch>(*this, &OpalMediaPatch::Main, false, GetThreadName(), PThread::HighPriority);
     PTRACE_CONTEXT_ID_TO(m_patchThread);
     PThread::Yield();
     PTRACE(4, "Starting thread " << m_patchThread->GetThreadName());
@@ -172,8 +649,30 @@ void OpalMediaPatch::Start()
 }
 
 
+PString OpalMediaPatch::GetThreadName() const
+{
+  PString threadName = m_source.GetPatchThreadName();
+  if (threadName.IsEmpty() && !m_sinks.empty())
+    threadName = m_sinks.front().m_stream->GetPatchThreadName();
+  if (threadName.IsEmpty())
+    threadName = "Media Patch";
+  return threadName;
+}
+
+
 void OpalMediaPatch::StopThread()
 {
+  OpalMediaPatchExecutor::Task * task;
+  {
+    PWaitAndSignal m(m_patchThreadMutex);
+    task = m_executorTask;
+    m_executorTask = NULL;
+  }
+
+  // Do outside mutex as the task may need it to start a thread
+  if (task != NULL)
+    m_executor->Remove(task);
+
   PThread::WaitAndDelete(m_patchThread, 10000, &m_patchThreadMutex);
 }
 
@@ -720,7 +1219,14 @@ void OpalMediaPatch::Main()
   m_patchThreadId = PThread::GetCurrentThreadId();
 #endif
 
-  bool asynchronous = OnStartMediaPatch();
+  MainLoop(m_startedByExecutor ? m_asynchronous : OnStartMediaPatch());
+
+  PTRACE(4, "Thread ended for " << *this);
+}
+
+
+void OpalMediaPatch::MainLoop(bool asynchronous)
+{
   PAdaptiveDelay asynchPacing;
   PThread::Times lastThreadTimes;
   const unsigned CheckCPUTimeMS =
@@ -783,6 +1289,68 @@ void OpalMediaPatch::Main()
     }
   }
 
+  OnPatchEnded();
+}
+
+
+bool OpalMediaPatch::OnScheduled(PTimeInterval & delay)
+{
+  if (!m_startedByExecutor) {
+#if OPAL_STATISTICS
+    m_patchThreadId = PThread::GetCurrentThreadId();
+#endif
+
+    m_asynchronous = OnStartMediaPatch();
+    m_startedByExecutor = true;
+
+    /* Only an asynchronous patch from an RTP stream can be driven by the
+       executor, as it can be made to never block on read. Anything else
+       blocks in the stream I/O for its timing, so needs its own thread. */
+    OpalRTPMediaStream * rtpStream = m_asynchronous ? dynamic_cast<OpalRTPMediaStream *>(&m_source) : NULL;
+    if (rtpStream == NULL) {
+      PWaitAndSignal m(m_patchThreadMutex);
+      if (m_executorTask != NULL) {
+        m_patchThread = new PThreadObj<OpalMediaPatch>(*this, &OpalMediaPatch::Main, false, GetThreadName(), PThread::HighPriority);
+        PTRACE_CONTEXT_ID_TO(m_patchThread);
+        PTRACE(4, "Starting thread " << m_patchThread->GetThreadName() << " for " << *this);
+      }
+      return false;
+    }
+
+    rtpStream->SetReadTimeout(0);
+    m_scheduledFrame.SetTimestamp(0);
+    PTRACE(4, "Executor started for " << *this);
+  }
+
+  if (!m_source.IsOpen()) {
+    OnPatchEnded();
+    return false;
+  }
+
+  if (m_source.IsPaused()) {
+    delay = 100;
+    return true;
+  }
+
+  if (!m_source.ReadPacket(m_scheduledFrame)) {
+    PTRACE(4, "Execution ended because source read failed on " << *this);
+    OnPatchEnded();
+    return false;
+  }
+
+  if (!DispatchFrame(m_scheduledFrame)) {
+    PTRACE(4, "Execution ended because all sink writes failed on " << *this);
+    OnPatchEnded();
+    return false;
+  }
+
+  delay = 10;
+  return true;
+}
+
+
+void OpalMediaPatch::OnPatchEnded()
+{
   m_source.OnStopMediaPatch(*this);
 
   if (m_sinks.IsEmpty() && m_source.GetPatch() == this) {
@@ -791,8 +1359,6 @@ void OpalMediaPatch::Main()
                 new PSafeWorkArg1<OpalConnection, OpalMediaStreamPtr, bool>(&m_source.GetConnection(),
                                                         &m_source, &OpalConnection::CloseMediaStream));
   }
-
-  PTRACE(4, "Thread ended for " << *this);
 }
 
 
@@ -851,6 +1417,41 @@ PBoolean OpalMediaPatch::PushFrame(RTP_DataFrame & frame)
 }
 
 
+PBoolean OpalMediaPatch::PushFrames(RTP_DataFrameList & frames)
+{
+  if (frames.GetSize() > 1 && LockReadOnly(P_DEBUG_LOCATION)) {
+    bool direct = m_bypassFromPatch == NULL && m_bypassToPatch == NULL && !m_transcoderChanged && !m_sinks.empty();
+    for (PList<Sink>::iterator s = m_sinks.begin(); direct && s != m_sinks.end(); ++s) {
+      if (s->m_primaryCodec != NULL)
+        direct = false;
+    }
+
+    if (direct) {
+      for (RTP_DataFrameList::iterator it = frames.begin(); it != frames.end(); ++it)
+        FilterFrame(*it, m_source.GetMediaFormat());
+
+      bool written = false;
+      for (PList<Sink>::iterator s = m_sinks.begin(); s != m_sinks.end(); ++s) {
+        if (s->WriteFrames(frames))
+          written = true;
+      }
+
+      UnlockReadOnly(P_DEBUG_LOCATION);
+      return written;
+    }
+
+    UnlockReadOnly(P_DEBUG_LOCATION);
+  }
+
+  for (RTP_DataFrameList::iterator it = frames.begin(); it != frames.end(); ++it) {
+    if (!DispatchFrame(*it))
+      return false;
+  }
+
+  return true;
+}
+
+
 bool OpalMediaPatch::DispatchFrame(RTP_DataFrame & frame)
 {
   if (!LockReadOnly(P_DEBUG_LOCATION))
@@ -949,80 +1550,113 @@ bool OpalMediaPatch::Sink::ExecuteCommand(const OpalMediaCommand & command, bool
 }
 
 
-bool OpalMediaPatch::Sink::WriteFrame(RTP_DataFrame & sourceFrame, bool bypassing)
+class OpalMediaPatchWriteBatch
 {
-  if (m_stream->IsPaused())
-    return true;
+  public:
+    OpalMediaPatchWriteBatch(OpalMediaStream & stream, bool enable)
+      : m_stream(stream)
+      , m_active(enable && stream.BeginWriteBatch())
+    { }
+
+    ~OpalMediaPatchWriteBatch()
+    {
+      if (m_active)
+        m_stream.EndWriteBatch();
+    }
+
+  private:
+    OpalMediaStream & m_stream;
+    bool              m_active;
+};
+
 
-  if (bypassing || m_primaryCodec == NULL) {
 #if OPAL_STATISTICS
-    OpalAudioFormat::FrameType audioFrameType;
-    if (m_audioFormat.IsValid())
-      audioFrameType = m_audioFormat.GetFrameType(sourceFrame.GetPayloadPtr(), sourceFrame.GetPayloadSize(), m_audioFrameDetector);
+void OpalMediaPatch::Sink::GetFrameTypes(const RTP_DataFrame & frame, FrameTypes & types)
+{
+  if (m_audioFormat.IsValid())
+    types.m_audio = m_audioFormat.GetFrameType(frame.GetPayloadPtr(), frame.GetPayloadSize(), m_audioFrameDetector);
 
 #if OPAL_VIDEO
-    // Must be done before the WritePacket() which could encrypt the packet
-    OpalVideoFormat::FrameType videoFrameType;
-    if (m_videoFormat.IsValid())
-      videoFrameType = m_videoFormat.GetFrameType(sourceFrame.GetPayloadPtr(), sourceFrame.GetPayloadSize(), m_videoFrameDetector);
-    else
-      videoFrameType = OpalVideoFormat::e_UnknownFrameType;
+  if (m_videoFormat.IsValid())
+    types.m_video = m_videoFormat.GetFrameType(frame.GetPayloadPtr(), frame.GetPayloadSize(), m_videoFrameDetector);
+  else
+    types.m_video = OpalVideoFormat::e_UnknownFrameType;
 #endif // OPAL_VIDEO
-#endif // OPAL_STATISTICS
+}
 
-    if (!m_stream->WritePacket(sourceFrame))
-      return false;
 
-#if OPAL_STATISTICS
-    RTP_SyncSourceId ssrc;
-    if (audioFrameType != OpalAudioFormat::e_UnknownFrameType) {
-      PWaitAndSignal mutex(m_statsMutex);
+void OpalMediaPatch::Sink::UpdateStatistics(const RTP_DataFrame & frame, const FrameTypes & types)
+{
+  RTP_SyncSourceId ssrc;
+  if (types.m_audio != OpalAudioFormat::e_UnknownFrameType) {
+    PWaitAndSignal mutex(m_statsMutex);
 
-      AudioStats & allStats = m_audioStatistics[0];
-      AudioStats * ssrcStats = (ssrc = sourceFrame.GetSyncSource()) != 0 ? &m_audioStatistics[ssrc] : NULL;
+    AudioStats & allStats = m_audioStatistics[0];
+    AudioStats * ssrcStats = (ssrc = frame.GetSyncSource()) != 0 ? &m_audioStatistics[ssrc] : NULL;
 
-      if (audioFrameType&OpalAudioFormat::e_SilenceFrame) {
-        ++allStats.m_silent;
-        if (ssrcStats)
-          ++ssrcStats->m_silent;
-      }
+    if (types.m_audio&OpalAudioFormat::e_SilenceFrame) {
+      ++allStats.m_silent;
+      if (ssrcStats)
+        ++ssrcStats->m_silent;
+    }
 
-      if (audioFrameType&OpalAudioFormat::e_FECFrame) {
-        ++allStats.m_FEC;
-        if (ssrcStats)
-          ++ssrcStats->m_FEC;
-      }
+    if (types.m_audio&OpalAudioFormat::e_FECFrame) {
+      ++allStats.m_FEC;
+      if (ssrcStats)
+        ++ssrcStats->m_FEC;
     }
+  }
 
 #if OPAL_VIDEO
-    switch (videoFrameType) {
-      case OpalVideoFormat::e_IntraFrame :
-        m_statsMutex.Wait();
-        m_videoStatistics[0].IncrementFrames(true);
-        if ((ssrc = sourceFrame.GetSyncSource()) != 0)
-          m_videoStatistics[ssrc].IncrementFrames(true);
-        PTRACE(4, "I-Frame detected: SSRC=" << RTP_TRACE_SRC(ssrc)
-                << ", ts=" << sourceFrame.GetTimestamp() << ", total=" << m_videoStatistics[ssrc].m_totalFrames
-                << ", key=" << m_videoStatistics[ssrc].m_keyFrames
-                << ", req=" << m_videoStatistics[ssrc].m_lastUpdateRequestTime << ", on " << m_patch);
-        m_statsMutex.Signal();
-        break;
+  switch (types.m_video) {
+    case OpalVideoFormat::e_IntraFrame :
+      m_statsMutex.Wait();
+      m_videoStatistics[0].IncrementFrames(true);
+      if ((ssrc = frame.GetSyncSource()) != 0)
+        m_videoStatistics[ssrc].IncrementFrames(true);
+      PTRACE(4, "I-Frame detected: SSRC=" << RTP_TRACE_SRC(ssrc)
+              << ", ts=" << frame.GetTimestamp() << ", total=" << m_videoStatistics[ssrc].m_totalFrames
+              << ", key=" << m_videoStatistics[ssrc].m_keyFrames
+              << ", req=" << m_videoStatistics[ssrc].m_lastUpdateRequestTime << ", on " << m_patch);
+      m_statsMutex.Signal();
+      break;
 
-      case OpalVideoFormat::e_InterFrame :
-        m_statsMutex.Wait();
-        m_videoStatistics[0].IncrementFrames(false);
-        if ((ssrc = sourceFrame.GetSyncSource()) != 0)
-          m_videoStatistics[ssrc].IncrementFrames(false);
-        PTRACE(5, "P-Frame detected: SSRC=" << RTP_TRACE_SRC(ssrc)
-                << ", ts=" << sourceFrame.GetTimestamp() << ", total=" << m_videoStatistics[ssrc].m_totalFrames
-                << ", key=" << m_videoStatistics[ssrc].m_keyFrames << ", on " << m_patch);
-        m_statsMutex.Signal();
-        break;
+    case OpalVideoFormat::e_InterFrame :
+      m_statsMutex.Wait();
+      m_videoStatistics[0].IncrementFrames(false);
+      if ((ssrc = frame.GetSyncSource()) != 0)
+        m_videoStatistics[ssrc].IncrementFrames(false);
+      PTRACE(5, "P-Frame detected: SSRC=" << RTP_TRACE_SRC(ssrc)
+              << ", ts=" << frame.GetTimestamp() << ", total=" << m_videoStatistics[ssrc].m_totalFrames
+              << ", key=" << m_videoStatistics[ssrc].m_keyFrames << ", on " << m_patch);
+      m_statsMutex.Signal();
+      break;
 
-      default :
-        break;
-    }
+    default :
+      break;
+  }
 #endif // OPAL_VIDEO
+}
+#endif // OPAL_STATISTICS
+
+
+bool OpalMediaPatch::Sink::WriteFrame(RTP_DataFrame & sourceFrame, bool bypassing)
+{
+  if (m_stream->IsPaused())
+    return true;
+
+  if (bypassing || m_primaryCodec == NULL) {
+#if OPAL_STATISTICS
+    // Must be done before the WritePacket() which could encrypt the packet
+    FrameTypes frameTypes;
+    GetFrameTypes(sourceFrame, frameTypes);
+#endif // OPAL_STATISTICS
+
+    if (!m_stream->WritePacket(sourceFrame))
+      return false;
+
+#if OPAL_STATISTICS
+    UpdateStatistics(sourceFrame, frameTypes);
 #endif // OPAL_STATISTICS
 
     PTRACE_IF(6, bypassing, "Bypassed packet " << setw(1) << sourceFrame);
@@ -1034,30 +1668,40 @@ bool OpalMediaPatch::Sink::WriteFrame(RTP_DataFrame & sourceFrame, bool bypassin
     return false;
   }
 
-  for (RTP_DataFrameList::iterator interFrame = m_intermediateFrames.begin(); interFrame != m_intermediateFrames.end(); ++interFrame) {
-    m_patch.FilterFrame(*interFrame, m_primaryCodec->GetOutputFormat());
+  if (m_secondaryCodec == NULL) {
+    // All the packets from one source frame, e.g. a video frame, are written, and encrypted, together
+    for (RTP_DataFrameList::iterator interFrame = m_intermediateFrames.begin(); interFrame != m_intermediateFrames.end(); ++interFrame)
+      m_patch.FilterFrame(*interFrame, m_primaryCodec->GetOutputFormat());
 
-    if (m_secondaryCodec == NULL) {
-      if (!m_stream->WritePacket(*interFrame))
-        return false;
-      if (m_primaryCodec == NULL)
-        return true;
+    if (!m_stream->WritePackets(m_intermediateFrames))
+      return false;
+
+    if (m_primaryCodec == NULL)
+      return true;
+
+    for (RTP_DataFrameList::iterator interFrame = m_intermediateFrames.begin(); interFrame != m_intermediateFrames.end(); ++interFrame)
       m_primaryCodec->CopyTimestamp(sourceFrame, *interFrame, false);
-      continue;
-    }
+  }
+  else {
+    // All the packets from one source frame, e.g. a video frame, can be sent together
+    OpalMediaPatchWriteBatch batch(*m_stream, m_intermediateFrames.GetSize() > 1);
 
-    if (!m_secondaryCodec->ConvertFrames(*interFrame, m_finalFrames)) {
-      PTRACE(1, "Media conversion (secondary) failed");
-      return false;
-    }
+    for (RTP_DataFrameList::iterator interFrame = m_intermediateFrames.begin(); interFrame != m_intermediateFrames.end(); ++interFrame) {
+      m_patch.FilterFrame(*interFrame, m_primaryCodec->GetOutputFormat());
 
-    for (RTP_DataFrameList::iterator finalFrame = m_finalFrames.begin(); finalFrame != m_finalFrames.end(); ++finalFrame) {
-      m_patch.FilterFrame(*finalFrame, m_secondaryCodec->GetOutputFormat());
-      if (!m_stream->WritePacket(*finalFrame))
+      if (!m_secondaryCodec->ConvertFrames(*interFrame, m_finalFrames)) {
+        PTRACE(1, "Media conversion (secondary) failed");
         return false;
-      if (m_secondaryCodec == NULL)
-        return true;
-      m_secondaryCodec->CopyTimestamp(sourceFrame, *finalFrame, false);
+      }
+
+      for (RTP_DataFrameList::iterator finalFrame = m_finalFrames.begin(); finalFrame != m_finalFrames.end(); ++finalFrame) {
+        m_patch.FilterFrame(*finalFrame, m_secondaryCodec->GetOutputFormat());
+        if (!m_stream->WritePacket(*finalFrame))
+          return false;
+        if (m_secondaryCodec == NULL)
+          return true;
+        m_secondaryCodec->CopyTimestamp(sourceFrame, *finalFrame, false);
+      }
     }
   }
 
@@ -1073,6 +1717,32 @@ bool OpalMediaPatch::Sink::WriteFrame(RTP_DataFrame & sourceFrame, bool bypassin
 }
 
 
+bool OpalMediaPatch::Sink::WriteFrames(RTP_DataFrameList & sourceFrames)
+{
+  if (m_stream->IsPaused())
+    return true;
+
+#if OPAL_STATISTICS
+  // Must be done before the WritePackets() which could encrypt the packets
+  std::vector<FrameTypes> frameTypes(sourceFrames.GetSize());
+  std::vector<FrameTypes>::iterator types = frameTypes.begin();
+  for (RTP_DataFrameList::iterator it = sourceFrames.begin(); it != sourceFrames.end(); ++it, ++types)
+    GetFrameTypes(*it, *types);
+#endif // OPAL_STATISTICS
+
+  if (!m_stream->WritePackets(sourceFrames))
+    return false;
+
+#if OPAL_STATISTICS
+  types = frameTypes.begin();
+  for (RTP_DataFrameList::iterator it = sourceFrames.begin(); it != sourceFrames.end(); ++it, ++types)
+    UpdateStatistics(*it, *types);
+#endif // OPAL_STATISTICS
+
+  return true;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalPassiveMediaPatch::OpalPassiveMediaPatch(OpalMediaStream & source)
@@ -1090,11 +1760,27 @@ void OpalPassiveMediaPatch::Start()
   if (CanStart()) {
     m_started = true;
     PTRACE(4, "Passive media patch started: " << *this);
-    m_source.GetConnection().GetEndPoint().GetManager().QueueDecoupledEvent(new PSafeWorkNoArg<OpalMediaPatch, bool>(this, &OpalMediaPatch::OnStartMediaPatch));
+
+    OpalManager & manager = m_source.GetConnection().GetEndPoint().GetManager();
+    PWaitAndSignal m(m_patchThreadMutex);
+    m_executor = manager.GetMediaPatchExecutor();
+    if (m_executor == NULL)
+      manager.QueueDecoupledEvent(new PSafeWorkNoArg<OpalMediaPatch, bool>(this, &OpalMediaPatch::OnStartMediaPatch));
+    else {
+      m_executorTask = new OpalMediaPatchExecutor::TaskObj<OpalPassiveMediaPatch>(*this, &OpalPassiveMediaPatch::OnScheduledStart);
+      m_executor->Schedule(*m_executorTask);
+    }
   }
 }
 
 
+bool OpalPassiveMediaPatch::OnScheduledStart(PTimeInterval &)
+{
+  OnStartMediaPatch();
+  return false;
+}
+
+
 void OpalPassiveMediaPatch::Close()
 {
   OpalMediaPatch::Close();
@@ -35,6 +35,7 @@
 #include <opal/recording.h>
 
 #include <ep/opalmixer.h>
+#include <rtp/pcapfile.h>
 #include <ptclib/mediafile.h>
 
 
@@ -495,6 +496,264 @@ OpalRecordManager * OpalMediaFileRecordManager::FactoryInitialiser::Create(OpalR
 static OpalMediaFileRecordManager::FactoryInitialiser OpalMediaFileRecordManager_FactoryInitialiser_instance;
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+/** This class manages the recording of OPAL calls to PCAP files, storing the
+    packets of each stream as received, with their arrival time, without any
+    decoding or mixing. That is left to be done offline, e.g. by playrtp.
+
+    Packets are queued to a dedicated writer thread, so disk stalls do not
+    affect media timing, which formats them into a large buffer and writes it
+    in one sequential write. If the disk cannot keep up and the queue is full,
+    packets are discarded rather than blocking the media.
+  */
+class OpalPCAPRecordManager : public OpalRecordManager
+{
+  public:
+    OpalPCAPRecordManager();
+    ~OpalPCAPRecordManager();
+
+    virtual bool OpenFile(const PFilePath & fn);
+    virtual bool IsOpen() const;
+    virtual bool Close();
+    virtual bool IsPassThrough() const { return true; }
+    virtual bool OpenStream(const PString & strmId, const OpalMediaFormat & format);
+    virtual bool CloseStream(const PString & strmId);
+
+    virtual bool WriteAudio(const PString & strmId, const RTP_DataFrame & rtp) { return WritePacket(strmId, rtp); }
+    virtual bool OnPushAudio() { return IsOpen(); }
+    virtual unsigned GetPushAudioPeriodMS() const { return 0; }
+#if OPAL_VIDEO
+    virtual bool WriteVideo(const PString & strmId, const RTP_DataFrame & rtp) { return WritePacket(strmId, rtp); }
+    virtual bool OnPushVideo() { return IsOpen(); }
+    virtual unsigned GetPushVideoPeriodMS() const { return 0; }
+#endif
+
+  protected:
+    bool WritePacket(const PString & strmId, const RTP_DataFrame & rtp);
+    void WriterMain();
+
+    struct Packet
+    {
+      Packet(const RTP_DataFrame & rtp, WORD port)
+        : m_rtp(rtp)
+        , m_port(port)
+      { }
+      RTP_DataFrame m_rtp;
+      WORD          m_port;
+    };
+    typedef std::deque<Packet> PacketQueue;
+
+    mutable PDECLARE_MUTEX(m_mutex);
+    OpalPCAPFile            * m_file;
+    std::map<PString, WORD>   m_ports;
+    WORD                      m_nextPort;
+
+    PThread          * m_writerThread;
+    atomic<bool>       m_writerRunning;
+    atomic<bool>       m_writeFailed;
+    PSyncPoint         m_writerSignal;
+    PDECLARE_MUTEX(m_queueMutex);
+    PacketQueue        m_queue;
+    PINDEX             m_queueLimit;
+    PINDEX             m_bufferSize;
+    atomic<unsigned>   m_discarded;
+};
+
+
+OpalPCAPRecordManager::OpalPCAPRecordManager()
+  : m_file(NULL)
+  , m_nextPort(5000)
+  , m_writerThread(NULL)
+  , m_writerRunning(false)
+  , m_writeFailed(false)
+  , m_queueLimit(10000)
+  , m_bufferSize(256*1024)
+  , m_discarded(0)
+{
+}
+
+
+OpalPCAPRecordManager::~OpalPCAPRecordManager()
+{
+  Close();
+}
+
+
+bool OpalPCAPRecordManager::OpenFile(const PFilePath & fn)
+{
+  PWaitAndSignal mutex(m_mutex);
+
+  if (m_file != NULL) {
+    PTRACE(2, "Cannot open recording after it has started.");
+    return false;
+  }
+
+  m_file = new OpalPCAPFile();
+  if (!m_file->Open(fn, PFile::WriteOnly)) {
+    PTRACE(2, "Cannot open PCAP file \"" << fn << "\" for writing: " << m_file->GetErrorText());
+    delete m_file;
+    m_file = NULL;
+    return false;
+  }
+
+  if (m_options.m_audioBufferSize > 0)
+    m_bufferSize = m_options.m_audioBufferSize;
+
+  m_writerRunning = true;
+  m_writerThread = new PThreadObj<OpalPCAPRecordManager>(*this, &OpalPCAPRecordManager::WriterMain, false, "PCAPRecord");
+
+  PTRACE(4, "Pass through recording opened for file \"" << fn << "\", buffer " << m_bufferSize << " bytes");
+  return true;
+}
+
+
+bool OpalPCAPRecordManager::IsOpen() const
+{
+  PWaitAndSignal mutex(m_mutex);
+  return m_file != NULL && !m_writeFailed;
+}
+
+
+bool OpalPCAPRecordManager::Close()
+{
+  // Writer drains the queue before it exits
+  m_writerRunning = false;
+  m_writerSignal.Signal();
+  PThread::WaitAndDelete(m_writerThread);
+
+  PWaitAndSignal mutex(m_mutex);
+
+  if (m_file == NULL)
+    return true;
+
+  PTRACE_IF(2, m_discarded > 0, "Discarded " << m_discarded << " packets, could not write fast enough");
+  delete m_file;
+  m_file = NULL;
+  return true;
+}
+
+
+bool OpalPCAPRecordManager::OpenStream(const PString & strmId, const OpalMediaFormat & format)
+{
+  PWaitAndSignal mutex(m_mutex);
+
+  if (m_file == NULL)
+    return false;
+
+  // Each stream has its own port, so they can be separated when played back
+  if (m_ports.find(strmId) == m_ports.end()) {
+    m_ports[strmId] = m_nextPort;
+    m_nextPort += 2;
+  }
+
+  PTRACE(3, "Recording stream " << strmId << " as " << format
+         << ", payload type " << format.GetPayloadType() << ", on port " << m_ports[strmId]);
+  return true;
+}
+
+
+bool OpalPCAPRecordManager::CloseStream(const PString & strmId)
+{
+  PTRACE(4, "Closed stream " << strmId);
+  return true;
+}
+
+
+bool OpalPCAPRecordManager::WritePacket(const PString & strmId, const RTP_DataFrame & rtp)
+{
+  WORD port;
+  {
+    PWaitAndSignal mutex(m_mutex);
+    if (m_file == NULL || m_writeFailed)
+      return false;
+
+    std::map<PString, WORD>::iterator it = m_ports.find(strmId);
+    if (it == m_ports.end())
+      return false;
+    port = it->second;
+  }
+
+  {
+    PWaitAndSignal mutex(m_queueMutex);
+    if (m_writeFailed)
+      return false; // Writer has gone
+
+    if ((PINDEX)m_queue.size() >= m_queueLimit) {
+      // Never block the media, discarding is better than stalling the call
+      PTRACE_IF(2, m_discarded == 0, "Recording queue full, discarding packets");
+      ++m_discarded;
+      return true;
+    }
+
+    m_queue.push_back(Packet(rtp, port));
+    if (!m_queue.back().m_rtp.GetAbsoluteTime().IsValid())
+      m_queue.back().m_rtp.SetAbsoluteTime();
+  }
+
+  m_writerSignal.Signal();
+  return true;
+}
+
+
+void OpalPCAPRecordManager::WriterMain()
+{
+  PTRACE(4, "Recording writer started");
+
+  PBYTEArray buffer(m_bufferSize + 2048);
+  PINDEX length = 0;
+  PacketQueue packets;
+  PTimeInterval lastWrite = PTimer::Tick();
+  bool running = true;
+
+  while (running) {
+    m_writerSignal.Wait(1000);
+    running = m_writerRunning;
+
+    {
+      PWaitAndSignal mutex(m_queueMutex);
+      packets.swap(m_queue);
+    }
+
+    for (PacketQueue::iterator it = packets.begin(); it != packets.end(); ++it)
+      length = m_file->FormatRTP(buffer, length, it->m_rtp, it->m_rtp.GetAbsoluteTime(), it->m_port);
+    packets.clear();
+
+    // Large sequential writes, but at least every second so little is lost on a crash
+    if (length > 0 && (length >= m_bufferSize || !running || (PTimer::Tick() - lastWrite) >= 1000)) {
+      if (!m_file->Write(buffer, length)) {
+        PTRACE(1, "Could not write to PCAP file: " << m_file->GetErrorText());
+        // Stop accepting packets, nothing will ever write them
+        PWaitAndSignal mutex(m_queueMutex);
+        m_writeFailed = true;
+        m_queue.clear();
+        break;
+      }
+      length = 0;
+      lastWrite = PTimer::Tick();
+    }
+  }
+
+  PTRACE(4, "Recording writer ended");
+}
+
+
+struct OpalPCAPRecordManager_FactoryInitialiser : OpalRecordManager::Factory::WorkerBase
+{
+  OpalPCAPRecordManager_FactoryInitialiser()
+  {
+    OpalRecordManager::Factory::Register(".pcap", this);
+  }
+
+  virtual OpalRecordManager * Create(OpalRecordManager::Factory::Param_T) const
+  {
+    return new OpalPCAPRecordManager();
+  }
+};
+
+static OpalPCAPRecordManager_FactoryInitialiser OpalPCAPRecordManager_FactoryInitialiser_instance;
+
+
 #endif // OPAL_HAS_MIXER
 
 
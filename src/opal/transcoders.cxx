@@ -35,6 +35,16 @@
 
 #include <opal/transcoders.h>
 
+#if PBYTE_ORDER==PLITTLE_ENDIAN
+  #if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define OPAL_TRANSCODER_SSE2 1
+    #include <emmintrin.h>
+  #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define OPAL_TRANSCODER_NEON 1
+    #include <arm_neon.h>
+  #endif
+#endif
+
 
 #define new PNEW
 #define PTraceModule() "Transcoder"
@@ -722,6 +732,9 @@ PBoolean OpalStreamedTranscoder::Convert(const RTP_DataFrame & input,
   BYTE * outputBytes = output.GetPayloadPtr();
   short * outputWords = (short *)outputBytes;
 
+  if (ConvertSamples(inputBytes, outputBytes, samples))
+    return true;
+
   switch (inputBitsPerSample) {
     case 16 :
       switch (outputBitsPerSample) {
@@ -885,8 +898,38 @@ PBoolean OpalStreamedTranscoder::Convert(const RTP_DataFrame & input,
 }
 
 
+bool OpalStreamedTranscoder::ConvertSamples(const BYTE *, BYTE *, PINDEX)
+{
+  return false;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
+// Convert between network byte order L16 and native PCM-16
+static void SwapLinear16(const BYTE * input, BYTE * output, PINDEX samples)
+{
+#if PBYTE_ORDER==PLITTLE_ENDIAN
+  PINDEX i = 0;
+#if OPAL_TRANSCODER_SSE2
+  for (; i + 8 <= samples; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(input + i*2));
+    _mm_storeu_si128((__m128i *)(output + i*2), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+  }
+#elif OPAL_TRANSCODER_NEON
+  for (; i + 8 <= samples; i += 8)
+    vst1q_u8(output + i*2, vrev16q_u8(vld1q_u8(input + i*2)));
+#endif
+  const unsigned short * inputWords = (const unsigned short *)input;
+  unsigned short * outputWords = (unsigned short *)output;
+  for (; i < samples; ++i)
+    outputWords[i] = (unsigned short)((inputWords[i] >> 8) | (inputWords[i] << 8));
+#else
+  memcpy(output, input, samples*2);
+#endif
+}
+
+
 Opal_Linear16Mono_PCM::Opal_Linear16Mono_PCM()
   : OpalStreamedTranscoder(OpalL16_MONO_8KHZ, OpalPCM16, 16, 16)
 {
@@ -904,6 +947,13 @@ int Opal_Linear16Mono_PCM::ConvertOne(int sample) const
 }
 
 
+bool Opal_Linear16Mono_PCM::ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples)
+{
+  SwapLinear16(input, output, samples);
+  return true;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 Opal_PCM_Linear16Mono::Opal_PCM_Linear16Mono()
@@ -924,4 +974,11 @@ int Opal_PCM_Linear16Mono::ConvertOne(int sample) const
 }
 
 
+bool Opal_PCM_Linear16Mono::ConvertSamples(const BYTE * input, BYTE * output, PINDEX samples)
+{
+  SwapLinear16(input, output, samples);
+  return true;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
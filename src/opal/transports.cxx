@@ -47,6 +47,11 @@
 #include <ptclib/pnat.h>
 #include <ptclib/http.h>
 
+#ifdef P_LINUX
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+#endif
+
 
 typedef PFactory<OpalInternalTransport, PCaselessString> OpalInternalTransportFactory;
 
@@ -1016,6 +1021,8 @@ OpalTransport::OpalTransport(OpalEndPoint & end, PChannel * channel)
   , m_thread(NULL)
   , m_idleTimer(m_endpoint.GetManager().GetTransportIdleTime())
   , m_referenceCount(0)
+  , m_reactorHandles(0)
+  , m_reactorThread(PNullThreadIdentifier)
 {
   m_keepAliveTimer.SetNotifier(PCREATE_NOTIFIER(KeepAlive), "OpalTransKeepAlive");
   PTRACE(5, "Transport constructed: this=" << this << ", channel=" << m_channel << ", ep=" << m_endpoint);
@@ -1056,6 +1063,13 @@ PBoolean OpalTransport::Close()
 {
   m_keepAliveTimer.Stop();
 
+  // Must be before the socket is closed, so can be removed from the reactor
+  if (m_reactorHandles > 0) {
+    OpalSignalingReactor * reactor = m_endpoint.GetManager().GetSignalingReactor();
+    if (reactor != NULL)
+      reactor->Remove(*this);
+  }
+
   /* Do not use PIndirectChannel::Close() as this deletes the sub-channel
      member field crashing the background thread. Just close the base
      sub-channel so breaks the threads I/O block.
@@ -1071,6 +1085,21 @@ void OpalTransport::CloseWait()
 
   Close();
   AttachThread(NULL);
+
+  // Wait for any handler being executed by the signalling reactor, unless it is us
+  PSimpleTimer timeout(m_endpoint.GetManager().GetSignalingTimeout()+2000);
+  while (m_reactorHandles > 0) {
+    m_threadMutex.Wait();
+    bool inHandler = m_reactorThread == PThread::GetCurrentThreadId();
+    m_threadMutex.Signal();
+    if (inHandler)
+      break;
+    if (timeout.HasExpired()) {
+      PTRACE(2, "Timeout waiting for signalling reactor to release " << *this);
+      break;
+    }
+    PThread::Sleep(10);
+  }
 }
 
 
@@ -1126,11 +1155,20 @@ void OpalTransport::AttachThread(PThread * thrd)
 
 PBoolean OpalTransport::IsRunning() const
 {
+  if (m_reactorHandles > 0)
+    return true;
+
   PWaitAndSignal lock(m_threadMutex);
   return m_thread != NULL && !m_thread->IsTerminated();
 }
 
 
+bool OpalTransport::CanUseSignalingReactor() const
+{
+  return false;
+}
+
+
 bool OpalTransport::IsOpen() const
 {
   PSafeLockReadOnly lock(*this);
@@ -1241,6 +1279,476 @@ void OpalTransport::ResetIdle()
 }
 
 
+//////////////////////////////////////////////////////////////////////////
+
+struct OpalSignalingReactor::Handle
+{
+  Handle(uint64_t id,
+         const OpalTransportPtr & transport,
+         const ReadyNotifier & notifier,
+         FramingFunction framer,
+         const PTimeInterval & timeout)
+    : m_id(id)
+    , m_transport(transport)
+    , m_notifier(notifier)
+    , m_framer(framer)
+    , m_timeout(timeout)
+    , m_deadline(timeout)
+    , m_fd(-1)
+    , m_state(e_Waiting)
+    , m_removed(false)
+  {
+    ++m_transport->m_reactorHandles;
+  }
+
+  ~Handle()
+  {
+    // Must be before m_transport goes, as that may delete the transport
+    --m_transport->m_reactorHandles;
+  }
+
+  bool IsFramed()
+  {
+    const PBYTEArray & buffer = m_transport->GetReadAheadBuffer();
+    return !buffer.IsEmpty() && m_framer(buffer, buffer.GetSize()) > 0;
+  }
+
+  uint64_t         m_id;
+  OpalTransportPtr m_transport;
+  ReadyNotifier    m_notifier;
+  FramingFunction  m_framer;
+  PTimeInterval    m_timeout;
+  PSimpleTimer     m_deadline;
+  PTimeInterval    m_savedReadTimeout;
+  int              m_fd;
+  enum {
+    e_Waiting,    // In epoll, only I/O thread may move from this state
+    e_Reading,    // I/O thread owns read ahead buffer
+    e_Dispatched  // Queued for, or executing, the handler
+  }                m_state;
+  bool             m_removed;
+};
+
+
+static const PTimeInterval SignalingCheckInterval(0, 1);
+
+#ifdef P_LINUX
+static const int    SignalingMaxEventsPerWait = 32;
+static const int    SignalingEventWaitTimeoutMS = 1000;
+static const PINDEX SignalingReadChunkSize = 4096;
+static const PINDEX SignalingMaxReadPerEvent = 65536;
+#endif
+
+
+OpalSignalingReactor::OpalSignalingReactor(unsigned threadCount, unsigned maxWorkers)
+  : m_running(false)
+  , m_epollFd(-1)
+  , m_wakeFd(-1)
+  , m_workers(std::max(maxWorkers, 1U), 0, "Signal-Work", PThread::HighPriority)
+  , m_lastHandleId(0)
+  , m_checkTimer(SignalingCheckInterval)
+{
+#ifdef P_LINUX
+  if (threadCount == 0)
+    return;
+
+  if ((m_epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+    PTRACE(1, "Could not create epoll for signalling reactor: errno=" << errno);
+    return;
+  }
+
+  if ((m_wakeFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC)) < 0) {
+    PTRACE(1, "Could not create event for signalling reactor: errno=" << errno);
+    return;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = 0; // Handle identifiers start at 1
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev) < 0) {
+    PTRACE(1, "Could not add wake event to signalling reactor: errno=" << errno);
+    return;
+  }
+
+  m_running = true;
+  for (unsigned i = 0; i < threadCount; ++i)
+    m_threads.push_back(new PThreadObj1Arg<OpalSignalingReactor, unsigned>(*this, i, &OpalSignalingReactor::ThreadMain,
+                                                                          false, PSTRSTRM("Signal-IO:" << i), PThread::HighPriority));
+  PTRACE(3, "Started signalling reactor with " << threadCount << " I/O threads, " << maxWorkers << " workers");
+#else
+  PTRACE_IF(2, threadCount > 0, "Signalling reactor not supported on this platform, using thread per transport");
+#endif
+}
+
+
+OpalSignalingReactor::~OpalSignalingReactor()
+{
+  m_running = false;
+  Wake();
+
+  for (vector<PThread *>::iterator it = m_threads.begin(); it != m_threads.end(); ++it) {
+    PTRACE_IF(2, !(*it)->WaitForTermination(10000), "Signalling reactor thread did not terminate");
+    delete *it;
+  }
+
+  // Anything left stops being serviced, handlers in progress are completed
+  {
+    vector<OpalTransportPtr> remaining;
+    {
+      PWaitAndSignal lock(m_mutex);
+      for (TransportMap::iterator it = m_transports.begin(); it != m_transports.end(); ++it)
+        remaining.push_back(it->second->m_transport);
+    }
+    for (vector<OpalTransportPtr>::iterator it = remaining.begin(); it != remaining.end(); ++it)
+      Remove(**it);
+  }
+
+  m_workers.Shutdown();
+  Housekeeping();
+
+#ifdef P_LINUX
+  if (m_wakeFd >= 0)
+    ::close(m_wakeFd);
+  if (m_epollFd >= 0)
+    ::close(m_epollFd);
+#endif
+}
+
+
+PINDEX OpalSignalingReactor::GetTransportCount() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_transports.size();
+}
+
+
+bool OpalSignalingReactor::Add(const OpalTransportPtr & transport,
+                               const ReadyNotifier & notifier,
+                               FramingFunction framer,
+                               const PTimeInterval & timeout)
+{
+  if (!m_running || transport == NULL || framer == NULL || !transport->CanUseSignalingReactor())
+    return false;
+
+  PChannel * channel = transport->GetChannel();
+  PChannel * base = channel != NULL ? channel->GetBaseReadChannel() : NULL;
+  if (base == NULL || !base->IsOpen())
+    return false;
+
+  PWaitAndSignal lock(m_mutex);
+
+  if (m_transports.find(&*transport) != m_transports.end())
+    return true; // Already being serviced
+
+  Handle * handle = new Handle(++m_lastHandleId, transport, notifier, framer, timeout);
+  handle->m_fd = base->GetHandle();
+
+  // Channel must never block from now on, Timeout means "nothing to read"
+  handle->m_savedReadTimeout = channel->GetReadTimeout();
+  channel->SetReadTimeout(0);
+
+  m_handles[handle->m_id] = handle;
+  m_transports[&*transport] = handle;
+
+  if (handle->IsFramed()) {
+    // Already have a PDU, e.g. read by a thread before being handed to us
+    handle->m_state = Handle::e_Dispatched;
+    Queue(*handle);
+  }
+  else if (!Arm(*handle)) {
+    Detach(*handle);
+    delete handle; // Caller has a reference, so transport cannot be deleted
+    return false;
+  }
+
+  PTRACE(4, &*transport, "Added to signalling reactor, fd=" << handle->m_fd << ": " << *transport);
+  return true;
+}
+
+
+void OpalSignalingReactor::Remove(OpalTransport & transport)
+{
+  {
+    PWaitAndSignal lock(m_mutex);
+
+    TransportMap::iterator it = m_transports.find(&transport);
+    if (it == m_transports.end())
+      return;
+
+    Handle & handle = *it->second;
+    Detach(handle);
+    PTRACE(4, &transport, "Removed from signalling reactor: " << transport);
+
+    /* If being read or dispatched, that thread will delete it. Otherwise, do
+       not delete here, as we are probably in the transport Close() and the
+       handle may have the last reference to it. */
+    if (handle.m_state != Handle::e_Waiting)
+      return;
+
+    m_closed.push_back(&handle);
+  }
+
+  Wake();
+}
+
+
+void OpalSignalingReactor::Detach(Handle & handle)
+{
+  handle.m_removed = true;
+  m_handles.erase(handle.m_id);
+  m_transports.erase(&*handle.m_transport);
+
+#ifdef P_LINUX
+  struct epoll_event ev; // Some kernels require non-NULL
+  epoll_ctl(m_epollFd, EPOLL_CTL_DEL, handle.m_fd, &ev);
+#endif
+
+  // Do not change from under the I/O thread, it would block
+  PChannel * channel = handle.m_transport->GetChannel();
+  if (channel != NULL && handle.m_state != Handle::e_Reading)
+    channel->SetReadTimeout(handle.m_savedReadTimeout);
+}
+
+
+bool OpalSignalingReactor::Arm(Handle & handle)
+{
+#ifdef P_LINUX
+  handle.m_state = Handle::e_Waiting;
+
+  // Socket may have been reconnected by the handler
+  PChannel * channel = handle.m_transport->GetChannel();
+  PChannel * base = channel != NULL ? channel->GetBaseReadChannel() : NULL;
+  if (base == NULL || !base->IsOpen())
+    return false;
+  handle.m_fd = base->GetHandle();
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN|EPOLLRDHUP|EPOLLONESHOT;
+  ev.data.u64 = handle.m_id;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_MOD, handle.m_fd, &ev) == 0)
+    return true;
+  if (errno == ENOENT && epoll_ctl(m_epollFd, EPOLL_CTL_ADD, handle.m_fd, &ev) == 0)
+    return true;
+
+  PTRACE(2, &*handle.m_transport, "Could not arm signalling reactor, errno=" << errno << ": " << *handle.m_transport);
+#endif
+  return false;
+}
+
+
+void OpalSignalingReactor::Queue(Handle & handle)
+{
+  m_workers.AddWork(new ReadyWork(*this, &handle));
+}
+
+
+void OpalSignalingReactor::Wake()
+{
+#ifdef P_LINUX
+  if (m_wakeFd >= 0) {
+    eventfd_t one = 1;
+    if (eventfd_write(m_wakeFd, one) < 0 && errno != EAGAIN)
+      PTRACE(1, "Could not wake signalling reactor: errno=" << errno);
+  }
+#endif
+}
+
+
+void OpalSignalingReactor::ThreadMain(unsigned index)
+{
+#ifdef P_LINUX
+  PTRACE(4, "Signalling reactor thread " << index << " started");
+
+  struct epoll_event events[SignalingMaxEventsPerWait];
+  while (m_running) {
+    bool housekeeping;
+    {
+      PWaitAndSignal lock(m_mutex);
+      housekeeping = !m_closed.empty() || m_checkTimer.HasExpired();
+    }
+
+    if (housekeeping && m_checkMutex.Wait(0)) {
+      Housekeeping();
+      m_checkMutex.Signal();
+    }
+
+    int count = epoll_wait(m_epollFd, events, SignalingMaxEventsPerWait, SignalingEventWaitTimeoutMS);
+    if (count < 0) {
+      PTRACE_IF(1, errno != EINTR, "Signalling reactor wait failed: errno=" << errno);
+      continue;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.u64 != 0)
+        OnReadable(events[i].data.u64);
+      else {
+        eventfd_t value;
+        eventfd_read(m_wakeFd, &value);
+      }
+    }
+  }
+
+  PTRACE(4, "Signalling reactor thread " << index << " ended");
+#endif
+}
+
+
+void OpalSignalingReactor::OnReadable(uint64_t id)
+{
+  Handle * handle;
+  {
+    PWaitAndSignal lock(m_mutex);
+
+    /* Look up by identifier, so a stale event for a handle that has been
+       removed, or a re-used file descriptor, is harmlessly ignored. */
+    HandleMap::iterator it = m_handles.find(id);
+    if (it == m_handles.end() || it->second->m_state != Handle::e_Waiting)
+      return;
+
+    handle = it->second;
+    handle->m_state = Handle::e_Reading;
+  }
+
+  bool ready = ReadAvailable(*handle);
+
+  {
+    PWaitAndSignal lock(m_mutex);
+
+    if (!handle->m_removed) {
+      // If could not re-arm, let the handler discover what is wrong
+      if (ready || !Arm(*handle)) {
+        handle->m_state = Handle::e_Dispatched;
+        Queue(*handle);
+      }
+      return;
+    }
+  }
+
+  // Transport was closed while we were reading
+  delete handle;
+}
+
+
+bool OpalSignalingReactor::ReadAvailable(Handle & handle)
+{
+#ifdef P_LINUX
+  OpalTransport & transport = *handle.m_transport;
+  PChannel * channel = transport.GetChannel();
+  if (channel == NULL)
+    return true;
+
+  PBYTEArray & buffer = transport.GetReadAheadBuffer();
+
+  /* Read what is there, but not without limit, so one busy socket cannot
+     starve the others sharing this thread. If there is more, and we do not
+     have a complete PDU yet, the re-arm will get us called again. */
+  PINDEX total = 0;
+  while (total < SignalingMaxReadPerEvent) {
+    PINDEX size = buffer.GetSize();
+    if (!channel->Read(buffer.GetPointer(size+SignalingReadChunkSize)+size, SignalingReadChunkSize)) {
+      buffer.SetSize(size);
+      if (channel->GetErrorCode(PChannel::LastReadError) == PChannel::Timeout)
+        break;
+
+      PTRACE(4, &transport, "Signalling reactor read failed: "
+             << channel->GetErrorText(PChannel::LastReadError) << ": " << transport);
+      return true; // Closed or error, let the handler find out
+    }
+
+    PINDEX count = channel->GetLastReadCount();
+    buffer.SetSize(size+count);
+    if (count == 0)
+      return true; // End of stream
+    total += count;
+  }
+#endif
+
+  return handle.IsFramed();
+}
+
+
+void OpalSignalingReactor::ReadyWork::Work()
+{
+  m_reactor.OnReady(m_handle);
+}
+
+
+void OpalSignalingReactor::OnReady(Handle * handle)
+{
+  OpalTransport & transport = *handle->m_transport;
+
+  m_mutex.Wait();
+  bool rearm = !handle->m_removed;
+  m_mutex.Signal();
+
+  if (rearm) {
+    PTRACE_CONTEXT_ID_PUSH_THREAD(transport);
+
+    transport.m_threadMutex.Wait();
+    transport.m_reactorThread = PThread::GetCurrentThreadId();
+    transport.m_threadMutex.Signal();
+
+    handle->m_notifier(transport, rearm);
+
+    transport.m_threadMutex.Wait();
+    transport.m_reactorThread = PNullThreadIdentifier;
+    transport.m_threadMutex.Signal();
+  }
+
+  {
+    PWaitAndSignal lock(m_mutex);
+
+    if (!handle->m_removed) {
+      if (rearm) {
+        handle->m_deadline = handle->m_timeout;
+
+        // Already have the next PDU, don't wait for the socket
+        if (handle->IsFramed()) {
+          Queue(*handle);
+          return;
+        }
+
+        if (Arm(*handle))
+          return;
+      }
+
+      // Handler has finished with the reactor, or could not continue
+      Detach(*handle);
+      PTRACE(4, &transport, "Released from signalling reactor: " << transport);
+    }
+  }
+
+  delete handle;
+}
+
+
+void OpalSignalingReactor::Housekeeping()
+{
+  std::list<Handle *> closed;
+  {
+    PWaitAndSignal lock(m_mutex);
+
+    closed.swap(m_closed);
+
+    if (m_running && m_checkTimer.HasExpired()) {
+      m_checkTimer = SignalingCheckInterval;
+      for (HandleMap::iterator it = m_handles.begin(); it != m_handles.end(); ++it) {
+        Handle & handle = *it->second;
+        if (handle.m_state == Handle::e_Waiting && handle.m_deadline.HasExpired()) {
+          PTRACE(4, &*handle.m_transport, "Signalling reactor timeout on " << *handle.m_transport);
+          handle.m_state = Handle::e_Dispatched;
+          Queue(handle);
+        }
+      }
+    }
+  }
+
+  // Outside of mutex, as may be last reference and transport deleted
+  for (std::list<Handle *>::iterator it = closed.begin(); it != closed.end(); ++it)
+    delete *it;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalTransportIP::OpalTransportIP(OpalEndPoint & end,
@@ -1364,10 +1872,25 @@ PBoolean OpalTransportTCP::Connect()
 }
 
 
+bool OpalTransportTCP::ReadBuffered(BYTE * data, PINDEX length)
+{
+  // Use anything the signalling reactor has already read first
+  PINDEX buffered = std::min(length, m_readAhead.GetSize());
+  if (buffered > 0) {
+    memcpy(data, (const BYTE *)m_readAhead, buffered);
+    PINDEX remaining = m_readAhead.GetSize() - buffered;
+    memmove(m_readAhead.GetPointer(), (const BYTE *)m_readAhead + buffered, remaining);
+    m_readAhead.SetSize(remaining);
+  }
+
+  return buffered == length || m_channel->ReadBlock(data + buffered, length - buffered);
+}
+
+
 PBoolean OpalTransportTCP::ReadPDU(PBYTEArray & pdu)
 {
   BYTE header[8];
-  if (!m_channel->Read(header, 1))
+  if (!ReadBuffered(header, 1))
     return false;
 
   // Save timeout
@@ -1381,7 +1904,7 @@ PBoolean OpalTransportTCP::ReadPDU(PBYTEArray & pdu)
 
   if (m_pduLengthFormat != 0) {
     size_t count = std::abs(m_pduLengthFormat);
-    if (PAssert(count > 0 && count <= sizeof(header), "Invalid PDU length") && m_channel->Read(header + 1, count - 1)) {
+    if (PAssert(count > 0 && count <= sizeof(header), "Invalid PDU length") && ReadBuffered(header + 1, count - 1)) {
       packetLength = 0;
       while (count-- > 0)
         packetLength |= header[count] << (8 * (m_pduLengthFormat < 0 ? count : (m_pduLengthFormat - count - 1)));
@@ -1396,7 +1919,7 @@ PBoolean OpalTransportTCP::ReadPDU(PBYTEArray & pdu)
   }
   else if (header[0] != 3) // Make sure is a RFC1006 TPKT version 3
     m_channel->SetErrorValues(PChannel::ProtocolFailure, 0x80000000);
-  else if (m_channel->ReadBlock(header + 1, 3)) { // Get TPKT header
+  else if (ReadBuffered(header + 1, 3)) { // Get TPKT header
     packetLength = ((header[2] << 8) | header[3]);
     if (packetLength >= 4) {
       packetLength -= 4;
@@ -1408,7 +1931,7 @@ PBoolean OpalTransportTCP::ReadPDU(PBYTEArray & pdu)
   }
 
   if (ok && packetLength > 0)
-    ok = m_channel->ReadBlock(pdu.GetPointer(packetLength), packetLength);
+    ok = ReadBuffered(pdu.GetPointer(packetLength), packetLength);
 
   m_channel->SetReadTimeout(oldTimeout);
 
@@ -1416,6 +1939,32 @@ PBoolean OpalTransportTCP::ReadPDU(PBYTEArray & pdu)
 }
 
 
+bool OpalTransportTCP::CanUseSignalingReactor() const
+{
+  return true;
+}
+
+
+PINDEX OpalTransportTCP::GetTPKTFrameLength(const BYTE * data, PINDEX size)
+{
+  if (size < 1)
+    return 0;
+
+  // Not a RFC1006 TPKT version 3, let ReadPDU() report the error
+  if (data[0] != 3)
+    return size;
+
+  if (size < 4)
+    return 0;
+
+  PINDEX packetLength = (data[2] << 8) | data[3];
+  if (packetLength < 4)
+    return size; // Dwarf, again let ReadPDU() report it
+
+  return size >= packetLength ? packetLength : 0;
+}
+
+
 PBoolean OpalTransportTCP::WritePDU(const PBYTEArray & pdu)
 {
   // We copy the data into a new buffer so we can do a single write call. This
@@ -2107,6 +2656,13 @@ const PCaselessString & OpalTransportWS::GetProtoPrefix() const
 }
 
 
+bool OpalTransportWS::CanUseSignalingReactor() const
+{
+  // PWebSocket does its own framing, cannot do non-blocking reads
+  return false;
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 
 OpalTransportWSS::OpalTransportWSS(OpalEndPoint & endpoint, PIPSocket::Address binding, WORD port, bool dummy)
@@ -2164,6 +2720,13 @@ const PCaselessString & OpalTransportWSS::GetProtoPrefix() const
 }
 
 
+bool OpalTransportWSS::CanUseSignalingReactor() const
+{
+  // PWebSocket does its own framing, cannot do non-blocking reads
+  return false;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 OpalHTTPConnector::OpalHTTPConnector(OpalManager & manager, const PURL & url)
@@ -284,6 +284,13 @@ bool OpalDTLSMediaTransport::IsEstablished() const
 }
 
 
+bool OpalDTLSMediaTransport::CanUseMediaReactor() const
+{
+  // Handshake is performed in the read thread, and blocks.
+  return false;
+}
+
+
 bool OpalDTLSMediaTransport::GetKeyInfo(OpalMediaCryptoKeyInfo * keyInfo[2])
 {
   for (PINDEX i = 0; i < 2; ++i) {
@@ -262,7 +262,11 @@ OpalJitterBuffer::~OpalJitterBuffer()
 
 OpalJitterBuffer * OpalJitterBuffer::Create(const OpalMediaType & mediaType, const Init & init)
 {
-  OpalJitterBuffer * jb = OpalJitterBufferFactory::CreateInstance(mediaType, init);
+  OpalJitterBuffer * jb;
+  if (init.m_ringBufferSize > 0 && mediaType == OpalMediaType::Audio())
+    jb = new OpalAudioRingJitterBuffer(init);
+  else
+    jb = OpalJitterBufferFactory::CreateInstance(mediaType, init);
   if (jb == NULL)
     jb = new OpalNonJitterBuffer(init);
   return jb;
@@ -603,7 +607,7 @@ OpalAudioJitterBuffer::AdjustResult OpalAudioJitterBuffer::AdjustCurrentJitterDe
 }
 
 
-PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval & PTRACE_PARAM(, const PTimeInterval & tick))
+PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval & timeout PTRACE_PARAM(, const PTimeInterval & tick))
 {
   // Default response is an empty frame, ie silence with possible comfort noise
   frame.SetPayloadType(RTP_DataFrame::CN);
@@ -611,7 +615,8 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
 
   if (m_maxJitterDelay == 0) {
     m_currentJitterDelay = 0;
-    m_frameCount.Wait(); // Go synchronous
+    if (!m_frameCount.Wait(timeout)) // Go synchronous
+      return !m_closed;
     PWaitAndSignal mutex(m_bufferMutex);
     if (m_frames.empty()) {
         // Must have been reset, clear the semaphore.
@@ -841,6 +846,609 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+#undef COMMON_TRACE_INFO
+#define COMMON_TRACE_INFO ": ts=" << requiredTimestamp << " (" << playOutTimestamp << "), dT=" << removalDelta << ", size=" << GetRingDepth()
+
+#ifndef NO_ANALYSER
+  #undef ANALYSE
+  #define ANALYSE(inout, time, extra) \
+    if (PTrace::CanTrace(ANALYSER_TRACE_LEVEL)) \
+      m_analyser->inout(tick, time, GetRingDepth(), extra)
+#endif
+
+static unsigned RingBufferSize(unsigned requested)
+{
+  unsigned size = 16;
+  while (size < requested && size < 65536)
+    size <<= 1;
+  return size;
+}
+
+
+OpalAudioRingJitterBuffer::OpalAudioRingJitterBuffer(const Init & init)
+  : OpalAudioJitterBuffer(init)
+  , m_ringSize(RingBufferSize(init.m_ringBufferSize))
+  , m_ringMask(m_ringSize-1)
+  , m_slots(new Slot[m_ringSize])
+  , m_readSequence(0)
+  , m_writeSequence(0)
+  , m_insertCount(0)
+  , m_removeCount(0)
+  , m_lastExtendedSequence(UINT_MAX)
+  , m_writerPacketTime(0)
+  , m_flushSequence(0)
+  , m_postedPacketTime(0)
+  , m_pendingTimeUnits(init.m_timeUnits)
+  , m_pendingPacketSize(init.m_packetSize)
+{
+  for (unsigned i = 0; i < m_ringSize; ++i)
+    m_slots[i].m_frame.SetMinSize(m_packetSize);
+
+  PTRACE_J(4, "Audio ring buffer created:" << *this);
+}
+
+
+OpalAudioRingJitterBuffer::~OpalAudioRingJitterBuffer()
+{
+  delete [] m_slots;
+}
+
+
+void OpalAudioRingJitterBuffer::PrintOn(ostream & strm) const
+{
+  strm << "this=" << (void *)this
+       << " packets=" << GetRingDepth() << '/' << m_ringSize
+       <<   " rate=" << m_timeUnits << "kHz"
+       <<  " delay=" << (m_minJitterDelay/m_timeUnits) << '-'
+                     << (m_currentJitterDelay/m_timeUnits) << '-'
+                     << (m_maxJitterDelay/m_timeUnits) << "ms"
+           " frame=" << (m_postedPacketTime/m_timeUnits) << "ms"
+            " grow=" << (m_jitterGrowTime/m_timeUnits) << "ms"
+          " shrink=" << (-m_jitterShrinkTime/m_timeUnits) << "ms"
+                " (" << (m_jitterShrinkPeriod/m_timeUnits) << "ms)";
+}
+
+
+void OpalAudioRingJitterBuffer::SetDelay(const Init & init)
+{
+  PAssert(m_timeUnits == init.m_timeUnits, PInvalidParameter);
+
+  m_bufferMutex.Wait();
+  m_pendingParams = init;
+  m_pendingTimeUnits = init.m_timeUnits;
+  m_pendingPacketSize = init.m_packetSize;
+  m_bufferMutex.Signal();
+
+  m_delayChange.Post();
+}
+
+
+void OpalAudioRingJitterBuffer::Restart()
+{
+  PTRACE_J(3, "Explicit restart of " << *this);
+  m_restartChange.Post();
+  m_closed = false;
+}
+
+
+RTP_Timestamp OpalAudioRingJitterBuffer::GetCurrentJitterDelay() const
+{
+  // Owned by the reader, a stale value is fine for other threads
+  return m_currentJitterDelay;
+}
+
+
+RTP_Timestamp OpalAudioRingJitterBuffer::GetPacketTime() const
+{
+  return m_postedPacketTime;
+}
+
+
+void OpalAudioRingJitterBuffer::InternalReset()
+{
+  // Called only in the reading thread, writer state is reset on its next write
+  InternalResetReader(m_writeSequence);
+  m_writerResetChange.Post();
+}
+
+
+void OpalAudioRingJitterBuffer::InternalResetWriter()
+{
+  m_frameTimeCount       = 0;
+  m_frameTimeSum         = 0;
+  m_lastSequenceNum      = USHRT_MAX;
+  m_lastTimestamp        = UINT_MAX;
+  m_consecutiveOverflows = 0;
+  m_lastExtendedSequence = m_writeSequence - 1;
+}
+
+
+void OpalAudioRingJitterBuffer::InternalFlushWriter()
+{
+  // Reader discards everything written so far, and restarts synchronisation
+  InternalResetWriter();
+  m_flushSequence = (unsigned)m_writeSequence;
+  m_flushChange.Post();
+}
+
+
+void OpalAudioRingJitterBuffer::InternalResetReader(unsigned flushSequence)
+{
+  m_lastBufferSize    = 0;
+  m_bufferStaticTime  = 0;
+  m_bufferLowTime     = 0;
+  m_bufferEmptiedTime = 0;
+
+  m_consecutiveLatePackets = 0;
+  m_consecutiveEmpty       = 0;
+
+  m_synchronisationState = e_SynchronisationStart;
+
+  unsigned sequence = m_readSequence;
+  while ((int)(flushSequence - sequence) > 0) {
+    Slot & slot = m_slots[sequence & m_ringMask];
+    if (slot.m_full && slot.m_sequence == sequence) {
+      slot.m_full = false;
+      ++m_removeCount;
+    }
+    ++sequence;
+  }
+  m_readSequence = sequence;
+}
+
+
+void OpalAudioRingJitterBuffer::InternalApplyChanges()
+{
+  if (m_restartChange.Handle())
+    InternalReset();
+
+  if (m_delayChange.Handle()) {
+    m_bufferMutex.Wait();
+    Init init(m_pendingParams, m_pendingTimeUnits, m_pendingPacketSize);
+    m_bufferMutex.Signal();
+    OpalAudioJitterBuffer::SetDelay(init);
+  }
+
+  if (m_sourceChange.Handle()) {
+    m_packetTime = 0;
+    m_packetsTooLate = m_bufferOverruns = 0; // Reset these stats for new SSRC
+  }
+
+  if (m_flushChange.Handle())
+    InternalResetReader(m_flushSequence);
+
+  if (m_talkBurstChange.Handle()) {
+    // Have been told there is explicit silence by marker, take opportunity
+    // to reduce the current jitter delay.
+    PTRACE_PARAM(AdjustResult adjusted =) AdjustCurrentJitterDelay(m_silenceShrinkTime);
+    PTRACE_J(adjusted == e_ReachedMinimum ? 2 : 3, "Start talk burst: " << adjusted << COMMON_TRACE_DELAY);
+  }
+
+  if (m_packetTimeChange.Handle()) {
+    m_packetTime = m_postedPacketTime;
+    PTRACE_PARAM(AdjustResult adjusted =) AdjustCurrentJitterDelay(0);
+    PTRACE_J(m_packetTimeChangedThrottle, "Frame time set  : "
+                "size=" << GetRingDepth() << ", "
+                "time=" << m_packetTime << " (" << (m_packetTime/m_timeUnits) << "ms), " <<
+                adjusted << COMMON_TRACE_DELAY << m_packetTimeChangedThrottle);
+  }
+}
+
+
+OpalAudioRingJitterBuffer::Slot * OpalAudioRingJitterBuffer::GetOldestSlot()
+{
+  unsigned writeSequence = m_writeSequence;
+  for (unsigned sequence = m_readSequence; (int)(writeSequence - sequence) > 0; ++sequence) {
+    Slot & slot = m_slots[sequence & m_ringMask];
+    if (slot.m_full) {
+      if (slot.m_sequence == sequence)
+        return &slot;
+
+      // Duplicate that raced past the reader, discard
+      slot.m_full = false;
+      ++m_removeCount;
+    }
+  }
+  return NULL;
+}
+
+
+void OpalAudioRingJitterBuffer::RemoveSlot(Slot & slot)
+{
+  m_readSequence = slot.m_sequence + 1;
+  ++m_removeCount;
+  slot.m_full = false; // Writer may now use it
+}
+
+
+bool OpalAudioRingJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTimeInterval & tick)
+{
+  if (m_closed)
+    return false;
+
+  if (frame.GetSize() < RTP_DataFrame::MinHeaderSize) {
+    PTRACE_J(2, "Writing invalid RTP data frame.");
+    return true; // Don't abort, but ignore
+  }
+
+  if (m_writerResetChange.Handle())
+    InternalResetWriter();
+
+  RTP_Timestamp timestamp = frame.GetTimestamp();
+  RTP_SequenceNumber currentSequenceNum = frame.GetSequenceNumber();
+  RTP_SyncSourceId newSyncSource = frame.GetSyncSource();
+
+  // Avoid issues with constant delay offset caused by initial in rush of packets
+  if (m_lastSyncSource == 0 && (m_lastInsertTick == 0 || (tick - m_lastInsertTick) < 10)) {
+    PTRACE_J(4, "Flushing initial audio packet:"
+                " SSRC=" << RTP_TRACE_SRC(newSyncSource) <<
+                " sn=" << currentSequenceNum <<
+                " ts=" << timestamp);
+    m_lastInsertTick = tick;
+    return true;
+  }
+
+  // Check for remote switching media senders, they shouldn't do this but do anyway
+  if (newSyncSource != m_lastSyncSource) {
+    PTRACE_IF(m_ssrcChangedThrottle, m_lastSyncSource != 0, "Buffer reset due to SSRC change from "
+              << RTP_TRACE_SRC(m_lastSyncSource) << " to " << RTP_TRACE_SRC(newSyncSource)
+              << " at sn=" << currentSequenceNum << m_ssrcChangedThrottle);
+    InternalFlushWriter();
+    m_writerPacketTime = 0;
+    m_postedPacketTime = 0;
+    m_sourceChange.Post();
+    m_lastSyncSource = newSyncSource;
+  }
+
+
+  // As for OpalAudioJitterBuffer, ignore markers from systems that send them continuously
+  if (m_consecutiveMarkerBits < m_maxConsecutiveMarkerBits) {
+    if (frame.GetMarker()) {
+      m_consecutiveMarkerBits++;
+      m_talkBurstChange.Post();
+      InternalFlushWriter();
+      PTRACE_J(4, "Start talk burst: ts=" << timestamp);
+    }
+    else
+      m_consecutiveMarkerBits = 0;
+  }
+  else {
+    if (m_consecutiveMarkerBits == m_maxConsecutiveMarkerBits) {
+      PTRACE_J(2, "Every packet has Marker bit, ignoring them from this client!");
+      m_consecutiveMarkerBits++;
+    }
+  }
+
+
+  // Average time between consecutive packets, as for OpalAudioJitterBuffer
+  if (m_lastSequenceNum != USHRT_MAX) {
+    if (timestamp < m_lastTimestamp) {
+      PTRACE_J(2, "Timestamps abruptly changed from " << m_lastTimestamp << " to " << timestamp << ", resynching");
+      InternalFlushWriter();
+    }
+    else if (m_lastSequenceNum+1 == currentSequenceNum) {
+      RTP_Timestamp delta = timestamp - m_lastTimestamp;
+      m_frameTimeSum += delta;
+      if (++m_frameTimeCount > AverageFrameTimePackets) {
+        int newFrameTime = (int)(m_frameTimeSum/m_frameTimeCount);
+        m_frameTimeSum = 0;
+        m_frameTimeCount = 0;
+
+        // If new average changed by more than millisecond, start using it.
+        if (std::abs(newFrameTime - (int)m_writerPacketTime) >= (int)m_timeUnits) {
+          m_writerPacketTime = newFrameTime;
+          m_postedPacketTime = newFrameTime;
+          m_packetTimeChange.Post();
+        }
+      }
+    }
+    else {
+      PTRACE_J(4, "Lost packet(s), resetting frame time average, sn=" << currentSequenceNum);
+      m_frameTimeSum = 0;
+      m_frameTimeCount = 0;
+    }
+  }
+
+  // Slots are indexed by sequence number, extended so it does not wrap
+  unsigned sequence;
+  if (m_lastSequenceNum == USHRT_MAX)
+    sequence = m_lastExtendedSequence + 1;
+  else {
+    int delta = (short)(currentSequenceNum - m_lastSequenceNum);
+    if (delta < -(int)m_ringSize || delta > (int)m_ringSize) {
+      PTRACE_J(3, "Sequence number jumped from " << m_lastSequenceNum << " to " << currentSequenceNum);
+      sequence = m_writeSequence;
+    }
+    else
+      sequence = m_lastExtendedSequence + delta;
+  }
+  m_lastSequenceNum = currentSequenceNum;
+  m_lastTimestamp = timestamp;
+  m_lastExtendedSequence = sequence;
+
+  unsigned readSequence = m_readSequence;
+  if ((int)(sequence - readSequence) < 0) {
+    PTRACE_J(2, "Attempt to insert RTP packet already played out: sn=" << currentSequenceNum << ", ts=" << timestamp);
+    return true;
+  }
+
+  /* Fail safe for infinite queueing, for example, if other thread is not
+     taking stuff out, or more outstanding than there are slots. The oldest
+     timestamp is found from the slots, which only this thread writes. */
+  RTP_Timestamp delta = 0;
+  for (unsigned oldest = readSequence; oldest != sequence; ++oldest) {
+    const Slot & slot = m_slots[oldest & m_ringMask];
+    if (slot.m_full && slot.m_sequence == oldest) {
+      delta = timestamp - slot.m_timestamp;
+      break;
+    }
+  }
+
+  Slot & slot = m_slots[sequence & m_ringMask];
+  if (sequence - readSequence < m_ringSize && !slot.m_full &&
+            delta < (m_maxJitterDelay > 0 ? (m_maxJitterDelay*2) : (m_timeUnits*1000)))
+    m_consecutiveOverflows = 0;
+  else if (slot.m_full && slot.m_sequence == sequence) {
+    PTRACE_J(2, "Attempt to insert two RTP packets with same sequence number: " << currentSequenceNum);
+    return true;
+  }
+  else {
+    ANALYSE(In, timestamp, "Overflow");
+    PTRACE_J(4, "Buffer overflow : ts=" << timestamp << ", delta=" << delta << ", size=" << GetRingDepth());
+    if (++m_consecutiveOverflows > (m_writerPacketTime == 0 ? AverageFrameTimePackets : MaxConsecutiveOverflows)) {
+      PTRACE_J(2, "Consecutive overflow packets, resynching");
+      InternalFlushWriter();
+    }
+    return true;
+  }
+
+  const Slot & previous = m_slots[(sequence-1) & m_ringMask];
+  if (previous.m_full && previous.m_sequence == sequence-1 && previous.m_timestamp == timestamp) {
+    PTRACE_J(2, "Attempt to insert two RTP packets with same timestamp: " << timestamp);
+    return true;
+  }
+
+  // Add to buffer, pre-allocated frame so is only a copy
+  slot.m_frame.Copy(frame);
+  slot.m_timestamp = timestamp;
+  slot.m_sequence = sequence;
+  slot.m_full = true;
+  if ((int)(sequence - m_writeSequence) >= 0)
+    m_writeSequence = sequence + 1;
+  ++m_insertCount;
+
+  ANALYSE(In, timestamp, m_synchronisationState != e_SynchronisationDone ? "PreBuf" : "");
+  PTRACE_IF(sm_EveryPacketLogLevel, m_maxJitterDelay > 0, "Inserted packet :"
+         " ts=" << timestamp << ","
+         " dT=" << (tick - m_lastInsertTick) << ","
+         " payload=" << frame.GetPayloadSize() << ","
+         " size=" << GetRingDepth());
+  m_lastInsertTick = tick;
+
+  if (m_maxJitterDelay == 0)
+    m_frameCount.Signal();
+
+  return true;
+}
+
+
+bool OpalAudioRingJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval & timeout PTRACE_PARAM(, const PTimeInterval & tick))
+{
+  // Default response is an empty frame, ie silence with possible comfort noise
+  frame.SetPayloadType(RTP_DataFrame::CN);
+  frame.SetPayloadSize(0);
+
+  if (m_maxJitterDelay == 0) {
+    m_currentJitterDelay = 0;
+    if (!m_frameCount.Wait(timeout)) // Go synchronous
+      return !m_closed;
+    InternalApplyChanges();
+    Slot * oldestSlot = GetOldestSlot();
+    if (oldestSlot == NULL) {
+        // Must have been reset, clear the semaphore.
+        while (m_frameCount.Wait(0))
+            ;
+    }
+    else {
+      frame.MakeUnique(); // Caller's buffer may be shared, e.g. NACK history
+      frame.Copy(oldestSlot->m_frame);
+      RemoveSlot(*oldestSlot);
+    }
+    return !m_closed;
+  }
+
+  if (m_closed)
+    return false;
+
+  InternalApplyChanges();
+
+#if PTRACING
+  PTimeInterval removalDelta;
+  if (tick == PMaxTimeInterval) {
+    PTimeInterval now = PTimer::Tick();
+    removalDelta = now - m_lastRemoveTick;
+    m_lastRemoveTick = now;
+  }
+  else {
+    removalDelta = tick - m_lastRemoveTick;
+    m_lastRemoveTick = tick;
+  }
+#endif
+
+  // Now we get the timestamp the caller wants
+  const RTP_Timestamp playOutTimestamp = frame.GetTimestamp();
+  RTP_Timestamp requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
+
+  Slot * oldestSlot = GetOldestSlot();
+  if (oldestSlot == NULL) {
+    // As for OpalAudioJitterBuffer, play silence, possibly shrinking the delay
+    ANALYSE(Out, requiredTimestamp, "Empty");
+
+    if ((playOutTimestamp - m_bufferEmptiedTime) > m_silenceShrinkPeriod) {
+      AdjustResult adjusted = AdjustCurrentJitterDelay(m_silenceShrinkTime);
+      if (adjusted != e_Unchanged) {
+        PTRACE_J(adjusted == e_ReachedMinimum ? 2 : 4,
+                 "Long silence    " COMMON_TRACE_INFO << ", " << adjusted << COMMON_TRACE_DELAY);
+        m_bufferEmptiedTime = playOutTimestamp;
+      }
+    }
+
+    ++m_consecutiveEmpty;
+    PTRACE_IF(2, m_consecutiveEmpty == 100, "Always empty    " COMMON_TRACE_INFO);
+    PTRACE_J(m_consecutiveEmpty < 100 && m_synchronisationState == e_SynchronisationDone ? 4U : 100U,
+           "Buffer is empty " COMMON_TRACE_INFO);
+    return true;
+  }
+  m_consecutiveEmpty  = 0;
+  m_bufferEmptiedTime = playOutTimestamp;
+
+  size_t maxFramesInBuffer;
+  if (m_packetTime == 0) {
+    m_synchronisationState = e_SynchronisationStart; // Can't start until we have an average packet time
+    maxFramesInBuffer = 1000000;                     // Disable clock overrun check later in code as well
+  }
+  else {
+    maxFramesInBuffer = m_currentJitterDelay/m_packetTime;
+    if (maxFramesInBuffer < 2)
+      maxFramesInBuffer = 2;
+
+    int currentFramesInBuffer = GetRingDepth(); // Must be signed int for later abs()
+
+    // Clock drift where the buffer drains, see OpalAudioJitterBuffer::ReadData()
+    if (m_bufferLowTime == 0 || currentFramesInBuffer > 1)
+      m_bufferLowTime = playOutTimestamp;
+    else if ((playOutTimestamp - m_bufferLowTime) > m_jitterDriftPeriod) {
+      m_bufferLowTime = playOutTimestamp;
+      PTRACE_J(4, "Clock underrun  " COMMON_TRACE_INFO);
+      m_timestampDelta -= m_packetTime;
+      ANALYSE(Out, requiredTimestamp, "Drift");
+      return true;
+    }
+
+    // Consistently the same size, so shrink the jitter buffer
+    if (m_bufferStaticTime == 0 || std::abs(currentFramesInBuffer - m_lastBufferSize) > 1)
+      m_bufferStaticTime = playOutTimestamp;
+    else if ((playOutTimestamp - m_bufferStaticTime) > m_jitterShrinkPeriod) {
+      m_bufferStaticTime = playOutTimestamp;
+
+      AdjustResult adjusted = AdjustCurrentJitterDelay(m_jitterShrinkTime);
+      PTRACE_J(adjusted == e_ReachedMinimum ? 2 : 4,
+               "Packets on time " COMMON_TRACE_INFO << ", " << adjusted << COMMON_TRACE_DELAY);
+      if (adjusted != e_Unchanged && currentFramesInBuffer > 1)
+        m_synchronisationState = e_SynchronisationShrink;
+    }
+    m_lastBufferSize = currentFramesInBuffer;
+  }
+
+  // Check current buffer state and act accordingly
+  switch (m_synchronisationState) {
+    case e_SynchronisationStart :
+      /* First packet of talk burst, re-calculate the timestamp delta */
+      m_timestampDelta = oldestSlot->m_timestamp - playOutTimestamp;
+      requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
+      m_synchronisationState = e_SynchronisationFill;
+      PTRACE_J(5, "Synchronising   " COMMON_TRACE_INFO << ", oldest=" << oldestSlot->m_timestamp);
+      ANALYSE(Out, oldestSlot->m_timestamp, "PreBuf");
+      return true;
+
+    case e_SynchronisationFill :
+      /* Now see if we have buffered enough yet */
+      if (requiredTimestamp < oldestSlot->m_timestamp) {
+        PTRACE(sm_EveryPacketLogLevel, "Pre-buffering   " COMMON_TRACE_INFO << ", oldest=" << oldestSlot->m_timestamp);
+        /* Nope, play out some silence */
+        ANALYSE(Out, oldestSlot->m_timestamp, "PreBuf");
+        return true;
+      }
+
+      m_synchronisationState = e_SynchronisationDone;
+      PTRACE_J(4, "Synchronise done" COMMON_TRACE_INFO << "," COMMON_TRACE_DELAY);
+      break;
+
+    case e_SynchronisationDone :
+      // Get rid of all the frames that are too late
+      while (requiredTimestamp >= oldestSlot->m_timestamp + m_packetTime) {
+        if (++m_consecutiveLatePackets > 10) {
+          PTRACE_J(2, "Too many late   " COMMON_TRACE_INFO);
+          InternalReset();
+          return true;
+        }
+
+        // Packets late, need a bigger jitter buffer
+        PTRACE_PARAM(AdjustResult adjusted =) AdjustCurrentJitterDelay(m_jitterGrowTime);
+        PTRACE_J(adjusted == e_ReachedMaximum ? 2 : 3,
+                 "Packet too late " COMMON_TRACE_INFO << ", "
+                 "oldest=" << oldestSlot->m_timestamp << ", " <<
+                 adjusted << COMMON_TRACE_DELAY);
+        ANALYSE(Out, oldestSlot->m_timestamp, "Late");
+        m_bufferStaticTime = playOutTimestamp;
+        RemoveSlot(*oldestSlot);
+        ++m_packetsTooLate;
+
+        if ((oldestSlot = GetOldestSlot()) == NULL) {
+          PTRACE(sm_EveryPacketLogLevel, "Buffer emptied  " COMMON_TRACE_INFO);
+          ANALYSE(Out, requiredTimestamp, "Emptied");
+          return true;
+        }
+
+        requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
+      }
+
+      // Clock overrun, see OpalAudioJitterBuffer::ReadData()
+      if (GetRingDepth() <= maxFramesInBuffer*m_overrunFactor)
+        break;
+
+      PTRACE(m_overrunFactor < 10 ? std::min(sm_EveryPacketLogLevel,4U) : 2,
+             "Clock overrun   " COMMON_TRACE_INFO << " greater than "
+             << maxFramesInBuffer*m_overrunFactor << " (" << maxFramesInBuffer << '*' << m_overrunFactor << ')');
+      m_timestampDelta += m_packetTime;
+      // Do next case
+
+    case e_SynchronisationShrink :
+      m_synchronisationState = e_SynchronisationDone;
+      requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
+      while (requiredTimestamp >= oldestSlot->m_timestamp + m_packetTime) {
+        ANALYSE(Out, oldestSlot->m_timestamp, "Shrink");
+        PTRACE(sm_EveryPacketLogLevel, "Dropping packet " COMMON_TRACE_INFO << ", actual-ts=" << oldestSlot->m_timestamp);
+        RemoveSlot(*oldestSlot);
+        ++m_bufferOverruns;
+
+        if ((oldestSlot = GetOldestSlot()) == NULL) {
+          PTRACE(sm_EveryPacketLogLevel, "Buffer emptied  " COMMON_TRACE_INFO);
+          ANALYSE(Out, requiredTimestamp, "Emptied");
+          return true;
+        }
+      }
+      break;
+  }
+
+  // Oldest packet not due yet, or one is missing, as for OpalAudioJitterBuffer
+  if (requiredTimestamp < oldestSlot->m_timestamp) {
+    if (oldestSlot->m_timestamp - requiredTimestamp > m_timeUnits*1000) {
+      PTRACE_J(2, "Too far in ahead" COMMON_TRACE_INFO);
+      InternalReset();
+    }
+    else {
+      PTRACE(sm_EveryPacketLogLevel, "Packet not ready" COMMON_TRACE_INFO << ", oldest=" << oldestSlot->m_timestamp);
+      ANALYSE(Out, requiredTimestamp, "Wait");
+    }
+    return true;
+  }
+
+  // Finally can return the frame we have
+  ANALYSE(Out, oldestSlot->m_timestamp, "");
+  frame.MakeUnique(); // Caller's buffer may be shared, e.g. NACK history
+  frame.Copy(oldestSlot->m_frame);
+  PTRACE(sm_EveryPacketLogLevel, "Delivered packet" COMMON_TRACE_INFO
+         << ", payload=" << frame.GetPayloadSize() << ", actual-ts=" << frame.GetTimestamp());
+  RemoveSlot(*oldestSlot);
+  frame.SetTimestamp(playOutTimestamp);
+  m_consecutiveLatePackets = 0;
+  return true;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalNonJitterBuffer::OpalNonJitterBuffer(const Init & init)
@@ -163,6 +163,74 @@ bool OpalPCAPFile::WriteRTP(const RTP_DataFrame & rtp, WORD port)
 }
 
 
+PINDEX OpalPCAPFile::FormatRTP(PBYTEArray & buffer, PINDEX offset, const RTP_DataFrame & rtp, const PTime & timestamp, WORD port) const
+{
+  static const PINDEX EthernetHeaderSize = 14;
+  static const PINDEX IPHeaderSize = 20;
+  static const PINDEX UDPHeaderSize = 8;
+  static const PINDEX HeadersSize = EthernetHeaderSize + IPHeaderSize + UDPHeaderSize;
+
+  PINDEX rtpSize = rtp.GetPacketSize();
+  PINDEX frameSize = HeadersSize + rtpSize;
+  BYTE * ptr = buffer.GetPointer(offset + sizeof(RecordHeader) + frameSize) + offset;
+
+  RecordHeader header;
+  header.ts_sec  = (uint32_t)timestamp.GetTimeInSeconds();
+  header.ts_usec = timestamp.GetMicrosecond();
+  header.incl_len = header.orig_len = frameSize;
+  memcpy(ptr, &header, sizeof(header)); // May not be aligned
+  ptr += sizeof(header);
+
+  // Ethernet, zero MAC addresses
+  memset(ptr, 0, 12);
+  *(PUInt16b *)(ptr+12) = 0x0800; // IPv4
+  ptr += EthernetHeaderSize;
+
+  static const BYTE Loopback[4] = { 127, 0, 0, 1 };
+  const PIPSocket::Address & srcIP = GetFilterSrcIP();
+  const PIPSocket::Address & dstIP = GetFilterDstIP();
+
+  ptr[0] = 0x45;  // Version 4, 20 byte header
+  ptr[1] = 0;
+  *(PUInt16b *)(ptr+2) = (WORD)(IPHeaderSize + UDPHeaderSize + rtpSize);
+  *(PUInt16b *)(ptr+4) = 0;
+  *(PUInt16b *)(ptr+6) = 0x4000;  // Don't fragment
+  ptr[8] = 64;  // TTL
+  ptr[9] = 17;  // UDP
+  *(PUInt16b *)(ptr+10) = 0;
+  if (srcIP.IsValid() && srcIP.GetVersion() == 4) {
+    DWORD ip = srcIP;
+    memcpy(ptr+12, &ip, 4);
+  }
+  else
+    memcpy(ptr+12, Loopback, 4);
+  if (dstIP.IsValid() && dstIP.GetVersion() == 4) {
+    DWORD ip = dstIP;
+    memcpy(ptr+16, &ip, 4);
+  }
+  else
+    memcpy(ptr+16, Loopback, 4);
+
+  DWORD checksum = 0;
+  for (PINDEX i = 0; i < IPHeaderSize; i += 2)
+    checksum += (ptr[i] << 8) | ptr[i+1];
+  while ((checksum >> 16) != 0)
+    checksum = (checksum & 0xffff) + (checksum >> 16);
+  *(PUInt16b *)(ptr+10) = (WORD)~checksum;
+  ptr += IPHeaderSize;
+
+  *(PUInt16b *)(ptr+0) = port;
+  *(PUInt16b *)(ptr+2) = port;
+  *(PUInt16b *)(ptr+4) = (WORD)(UDPHeaderSize + rtpSize);
+  *(PUInt16b *)(ptr+6) = 0; // No checksum
+  ptr += UDPHeaderSize;
+
+  memcpy(ptr, (const BYTE *)rtp, rtpSize);
+
+  return offset + sizeof(RecordHeader) + frameSize;
+}
+
+
 bool OpalPCAPFile::Frame::Read(PChannel & channel, PINDEX)
 {
   PreRead();
@@ -43,6 +43,8 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendRedundantFra
     return status;
 
   if (redundancies.empty()) {
+    if (frame.GetPayloadSize() == 0)
+      return e_IgnorePacket; // FEC flush, but parity went out with a media packet first
     PTRACE(m_throttleTxRED, &m_session, m_session << "no redundant blocks added");
     return e_ProcessPacket;
   }
@@ -81,15 +83,16 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendRedundantFra
 }
 
 
+static const PINDEX MaxRedundantBlockSize = 1023; // RFC 2198 has 10 bits for block length
+static const unsigned MaxFecMaskBits = 48;          // RFC 5109 long mask
+
 OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendRedundantData(RTP_DataFrame & primary, RTP_DataFrameList & redundancies)
 {
-  if (m_session.m_ulpFecPayloadType == RTP_DataFrame::IllegalPayloadType)
+  if (m_session.m_ulpFecPayloadType == RTP_DataFrame::IllegalPayloadType || IsRtx())
     return e_ProcessPacket; // No redundancies, add primary data and return
 
-  FecData fec;
-  fec.m_level.resize(m_session.m_ulpFecSendLevel);
-
-  switch (OnSendFEC(primary, fec)) {
+  vector<FecData> fecList;
+  switch (OnSendFEC(primary, fecList)) {
     case e_AbortTransport :
       return e_AbortTransport;
     case e_IgnorePacket :
@@ -98,67 +101,130 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendRedundantDat
       break;
   }
 
-  PINDEX size = 10;
-  size_t maskSize = 0;
-  for (vector<FecLevel>::iterator it = fec.m_level.begin(); it != fec.m_level.end(); ++it) {
-    if (!PAssert(!it->m_data.empty(), PLogicError))
-      return e_ProcessPacket; // Invalid redundancy, add primary data and return
-
-    if (maskSize == 0) {
-      maskSize = it->m_mask.size();
-      if (!PAssert(maskSize == 2 || maskSize == 6, PLogicError))
+  for (vector<FecData>::iterator fec = fecList.begin(); fec != fecList.end(); ++fec) {
+    PINDEX size = 10;
+    size_t maskSize = 0;
+    for (vector<FecLevel>::iterator it = fec->m_level.begin(); it != fec->m_level.end(); ++it) {
+      if (!PAssert(!it->m_data.empty(), PLogicError))
         return e_ProcessPacket; // Invalid redundancy, add primary data and return
+
+      if (maskSize == 0) {
+        maskSize = it->m_mask.size();
+        if (!PAssert(maskSize == 2 || maskSize == 6, PLogicError))
+          return e_ProcessPacket; // Invalid redundancy, add primary data and return
+      }
+      else {
+        if (!PAssert(maskSize == it->m_mask.size(), PLogicError))
+          return e_ProcessPacket; // Invalid redundancy, add primary data and return
+      }
+
+      size += it->m_data.size() + maskSize + 2;
     }
-    else {
-      if (!PAssert(maskSize == it->m_mask.size(), PLogicError))
-        return e_ProcessPacket; // Invalid redundancy, add primary data and return
+
+    if (size > MaxRedundantBlockSize) {
+      PTRACE(m_throttleTxFEC, &m_session, *this << "ULP-FEC block too large for redundant packet: "
+             << size << " bytes, SN base=" << fec->m_snBase << m_throttleTxFEC);
+      continue;
     }
 
-    size += it->m_data.size() + maskSize + 2;
-  }
+    RTP_DataFrame * red = new RTP_DataFrame(size);
+    redundancies.Append(red);
+    red->CopyHeader(primary);
+    red->SetPayloadType(m_session.m_ulpFecPayloadType);
+
+    BYTE * data = red->GetPayloadPtr();
+    if (maskSize == 6)
+      *data |= 0x40;
+    if (fec->m_pRecovery)
+      *data |= 0x20;
+    if (fec->m_xRecovery)
+      *data |= 0x10;
+    *data |= (BYTE)(fec->m_ccRecovery&0xf);
+    ++data;
+    if (fec->m_mRecovery)
+      *data |= 0x80;
+    *data |= (BYTE)(fec->m_ptRecovery&0x7f);
+    ++data;
+    *(PUInt16b *)data = (uint16_t)fec->m_snBase;
+    data += 2;
+    *(PUInt32b *)data = fec->m_tsRecovery;
+    data += 4;
+    *(PUInt16b *)data = (uint16_t)fec->m_lenRecovery;
+    data += 2;
 
-  RTP_DataFrame * red = new RTP_DataFrame(size);
-  redundancies.Append(red);
-  red->CopyHeader(primary);
-  red->SetPayloadType(m_session.m_ulpFecPayloadType);
-
-  BYTE * data = red->GetPayloadPtr();
-  if (maskSize == 6)
-    *data |= 0x40;
-  if (fec.m_pRecovery)
-    *data |= 0x20;
-  if (fec.m_xRecovery)
-    *data |= 0x10;
-  *data |= (BYTE)(fec.m_ccRecovery&0xf);
-  ++data;
-  if (fec.m_mRecovery)
-    *data |= 0x80;
-  *data |= (BYTE)(fec.m_ptRecovery&0x7f);
-  ++data;
-  *(PUInt16b *)data = (uint16_t)fec.m_snBase;
-  data += 2;
-  *(PUInt32b *)data = fec.m_tsRecovery;
-  data += 4;
-  *(PUInt16b *)data = (uint16_t)fec.m_lenRecovery;
-  data += 2;
+    for (vector<FecLevel>::iterator it = fec->m_level.begin(); it != fec->m_level.end(); ++it) {
+      *(PUInt16b *)data = (uint16_t)it->m_data.size();
+      data += 2;
+      memcpy(data, it->m_mask, maskSize);
+      data += maskSize;
+      memcpy(data, it->m_data, it->m_data.size());
+      data += it->m_data.size();
+    }
 
-  for (vector<FecLevel>::iterator it = fec.m_level.begin(); it != fec.m_level.end(); ++it) {
-    *(PUInt16b *)data = (uint16_t)it->m_data.size();
-    data += 2;
-    memcpy(data, it->m_mask, maskSize);
-    data += maskSize;
-    memcpy(data, it->m_data, it->m_data.size());
-    data += it->m_data.size();
+    ++m_fecPackets;
+    PTRACE(5, &m_session, *this << "adding ULP-FEC: SN base=" << fec->m_snBase << ", size=" << size);
   }
 
-  PTRACE(5, &m_session, m_session << "adding (eventually) redundant ULP-FEC");
   return e_ProcessPacket;
 }
 
 
-OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendFEC(RTP_DataFrame & /*primary*/, FecData & /*fec*/)
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendFEC(RTP_DataFrame & primary, vector<FecData> & fec)
+{
+  unsigned groupSize = std::min(std::max(m_session.m_ulpFecGroupSize, 1U), MaxFecMaskBits);
+  unsigned levels = std::min(std::max(m_session.m_ulpFecSendLevel, 1U), groupSize);
+  if (m_fecEncoder.GetGroupSize() != groupSize || m_fecEncoder.GetLevels() != levels)
+    m_fecEncoder.SetGroupSize(groupSize, levels);
+
+  // Empty packet has nothing to protect, it only carries the parity, see GetFECFlushFrame()
+  if (primary.GetPayloadSize() == 0)
+    return m_fecEncoder.Flush(fec) ? e_ProcessPacket : e_IgnorePacket;
+
+  return m_fecEncoder.Encode(primary, fec) ? e_ProcessPacket : e_IgnorePacket;
+}
+
+
+static const PTimeInterval FecIdleFlushTime(0, 1);
+
+bool OpalRTPSession::SyncSource::GetFECFlushFrame(RTP_DataFrame & frame, const PTime & now, bool idleOnly)
+{
+  if (m_direction != e_Sender || IsRtx() || !m_fecEncoder.HasPending())
+    return false;
+
+  if (idleOnly && (now - m_lastPacketNetTime) < FecIdleFlushTime)
+    return false;
+
+  // Same payload type and timestamp as the last media, but no payload
+  frame.SetPayloadSize(0);
+  frame.SetSyncSource(m_sourceIdentifier);
+  frame.SetPayloadType(m_fecEncoder.GetLastPayloadType());
+  frame.SetTimestamp(m_fecEncoder.GetLastTimestamp());
+  return true;
+}
+
+
+void OpalRTPSession::FlushFEC(const PTime & now, bool idleOnly)
 {
-  return e_IgnorePacket;
+  if (m_ulpFecPayloadType == RTP_DataFrame::IllegalPayloadType || m_redundencyPayloadType == RTP_DataFrame::IllegalPayloadType)
+    return;
+
+  RTP_DataFrameList frames;
+  {
+    P_INSTRUMENTED_LOCK_READ_ONLY(return);
+    for (SyncSourceMap::iterator it = m_SSRC.begin(); it != m_SSRC.end(); ++it) {
+      RTP_DataFrame * frame = new RTP_DataFrame;
+      if (it->second->GetFECFlushFrame(*frame, now, idleOnly))
+        frames.Append(frame);
+      else
+        delete frame;
+    }
+  }
+
+  // Actual transmission has to be outside mutex
+  for (RTP_DataFrameList::iterator it = frames.begin(); it != frames.end(); ++it) {
+    PTRACE(4, *this << "flushing ULP-FEC parity for SSRC=" << RTP_TRACE_SRC(it->GetSyncSource()));
+    WriteData(*it);
+  }
 }
 
 
@@ -211,6 +277,10 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveRedundant
     size -= len;
   }
 
+  // Empty primary is only there to carry redundant data, e.g. final FEC parity
+  if (primary.GetPayloadSize() == 0)
+    return e_IgnorePacket;
+
   frame = primary;
   return e_ProcessPacket;
 }
@@ -228,14 +298,14 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveRedundant
     return e_ProcessPacket;
   }
 
-  if (size <= 16) {
+  if (size < 14) {
     PTRACE(2, &m_session, m_session << "redundant ULP-FEC too small: " << size << " bytes");
     return e_IgnorePacket; // This is abort processing redundant data and just return the primary frame
   }
 
   FecData fec;
   fec.m_timestamp = timestamp;
-  bool maskSize = (*data & 0x40) != 0 ? 6 : 2;
+  PINDEX maskSize = (*data & 0x40) != 0 ? 6 : 2;
   fec.m_pRecovery = (*data & 0x20) != 0;
   fec.m_xRecovery = (*data & 0x10) != 0;
   fec.m_ccRecovery = (*data & 0xf);
@@ -253,13 +323,21 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveRedundant
 
   PINDEX hdrLen = 2 + maskSize;
   while (size >= hdrLen) {
+    PINDEX protectionLength = *(PUInt16b *)data;
+    if (size < hdrLen + protectionLength) {
+      PTRACE(2, &m_session, m_session << "redundant ULP-FEC level " << fec.m_level.size() << " truncated: "
+             << size << " bytes, expecting " << (hdrLen + protectionLength));
+      return e_IgnorePacket;
+    }
+
+    // Copy as may be kept until the packets it protects arrive
     FecLevel level;
-    level.m_mask = PBYTEArray(data+2, maskSize, false);
-    level.m_data = PBYTEArray(data+hdrLen, *(PUInt16b *)data, false);
+    level.m_mask = PBYTEArray(data+2, maskSize);
+    level.m_data = PBYTEArray(data+hdrLen, protectionLength);
     fec.m_level.push_back(level);
 
-    data += hdrLen;
-    size -= hdrLen;
+    data += hdrLen + protectionLength;
+    size -= hdrLen + protectionLength;
   }
 
   PTRACE(5, &m_session, m_session << "redundant ULP-FEC:"
@@ -268,18 +346,329 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveRedundant
 }
 
 
-OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveFEC(RTP_DataFrame & /*primary*/, const FecData & /*fec*/)
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveFEC(RTP_DataFrame & primary, const FecData & fec)
 {
-  /* If there is something in m_pendingPackets, then there was a missing
-     packet(s). From the primary data packet and the FEC info, it should be
-     possible to calculate the missing packet and insert it into the correct
-     position of m_pendingPackets. It will then be fed out as though it was
-     just an out of order packet.
-   */
+  RTP_DataFrameList recovered;
+  m_fecDecoder.AddFEC(fec, primary.GetSyncSource(), recovered);
+  return OnReceiveFECRecovered(recovered);
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveFECProtected(RTP_DataFrame & frame)
+{
+  RTP_DataFrameList recovered;
+  m_fecDecoder.AddPacket(frame, recovered);
+  return OnReceiveFECRecovered(recovered);
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveFECRecovered(RTP_DataFrameList & recovered)
+{
+  if (recovered.IsEmpty())
+    return e_ProcessPacket;
+
+  bool resequencing = m_session.ResequenceOutOfOrderPackets(*this);
+
+  for (RTP_DataFrameList::iterator it = recovered.begin(); it != recovered.end(); ++it) {
+    it->SetLipSyncId(m_mediaStreamId);
+
+    uint32_t sequenceNumber = ExtendSequenceNumber(it->GetSequenceNumber());
+    if (sequenceNumber > m_extendedSequenceNumber) {
+      /* We are still waiting for it, so put where the resequencing will find
+         it, replacing the "lost" marker if there is one. */
+      RxPacket rxp(*it, e_RxFromFEC);
+      std::pair<RxPacketMap::iterator,bool> result = m_pendingRxPackets.insert(make_pair(sequenceNumber, rxp));
+      if (!result.second) {
+        if (!result.first->second.m_lastNackTime.IsValid())
+          continue; // Actually arrived while we were recovering it
+        result.first->second = rxp;
+      }
+      ++m_fecPackets;
+      PTRACE(m_throttleRxFEC, &m_session, *this << "recovered packet SN=" << it->GetSequenceNumber()
+             << " via ULP-FEC, pending resequencing" << m_throttleRxFEC);
+    }
+    else if (resequencing) {
+      PTRACE(4, &m_session, *this << "recovered packet SN=" << it->GetSequenceNumber()
+             << " via ULP-FEC too late, expected=" << (m_extendedSequenceNumber+1));
+    }
+    else {
+      // The jitter buffer will put it in the right place, if it is not too late
+      ++m_fecPackets;
+      if (m_packetsUnrecovered > 0)
+        --m_packetsUnrecovered;
+      PTRACE(m_throttleRxFEC, &m_session, *this << "recovered packet SN=" << it->GetSequenceNumber()
+             << " via ULP-FEC, passed to jitter buffer" << m_throttleRxFEC);
+      if (CallReceiveNotifiers(*it) == e_AbortTransport)
+        return e_AbortTransport;
+    }
+  }
 
   return e_ProcessPacket;
 }
 
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalRTPSession::FecEncoder::FecEncoder(unsigned groupSize, unsigned levels)
+  : m_groupSize(0)
+  , m_levels(0)
+  , m_count(0)
+  , m_snBase(0)
+  , m_lastPayloadType(RTP_DataFrame::IllegalPayloadType)
+  , m_lastTimestamp(0)
+{
+  SetGroupSize(groupSize, levels);
+}
+
+
+void OpalRTPSession::FecEncoder::SetGroupSize(unsigned groupSize, unsigned levels)
+{
+  m_groupSize = std::min(std::max(groupSize, 1U), MaxFecMaskBits);
+  m_levels = std::min(std::max(levels, 1U), m_groupSize);
+  m_count = 0;
+  m_ready.clear();
+}
+
+
+void OpalRTPSession::FecEncoder::StartGroup(RTP_SequenceNumber snBase)
+{
+  m_snBase = snBase;
+  m_count = 0;
+
+  // New arrays, as previous may be shared with data being sent
+  m_parity.resize(m_levels);
+  m_masks.assign(m_levels, 0);
+  for (vector<FecData>::iterator it = m_parity.begin(); it != m_parity.end(); ++it) {
+    it->m_timestamp = 0;
+    it->m_pRecovery = false;
+    it->m_xRecovery = false;
+    it->m_ccRecovery = 0;
+    it->m_mRecovery = false;
+    it->m_ptRecovery = 0;
+    it->m_snBase = snBase;
+    it->m_tsRecovery = 0;
+    it->m_lenRecovery = 0;
+    it->m_level.assign(1, FecLevel());
+  }
+}
+
+
+bool OpalRTPSession::FecEncoder::Encode(const RTP_DataFrame & frame, vector<FecData> & fec)
+{
+  /* Parity for the previous group goes out with this packet, rather than
+     the last packet of the group, so it is not lost along with it. */
+  fec.swap(m_ready);
+  m_ready.clear();
+
+  m_lastPayloadType = frame.GetPayloadType();
+  m_lastTimestamp = frame.GetTimestamp();
+
+  RTP_SequenceNumber sn = frame.GetSequenceNumber();
+  unsigned offset = (RTP_SequenceNumber)(sn - m_snBase);
+  if (m_count == 0 || offset >= MaxFecMaskBits) {
+    StartGroup(sn); // A big jump in sequence numbers abandons partial group
+    offset = 0;
+  }
+
+  unsigned index = m_count % m_levels;
+  m_masks[index] |= 1ULL << offset;
+
+  FecData & parity = m_parity[index];
+  parity.m_mRecovery = parity.m_mRecovery != frame.GetMarker();
+  parity.m_ptRecovery ^= frame.GetPayloadType();
+  parity.m_tsRecovery ^= frame.GetTimestamp();
+  parity.m_timestamp = frame.GetTimestamp();
+
+  PINDEX size = frame.GetPayloadSize();
+  parity.m_lenRecovery ^= size;
+
+  PBYTEArray & data = parity.m_level[0].m_data;
+  if (data.GetSize() < size)
+    data.SetSize(size);
+  BYTE * parityPtr = data.GetPointer();
+  const BYTE * payloadPtr = frame.GetPayloadPtr();
+  for (PINDEX i = 0; i < size; ++i)
+    parityPtr[i] ^= payloadPtr[i];
+
+  if (++m_count == m_groupSize)
+    CompleteGroup();
+
+  return !fec.empty();
+}
+
+
+bool OpalRTPSession::FecEncoder::Flush(vector<FecData> & fec)
+{
+  if (m_count > 0)
+    CompleteGroup();
+
+  fec.swap(m_ready);
+  m_ready.clear();
+  return !fec.empty();
+}
+
+
+void OpalRTPSession::FecEncoder::CompleteGroup()
+{
+  for (unsigned level = 0; level < m_levels; ++level) {
+    uint64_t bits = m_masks[level];
+    if (bits == 0)
+      continue;
+
+    PBYTEArray & mask = m_parity[level].m_level[0].m_mask;
+    mask.SetSize((bits >> 16) != 0 ? 6 : 2);
+    for (unsigned offset = 0; offset < MaxFecMaskBits; ++offset) {
+      if ((bits & (1ULL << offset)) != 0)
+        mask[offset/8] |= (BYTE)(0x80 >> (offset%8));
+    }
+
+    m_ready.push_back(m_parity[level]);
+  }
+
+  m_count = 0;
+}
+
+
+OpalRTPSession::FecDecoder::FecDecoder()
+  : m_history(HistorySize)
+  , m_historySN(HistorySize, -1)
+  , m_ssrc(0)
+  , m_highestSN(0)
+  , m_receivedAny(false)
+{
+}
+
+
+bool OpalRTPSession::FecDecoder::HasPacket(RTP_SequenceNumber sn) const
+{
+  return m_historySN[sn % HistorySize] == sn;
+}
+
+
+void OpalRTPSession::FecDecoder::AddPacket(const RTP_DataFrame & frame, RTP_DataFrameList & recovered)
+{
+  RTP_SequenceNumber sn = frame.GetSequenceNumber();
+  if (!m_receivedAny || (RTP_SequenceNumber)(sn - m_highestSN) < 0x8000)
+    m_highestSN = sn;
+  m_receivedAny = true;
+  m_ssrc = frame.GetSyncSource();
+
+  // Take a copy as the caller is likely to alter it, e.g. decoding in place
+  unsigned index = sn % HistorySize;
+  m_history[index] = frame;
+  m_history[index].MakeUnique();
+  m_historySN[index] = sn;
+
+  if (!m_pending.empty())
+    RecoverPending(recovered);
+}
+
+
+void OpalRTPSession::FecDecoder::AddFEC(const FecData & fec, RTP_SyncSourceId ssrc, RTP_DataFrameList & recovered)
+{
+  m_ssrc = ssrc;
+
+  if (Recover(fec, recovered)) {
+    if (!recovered.IsEmpty() && !m_pending.empty())
+      RecoverPending(recovered);
+    return;
+  }
+
+  m_pending.push_back(fec);
+  if (m_pending.size() > MaxPendingFEC)
+    m_pending.pop_front();
+}
+
+
+void OpalRTPSession::FecDecoder::RecoverPending(RTP_DataFrameList & recovered)
+{
+  // A recovered packet might allow another parity block to be used, so keep going
+  PINDEX previous;
+  do {
+    previous = recovered.GetSize();
+
+    std::list<FecData>::iterator it = m_pending.begin();
+    while (it != m_pending.end()) {
+      RTP_SequenceNumber age = (RTP_SequenceNumber)(m_highestSN - it->m_snBase);
+      if ((age < 0x8000 && age > HistorySize - MaxFecMaskBits) || Recover(*it, recovered))
+        m_pending.erase(it++);
+      else
+        ++it;
+    }
+  } while (recovered.GetSize() > previous && !m_pending.empty());
+}
+
+
+bool OpalRTPSession::FecDecoder::Recover(const FecData & fec, RTP_DataFrameList & recovered)
+{
+  // Only use level 0, which must cover the entire packet to recover it
+  if (fec.m_level.empty())
+    return true;
+
+  const FecLevel & level = fec.m_level[0];
+  unsigned maskBits = level.m_mask.GetSize()*8;
+
+  vector<const RTP_DataFrame *> present;
+  RTP_SequenceNumber missingSN = 0;
+  unsigned missing = 0;
+  for (unsigned offset = 0; offset < maskBits; ++offset) {
+    if ((level.m_mask[offset/8] & (0x80 >> (offset%8))) != 0) {
+      RTP_SequenceNumber sn = (RTP_SequenceNumber)(fec.m_snBase + offset);
+      if (HasPacket(sn))
+        present.push_back(&m_history[sn % HistorySize]);
+      else {
+        if (++missing > 1)
+          return false; // Wait and see if we get more
+        missingSN = sn;
+      }
+    }
+  }
+
+  if (missing == 0)
+    return true; // Got everything, this parity is not needed
+
+  bool marker = fec.m_mRecovery;
+  unsigned payloadType = fec.m_ptRecovery;
+  unsigned timestamp = fec.m_tsRecovery;
+  PINDEX length = fec.m_lenRecovery;
+  for (vector<const RTP_DataFrame *>::iterator it = present.begin(); it != present.end(); ++it) {
+    marker = marker != (*it)->GetMarker();
+    payloadType ^= (*it)->GetPayloadType();
+    timestamp ^= (*it)->GetTimestamp();
+    length ^= (*it)->GetPayloadSize();
+  }
+
+  if (length > level.m_data.GetSize()) {
+    PTRACE(4, "Cannot recover SN=" << missingSN << ", ULP-FEC protection length "
+           << level.m_data.GetSize() << " less than packet length " << length);
+    return true;
+  }
+
+  RTP_DataFrame * frame = new RTP_DataFrame(length);
+  frame->SetPayloadType((RTP_DataFrame::PayloadTypes)(payloadType&0x7f));
+  frame->SetMarker(marker);
+  frame->SetSequenceNumber(missingSN);
+  frame->SetTimestamp(timestamp);
+  frame->SetSyncSource(m_ssrc);
+
+  BYTE * payloadPtr = frame->GetPayloadPtr();
+  memcpy(payloadPtr, level.m_data, length);
+  for (vector<const RTP_DataFrame *>::iterator it = present.begin(); it != present.end(); ++it) {
+    const BYTE * protectedPtr = (*it)->GetPayloadPtr();
+    PINDEX count = std::min(length, (*it)->GetPayloadSize());
+    for (PINDEX i = 0; i < count; ++i)
+      payloadPtr[i] ^= protectedPtr[i];
+  }
+
+  recovered.Append(frame);
+
+  unsigned index = missingSN % HistorySize;
+  m_history[index] = *frame;
+  m_history[index].MakeUnique();
+  m_historySN[index] = missingSN;
+  return true;
+}
+
 #endif // OPAL_RTP_FEC
 
 
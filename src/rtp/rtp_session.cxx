@@ -118,6 +118,7 @@ OpalRTPSession::OpalRTPSession(const Init & init)
   , m_redundencyPayloadType(RTP_DataFrame::IllegalPayloadType)
   , m_ulpFecPayloadType(RTP_DataFrame::IllegalPayloadType)
   , m_ulpFecSendLevel(2)
+  , m_ulpFecGroupSize(8)
 #endif
   , m_dummySyncSource(*this, 0, e_Receiver, "-")
   , m_rtcpPacketsSent(0)
@@ -480,6 +481,9 @@ OpalRTPSession::SyncSource::SyncSource(OpalRTPSession & session, RTP_SyncSourceI
   , m_metrics(NULL)
 #endif
   , m_jitterBuffer(NULL)
+#if OPAL_RTP_FEC
+  , m_fecPackets(0)
+#endif
 {
   if (m_canonicalName.IsEmpty()) {
     /* CNAME is no longer just a username@host string, for security!
@@ -792,6 +796,10 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveData(RTP_
       ++m_rtxDuplicates;
       break;
 
+    case e_RxFromFEC :
+      PTRACE(4, &m_session, *this << "FEC recovered packet too late: SN=" << sequenceNumber << ", expected=" << expectedSequenceNumber);
+      break;
+
     case e_RxFromNetwork :
       ++m_lateOutOfOrder;
 
@@ -888,12 +896,7 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveData(RTP_
   }
 #endif
 
-  SendReceiveStatus status = m_session.OnReceiveData(frame, rxType, now);
-
-#if OPAL_RTP_FEC
-  if (status == e_ProcessPacket && frame.GetPayloadType() == m_session.m_redundencyPayloadType)
-    status = OnReceiveRedundantFrame(frame);
-#endif
+  SendReceiveStatus status = DecodeReceivedData(frame, rxType, now);
 
   if (rxType != e_RxFromRTX) {
     PINDEX hdrlen;
@@ -976,6 +979,34 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveData(RTP_
   if (IsRtx())
     return OnReceiveRetransmit(frame, now);
 
+  return CallReceiveNotifiers(frame);
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::DecodeReceivedData(RTP_DataFrame & frame,
+                                                                                 ReceiveType rxType,
+                                                                                 const PTime & now)
+{
+  // Already been through session (e.g. decrypted) and redundancy decoding
+  if (rxType == e_RxFromFEC)
+    return e_ProcessPacket;
+
+  SendReceiveStatus status = m_session.OnReceiveData(frame, rxType, now);
+
+#if OPAL_RTP_FEC
+  if (status == e_ProcessPacket && frame.GetPayloadType() == m_session.m_redundencyPayloadType)
+    status = OnReceiveRedundantFrame(frame);
+
+  if (status == e_ProcessPacket && m_session.m_ulpFecPayloadType != RTP_DataFrame::IllegalPayloadType && !IsRtx())
+    status = OnReceiveFECProtected(frame);
+#endif
+
+  return status;
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::CallReceiveNotifiers(RTP_DataFrame & frame)
+{
   Data data(frame);
   for (NotifierMap::iterator it = m_notifiers.begin(); it != m_notifiers.end(); ++it) {
     it->second(m_session, data);
@@ -1108,7 +1139,7 @@ uint32_t OpalRTPSession::SyncSource::ExtendSequenceNumber(RTP_SequenceNumber seq
 
 
 OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnOutOfOrderPacket(RTP_DataFrame & frame,
-                                                                                 ReceiveType &,
+                                                                                 ReceiveType & rxType,
                                                                                  const PTime & now)
 {
   uint32_t sequenceNumber = ExtendSequenceNumber(frame.GetSequenceNumber());
@@ -1154,6 +1185,18 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnOutOfOrderPacket
   }
 
   RxPacket rxp(frame);
+
+#if OPAL_RTP_FEC
+  /* Decode now rather than when resequenced, so this packet, or the parity it
+     carries, can be used to recover the packets we are waiting for. */
+  if (rxType == e_RxFromNetwork && m_session.m_ulpFecPayloadType != RTP_DataFrame::IllegalPayloadType) {
+    SendReceiveStatus status = DecodeReceivedData(frame, rxType, now);
+    if (status != e_ProcessPacket)
+      return status;
+    rxp = RxPacket(frame, e_RxFromFEC);
+  }
+#endif
+
   std::pair<RxPacketMap::iterator,bool> result = m_pendingRxPackets.insert(make_pair(sequenceNumber, rxp));
   if (!result.second)
     result.first->second = rxp;
@@ -1169,6 +1212,8 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnOutOfOrderPacket
     RxPacketMap::iterator next = m_pendingRxPackets.begin();
     sequenceNumber = next->first;
     frame = next->second;
+    if (next->second.m_rxType == e_RxFromFEC)
+      rxType = e_RxFromFEC;
 
     m_pendingRxPackets.erase(next);
 
@@ -1222,7 +1267,7 @@ bool OpalRTPSession::SyncSource::HandlePendingFrames(const PTime & now)
     if (remaining > 0)
       m_endWaitOutOfOrderTime = now + m_session.GetOutOfOrderWaitTime();
 
-    if (OnReceiveData(next->second, e_RxOutOfOrder, now) == e_AbortTransport)
+    if (OnReceiveData(next->second, next->second.m_rxType, now) == e_AbortTransport)
       return false;
 
     m_pendingRxPackets.erase(next);
@@ -1757,6 +1802,19 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::OnSendData(RewriteMode & rewri
 }
 
 
+void OpalRTPSession::OnSendData(RewriteMode rewrite,
+                                RTP_DataFrameList & frames,
+                                std::vector<SendReceiveStatus> & statuses,
+                                const PTime & now)
+{
+  statuses.reserve(frames.GetSize());
+  for (RTP_DataFrameList::iterator it = frames.begin(); it != frames.end(); ++it) {
+    RewriteMode frameRewrite = rewrite; // OnSendData may change it
+    statuses.push_back(OnSendData(frameRewrite, *it, now));
+  }
+}
+
+
 OpalRTPSession::SendReceiveStatus OpalRTPSession::OnSendControl(RTP_ControlFrame &, const PTime &)
 {
   ++m_rtcpPacketsSent;
@@ -2075,6 +2133,9 @@ void OpalRTPSession::TimedSendReport(PTimer&, P_INT_PTR)
 {
   PTRACE_CONTEXT_ID_PUSH_THREAD(*this);
   PTRACE(5, *this << "sending periodic report");
+#if OPAL_RTP_FEC
+  FlushFEC(PTime(), true);
+#endif
   SendReport(0, false);
 }
 
@@ -2201,6 +2262,9 @@ void OpalRTPSession::GetStatistics(OpalMediaStatistics & statistics, Direction d
         AddSpecial(statistics.m_NACKs, ssrcStats.m_NACKs);
         AddSpecial(statistics.m_rtxPackets, ssrcStats.m_rtxPackets);
         AddSpecial(statistics.m_rtxDuplicates, ssrcStats.m_rtxDuplicates);
+#if OPAL_RTP_FEC
+        AddSpecial(statistics.m_FEC, ssrcStats.m_FEC);
+#endif
         AddSpecial(statistics.m_unrecovered, ssrcStats.m_unrecovered);
         AddSpecial(statistics.m_packetsLost, ssrcStats.m_packetsLost);
         if (statistics.m_maxConsecutiveLost < ssrcStats.m_maxConsecutiveLost)
@@ -2265,6 +2329,10 @@ void OpalRTPSession::SyncSource::GetStatistics(OpalMediaStatistics & statistics)
   statistics.m_rtxSSRC           = m_rtxSSRC;
   statistics.m_rtxPackets        = m_rtxPackets;
   statistics.m_rtxDuplicates     = m_rtxDuplicates;
+#if OPAL_RTP_FEC
+  if (m_session.m_ulpFecPayloadType != RTP_DataFrame::IllegalPayloadType)
+    statistics.m_FEC             = m_fecPackets;
+#endif
   statistics.m_unrecovered       = m_packetsUnrecovered;
   statistics.m_packetsLost       = m_packetsMissing;
   if (statistics.m_maxConsecutiveLost < m_maxConsecutiveLost)
@@ -3202,6 +3270,12 @@ bool OpalRTPSession::Close()
   m_endpoint.RegisterLocalRTP(this, true);
   m_reportTimer.Stop(true);
 
+#if OPAL_RTP_FEC
+  // Last group's parity would otherwise never be sent
+  if (IsOpen())
+    FlushFEC(PTime(), false);
+#endif
+
   if (IsOpen() && LockReadOnly(P_DEBUG_LOCATION)) {
     for (SyncSourceMap::iterator it = m_SSRC.begin(); it != m_SSRC.end(); ++it) {
       if ( it->second->m_direction == e_Sender &&
@@ -3402,6 +3476,66 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::WriteData(RTP_DataFrame & fram
 
   UnlockReadWrite(P_DEBUG_LOCATION);
 
+  return WriteProcessedData(*transport, status, frame, remote);
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::WriteData(RTP_DataFrameList & frames,
+                                                            RewriteMode rewrite,
+                                                            const PIPSocketAddressAndPort * remote,
+                                                            const PTime & now)
+{
+  OpalMediaTransportPtr transport = m_transport; // This way avoids races
+  if (transport == NULL) {
+    PTRACE(2, *this << "could not write data frames, no transport");
+    return e_AbortTransport;
+  }
+
+  if (!transport->IsEstablished() || frames.IsEmpty())
+    return e_IgnorePacket;
+
+  if (!LockReadWrite(P_DEBUG_LOCATION))
+    return e_AbortTransport;
+
+  std::vector<SendReceiveStatus> statuses;
+  OnSendData(rewrite, frames, statuses, now);
+
+  UnlockReadWrite(P_DEBUG_LOCATION);
+
+  bool batching = frames.GetSize() > 1 && transport->BeginWriteBatch(e_Data);
+
+  SendReceiveStatus result = e_IgnorePacket;
+  std::vector<SendReceiveStatus>::iterator status = statuses.begin();
+  for (RTP_DataFrameList::iterator it = frames.begin(); it != frames.end(); ++it, ++status) {
+    switch (WriteProcessedData(*transport, *status, *it, remote)) {
+      case e_ProcessPacket :
+        result = e_ProcessPacket;
+        break;
+
+      case e_IgnorePacket :
+        break;
+
+      default :
+        if (batching)
+          transport->EndWriteBatch();
+        return e_AbortTransport;
+    }
+  }
+
+  if (batching && !transport->EndWriteBatch()) {
+    SessionFailed(e_Data PTRACE_PARAM(, "on transport batch write"));
+    return e_AbortTransport;
+  }
+
+  return result;
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::WriteProcessedData(OpalMediaTransport & transport,
+                                                                     SendReceiveStatus status,
+                                                                     RTP_DataFrame & frame,
+                                                                     const PIPSocketAddressAndPort * remote)
+{
   switch (status) {
     case e_IgnorePacket:
       return e_IgnorePacket;
@@ -3409,7 +3543,7 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::WriteData(RTP_DataFrame & fram
     case e_ProcessPacket:
     {
       int mtu = INT_MIN;
-      if (transport->Write(frame.GetPointer(), frame.GetPacketSize(), e_Data, remote, &mtu))
+      if (transport.Write(frame.GetPointer(), frame.GetPacketSize(), e_Data, remote, &mtu))
         return e_ProcessPacket;
 
       if (mtu > INT_MIN) {
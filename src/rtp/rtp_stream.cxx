@@ -378,6 +378,75 @@ PBoolean OpalRTPMediaStream::ReadPacket(RTP_DataFrame & packet)
 
 
 PBoolean OpalRTPMediaStream::WritePacket(RTP_DataFrame & packet)
+{
+  if (!PrepareWrite())
+    return false;
+
+  if (!PrepareWritePacket(packet))
+    return true;
+
+  PSimpleTimer failsafe(m_connection.GetEndPoint().GetManager().GetTxMediaTimeout());
+  while (IsOpen()) {
+    switch (m_rtpSession.WriteData(packet, m_rewriteHeaders ? OpalRTPSession::e_RewriteHeader : OpalRTPSession::e_RewriteSSRC)) {
+      case OpalRTPSession::e_AbortTransport :
+        return false;
+
+      case OpalRTPSession::e_ProcessPacket :
+        return true;
+
+      case OpalRTPSession::e_IgnorePacket :
+        PTRACE(m_throttleWriteData, m_rtpSession << "write data delayed on  " << *this);
+        PThread::Sleep(20);
+        break;
+    }
+    if (failsafe.HasExpired()) {
+        PTRACE(2, m_rtpSession << "write data failed, delayed for too long on  " << *this);
+        return false;
+    }
+  }
+
+  return false;
+}
+
+
+PBoolean OpalRTPMediaStream::WritePackets(RTP_DataFrameList & packets)
+{
+  if (packets.GetSize() < 2)
+    return OpalMediaStream::WritePackets(packets);
+
+  if (!PrepareWrite())
+    return false;
+
+  for (RTP_DataFrameList::iterator it = packets.begin(); it != packets.end(); ++it) {
+    if (!PrepareWritePacket(*it))
+      return OpalMediaStream::WritePackets(packets); // Some to be ignored, rare, so do it the slow way
+  }
+
+  PSimpleTimer failsafe(m_connection.GetEndPoint().GetManager().GetTxMediaTimeout());
+  while (IsOpen()) {
+    switch (m_rtpSession.WriteData(packets, m_rewriteHeaders ? OpalRTPSession::e_RewriteHeader : OpalRTPSession::e_RewriteSSRC)) {
+      case OpalRTPSession::e_AbortTransport :
+        return false;
+
+      case OpalRTPSession::e_ProcessPacket :
+        return true;
+
+      case OpalRTPSession::e_IgnorePacket :
+        PTRACE(m_throttleWriteData, m_rtpSession << "write data delayed on  " << *this);
+        PThread::Sleep(20);
+        break;
+    }
+    if (failsafe.HasExpired()) {
+        PTRACE(2, m_rtpSession << "write data failed, delayed for too long on  " << *this);
+        return false;
+    }
+  }
+
+  return false;
+}
+
+
+bool OpalRTPMediaStream::PrepareWrite()
 {
   if (!IsOpen()) {
     PTRACE(4, "Write to closed media stream " << *this);
@@ -404,6 +473,12 @@ PBoolean OpalRTPMediaStream::WritePacket(RTP_DataFrame & packet)
   }
 #endif
 
+  return true;
+}
+
+
+bool OpalRTPMediaStream::PrepareWritePacket(RTP_DataFrame & packet)
+{
   m_timestamp = packet.GetTimestamp();
 
   if (m_rewriteHeaders && packet.GetPayloadSize() == 0
@@ -411,35 +486,39 @@ PBoolean OpalRTPMediaStream::WritePacket(RTP_DataFrame & packet)
           && (!packet.GetMarker() || GetMediaFormat().GetMediaType() != OpalMediaType::Video())
 #endif
       )
-    return true; // Ignore empty packets, except for video with marker, which can plausibly be empty
+    return false; // Ignore empty packets, except for video with marker, which can plausibly be empty
 
   if (m_syncSource != 0)
     packet.SetSyncSource(m_syncSource);
 
-  PSimpleTimer failsafe(m_connection.GetEndPoint().GetManager().GetTxMediaTimeout());
-  while (IsOpen()) {
-    switch (m_rtpSession.WriteData(packet, m_rewriteHeaders ? OpalRTPSession::e_RewriteHeader : OpalRTPSession::e_RewriteSSRC)) {
-      case OpalRTPSession::e_AbortTransport :
-        return false;
+  return true;
+}
 
-      case OpalRTPSession::e_ProcessPacket :
-        return true;
 
-      case OpalRTPSession::e_IgnorePacket :
-        PTRACE(m_throttleWriteData, m_rtpSession << "write data delayed on  " << *this);
-        PThread::Sleep(20);
-        break;
-    }
-    if (failsafe.HasExpired()) {
-        PTRACE(2, m_rtpSession << "write data failed, delayed for too long on  " << *this);
-        return false;
-    }
-  }
+bool OpalRTPMediaStream::BeginWriteBatch()
+{
+  if (!IsOpen() || IsSource())
+    return false;
+
+  // Remember transport, in case session changes it before EndWriteBatch()
+  m_writeBatchTransport = m_rtpSession.GetTransport();
+  if (m_writeBatchTransport != NULL && m_writeBatchTransport->BeginWriteBatch(OpalMediaTransport::e_Data))
+    return true;
 
+  m_writeBatchTransport.SetNULL();
   return false;
 }
 
 
+void OpalRTPMediaStream::EndWriteBatch()
+{
+  if (m_writeBatchTransport != NULL) {
+    m_writeBatchTransport->EndWriteBatch();
+    m_writeBatchTransport.SetNULL();
+  }
+}
+
+
 PBoolean OpalRTPMediaStream::SetDataSize(PINDEX PTRACE_PARAM(dataSize), PINDEX /*frameTime*/)
 {
   PTRACE(3, "Data size cannot be changed to " << dataSize << ", fixed at " << GetDataSize());
@@ -343,8 +343,12 @@ OpalMediaFormatList OpalRTPConnection::NegotiateFECMediaFormats(OpalMediaSession
 
           if (fmt->GetName().NumCompare(OPAL_REDUNDANT_PREFIX) == EqualTo)
             rtpSession->SetRedundencyPayloadType(fmt->GetPayloadType());
-          else if (fmt->GetName().NumCompare(OPAL_ULP_FEC_PREFIX) == EqualTo)
+          else if (fmt->GetName().NumCompare(OPAL_ULP_FEC_PREFIX) == EqualTo) {
             rtpSession->SetUlpFecPayloadType(fmt->GetPayloadType());
+            // Protection is our choice, so use local format options
+            rtpSession->SetUlpFecGroupSize(it->GetOptionInteger(OpalFEC::GroupSizeOption(), rtpSession->GetUlpFecGroupSize()));
+            rtpSession->SetUlpFecSendLevel(it->GetOptionInteger(OpalFEC::ProtectionLevelOption(), rtpSession->GetUlpFecSendLevel()));
+          }
 
           PTRACE(4, "Accepted redundant format " << *fmt << ", pt=" << fmt->GetPayloadType());
         }
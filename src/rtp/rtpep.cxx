@@ -71,6 +71,20 @@ namespace OpalFEC
   }
 
 
+  const PString & GroupSizeOption()
+  {
+    static const PConstCaselessString s("FEC Group Size");
+    return s;
+  }
+
+
+  const PString & ProtectionLevelOption()
+  {
+    static const PConstCaselessString s("FEC Protection Level");
+    return s;
+  }
+
+
   class BaseMediaFormat : public OpalMediaFormat
   {
     PCLASSINFO(BaseMediaFormat, OpalMediaFormat)
@@ -110,6 +124,8 @@ namespace OpalFEC
     UlpFecMediaFormat(const char * name, const OpalMediaType & mediaType, unsigned clockRate)
       : BaseMediaFormat(name, mediaType, clockRate, "ulpfec", "RFC 5109 ULP Forward Error Correction for ")
     {
+      AddOption(new OpalMediaOptionUnsigned(GroupSizeOption(), false, OpalMediaOption::NoMerge, 8, 1, 48));
+      AddOption(new OpalMediaOptionUnsigned(ProtectionLevelOption(), false, OpalMediaOption::NoMerge, 2, 1, 8));
     }
   };
 
@@ -473,6 +473,8 @@ OpalSRTPSession::OpalSRTPSession(const Init & init)
 {
   CHECK_ERROR(srtp_create, (&m_context, NULL));
 
+  m_protectBuffers.reserve(MaxProtectBuffers);
+
   for (int i = 0; i < 2; ++i) {
     m_keyInfo[i] = NULL;
     for (int j = 0; j < 2; j++)
@@ -691,28 +693,119 @@ OpalRTPSession::SendReceiveStatus OpalSRTPSession::OnSendData(RewriteMode & rewr
     return e_IgnorePacket;
   }
 
+  return ProtectData(frame);
+}
+
+
+void OpalSRTPSession::OnSendData(RewriteMode rewrite, RTP_DataFrameList & frames, std::vector<SendReceiveStatus> & statuses, const PTime & now)
+{
+  // Aleady locked on entry
+
+  /* Retransmits can change the rewrite mode per frame, and are never sent as
+     a list anyway, so let the single frame version sort them out. */
+  if (rewrite != e_RewriteHeader && rewrite != e_RewriteSSRC) {
+    OpalRTPSession::OnSendData(rewrite, frames, statuses, now);
+    return;
+  }
+
+  if (frames.IsEmpty())
+    return;
+
+  statuses.reserve(frames.GetSize());
+  for (RTP_DataFrameList::iterator it = frames.begin(); it != frames.end(); ++it) {
+    RewriteMode frameRewrite = rewrite;
+    statuses.push_back(OpalRTPSession::OnSendData(frameRewrite, *it, now));
+  }
+
+  if (!IsCryptoSecured(e_Sender)) {
+    OPAL_SRTP_TRACE(2, e_Sender, e_Data, frames.begin()->GetSyncSource(), 1, "keys not set, cannot protect data");
+    for (std::vector<SendReceiveStatus>::iterator it = statuses.begin(); it != statuses.end(); ++it) {
+      if (*it == e_ProcessPacket)
+        *it = e_IgnorePacket;
+    }
+    return;
+  }
+
+  ProtectData(frames, statuses);
+}
+
+
+RTP_DataFrame * OpalSRTPSession::GetProtectBuffer()
+{
+  // Aleady locked on entry
+
+  /* A buffer is free if no frame we gave it to still refers to it. Note the
+     reference count can only go down, from outside this lock, so is safe. */
+  for (vector<RTP_DataFrame>::iterator it = m_protectBuffers.begin(); it != m_protectBuffers.end(); ++it) {
+    if (it->IsUnique())
+      return &*it;
+  }
+
+  if (m_protectBuffers.size() >= MaxProtectBuffers)
+    return NULL;
+
+  m_protectBuffers.push_back(RTP_DataFrame(0, ProtectBufferSize + SRTP_MAX_TRAILER_LEN));
+  return &m_protectBuffers.back();
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalSRTPSession::ProtectData(RTP_DataFrame & frame)
+{
+  // Aleady locked on entry
+
   int len = frame.GetPacketSize();
 
-  frame.MakeUnique();
-  frame.SetMinSize(len + SRTP_MAX_TRAILER_LEN);
+  /* If the frame is shared, e.g. the same media fanned out to many legs, or
+     has no room for the trailer, then libSRTP, which encrypts in place, would
+     need a new copy of the whole packet. Instead, protect it in a reusable
+     buffer, and have the frame refer to that, leaving the original alone. */
+  RTP_DataFrame * buffer = NULL;
+  if (!frame.IsUnique() || frame.GetSize() < len + SRTP_MAX_TRAILER_LEN) {
+    buffer = GetProtectBuffer();
+    if (buffer != NULL)
+      buffer->Copy(frame);
+  }
 
-  status = CheckConsecutiveErrors(
+  RTP_DataFrame & target = buffer != NULL ? *buffer : frame;
+  target.MakeUnique();
+  target.SetMinSize(len + SRTP_MAX_TRAILER_LEN);
+
+  PTRACE_PARAM(RTP_SyncSourceId ssrc = frame.GetSyncSource());
+  SendReceiveStatus status = CheckConsecutiveErrors(
               CHECK_ERROR(
-                  srtp_protect, (m_context, frame.GetPointer(), &len),
-                  this, ssrc, frame.GetSequenceNumber()
+                  srtp_protect, (m_context, target.GetPointer(), &len),
+                  this, ssrc, target.GetSequenceNumber()
               ),
               e_Sender, e_Data);
   if (status != e_ProcessPacket)
     return status;
 
-  OPAL_SRTP_TRACE(3, e_Sender, e_Data, ssrc, 2, "protected RTP packet: " << frame.GetPacketSize() << "->" << len);
+  OPAL_SRTP_TRACE(3, e_Sender, e_Data, ssrc, 2, "protected RTP packet: " << target.GetPacketSize() << "->" << len
+                  << (buffer != NULL ? " (buffered)" : ""));
 
-  frame.SetPayloadSize(len - frame.GetHeaderSize());
+  target.SetPayloadSize(len - target.GetHeaderSize());
+
+  if (buffer != NULL)
+    frame = *buffer;
 
   return e_ProcessPacket;
 }
 
 
+void OpalSRTPSession::ProtectData(RTP_DataFrameList & frames, std::vector<SendReceiveStatus> & statuses)
+{
+  // Aleady locked on entry
+
+  /* Note libSRTP has no call to protect several packets at once, so this
+     saves the lock and key checks for each packet, not the encryption. */
+  std::vector<SendReceiveStatus>::iterator status = statuses.begin();
+  for (RTP_DataFrameList::iterator it = frames.begin(); it != frames.end(); ++it, ++status) {
+    if (*status == e_ProcessPacket)
+      *status = ProtectData(*it);
+  }
+}
+
+
 OpalRTPSession::SendReceiveStatus OpalSRTPSession::OnSendControl(RTP_ControlFrame & frame, const PTime & now)
 {
   // Aleady locked on entry
@@ -441,7 +441,9 @@ OpalICEMediaTransport::ICEChannel::ICEChannel(OpalICEMediaTransport & owner, Sub
 PBoolean OpalICEMediaTransport::ICEChannel::Read(void * data, PINDEX size)
 {
   for (;;) {
-    SetReadTimeout(m_owner.m_state <= e_Completed ? m_owner.m_mediaTimeout : m_owner.m_iceTimeout);
+    // When serviced by the media reactor, the read must never block
+    if (!m_owner.m_subchannels[m_subchannel].m_polled)
+      SetReadTimeout(m_owner.m_state <= e_Completed ? m_owner.m_mediaTimeout : m_owner.m_iceTimeout);
     if (!PIndirectChannel::Read(data, size))
       return false;
     if (m_owner.InternalHandleICE(m_subchannel, data, GetLastReadCount()))
@@ -90,6 +90,8 @@ SIPHandler::SIPHandler(SIP_PDU::Methods method,
   , m_state(Unavailable)
   , m_receivedResponse(false)
   , m_expireTimer(ep.GetThreadPool(), ep, m_callID, &SIPHandler::OnExpireTimeout)
+  , m_reconnectTimer(ep.GetThreadPool(), ep, m_callID, &SIPHandler::OnReconnectTimeout)
+  , m_reconnectAttempts(0)
   , m_retryForbidden(params.m_retryForbidden)
 {
   PTRACE_CONTEXT_ID_NEW();
@@ -120,6 +122,7 @@ SIPHandler::SIPHandler(SIP_PDU::Methods method,
 SIPHandler::~SIPHandler() 
 {
   m_expireTimer.Stop();
+  m_reconnectTimer.Stop();
 
   PTRACE_IF(4, !m_addressOfRecord.IsEmpty(),
             "Destroyed " << m_method << " handler for " << m_addressOfRecord);
@@ -556,6 +559,50 @@ void SIPHandler::OnExpireTimeout()
 }
 
 
+void SIPHandler::ReconnectTransport(const OpalTransportPtr & transport)
+{
+  PSafeLockReadWrite mutex(*this);
+  if (!mutex.IsLocked())
+    return;
+
+  m_reconnectTransport = transport;
+  m_reconnectAttempts = 0;
+  m_reconnectTimer.SetInterval(1); // Connect() can block, so not in the caller's thread
+}
+
+
+void SIPHandler::OnReconnectTimeout()
+{
+  OpalTransportPtr transport;
+  {
+    PSafeLockReadOnly mutex(*this);
+    if (!mutex.IsLocked())
+      return;
+    transport = m_reconnectTransport;
+  }
+
+  if (transport == NULL)
+    return;
+
+  State newState = Restoring;
+  if (!transport->Connect()) {
+    if (++m_reconnectAttempts < 2) {
+      // In case remote is bouncing, and is back up quickly, have another go
+      PTRACE(4, "Reconnect failed, retrying in a second, transport " << *transport);
+      m_reconnectTimer.SetInterval(0, 1);
+      return;
+    }
+
+    // Remote has not come back quickly, possibly never, set register into Unavailable
+    // mode where it periodically retries reconnect.
+    newState = Unavailable;
+  }
+
+  m_reconnectTransport.SetNULL();
+  ActivateState(newState);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 static atomic<uint32_t> LastRegId;
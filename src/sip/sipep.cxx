@@ -141,10 +141,13 @@ void SIPEndPoint::ShutDown()
   // Clean up transactions still in progress, waiting for them to terminate.
   for (;;) {
     bool allTerminated = true;
-    for (PSafeDictionary<PString, SIPTransactionBase>::iterator it = m_activeTransactions.begin(); it != m_activeTransactions.end(); ++it) {
-      if (!it->second->IsTerminated()) {
-        allTerminated = false;
-        break;
+    for (unsigned shard = 0; allTerminated && shard < m_activeTransactions.GetShardCount(); ++shard) {
+      TransactionDict::Shard & transactions = m_activeTransactions.GetShardAt(shard);
+      for (TransactionDict::Shard::iterator it = transactions.begin(); it != transactions.end(); ++it) {
+        if (!it->second->IsTerminated()) {
+          allTerminated = false;
+          break;
+        }
       }
     }
     if (allTerminated)
@@ -153,8 +156,11 @@ void SIPEndPoint::ShutDown()
   }
   m_activeTransactions.RemoveAll();
 
-  for (PSafeDictionary<OpalTransportAddress, OpalTransport>::iterator it = m_transportsTable.begin(); it != m_transportsTable.end(); ++it)
-    it->second->CloseWait();
+  for (unsigned shard = 0; shard < m_transportsTable.GetShardCount(); ++shard) {
+    TransportDict::Shard & transports = m_transportsTable.GetShardAt(shard);
+    for (TransportDict::Shard::iterator it = transports.begin(); it != transports.end(); ++it)
+      it->second->CloseWait();
+  }
   m_transportsTable.RemoveAll(true); // Make sure anything left is really deleted
 
   // Now shut down listeners and aggregators
@@ -208,7 +214,8 @@ void SIPEndPoint::NewIncomingConnection(OpalListener &, const OpalTransportPtr &
   }
 
   AddTransport(transport, m_keepAliveType);
-  TransportThreadMain(transport);
+  if (!AddToSignalingReactor(transport))
+    TransportThreadMain(transport);
 }
 
 
@@ -256,6 +263,30 @@ void SIPEndPoint::TransportThreadMain(OpalTransportPtr transport)
 }
 
 
+bool SIPEndPoint::AddToSignalingReactor(const OpalTransportPtr & transport)
+{
+  OpalSignalingReactor * reactor = GetManager().GetSignalingReactor();
+  return reactor != NULL && reactor->Add(transport, PCREATE_SignalingReadyNotifier(OnTransportReady), SIP_PDU::GetStreamFrameLength);
+}
+
+
+void SIPEndPoint::OnTransportReady(OpalTransport & transport, bool & rearm)
+{
+  // One pass of the TransportThreadMain() loop
+  OpalTransportPtr transportPtr(&transport, PSafeReference);
+  HandlePDU(transportPtr);
+
+  if (transport.IsGood()) {
+    // Will already be in reactor, unless was lost and reconnected by HandlePDU()
+    AddToSignalingReactor(transportPtr);
+    return;
+  }
+
+  rearm = false;
+  transport.Close();
+}
+
+
 OpalTransportPtr SIPEndPoint::GetTransport(const SIPTransactionOwner & transactor,
                                             SIP_PDU::StatusCodes & reason)
 {
@@ -379,9 +410,11 @@ OpalTransportPtr SIPEndPoint::GetTransport(const SIPTransactionOwner & transacto
     else if (!transport->IsAuthenticated(transactor.GetRequestURI().GetHostName()))
       reason = SIP_PDU::Local_NotAuthenticated;
     else {
-      if (transport->IsReliable())
-        transport->AttachThread(new PThreadObj1Arg<SIPEndPoint, OpalTransportPtr>
-                (*this, transport, &SIPEndPoint::TransportThreadMain, false, "SIP Transport", PThread::HighestPriority));
+      if (transport->IsReliable()) {
+        if (!AddToSignalingReactor(transport))
+          transport->AttachThread(new PThreadObj1Arg<SIPEndPoint, OpalTransportPtr>
+                  (*this, transport, &SIPEndPoint::TransportThreadMain, false, "SIP Transport", PThread::HighestPriority));
+      }
       else
         transport->SetPromiscuous(OpalTransport::AcceptFromAny);
 
@@ -419,17 +452,8 @@ void SIPEndPoint::HandlePDU(const OpalTransportPtr & transport)
                 regHandler->GetState() == SIPHandler::Subscribed &&
                 regHandler->GetParams().m_compatibility == SIPRegister::e_RFC5626 &&
                 regHandler->GetRemoteTransportAddress().IsEquivalent(transport->GetRemoteAddress())) {
-            SIPHandler::State newState = SIPHandler::Restoring;
-            if (!transport->Connect()) {
-              // In case remote is bouncing, and is back up quickly, have another go
-              PThread::Sleep(1000);
-              if (!transport->Connect()) {
-                // Remote has not come back quickly, possibly never, set register into Unavailable
-                // mode where it periodically retries reconnect.
-                newState = SIPHandler::Unavailable;
-              }
-            }
-            regHandler->ActivateState(newState);
+            // Do not block the signalling thread, which may be shared with other transports
+            regHandler->ReconnectTransport(transport);
             break;
           }
         }
@@ -557,9 +581,12 @@ PBoolean SIPEndPoint::GarbageCollection()
 {
   PTRACE(6, "Garbage collection: transactions=" << m_activeTransactions.GetSize() << ", connections=" << m_connectionsActive.GetSize());
 
-  for (PSafeDictionary<PString, SIPTransactionBase>::iterator it = m_activeTransactions.begin(); it != m_activeTransactions.end(); ++it) {
-    if (it->second->IsTerminated())
-      m_activeTransactions.RemoveAt(it->first); // Unlike a PDictionary() or std::map<>, this is safe to do
+  for (unsigned shard = 0; shard < m_activeTransactions.GetShardCount(); ++shard) {
+    TransactionDict::Shard & transactions = m_activeTransactions.GetShardAt(shard);
+    for (TransactionDict::Shard::iterator it = transactions.begin(); it != transactions.end(); ++it) {
+      if (it->second->IsTerminated())
+        transactions.RemoveAt(it->first); // Unlike a PDictionary() or std::map<>, this is safe to do
+    }
   }
   bool transactionsDone = m_activeTransactions.DeleteObjectsToBeRemoved();
 
@@ -577,11 +604,14 @@ PBoolean SIPEndPoint::GarbageCollection()
     // Do not do the CloseWait() inside this mutex, can cause phantom (and, possibly, actual) deadlocks
     {
       P_INSTRUMENTED_WAIT_AND_SIGNAL(m_transportsMutex);
-      for (PSafeDictionary<OpalTransportAddress, OpalTransport>::iterator it = m_transportsTable.begin(); it != m_transportsTable.end(); ++it) {
-        if (it->second->IsIdle()) {
-          PTRACE(3, "Removing transport to " << it->first);
-          transportsToClose.push_back(it->second);
-          m_transportsTable.RemoveAt(it->first);
+      for (unsigned shard = 0; shard < m_transportsTable.GetShardCount(); ++shard) {
+        TransportDict::Shard & transports = m_transportsTable.GetShardAt(shard);
+        for (TransportDict::Shard::iterator it = transports.begin(); it != transports.end(); ++it) {
+          if (it->second->IsIdle()) {
+            PTRACE(3, "Removing transport to " << it->first);
+            transportsToClose.push_back(it->second);
+            transports.RemoveAt(it->first);
+          }
         }
       }
     }
@@ -595,11 +625,14 @@ PBoolean SIPEndPoint::GarbageCollection()
   bool transportsDone = m_transportsTable.DeleteObjectsToBeRemoved();
 
 
-  for (RegistrarDict::iterator it = m_registeredUAs.begin(); it != m_registeredUAs.end(); ++it) {
-    if (it->second->ExpireBindings())
-      OnChangedRegistrarAoR(*it->second);
-    if (!it->second->HasBindings())
-      m_registeredUAs.RemoveAt(it->first);
+  for (unsigned shard = 0; shard < m_registeredUAs.GetShardCount(); ++shard) {
+    RegistrarDict::Shard & registered = m_registeredUAs.GetShardAt(shard);
+    for (RegistrarDict::Shard::iterator it = registered.begin(); it != registered.end(); ++it) {
+      if (it->second->ExpireBindings())
+        OnChangedRegistrarAoR(*it->second);
+      if (!it->second->HasBindings())
+        registered.RemoveAt(it->first);
+    }
   }
   bool registrarDone = m_registeredUAs.DeleteObjectsToBeRemoved();
 
@@ -981,8 +1014,10 @@ SIPEndPoint::RegistrarAoR * SIPEndPoint::CreateRegistrarAoR(const SIP_PDU & requ
 SIPURLList SIPEndPoint::GetRegistrarAoRs() const
 {
   SIPURLList list;
-  for (PSafePtr<RegistrarAoR> ua(m_registeredUAs); ua != NULL; ++ua)
-    list.push_back(ua->GetAoR());
+  for (unsigned shard = 0; shard < m_registeredUAs.GetShardCount(); ++shard) {
+    for (PSafePtr<RegistrarAoR> ua(m_registeredUAs.GetShardAt(shard)); ua != NULL; ++ua)
+      list.push_back(ua->GetAoR());
+  }
   return list;
 }
 
@@ -2166,6 +2166,17 @@ void SIP_PDU::PrintOn(ostream & strm) const
 }
 
 
+#if PTRACING
+static PString TransportTraceName(const OpalTransportPtr & transport)
+{
+  PStringStream name;
+  if (transport != NULL)
+    name << " from " << transport->GetLastReceivedAddress() << " on " << *transport;
+  return name;
+}
+#endif
+
+
 SIP_PDU::StatusCodes SIP_PDU::Read()
 {
   if (m_transport == NULL)
@@ -2179,7 +2190,7 @@ SIP_PDU::StatusCodes SIP_PDU::Read()
   StatusCodes status;
 
   if (m_transport->IsReliable()) {
-    status = Parse(*m_transport->GetChannel(), false);
+    status = ReadStream();
     PTRACE_IF(2, status == SIP_PDU::Local_TransportLost,
               "Reliable transport lost to " << *m_transport <<
               " - " << m_transport->GetErrorText(PChannel::LastReadError));
@@ -2196,9 +2207,7 @@ SIP_PDU::StatusCodes SIP_PDU::Read()
     truncated = true;
   }
 
-  PStringStream datagram;
-  datagram = PString(pdu);
-  status = Parse(datagram, truncated);
+  status = Parse((const char *)(const BYTE *)pdu, pdu.GetSize(), truncated);
 
 #if PTRACING
   if (status == Local_TransportLost && PTrace::CanTrace(2)) {
@@ -2257,12 +2266,6 @@ SIP_PDU::StatusCodes SIP_PDU::Read()
 
 SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
 {
-#if PTRACING
-  PStringStream transportName;
-  if (m_transport != NULL)
-    transportName << " from " << m_transport->GetLastReceivedAddress() << " on " << *m_transport;
-#endif
-
   stream.clear();
 
   // get the message from transport/datagram into cmd and parse MIME
@@ -2279,17 +2282,17 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
 
     // Two CRLF's in a row is "ping"
     if (cmd.IsEmpty()) {
-      PTRACE(5, "Probable keep-alive ping" << transportName);
+      PTRACE(5, "Probable keep-alive ping" << TransportTraceName(m_transport));
       return Local_KeepAlive;
     }
 
     // Got here, is probably pong to our ping
-    PTRACE(5, "Probable keep-alive pong" << transportName);
+    PTRACE(5, "Probable keep-alive pong" << TransportTraceName(m_transport));
   }
 
   stream >> m_mime;
   if (stream.bad()) {
-    PTRACE(1, "Invalid message from" << transportName
+    PTRACE(1, "Invalid message from" << TransportTraceName(m_transport)
            << ", request \"" << cmd << "\", mime:\n" << m_mime);
     return stream.bad() ? SIP_PDU::Failure_BadRequest : SIP_PDU::Failure_MessageTooLarge;
   }
@@ -2299,11 +2302,364 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
     return SIP_PDU::Failure_MessageTooLarge;
   }
 
+  StatusCodes status = ParseStartLine(cmd);
+  if (status != SIP_PDU::Successful_OK)
+    return status;
+
+  // get the SDP content body
+  // if a content length is specified, read that length
+  // if no content length is specified (which is not the same as zero length)
+  // then read until end of datagram or stream
+  int contentLength;
+  bool contentLengthPresent = GetValidContentLength(contentLength);
+
+  // Don't worry about body if was truncated packet
+  if (!truncated) {
+    if (contentLengthPresent) {
+      if (contentLength > 0) {
+        stream.read(m_entityBody.GetPointerAndSetLength(contentLength), contentLength);
+        if (stream.gcount() != (std::streamsize)contentLength)
+          truncated = true;
+      }
+    }
+    else {
+      contentLength = 0;
+      int c;
+      while ((c = stream.get()) != EOF) {
+        m_entityBody.SetMinSize((++contentLength/1000+1)*1000);
+        m_entityBody += (char)c;
+      }
+    }
+
+    m_entityBody[contentLength] = '\0';
+  }
+
+  return ParseCompleted(cmd, truncated, contentLength);
+}
+
+
+// Get next line, without the CRLF, returns false if no complete line available
+static bool GetNextLine(const char * & ptr, const char * end, const char * & lineStart, const char * & lineEnd)
+{
+  const char * eol = (const char *)memchr(ptr, '\n', end - ptr);
+  if (eol == NULL)
+    return false;
+
+  lineStart = ptr;
+  lineEnd = eol > ptr && eol[-1] == '\r' ? eol-1 : eol;
+  ptr = eol+1;
+  return true;
+}
+
+
+static void AddMIMEField(SIPMIMEInfo & mime, const char * start, const char * end)
+{
+  const char * colon = (const char *)memchr(start, ':', end - start);
+  if (colon == NULL)
+    return;
+
+  const char * nameEnd = colon;
+  while (nameEnd > start && isspace((BYTE)nameEnd[-1]))
+    --nameEnd;
+
+  const char * valueStart = colon+1;
+  while (valueStart < end && isspace((BYTE)*valueStart))
+    ++valueStart;
+  while (end > valueStart && isspace((BYTE)end[-1]))
+    --end;
+
+  mime.AddMIME(PString(start, nameEnd - start), PString(valueStart, end - valueStart));
+}
+
+
+SIP_PDU::StatusCodes SIP_PDU::Parse(const char * data, PINDEX length, bool truncated)
+{
+  // Same as the PString conversion of old, stop at any embedded null
+  const char * nul = (const char *)memchr(data, '\0', length);
+  if (nul != NULL)
+    length = nul - data;
+
+  const char * ptr = data;
+  const char * end = data + length;
+  const char * lineStart;
+  const char * lineEnd;
+
+  if (!GetNextLine(ptr, end, lineStart, lineEnd))
+    return Local_TransportLost;
+
+  // If empty string got CRLF, try again
+  if (lineStart == lineEnd) {
+    if (!GetNextLine(ptr, end, lineStart, lineEnd))
+      return Local_TransportLost;
+
+    // Two CRLF's in a row is "ping"
+    if (lineStart == lineEnd) {
+      PTRACE(5, "Probable keep-alive ping" << TransportTraceName(m_transport));
+      return Local_KeepAlive;
+    }
+
+    // Got here, is probably pong to our ping
+    PTRACE(5, "Probable keep-alive pong" << TransportTraceName(m_transport));
+  }
+
+  PString cmd(lineStart, lineEnd - lineStart);
+
+  /* Each header line is added directly from the buffer, only lines with
+     continuations need to be assembled into a temporary string. */
+  m_mime.RemoveAll();
+  const char * fieldStart = NULL;
+  const char * fieldEnd = NULL;
+  PString continued;
+  for (;;) {
+    if (!GetNextLine(ptr, end, lineStart, lineEnd)) {
+      PTRACE(3, "Truncated MIME:\n" << cmd << '\n' << m_mime);
+      return SIP_PDU::Failure_MessageTooLarge;
+    }
+
+    if (lineStart < lineEnd && (*lineStart == ' ' || *lineStart == '\t')) {
+      if (fieldStart != NULL) {
+        if (continued.IsEmpty())
+          continued = PString(fieldStart, fieldEnd - fieldStart);
+        while (lineStart < lineEnd && isspace((BYTE)*lineStart))
+          ++lineStart;
+        continued += ' ';
+        continued += PString(lineStart, lineEnd - lineStart);
+      }
+      continue;
+    }
+
+    if (!continued.IsEmpty()) {
+      AddMIMEField(m_mime, continued, (const char *)continued + continued.GetLength());
+      continued.MakeEmpty();
+    }
+    else if (fieldStart != NULL)
+      AddMIMEField(m_mime, fieldStart, fieldEnd);
+
+    if (lineStart == lineEnd)
+      break;
+
+    fieldStart = lineStart;
+    fieldEnd = lineEnd;
+  }
+
+  StatusCodes status = ParseStartLine(cmd);
+  if (status != SIP_PDU::Successful_OK)
+    return status;
+
+  int contentLength;
+  bool contentLengthPresent = GetValidContentLength(contentLength);
+
+  // Don't worry about body if was truncated packet
+  if (!truncated) {
+    PINDEX available = end - ptr;
+    if (!contentLengthPresent)
+      contentLength = available;
+    else if (contentLength > available) {
+      contentLength = available;
+      truncated = true;
+    }
+    m_entityBody = PString(ptr, contentLength);
+  }
+
+  return ParseCompleted(cmd, truncated, contentLength);
+}
+
+
+// Check for header field name, case insensitive, full or compact form
+static bool IsFieldName(const char * name, PINDEX length, const char * fullName, char compactName)
+{
+  if (length == 1)
+    return tolower((BYTE)*name) == compactName;
+
+  if (length != (PINDEX)strlen(fullName))
+    return false;
+
+  for (PINDEX i = 0; i < length; ++i) {
+    if (tolower((BYTE)name[i]) != tolower((BYTE)fullName[i]))
+      return false;
+  }
+  return true;
+}
+
+
+static const PINDEX StreamMaxHeaderSize = 65536;
+static const int StreamMaxContentLength = 65535;
+
+
+// Find Content-Length without building the MIME, the full parse does that
+static int GetStreamContentLength(const char * ptr, const char * end)
+{
+  const char * lineStart;
+  const char * lineEnd;
+  while (GetNextLine(ptr, end, lineStart, lineEnd)) {
+    const char * colon = (const char *)memchr(lineStart, ':', lineEnd - lineStart);
+    if (colon != NULL) {
+      const char * nameEnd = colon;
+      while (nameEnd > lineStart && isspace((BYTE)nameEnd[-1]))
+        --nameEnd;
+      if (IsFieldName(lineStart, nameEnd - lineStart, "Content-Length", 'l'))
+        return atoi(colon+1);
+    }
+  }
+  return 0;
+}
+
+
+PINDEX SIP_PDU::GetStreamFrameLength(const BYTE * buffer, PINDEX size)
+{
+  // This must follow exactly what ReadStream() does
+  const char * data = (const char *)buffer;
+
+  /* Returned while the header is incomplete. Past the maximum header size
+     the whole buffer is handed over so ReadStream() fails it, rather than
+     buffering without limit. */
+  PINDEX needMore = size > StreamMaxHeaderSize ? size : 0;
+
+  PINDEX offset = 0;
+  while (size - offset >= 2 && data[offset] == '\r' && data[offset+1] == '\n') {
+    if (size - offset >= 4 && data[offset+2] == '\r' && data[offset+3] == '\n')
+      return offset+4; // Keep-alive ping
+    if (size - offset == 2 || (size - offset == 3 && data[offset+2] == '\r'))
+      return needMore; // Need more data to tell
+    offset += 2; // Pong, skipped by ReadStream()
+  }
+
+  PINDEX headerLength = 0;
+  for (PINDEX searched = offset; searched+1 < size; ++searched) {
+    if (data[searched] == '\n') {
+      if (data[searched+1] == '\n') {
+        headerLength = searched+2 - offset;
+        break;
+      }
+      if (data[searched+1] == '\r') {
+        if (searched+2 >= size)
+          return needMore;
+        if (data[searched+2] == '\n') {
+          headerLength = searched+3 - offset;
+          break;
+        }
+      }
+    }
+  }
+
+  if (headerLength == 0)
+    return needMore;
+
+  int contentLength = GetStreamContentLength(data+offset, data+offset+headerLength);
+  if (contentLength < 0 || contentLength > StreamMaxContentLength)
+    contentLength = 0;
+
+  // Waiting for the body is bounded by StreamMaxContentLength
+  PINDEX messageLength = offset + headerLength + contentLength;
+  return size >= messageLength ? messageLength : 0;
+}
+
+
+SIP_PDU::StatusCodes SIP_PDU::ReadStream()
+{
+  static const PINDEX ReadChunkSize = 4096;
+
+  PChannel & channel = *m_transport->GetChannel();
+  PBYTEArray & buffer = m_transport->GetReadAheadBuffer();
+
+  /* Frame the message in the buffered data using the blank line at the end
+     of the header and the Content-Length, reading from the channel in large
+     chunks as required. Anything after the message is left for next time. */
+  PINDEX headerLength = 0;
+  PINDEX searched = 0;
+  for (;;) {
+    const char * data = (const char *)(const BYTE *)buffer;
+    PINDEX size = buffer.GetSize();
+
+    if (size >= 2 && data[0] == '\r' && data[1] == '\n') {
+      // Two CRLF's in a row is "ping"
+      if (size >= 4 && data[2] == '\r' && data[3] == '\n') {
+        PTRACE(5, "Probable keep-alive ping" << TransportTraceName(m_transport));
+        memmove(buffer.GetPointer(), data+4, size-4);
+        buffer.SetSize(size-4);
+        return Local_KeepAlive;
+      }
+
+      /* Single CRLF is probably pong to our ping. Anything but exactly two
+         CRLF's means it was a single one, only "\r\n\r" needs more data. */
+      if (size > 3 || (size == 3 && data[2] != '\r')) {
+        PTRACE(5, "Probable keep-alive pong" << TransportTraceName(m_transport));
+        memmove(buffer.GetPointer(), data+2, size-2);
+        buffer.SetSize(size-2);
+        searched = 0;
+        continue;
+      }
+    }
+    else {
+      while (searched+1 < size) {
+        if (data[searched] == '\n') {
+          if (data[searched+1] == '\n') {
+            headerLength = searched+2;
+            break;
+          }
+          if (data[searched+1] == '\r') {
+            if (searched+2 >= size)
+              break; // Need more data to tell
+            if (data[searched+2] == '\n') {
+              headerLength = searched+3;
+              break;
+            }
+          }
+        }
+        ++searched;
+      }
+
+      if (headerLength > 0)
+        break;
+    }
+
+    if (size > StreamMaxHeaderSize) {
+      PTRACE(2, "Header too large, " << size << " bytes with no end" << TransportTraceName(m_transport));
+      buffer.SetSize(0);
+      return SIP_PDU::Failure_MessageTooLarge;
+    }
+
+    if (!channel.Read(buffer.GetPointer(size+ReadChunkSize)+size, ReadChunkSize)) {
+      buffer.SetSize(size);
+      return Local_TransportLost;
+    }
+    buffer.SetSize(size+channel.GetLastReadCount());
+  }
+
+  const char * headerStart = (const char *)(const BYTE *)buffer;
+  int contentLength = GetStreamContentLength(headerStart, headerStart + headerLength);
+  if (contentLength < 0 || contentLength > StreamMaxContentLength) {
+    PTRACE(2, "Invalid Content-Length " << contentLength << " on stream" << TransportTraceName(m_transport) << ", ignoring body.");
+    contentLength = 0;
+  }
+
+  PINDEX messageLength = headerLength + contentLength;
+  while (buffer.GetSize() < messageLength) {
+    PINDEX size = buffer.GetSize();
+    if (!channel.Read(buffer.GetPointer(messageLength)+size, messageLength-size)) {
+      buffer.SetSize(size);
+      return Local_TransportLost;
+    }
+    buffer.SetSize(size+channel.GetLastReadCount());
+  }
+
+  StatusCodes status = Parse((const char *)(const BYTE *)buffer, messageLength, false);
+
+  PINDEX remaining = buffer.GetSize() - messageLength;
+  memmove(buffer.GetPointer(), (const BYTE *)buffer + messageLength, remaining);
+  buffer.SetSize(remaining);
+
+  return status;
+}
+
+
+SIP_PDU::StatusCodes SIP_PDU::ParseStartLine(const PString & cmd)
+{
   if (cmd.Left(4) *= "SIP/") {
     // parse Response version, code & reason (ie: "SIP/2.0 200 OK")
     PINDEX space = cmd.Find(' ');
     if (space == P_MAX_INDEX) {
-      PTRACE(2, "Bad Status-Line \"" << cmd << "\" received" << transportName);
+      PTRACE(2, "Bad Status-Line \"" << cmd << "\" received" << TransportTraceName(m_transport));
       return SIP_PDU::Failure_BadRequest;
     }
 
@@ -2317,7 +2673,7 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
     // parse the method, URI and version
     PStringArray cmds = cmd.Tokenise( ' ', false);
     if (cmds.GetSize() < 3) {
-      PTRACE(2, "Bad Request-Line \"" << cmd << "\" received" << transportName);
+      PTRACE(2, "Bad Request-Line \"" << cmd << "\" received" << TransportTraceName(m_transport));
       return SIP_PDU::Failure_BadRequest;
     }
 
@@ -2325,7 +2681,7 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
     while (!(cmds[0] *= MethodNames[i])) {
       i++;
       if (i >= NumMethods) {
-        PTRACE(2, "Unknown method name " << cmds[0] << " received" << transportName);
+        PTRACE(2, "Unknown method name " << cmds[0] << " received" << TransportTraceName(m_transport));
         return SIP_PDU::Failure_BadRequest;
       }
     }
@@ -2338,50 +2694,39 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
   }
 
   if (m_versionMajor < 2) {
-    PTRACE(2, "Invalid version (" << m_versionMajor << ") received" << transportName);
+    PTRACE(2, "Invalid version (" << m_versionMajor << ") received" << TransportTraceName(m_transport));
     return SIP_PDU::Failure_BadRequest;
   }
 
-  // get the SDP content body
-  // if a content length is specified, read that length
-  // if no content length is specified (which is not the same as zero length)
-  // then read until end of datagram or stream
-  int contentLength = m_mime.GetContentLength();
-  bool contentLengthPresent = m_mime.IsContentLengthPresent();
+  return SIP_PDU::Successful_OK;
+}
+
+
+bool SIP_PDU::GetValidContentLength(int & contentLength) const
+{
+  contentLength = m_mime.GetContentLength();
 
-  if (!contentLengthPresent) {
-    PTRACE(2, "No Content-Length present" << transportName << ", reading till end of datagram/stream.");
+  if (!m_mime.IsContentLengthPresent()) {
+    PTRACE(2, "No Content-Length present" << TransportTraceName(m_transport) << ", reading till end of datagram/stream.");
+    return false;
   }
-  else if (contentLength < 0) {
-    PTRACE(2, "Impossible negative Content-Length" << transportName << ", reading till end of datagram/stream.");
-    contentLengthPresent = false;
+
+  if (contentLength < 0) {
+    PTRACE(2, "Impossible negative Content-Length" << TransportTraceName(m_transport) << ", reading till end of datagram/stream.");
+    return false;
   }
-  else if (contentLength > 65535) {
-    PTRACE(2, "Implausibly long Content-Length " << contentLength << " received" << transportName << ", reading to end of datagram/stream.");
-    contentLengthPresent = false;
+
+  if (contentLength > 65535) {
+    PTRACE(2, "Implausibly long Content-Length " << contentLength << " received" << TransportTraceName(m_transport) << ", reading to end of datagram/stream.");
+    return false;
   }
 
-  // Don't worry about body if was truncated packet
-  if (!truncated) {
-    if (contentLengthPresent) {
-      if (contentLength > 0) {
-        stream.read(m_entityBody.GetPointerAndSetLength(contentLength), contentLength);
-        if (stream.gcount() != (std::streamsize)contentLength)
-          truncated = true;
-      }
-    }
-    else {
-      contentLength = 0;
-      int c;
-      while ((c = stream.get()) != EOF) {
-        m_entityBody.SetMinSize((++contentLength/1000+1)*1000);
-        m_entityBody += (char)c;
-      }
-    }
+  return true;
+}
 
-    m_entityBody[contentLength] = '\0';
-  }
 
+SIP_PDU::StatusCodes SIP_PDU::ParseCompleted(const PString & PTRACE_PARAM(cmd), bool truncated, int PTRACE_PARAM(contentLength))
+{
 #if PTRACING
   if (PTrace::CanTrace(3)) {
     ostream & trace = PTRACE_BEGIN(3);